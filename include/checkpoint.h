@@ -0,0 +1,116 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Checkpoints of the evolution state of a shark execution
+ */
+
+#ifndef SHARK_CHECKPOINT_H_
+#define SHARK_CHECKPOINT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "execution.h"
+#include "options.h"
+
+namespace shark {
+
+/**
+ * A binary checkpoint of the evolution state of a shark execution.
+ *
+ * A checkpoint taken at a given snapshot contains the halos and subhalos of
+ * all merger trees from that snapshot onwards, including all their galaxies
+ * (and their histories), plus the global baryon bookkeeping. Halos of
+ * earlier snapshots are not needed anymore to continue the evolution, and
+ * are not stored, like when using execution.release_past_snapshots.
+ *
+ * Galaxies evolved out of a checkpoint are identical to those of an
+ * uninterrupted execution, as all random numbers are drawn from generators
+ * seeded with the execution seed and the ID of the object they are used for.
+ * Checkpoints are therefore identified by a key derived from the seed and
+ * the values of all options (except for those known not to change results,
+ * like execution.checkpoint_snapshots), and cannot be loaded by executions
+ * with a different key.
+ *
+ * Records are written as flat arrays of plain structures with index-based
+ * links, so they can be memory-mapped and turned back into objects using
+ * multiple threads.
+ */
+class Checkpoint {
+
+public:
+
+	/// Version of the on-disk format; it must be increased on every layout
+	/// change, including changes to the galaxy components stored in it
+	static const std::uint32_t VERSION = 1;
+
+	/**
+	 * Constructor
+	 *
+	 * @param filename The name of the checkpoint file
+	 * @param options The options of this execution
+	 * @param exec_params The execution parameters of this execution
+	 */
+	Checkpoint(const std::string &filename, const Options &options, const ExecutionParameters &exec_params);
+
+	/**
+	 * Saves the evolution state of @p trees once galaxies have been evolved
+	 * up to @p snapshot.
+	 *
+	 * @param snapshot The snapshot galaxies have been evolved up to
+	 * @param trees The merger trees to save
+	 * @param all_baryons The global baryon bookkeeping to save
+	 * @param threads The number of threads used to prepare the checkpoint
+	 */
+	void save(int snapshot, const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons, unsigned int threads) const;
+
+	/**
+	 * Loads the evolution state saved at @p snapshot, if the checkpoint file
+	 * exists. An exception is thrown if the file exists but was saved by an
+	 * execution with a different key, or at a different snapshot.
+	 *
+	 * @param snapshot The snapshot the checkpoint is expected to be saved at
+	 * @param trees The vector where loaded trees will be stored
+	 * @param all_baryons The TotalBaryon object where the global baryon
+	 * bookkeeping is loaded
+	 * @param threads The number of threads used to load the checkpoint
+	 * @return Whether the checkpoint file was found and loaded
+	 */
+	bool load(int snapshot, std::vector<MergerTreePtr> &trees, TotalBaryon &all_baryons, unsigned int threads) const;
+
+	/// @return The name of the checkpoint file used by this object
+	const std::string &get_filename() const
+	{
+		return filename;
+	}
+
+private:
+	std::string filename;
+	std::uint64_t key;
+	std::uint32_t seed;
+};
+
+}  // namespace shark
+
+#endif // SHARK_CHECKPOINT_H_
@@ -0,0 +1,132 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Columnar, memory-mappable merger tree files
+ */
+
+#ifndef SHARK_COLUMNAR_TREES_H_
+#define SHARK_COLUMNAR_TREES_H_
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+
+namespace shark {
+
+/**
+ * A merger tree file in shark's columnar format.
+ *
+ * Columnar tree files contain the same per-subhalo information that shark
+ * reads from SURFS HDF5 tree files, stored as fixed-width, native-endian
+ * arrays (one per property) which are memory-mapped rather than read.
+ * Rows are sorted by snapshot and host halo index, and an offsets table gives
+ * the first row of each snapshot, so readers can skip whole snapshots
+ * without touching their data.
+ *
+ * Columnar files are created out of SURFS HDF5 files with
+ * write_columnar_trees, or with the shark-convert-trees program.
+ */
+class ColumnarTreeFile {
+
+public:
+
+	/// Version of the on-disk format; it must be increased on every layout change
+	static const std::uint32_t VERSION = 1;
+
+	/// The columns contained in a columnar tree file
+	enum column_t {
+		POSITION = 0,
+		VELOCITY,
+		ANGULAR_MOMENTUM,
+		NODE_MASS,
+		GAS_MASS,
+		PARTICLE_NUMBER,
+		MAXIMUM_CIRCULAR_VELOCITY,
+		SNAPSHOT_NUMBER,
+		NODE_INDEX,
+		DESCENDANT_INDEX,
+		HOST_INDEX,
+		DESCENDANT_HOST,
+		IS_MAIN_PROGENITOR,
+		IS_INTERPOLATED,
+		N_COLUMNS
+	};
+
+	/**
+	 * Opens and maps the columnar tree file @p fname
+	 *
+	 * @param fname The name of the file
+	 */
+	explicit ColumnarTreeFile(const std::string &fname);
+
+	/// @return The number of rows (i.e., subhalos) in this file
+	std::size_t size() const;
+
+	/// @return The total number of files the original simulation was split into
+	unsigned int number_of_files() const;
+
+	/// @return Whether the file contains gas masses
+	bool has_gas_mass() const;
+
+	/**
+	 * Returns the index of the first row that belongs to @p snapshot or
+	 * any later snapshot.
+	 *
+	 * @param snapshot A snapshot number
+	 * @return The first row at or after @p snapshot
+	 */
+	std::size_t first_row_from(int snapshot) const;
+
+	/**
+	 * Returns a pointer to the beginning of column @p column. Vector columns
+	 * (position, velocity, angular momentum) have three elements per row.
+	 *
+	 * @param column The column to return
+	 * @return A pointer to the data of @p column
+	 */
+	template <typename T>
+	const T *column(column_t column) const
+	{
+		return file.at<T>(column_offset(column));
+	}
+
+private:
+	MappedFile file;
+	std::size_t column_offset(column_t column) const;
+};
+
+/**
+ * Converts the SURFS HDF5 tree file @p hdf5_fname into a columnar tree file
+ * named @p columnar_fname.
+ *
+ * @param hdf5_fname The name of the SURFS HDF5 file to convert
+ * @param columnar_fname The name of the columnar file to create
+ * @param gas_mass Whether to convert gas masses as well, which are present
+ * only in hydrodynamical simulations
+ * @return The number of rows written
+ */
+std::size_t write_columnar_trees(const std::string &hdf5_fname, const std::string &columnar_fname, bool gas_mass);
+
+}  // namespace shark
+
+#endif // SHARK_COLUMNAR_TREES_H_
@@ -55,7 +55,7 @@ public:
 
 	double toomre_parameter(const Galaxy &galaxy) const;
 
-	void evaluate_disk_instability (HaloPtr &halo, int snapshot, double delta_t);
+	void evaluate_disk_instability (const HaloPtr &halo, int snapshot, double delta_t);
 
 	void create_starburst(SubhaloPtr &subhalo, Galaxy &galaxy, double z, int snapshot, double delta_t);
 
@@ -0,0 +1,297 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Distributed execution of shark across subvolumes, with a coordinator
+ * handing out batches of subvolumes to workers
+ */
+
+#ifndef SHARK_DISTRIBUTED_H_
+#define SHARK_DISTRIBUTED_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "baryon.h"
+#include "total_baryon.h"
+
+namespace shark {
+
+// Forward declaration to avoid including options.h
+class Options;
+
+/// A set of subvolumes evolved together by a worker
+struct work_batch {
+
+	/// The ID of this batch
+	int id = 0;
+
+	/// The estimated cost of evolving this batch, in arbitrary units
+	double cost = 0;
+
+	/// The seed used to evolve this batch, the same for all batches
+	std::uint32_t seed = 0;
+
+	/// The subvolumes (simulation batches) of this batch
+	std::vector<unsigned int> subvolumes;
+};
+
+/// The global quantities tracked by a batch after evolving a snapshot.
+/// These are the entries for a single snapshot of a TotalBaryon, and are sent
+/// by workers as they are in memory
+struct snapshot_baryons {
+	std::int32_t batch;
+	std::int32_t snapshot;
+	BaryonBase mcold;
+	BaryonBase mstars;
+	BaryonBase mstars_burst_galaxymergers;
+	BaryonBase mstars_burst_diskinstabilities;
+	BaryonBase mhot_halo;
+	BaryonBase mcold_halo;
+	BaryonBase mejected_halo;
+	BaryonBase mBH;
+	BaryonBase mHI;
+	BaryonBase mH2;
+	BaryonBase mDM;
+	double SFR_disk;
+	double SFR_bulge;
+	double max_BH;
+	std::int32_t major_mergers;
+	std::int32_t minor_mergers;
+	std::int32_t disk_instabil;
+	/// Baryons created at snapshot + 1
+	double baryon_total_created;
+	/// Baryons lost at snapshot
+	double baryon_total_lost;
+};
+
+/**
+ * Returns the global quantities tracked in @p all_baryons for @p snapshot,
+ * which must be the last snapshot tracked.
+ *
+ * @param batch The ID of the batch evolved
+ * @param snapshot The snapshot just evolved
+ * @param all_baryons The global quantities tracked by the batch
+ * @return The global quantities of @p snapshot
+ */
+snapshot_baryons get_snapshot_baryons(int batch, int snapshot, const TotalBaryon &all_baryons);
+
+/// The outcome of evolving a batch
+struct batch_result {
+
+	/// The ID of the batch
+	int batch;
+
+	/// The reason why the batch failed, empty if it was evolved successfully
+	std::string error;
+};
+
+/**
+ * The means by which a coordinator and its workers communicate.
+ *
+ * The coordinator publishes a list of batches, which workers claim one after
+ * the other in the order they were published. While evolving a batch workers
+ * send its global quantities after each snapshot, and report when the batch
+ * is finished. The coordinator receives all of this periodically.
+ */
+class Transport {
+
+public:
+	virtual ~Transport() = default;
+
+	/// Makes @p batches available to workers, replacing any published before
+	virtual void publish(const std::vector<work_batch> &batches) = 0;
+
+	/**
+	 * Claims the next available batch for this worker.
+	 *
+	 * @param batch Set to the batch claimed
+	 * @return Whether a batch was claimed, false if none was left
+	 */
+	virtual bool claim(work_batch &batch) = 0;
+
+	/// Sends the global quantities of a snapshot of a claimed batch
+	virtual void send(const snapshot_baryons &baryons) = 0;
+
+	/// Reports that a claimed batch finished, successfully if @p error is empty
+	virtual void finish(int batch, const std::string &error) = 0;
+
+	/**
+	 * Receives all global quantities and results sent by workers since the
+	 * previous call. Global quantities of a batch are always received before
+	 * (or together with) its result.
+	 *
+	 * @param baryons Appended with the global quantities received
+	 * @param results Appended with the results received
+	 */
+	virtual void receive(std::vector<snapshot_baryons> &baryons, std::vector<batch_result> &results) = 0;
+};
+
+/**
+ * A transport between a coordinator and workers living in the same process,
+ * mainly useful for testing.
+ */
+class LocalTransport : public Transport {
+
+public:
+	void publish(const std::vector<work_batch> &batches) override;
+	bool claim(work_batch &batch) override;
+	void send(const snapshot_baryons &baryons) override;
+	void finish(int batch, const std::string &error) override;
+	void receive(std::vector<snapshot_baryons> &baryons, std::vector<batch_result> &results) override;
+
+private:
+	std::mutex mutex;
+	std::deque<work_batch> batches;
+	std::vector<snapshot_baryons> baryons;
+	std::vector<batch_result> results;
+};
+
+/**
+ * A transport through a directory visible to the coordinator and all its
+ * workers, like one in a shared filesystem.
+ *
+ * Batches are published as one file each under queue/, which appears only
+ * once all of them are written, and workers claim them by atomically
+ * renaming them into claimed/. Workers write global quantities and results
+ * as one file each under results/, and the coordinator reads them as they
+ * appear. Files are renamed into place once fully written, so they are never
+ * read half-way through.
+ */
+class DirectoryTransport : public Transport {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param directory The directory used to communicate
+	 */
+	explicit DirectoryTransport(const std::string &directory);
+
+	void publish(const std::vector<work_batch> &batches) override;
+	bool claim(work_batch &batch) override;
+	void send(const snapshot_baryons &baryons) override;
+	void finish(int batch, const std::string &error) override;
+	void receive(std::vector<snapshot_baryons> &baryons, std::vector<batch_result> &results) override;
+
+private:
+	std::string directory;
+	std::set<std::string> received;
+
+	void write_file(const std::string &name, const std::string &contents);
+};
+
+/**
+ * Hands out batches to workers through a Transport and assembles the global
+ * quantities they send back into those of the whole volume.
+ */
+class Coordinator {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param transport The transport used to communicate with workers
+	 * @param min_snapshot The first snapshot evolved by workers
+	 * @param max_snapshot The snapshot where evolution stops
+	 * @param worker_timeout How long receive() waits for workers to send
+	 * anything before giving up, zero meaning forever
+	 */
+	Coordinator(Transport &transport, int min_snapshot, int max_snapshot,
+	            std::chrono::steady_clock::duration worker_timeout = std::chrono::steady_clock::duration::zero());
+
+	/// Publishes @p batches for workers to claim, costliest first
+	void publish(std::vector<work_batch> batches);
+
+	/**
+	 * Receives the global quantities and results sent by workers, and logs
+	 * the global quantities of each snapshot once all batches have sent them.
+	 * If any batch failed, or if nothing has been received for longer than
+	 * the worker timeout, an exception is thrown.
+	 *
+	 * @return Whether all batches have finished
+	 */
+	bool receive();
+
+	/**
+	 * Returns the global quantities of all batches together, as they would
+	 * have been tracked by a single execution. Quantities are combined in
+	 * batch ID order, so they don't depend on which worker evolved what.
+	 *
+	 * @return The global quantities of all batches
+	 */
+	TotalBaryon get_total_baryons() const;
+
+private:
+	Transport &transport;
+	int min_snapshot;
+	int max_snapshot;
+	std::chrono::steady_clock::duration worker_timeout;
+	std::chrono::steady_clock::time_point last_received;
+	std::map<int, std::vector<unsigned int>> pending_batches;
+	std::size_t n_batches = 0;
+	std::map<int, std::map<int, snapshot_baryons>> batch_baryons;
+	std::map<int, std::size_t> snapshot_batches;
+};
+
+/**
+ * Runs a coordinator. One batch is created per subvolume in
+ * execution.simulation_batches, with the cost predicted for the subvolume by
+ * execution.tree_cost_model as its estimated cost, or the size of its tree
+ * file if the model doesn't know the cost of all subvolumes. Once all
+ * batches have been evolved by workers, the global quantities of the whole
+ * volume are written into global.hdf5.
+ *
+ * @param options The options of the execution
+ * @param transport The transport used to communicate with workers
+ * @param local_workers The number of worker processes to start in this
+ * machine, which requires @p transport to work across processes
+ * @param threads The number of threads used by each local worker
+ * @param worker_timeout How long to wait for workers to send anything before
+ * failing, zero meaning forever
+ */
+void run_coordinator(const Options &options, Transport &transport, unsigned int local_workers, unsigned int threads,
+                     std::chrono::steady_clock::duration worker_timeout = std::chrono::steady_clock::duration::zero());
+
+/**
+ * Runs a worker, which evolves batches until no batch is left to claim.
+ * Each batch is evolved by a separate shark execution using @p options,
+ * overridden by the batch's subvolumes and seed, and writes its outputs as
+ * usual.
+ *
+ * @param options The options of the execution, the same as the coordinator's
+ * @param transport The transport used to communicate with the coordinator
+ * @param threads The number of threads used to evolve each batch
+ * @return The number of batches evolved
+ */
+unsigned int run_worker(const Options &options, Transport &transport, unsigned int threads);
+
+}  // namespace shark
+
+#endif // SHARK_DISTRIBUTED_H_
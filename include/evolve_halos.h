@@ -34,25 +34,58 @@
 #include "cosmology.h"
 #include "execution.h"
 #include "physical_model.h"
+#include "ranges.h"
 #include "simulation.h"
 #include "star_formation.h"
 
 namespace shark {
 
+using halo_range = range<std::vector<HaloPtr>::const_iterator>;
+
 /**
  * Transfers galaxies of the subhalos of this snapshot into the corresponding
  * subhalos of the next snapshot, and baryon components from subhalo to subhalo.
+ * The baryons of subhalos without descendant are added up in the order of
+ * @p trees, so their total doesn't depend on how halos were grouped.
  *
- * @param halos The halos whose subhalos need to be transferred to the next snapshot
+ * @param trees All merger trees, always given in the same order
+ * @param halo_groups The halos whose subhalos need to be transferred to the
+ * next snapshot. Groups are processed in parallel, so the descendants of the
+ * halos of one group must not be shared with other groups (e.g., each group
+ * can contain the halos of a set of merger trees).
  * @param snapshot This snapshot
  * @param AllBaryons The TotalBaryon accummulation object
+ * @param threads The number of threads to use
  */
-void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons);
+void transfer_galaxies_to_next_snapshot(const std::vector<MergerTreePtr> &trees, const std::vector<halo_range> &halo_groups, int snapshot,
+		TotalBaryon &AllBaryons, unsigned int threads);
 
-void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat);
+/**
+ * Accumulates the global amounts of baryons (and other quantities) of the
+ * halos of all merger trees at this snapshot.
+ *
+ * @param cosmology The cosmology
+ * @param simulation_params The simulation parameters
+ * @param trees All merger trees, always given in the same order
+ * @param AllBaryons The TotalBaryon accummulation object
+ * @param snapshot This snapshot
+ * @param molgas The molecular gas of all galaxies
+ * @param deltat The duration of this snapshot
+ * @param threads The number of threads to use
+ */
+void track_total_baryons(Cosmology &cosmology, SimulationParameters simulation_params, const std::vector<MergerTreePtr> &trees,
+		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads);
+
+/**
+ * Appends the star formation and black hole history items of this snapshot
+ * to the galaxies of @p halo.
+ *
+ * @param halo The halo whose galaxies' histories are recorded
+ * @param snapshot This snapshot
+ */
+void record_galaxy_histories(const Halo &halo, int snapshot);
 
-void reset_instantaneous_galaxy_properties(const std::vector<HaloPtr> &halos, int snapshot);
+void reset_instantaneous_galaxy_properties(const std::vector<HaloPtr> &halos, int snapshot, unsigned int threads);
 
 }  // namespace shark
 
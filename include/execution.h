@@ -52,6 +52,16 @@ public:
 	bool output_snapshot(int snapshot);
 	int last_output_snapshot();
 
+	/**
+	 * Snapshots at which the evolution state is checkpointed, i.e., once
+	 * galaxies have been evolved up to (and written at, if requested) them.
+	 * Executions can be restarted from the latest of these checkpoints.
+	 */
+	std::set<int> checkpoint_snapshots;
+
+	/// Whether the evolution state should be checkpointed at @p snapshot
+	bool checkpoint_snapshot(int snapshot) const;
+
 	template <typename Component>
 	std::random_device::result_type get_seed(const Component &component)
 	{
@@ -85,6 +95,88 @@ public:
 	float ode_solver_precision = 0;
 	int ignore_npart_threshold = 1000;
 	float ignore_below_z = 1.0;
+
+	/**
+	 * Directory where fully-built merger trees are cached across executions.
+	 * An empty value (the default) disables the cache.
+	 */
+	std::string tree_cache_dir;
+
+	/**
+	 * Whether tree cache keys include checksums of the full contents of
+	 * input files, rather than only their names, sizes and modification
+	 * times, which is much cheaper but misses in-place modifications that
+	 * keep both.
+	 */
+	bool tree_cache_checksums = false;
+
+	/**
+	 * Whether the halos and subhalos of each snapshot are released after
+	 * their galaxies have been transferred to the next snapshot, reducing
+	 * the amount of memory used during the evolution.
+	 */
+	bool release_past_snapshots = false;
+
+	/**
+	 * Whether halos and subhalos are loaded from the tree cache one snapshot
+	 * at a time rather than all at once. Requires tree_cache_dir to be set,
+	 * and implies release_past_snapshots.
+	 */
+	bool stream_snapshots = false;
+
+	/**
+	 * Halo, subhalo and galaxy properties to write in galaxies.hdf5 files,
+	 * given as dataset names (e.g., ``galaxies/mstars_disk``). Names can
+	 * contain ``*`` wildcards, and are excluded rather than included when
+	 * prefixed with ``!``. If no names are included, all properties are
+	 * written except those excluded. An empty list (the default) writes
+	 * all properties.
+	 */
+	std::vector<std::string> output_properties;
+
+	/**
+	 * Whether the halo, subhalo or galaxy property @p name should be written,
+	 * according to output_properties.
+	 *
+	 * @param name The name of the property's dataset (e.g., ``halo/mvir``)
+	 * @return Whether the property should be written
+	 */
+	bool output_property(const std::string &name) const;
+
+	/**
+	 * If not 0, galaxies.hdf5 files are written in blocks of (approximately)
+	 * this many galaxies, bounding the memory needed to write them.
+	 */
+	unsigned int output_block_size = 0;
+
+	/**
+	 * File where machine-readable metrics of the execution are appended, as
+	 * one JSON object per line. An empty value (the default) disables them.
+	 */
+	std::string metrics_file;
+
+	/**
+	 * File where a sample of the ODE solutions of the galaxy evolution is
+	 * written, to be replayed by shark-bench-physics. An empty value (the
+	 * default) disables sampling.
+	 */
+	std::string solver_samples_file;
+
+	/// The number of ODE solutions sampled per snapshot
+	unsigned int solver_samples_per_snapshot = 100;
+
+	/**
+	 * File where the time taken to evolve each merger tree is written,
+	 * together with its structural features, to calibrate a tree cost model.
+	 * An empty value (the default) disables it.
+	 */
+	std::string tree_timings_file;
+
+	/**
+	 * Tree cost model used to partition merger trees across threads. An
+	 * empty value (the default) uses their initial galaxy count as cost.
+	 */
+	std::string tree_cost_model;
 };
 
 } // namespace shark
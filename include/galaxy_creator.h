@@ -39,12 +39,23 @@ public:
 	GalaxyCreator(CosmologyPtr cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params);
 	void create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons);
 
+	/**
+	 * Creates the galaxies of the given halos at @p snapshot. Snapshots must
+	 * be given in increasing order, so galaxy IDs and the total amount of
+	 * baryons created are the same as if all of them were created at once.
+	 *
+	 * @return The number of galaxies created
+	 */
+	int create_galaxies(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons);
+
 private:
 	bool create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t ID);
 
 	CosmologyPtr cosmology;
 	GasCoolingParameters cool_params;
 	SimulationParameters sim_params;
+	Galaxy::id_t next_galaxy_id = 0;
+	double total_baryon = 0;
 };
 
 }  // namespace shark
@@ -132,15 +132,15 @@ public:
 	 * @param halo the halo where subhalos are going to be possibly merged
 	 * @param z the redshift
 	 */
-	void merging_subhalos(HaloPtr &halo, double z, int snapshot);
+	void merging_subhalos(const HaloPtr &halo, double z, int snapshot);
 
-	void merging_galaxies(HaloPtr &halo, int snapshot, double delta_t);
+	void merging_galaxies(const HaloPtr &halo, int snapshot, double delta_t);
 
-	void create_merger(Galaxy &central, const Galaxy &satellite, HaloPtr &halo, int snapshot) const;
+	void create_merger(Galaxy &central, const Galaxy &satellite, const HaloPtr &halo, int snapshot) const;
 
-	void create_starbursts(HaloPtr &halo, double z, double delta_t);
+	void create_starbursts(const HaloPtr &halo, double z, double delta_t);
 
-	double bulge_size_merger(double mass_ratio, double mgas_ratio, const Galaxy &central, const Galaxy &satellite, HaloPtr &halo, double z) const;
+	double bulge_size_merger(double mass_ratio, double mgas_ratio, const Galaxy &central, const Galaxy &satellite, const HaloPtr &halo, double z) const;
 
 	double r_remnant(double mc, double ms, double rc, double rs) const;
 
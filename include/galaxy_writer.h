@@ -45,6 +45,9 @@
 
 namespace shark {
 
+struct GalaxyColumns;
+class SelectedColumnsWriter;
+
 class GalaxyWriter {
 
 public:
@@ -54,13 +57,31 @@ public:
 			CosmologyPtr cosmology,
 			DarkMatterHalosPtr darkmatterhalo,
 			SimulationParameters sim_params,
-			AGNFeedbackParameters agn_params);
+			AGNFeedbackParameters agn_params,
+			unsigned int threads = 1);
 	virtual ~GalaxyWriter() = default;
 
 	virtual void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) = 0;
 
 	void track_total_baryons(int snapshot, const std::vector<HaloPtr> &halos);
 
+	/**
+	 * Returns the name of the directory where the outputs of @p snapshot are
+	 * written, without creating it.
+	 *
+	 * @param snapshot The snapshot whose outputs are written
+	 * @return The name of the output directory for @p snapshot
+	 */
+	std::string get_output_directory_name(int snapshot) const;
+
+	/**
+	 * Returns the name of the directory of this model, under which the
+	 * outputs of all snapshots are written, without creating it.
+	 *
+	 * @return The name of the directory of this model
+	 */
+	std::string get_model_directory_name() const;
+
 protected:
 
 	ExecutionParameters exec_params;
@@ -69,6 +90,7 @@ protected:
 	DarkMatterHalosPtr darkmatterhalo;
 	SimulationParameters sim_params;
 	AGNFeedbackParameters agn_params;
+	unsigned int threads;
 
 	std::string get_output_directory(int snapshot);
 };
@@ -79,9 +101,22 @@ public:
 	using GalaxyWriter::GalaxyWriter;
 	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
 
+	/**
+	 * Writes the global properties in @p AllBaryons, up to @p snapshot, into
+	 * a global.hdf5 file in the directory of this model.
+	 *
+	 * @param snapshot The last snapshot whose global properties are written
+	 * @param AllBaryons The global properties to write
+	 * @return The name of the file written
+	 */
+	std::string write_global(int snapshot, TotalBaryon &AllBaryons);
+
 private:
 	void write_header (hdf5::Writer &file, int snapshot);
 	void write_galaxies (hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
+	void write_galaxies_in_blocks (SelectedColumnsWriter &writer, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
+	std::size_t fill_galaxy_columns (GalaxyColumns &columns, int snapshot, const std::vector<HaloPtr> &halos, std::size_t first_halo, std::size_t last_halo, std::size_t first_subhalo, const molgas_per_galaxy &molgas_per_gal);
+	void write_galaxy_columns (SelectedColumnsWriter &writer, const GalaxyColumns &columns);
 	void write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons);
 	void write_sf_histories (int snapshot, const std::vector<HaloPtr> &halos);
 	void write_bh_histories (int snapshot, const std::vector<HaloPtr> &halos);
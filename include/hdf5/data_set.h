@@ -26,6 +26,7 @@
 #ifndef SHARK_HDF5_DATA_SET_H
 #define SHARK_HDF5_DATA_SET_H
 
+#include <vector>
 #include <hdf5.h>
 #include "hdf5/location.h"
 
@@ -41,12 +42,16 @@ public:
 
 	static DataSet
 	create(AbstractGroup& parent, const std::string& name, const DataType& dataType, const DataSpace& dataSpace);
+	static DataSet
+	create(AbstractGroup& parent, const std::string& name, const DataType& dataType, const DataSpace& dataSpace,
+	       const std::vector<hsize_t>& chunk_dimensions);
 
 	DataType getDataType() const;
 	DataSpace getSpace() const;
 
 	void read(void* buf, const DataType& dataType, const DataSpace& memSpace, const DataSpace& fileSpace) const;
 	void write(const void* buf, const DataType& memDataType, const DataSpace& memSpace, const DataSpace& fileSpace);
+	void setExtent(const std::vector<hsize_t>& dimensions);
 
 private:
 	explicit DataSet(hid_t handle);
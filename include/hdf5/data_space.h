@@ -54,6 +54,7 @@ public:
 
 	static DataSpace create(const DataSpaceType& type);
 	static DataSpace create(std::vector<hsize_t> dimensions);
+	static DataSpace create(std::vector<hsize_t> dimensions, std::vector<hsize_t> max_dimensions);
 
 	int getSimpleExtentNdims() const;
 	std::vector<hsize_t> getSimpleExtentDims() const;
@@ -26,6 +26,7 @@
 #ifndef SHARK_HDF5_GROUP_H
 #define SHARK_HDF5_GROUP_H
 
+#include <vector>
 #include "hdf5/location.h"
 
 namespace shark {
@@ -46,6 +47,8 @@ public:
 	DataSet openDataSet(const std::string& name) const;
 	Group createGroup(const std::string& name);
 	DataSet createDataSet(const std::string& name, const DataType& dataType, const DataSpace& dataSpace);
+	DataSet createDataSet(const std::string& name, const DataType& dataType, const DataSpace& dataSpace,
+	                      const std::vector<hsize_t>& chunk_dimensions);
 };
 
 class Group : public AbstractGroup {
@@ -26,6 +26,7 @@
 #ifndef SHARK_HDF5_WRITER_H_
 #define SHARK_HDF5_WRITER_H_
 
+#include <algorithm>
 #include <iterator>
 #include <memory>
 #include <sstream>
@@ -265,10 +266,71 @@ public:
 		_write_dataset(dataset, dataType, dataSpace, values);
 	}
 
+	/**
+	 * Writes @p values, given row after row, as the two-dimensional dataset
+	 * @p name with @p columns values per row. This is the counterpart of
+	 * Reader::read_dataset_v_2.
+	 *
+	 * @param name The name of the dataset
+	 * @param values The values to write
+	 * @param columns The number of values in each row
+	 * @param comment An optional comment for the dataset
+	 */
+	template<typename T>
+	void write_dataset_v_2(const std::string& name, const std::vector<T>& values, hsize_t columns,
+	                       const std::string& comment = NO_COMMENT) {
+		auto dataSpace = DataSpace::create({values.size() / columns, columns});
+		DataType dataType = _datatype<T>(values);
+		auto dataset = get_or_create_dataset(tokenize(name, "/"), dataType, dataSpace);
+		set_comment(dataset, comment);
+		_write_dataset(dataset, dataType, dataSpace, values);
+	}
+
+	/**
+	 * Creates the one-dimensional dataset @p name with no elements and
+	 * unlimited maximum size, to which values can be later added with
+	 * append_dataset.
+	 *
+	 * @param name The name of the dataset
+	 * @param chunk_size The number of elements in each of the dataset's chunks
+	 * @param comment An optional comment for the dataset
+	 */
+	template<typename T>
+	void create_extendible_dataset(const std::string& name, hsize_t chunk_size, const std::string& comment = NO_COMMENT) {
+		DataType dataType = _datatype<T>(std::vector<T>{});
+		auto dataset = create_extendible_dataset(tokenize(name, "/"), dataType, std::max(chunk_size, hsize_t(1)));
+		set_comment(dataset, comment);
+	}
+
+	/**
+	 * Appends @p values at the end of the dataset @p name,
+	 * which must have been created with create_extendible_dataset.
+	 *
+	 * @param name The name of the dataset
+	 * @param values The values to append
+	 */
+	template<typename T>
+	void append_dataset(const std::string& name, const std::vector<T>& values) {
+		if (values.empty()) {
+			return;
+		}
+		auto dataset = get_dataset(tokenize(name, "/"));
+		auto size = dataset.getSpace().getSimpleExtentDims()[0];
+		dataset.setExtent({size + values.size()});
+		auto fileSpace = dataset.getSpace();
+		fileSpace.selectHyperslab(HyperslabSelection::Set, {size}, {1}, {values.size()}, {1});
+		auto memSpace = DataSpace::create({values.size()});
+		DataType mem_dataType(datatype_traits<T>::native_type);
+		dataset.write(values.data(), mem_dataType, memSpace, fileSpace);
+	}
+
 private:
 
 	Group get_or_create_group(const std::vector<std::string>& path);
 
+	DataSet
+	create_extendible_dataset(const std::vector<std::string>& path, const DataType& dataType, hsize_t chunk_size);
+
 	DataSet
 	get_or_create_dataset(const std::vector<std::string>& path, const DataType& dataType, const DataSpace& dataSpace);
 
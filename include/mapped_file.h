@@ -0,0 +1,90 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Read-only, memory-mapped files
+ */
+
+#ifndef SHARK_MAPPED_FILE_H_
+#define SHARK_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A read-only view over the full contents of a file.
+ *
+ * On POSIX systems the file is mapped into memory, so its contents are
+ * paged in lazily by the operating system and shared with the page cache.
+ * On other systems the file is read into a private buffer instead.
+ */
+class MappedFile {
+
+public:
+
+	/**
+	 * Maps file @p fname into memory
+	 *
+	 * @param fname The name of the file to map
+	 */
+	explicit MappedFile(const std::string &fname);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	/// @return A pointer to the beginning of the file contents
+	const char *data() const
+	{
+		return m_data;
+	}
+
+	/// @return The size of the file, in bytes
+	std::size_t size() const
+	{
+		return m_size;
+	}
+
+	/**
+	 * Returns a typed pointer to the contents of the file starting at
+	 * @p offset bytes.
+	 *
+	 * @param offset The offset from the beginning of the file, in bytes
+	 * @return A pointer to the contents of the file at @p offset
+	 */
+	template <typename T>
+	const T *at(std::size_t offset) const
+	{
+		return reinterpret_cast<const T *>(m_data + offset);
+	}
+
+private:
+	const char *m_data = nullptr;
+	std::size_t m_size = 0;
+	std::vector<char> m_buffer;
+};
+
+}  // namespace shark
+
+#endif // SHARK_MAPPED_FILE_H_
@@ -67,25 +67,54 @@ public:
 
 	using Identifiable::Identifiable;
 
-	using root_subrange = range_filter<std::vector<HaloPtr>, detail::is_root>;
-	using snapshot_subrange = range<std::vector<HaloPtr>::iterator>;
+	// Halos are only given out through const iterators, so this tree stays
+	// in control of which halos it contains and in which order
+	using root_subrange = range_filter<const std::vector<HaloPtr>, detail::is_root>;
+	using snapshot_subrange = range<std::vector<HaloPtr>::const_iterator>;
+
+	/// @return All halos contained in this merger tree
+	const std::vector<HaloPtr> &get_halos() const
+	{
+		return halos;
+	}
 
 	void add_halo(const HaloPtr &halo) {
+		insert_halo(halos.end(), halo);
+	}
+
+	/**
+	 * Inserts @p halo in this merger tree before @p position. Like add_halo,
+	 * this drops the snapshot offsets table.
+	 *
+	 * @param position The position before which @p halo is inserted
+	 * @param halo The halo to insert
+	 */
+	void insert_halo(std::vector<HaloPtr>::const_iterator position, const HaloPtr &halo)
+	{
 		if (last_snapshot < halo->snapshot) {
 			last_snapshot = halo->snapshot;
 		}
-		halos.push_back(halo);
+		halos.insert(position, halo);
+		snapshot_offsets.clear();
 	}
 
-	snapshot_subrange halos_at(int snapshot)
+	snapshot_subrange halos_at(int snapshot) const
 	{
+		// Use the snapshot offsets table if there is one
+		if (!snapshot_offsets.empty()) {
+			if (snapshot < first_snapshot || snapshot >= first_snapshot + int(snapshot_offsets.size()) - 1) {
+				return {halos.cend(), halos.cend()};
+			}
+			auto i = std::size_t(snapshot - first_snapshot);
+			return {halos.cbegin() + snapshot_offsets[i], halos.cbegin() + snapshot_offsets[i + 1]};
+		}
 		return {
-			std::lower_bound(halos.begin(), halos.end(), snapshot, by_snapshot{}),
-			std::upper_bound(halos.begin(), halos.end(), snapshot, by_snapshot{})
+			std::lower_bound(halos.cbegin(), halos.cend(), snapshot, by_snapshot{}),
+			std::upper_bound(halos.cbegin(), halos.cend(), snapshot, by_snapshot{})
 		};
 	}
 
-	snapshot_subrange halos_at_last_snapshot()
+	snapshot_subrange halos_at_last_snapshot() const
 	{
 		return halos_at(last_snapshot);
 	}
@@ -93,13 +122,38 @@ public:
 	void consolidate()
 	{
 		std::sort(halos.begin(), halos.end(), by_snapshot{});
+		index_snapshots();
+	}
+
+	/**
+	 * Builds the table with the position of the first halo of each snapshot,
+	 * which halos_at() uses to find halos in constant time. Halos must be
+	 * sorted by snapshot already. Adding halos drops the table, and until this
+	 * is called again halos_at() falls back to a binary search.
+	 */
+	void index_snapshots()
+	{
+		snapshot_offsets.clear();
+		if (halos.empty()) {
+			return;
+		}
+		first_snapshot = halos.front()->snapshot;
+		auto last_snapshot = halos.back()->snapshot;
+		snapshot_offsets.reserve(last_snapshot - first_snapshot + 2);
+		std::size_t i = 0;
+		for (int snapshot = first_snapshot; snapshot <= last_snapshot + 1; snapshot++) {
+			while (i != halos.size() && halos[i]->snapshot < snapshot) {
+				i++;
+			}
+			snapshot_offsets.push_back(i);
+		}
 	}
 
 	/**
 	 * Get all the roots of this merger tree -- that is, all Halos
 	 * that don't have an ascendant.
 	 */
-	root_subrange roots()
+	root_subrange roots() const
 	{
 		return {halos};
 	}
@@ -115,10 +169,24 @@ public:
 		});
 	}
 
-	/// All halos contained in this merger tree
-	std::vector<HaloPtr> halos;
+	/**
+	 * Releases the halos (and their subhalos) of this merger tree up to
+	 * @p snapshot, breaking the links with their descendants that would
+	 * otherwise keep them alive.
+	 *
+	 * @param snapshot The last snapshot whose halos are released
+	 */
+	void release_halos(int snapshot);
+
 	/// Last snapshot included by this MergerTree
 	int last_snapshot = -1;
+
+private:
+	/// All halos contained in this merger tree, only modified through the
+	/// methods above so the snapshot offsets table never gets out of date
+	std::vector<HaloPtr> halos;
+	int first_snapshot = 0;
+	std::vector<std::size_t> snapshot_offsets;
 };
 
 template <typename T>
@@ -0,0 +1,128 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Flat representation of the halos of a merger tree and their links
+ */
+
+#ifndef SHARK_MERGER_TREE_GRAPH_H_
+#define SHARK_MERGER_TREE_GRAPH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "components.h"
+#include "ranges.h"
+
+namespace shark {
+
+/**
+ * A flat, read-only view of the halos of a MergerTree and the links between
+ * them.
+ *
+ * Halos are identified by integer handles, which are their positions in the
+ * tree's list of halos (sorted by snapshot). Descendants and main progenitors
+ * are stored as handles, and progenitors in compressed sparse row form (one
+ * offsets array and one handles array), so algorithms walking the tree don't
+ * need to follow pointers or look halos up. The view is valid as long as the
+ * halos of the tree and their links are not modified.
+ */
+class MergerTreeGraph {
+
+public:
+	using handle_t = std::int32_t;
+	using handle_range = range<const handle_t *>;
+
+	/// The handle used to denote "no halo"
+	static constexpr handle_t none = -1;
+
+	MergerTreeGraph() = default;
+
+	/**
+	 * Creates the graph of @p tree, which must have been consolidated already.
+	 * Main progenitors are found through the halos' central subhalos,
+	 * which must have been defined for them to be present in the graph.
+	 *
+	 * @param tree The tree to create a graph for
+	 */
+	explicit MergerTreeGraph(const MergerTree &tree);
+
+	/// @return The number of halos in the graph
+	std::size_t size() const
+	{
+		return descendants.size();
+	}
+
+	/// @return The halo with handle @p h
+	const HaloPtr &halo(handle_t h) const
+	{
+		return (*halos)[h];
+	}
+
+	/// @return The handle of the descendant of halo @p h, or none
+	handle_t descendant(handle_t h) const
+	{
+		return descendants[h];
+	}
+
+	/// @return The handle of the main progenitor of halo @p h, or none
+	handle_t main_progenitor(handle_t h) const
+	{
+		return main_progenitors[h];
+	}
+
+	/// @return The handles of the progenitors of halo @p h, in their original order
+	handle_range progenitors(handle_t h) const
+	{
+		return {progenitor_handles.data() + progenitor_offsets[h], progenitor_handles.data() + progenitor_offsets[h + 1]};
+	}
+
+	/**
+	 * Returns the range of handles of the halos at @p snapshot in constant time.
+	 *
+	 * @param snapshot The snapshot of the halos
+	 * @return A [first, last) pair of handles
+	 */
+	std::pair<handle_t, handle_t> halos_at(int snapshot) const
+	{
+		if (snapshot_offsets.empty() || snapshot < first_snapshot) {
+			return {0, 0};
+		}
+		auto i = std::size_t(snapshot - first_snapshot);
+		if (i + 1 >= snapshot_offsets.size()) {
+			return {handle_t(size()), handle_t(size())};
+		}
+		return {snapshot_offsets[i], snapshot_offsets[i + 1]};
+	}
+
+private:
+	const std::vector<HaloPtr> *halos = nullptr;
+	int first_snapshot = 0;
+	std::vector<handle_t> snapshot_offsets;
+	std::vector<handle_t> descendants;
+	std::vector<handle_t> main_progenitors;
+	std::vector<handle_t> progenitor_offsets;
+	std::vector<handle_t> progenitor_handles;
+};
+
+}  // namespace shark
+
+#endif // SHARK_MERGER_TREE_GRAPH_H_
@@ -33,6 +33,8 @@
 
 namespace shark {
 
+struct SubhaloColumns;
+
 class SURFSReader {
 
 public:
@@ -46,6 +48,14 @@ public:
 
 	const std::vector<HaloPtr> read_halos(std::vector<unsigned int> batches);
 
+	/**
+	 * Returns the names of the files that will be read for the given batches
+	 *
+	 * @param batches The batches to read
+	 * @return The filenames for @p batches
+	 */
+	const std::vector<std::string> get_filenames(const std::vector<unsigned int> &batches);
+
 private:
 	std::string prefix;
 	DarkMatterHalosPtr dark_matter_halos;
@@ -54,7 +64,9 @@ private:
 
 	const std::vector<HaloPtr> read_halos(unsigned int batch);
 	const std::vector<SubhaloPtr> read_subhalos(unsigned int batch);
+	const std::vector<SubhaloPtr> create_subhalos(const SubhaloColumns &columns, const std::string &fname);
 	const std::string get_filename(unsigned int batch);
+	unsigned int get_number_of_files();
 
 };
 
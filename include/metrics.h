@@ -0,0 +1,143 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Machine-readable execution metrics
+ */
+
+#ifndef SHARK_METRICS_H_
+#define SHARK_METRICS_H_
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A single metrics record, built as a flat JSON object.
+ *
+ * All records have a "type" member identifying them, followed by the members
+ * added to them in order. Non-finite floating-point values are written as
+ * null.
+ */
+class MetricsRecord {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param type The type of this record
+	 */
+	explicit MetricsRecord(const std::string &type);
+
+	/**
+	 * Adds member @p name with value @p value to this record. Values can be
+	 * numbers, booleans, strings, or vectors of any of them.
+	 *
+	 * @return This record
+	 */
+	template <typename T>
+	MetricsRecord &add(const std::string &name, const T &value)
+	{
+		os << ',';
+		write_value(name);
+		os << ':';
+		write_value(value);
+		return *this;
+	}
+
+	/// @return This record as a JSON object
+	std::string str() const;
+
+private:
+	std::ostringstream os;
+
+	template <typename T>
+	void write_value(const T &value, typename std::enable_if<std::is_integral<T>::value>::type * = nullptr)
+	{
+		os << value;
+	}
+
+	template <typename T>
+	void write_value(const T &value, typename std::enable_if<std::is_floating_point<T>::value>::type * = nullptr)
+	{
+		write_double(double(value));
+	}
+
+	template <typename T>
+	void write_value(const std::vector<T> &values)
+	{
+		os << '[';
+		for (std::size_t i = 0; i != values.size(); i++) {
+			if (i != 0) {
+				os << ',';
+			}
+			write_value(values[i]);
+		}
+		os << ']';
+	}
+
+	void write_value(bool value);
+	void write_value(const char *value);
+	void write_value(const std::string &value);
+	void write_double(double value);
+};
+
+/**
+ * A JSON Lines file where metrics records are appended.
+ *
+ * Records are written (and flushed) as soon as they are given, so metrics of
+ * executions that end abruptly are not lost. An object created with an empty
+ * filename is disabled and ignores all records.
+ */
+class Metrics {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param filename The name of the metrics file. If empty, metrics are
+	 * disabled
+	 */
+	explicit Metrics(const std::string &filename);
+
+	/// @return Whether records are written at all
+	bool enabled() const
+	{
+		return f.is_open();
+	}
+
+	/// Appends @p record to the metrics file, if enabled
+	void write(const MetricsRecord &record);
+
+private:
+	std::string filename;
+	std::ofstream f;
+};
+
+}  // namespace shark
+
+#endif // SHARK_METRICS_H_
@@ -27,6 +27,7 @@
 #define SHARK_ODE_SOLVER_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <gsl/gsl_odeiv2.h>
@@ -74,8 +75,19 @@ public:
 	 * @param dimension The dimensionality of the ODE system to solve
 	 * @param precision The precision to use for the adaptive step sizes.
 	 * @param params The parameters to pass down to ``evaluator``
+	 * @param step_type The GSL stepping function used to solve the system
 	 */
-	ODESolver(ode_evaluator evaluator, size_t dimension, double precision, void *params);
+	ODESolver(ode_evaluator evaluator, size_t dimension, double precision, void *params,
+	          const gsl_odeiv2_step_type *step_type = gsl_odeiv2_step_rkck);
+
+	/**
+	 * Returns the GSL stepping function called @p name (e.g., ``rkck``).
+	 * Only stepping functions that don't need a Jacobian are supported.
+	 *
+	 * @param name The name of the stepping function
+	 * @return The stepping function
+	 */
+	static const gsl_odeiv2_step_type *step_type(const std::string &name);
 
 	/**
 	 * Evolves the ODE system from 0 to ``delta_t``
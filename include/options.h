@@ -101,6 +101,20 @@ public:
 		}
 	}
 
+	/// Returns all the options that belong to group `group`
+	///
+	/// @param group The option group name (e.g., "simulation")
+	/// @return The options of the group, indexed by their full name
+	options_t get_group(const std::string &group) const;
+
+	/// Returns all the options held by this object
+	///
+	/// @return All options, indexed by their full name
+	const options_t &get_all() const
+	{
+		return options;
+	}
+
 	/// Parses `optspec` into its `name` and `value` components. It does so by
 	/// looking at an equals ("=") sign and interpreting the left-hand side string
 	/// as an option name and the right-hand side string as a value
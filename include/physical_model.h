@@ -37,6 +37,7 @@
 #include "numerical_constants.h"
 #include "ode_solver.h"
 #include "recycling.h"
+#include "solver_samples.h"
 #include "stellar_feedback.h"
 #include "star_formation.h"
 #include "subhalo.h"
@@ -48,6 +49,9 @@ class PhysicalModel {
 
 public:
 
+	/// The number of equations of the ODE system solved by this model
+	static constexpr int DIMENSION = NC;
+
 	/**
 	 * The set of parameters passed down to the ODESolver. It includes the
 	 * physical model itself, the galaxy and subhalo being evolved on each call,
@@ -79,6 +83,38 @@ public:
 		double vsubh;
 		double vgal;
 		BlackHole smbh;
+
+		/// Stores these parameters into @p record
+		void save(solver_sample_record &record) const
+		{
+			record.burst = burst;
+			record.rgas = rgas;
+			record.rstar = rstar;
+			record.mcoolrate = mcoolrate;
+			record.zcool = zcool;
+			record.jcold_halo = jcold_halo;
+			record.delta_t = delta_t;
+			record.redshift = redshift;
+			record.vsubh = vsubh;
+			record.vgal = vgal;
+			record.smbh = smbh;
+		}
+
+		/// Sets these parameters from @p record
+		void restore(const solver_sample_record &record)
+		{
+			burst = record.burst != 0;
+			rgas = record.rgas;
+			rstar = record.rstar;
+			mcoolrate = record.mcoolrate;
+			zcool = record.zcool;
+			jcold_halo = record.jcold_halo;
+			delta_t = record.delta_t;
+			redshift = record.redshift;
+			vsubh = record.vsubh;
+			vgal = record.vgal;
+			smbh = record.smbh;
+		}
 	};
 
 	PhysicalModel(
@@ -100,6 +136,36 @@ public:
 	virtual ~PhysicalModel() = default;
 
 	void evolve_galaxy(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
+	{
+		// Define cooling rate only in the case galaxy is central.
+		auto mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
+		set_solver_state(params, ode_values, subhalo, galaxy, z, delta_t, mcoolrate);
+		std::uint64_t sample_key;
+		bool sample = sample_recorder && sample_recorder->should_sample(galaxy.id, false, sample_key);
+		if (sample) {
+			sample_values = ode_values;
+		}
+		ode_solver.evolve(ode_values, delta_t);
+		galaxy_ode_evaluations += ode_solver.num_evaluations();
+		if (sample) {
+			record_sample(sample_key, galaxy.id, params, ode_solver.num_evaluations(), ode_values);
+		}
+		to_galaxy(ode_values, subhalo, galaxy, delta_t);
+	}
+
+	/**
+	 * Sets the parameters and initial values of the ODE system that evolves
+	 * @p galaxy, as done by evolve_galaxy once the cooling rate is known.
+	 *
+	 * @param params The parameters to set
+	 * @param y The initial values to set
+	 * @param subhalo The subhalo hosting @p galaxy
+	 * @param galaxy The galaxy to evolve
+	 * @param z The current redshift
+	 * @param delta_t The time span of the evolution
+	 * @param mcoolrate The gas cooling rate onto @p galaxy
+	 */
+	void set_solver_state(solver_params &params, std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy, double z, double delta_t, double mcoolrate)
 	{
 		/**
 		 * Parameters that are needed as input in the ode_solver:
@@ -114,8 +180,7 @@ public:
 		 * burst: boolean parameter indicating if this is a starburst or not.
 		 */
 
-		// Define cooling rate only in the case galaxy is central.
-		params.mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
+		params.mcoolrate = mcoolrate;
 		if(subhalo.cold_halo_gas.mass > 0){
 			params.zcool = subhalo.cold_halo_gas.mass_metals /  subhalo.cold_halo_gas.mass;
 		}
@@ -140,10 +205,7 @@ public:
 		params.smbh = galaxy.smbh;
 		params.redshift = z;
 
-		from_galaxy(ode_values, subhalo, galaxy);
-		ode_solver.evolve(ode_values, delta_t);
-		galaxy_ode_evaluations += ode_solver.num_evaluations();
-		to_galaxy(ode_values, subhalo, galaxy, delta_t);
+		from_galaxy(y, subhalo, galaxy);
 	}
 
 	void evolve_galaxy_starburst(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t, bool from_galaxy_merger)
@@ -171,8 +233,16 @@ public:
 		starburst_params.smbh = galaxy.smbh;
 
 		from_galaxy_starburst(starburst_ode_values, subhalo, galaxy);
+		std::uint64_t sample_key;
+		bool sample = sample_recorder && sample_recorder->should_sample(galaxy.id, true, sample_key);
+		if (sample) {
+			sample_values = starburst_ode_values;
+		}
 		starburst_ode_solver.evolve(starburst_ode_values, delta_t);
 		galaxy_starburst_ode_evaluations += starburst_ode_solver.num_evaluations();
+		if (sample) {
+			record_sample(sample_key, galaxy.id, starburst_params, starburst_ode_solver.num_evaluations(), starburst_ode_values);
+		}
 		to_galaxy_starburst(starburst_ode_values, subhalo, galaxy, delta_t, from_galaxy_merger);
 	}
 
@@ -195,6 +265,12 @@ public:
 		galaxy_starburst_ode_evaluations = 0;
 	}
 
+	/// Sets the recorder where a sample of the ODE solutions made by this
+	/// model is kept, or nullptr (the default) to not sample them
+	void set_sample_recorder(SolverSampleRecorder *recorder) {
+		sample_recorder = recorder;
+	}
+
 private:
 	solver_params params;
 	solver_params starburst_params;
@@ -205,8 +281,29 @@ private:
 	GasCooling gas_cooling;
 	std::size_t galaxy_ode_evaluations;
 	std::size_t galaxy_starburst_ode_evaluations;
+	SolverSampleRecorder *sample_recorder = nullptr;
+	std::vector<double> sample_values;
+
+	void record_sample(std::uint64_t key, Galaxy::id_t galaxy_id, const solver_params &sample_params, std::size_t evaluations, const std::vector<double> &final_values)
+	{
+		solver_sample sample {};
+		sample.key = key;
+		sample_params.save(sample.record);
+		sample.record.galaxy_id = galaxy_id;
+		sample.record.evaluations = evaluations;
+		sample.initial_values = std::move(sample_values);
+		sample.final_values = final_values;
+		sample_recorder->add(std::move(sample));
+	}
 };
 
+/**
+ * Evaluates the ODE system of BasicPhysicalModel, which is given as @p data
+ * (a BasicPhysicalModel::solver_params object). It follows the
+ * ODESolver::ode_evaluator definition.
+ */
+int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *data);
+
 class BasicPhysicalModel : public PhysicalModel<19> {
 public:
 	BasicPhysicalModel(double ode_solver_precision,
@@ -43,7 +43,7 @@ namespace shark {
  * method) and a unary predicate function object and allows easy iteration over
  * the filtered elements of the range for which the predicate is true. Iteration
  * is provided via begin() and end() iterators, and therefore this class is also
- * a range.
+ * a range. Filters over a const Range only give const access to its elements.
  */
 template <typename Range, typename UnaryPredicate>
 class range_filter {
@@ -62,8 +62,8 @@ public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = typename Range::value_type;
 		using difference_type = std::ptrdiff_t;
-		using reference = typename std::conditional<is_const, const value_type &, value_type &>::type;
-		using pointer = typename std::conditional<is_const, const value_type *, value_type *>::type;
+		using reference = typename std::conditional<is_const || std::is_const<Range>::value, const value_type &, value_type &>::type;
+		using pointer = typename std::conditional<is_const || std::is_const<Range>::value, const value_type *, value_type *>::type;
 
 	private:
 		typename Range::const_iterator m_pos;
@@ -26,12 +26,16 @@
 #ifndef SHARK_SHARK_RUNNER_H
 #define SHARK_SHARK_RUNNER_H
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace shark {
 
-// Forward declaration to avoid including options.h
+// Forward declarations to avoid including options.h and total_baryon.h
 class Options;
+class TotalBaryon;
 
 /**
  * The main driver of a shark instance run.
@@ -62,9 +66,52 @@ public:
 	/// Run shark until completion
 	void run();
 
+	/**
+	 * Resumes a previous execution from its latest checkpoint and runs shark
+	 * until completion.
+	 *
+	 * Checkpoints are looked for at the snapshots given in
+	 * execution.checkpoint_snapshots, latest first. If none is found shark
+	 * runs from the beginning, like run() does. Checkpoints can only be
+	 * loaded by executions with the same options and seed as the one that
+	 * saved them.
+	 */
+	void restart();
+
 	/// Report total execution times
 	void report_total_times();
 
+	/// A function called after evolving each snapshot, with the global
+	/// quantities tracked so far
+	using snapshot_callback = std::function<void(int snapshot, const TotalBaryon &all_baryons)>;
+
+	/**
+	 * Sets a function to be called after the galaxies of each snapshot have
+	 * been evolved, tracked and written.
+	 *
+	 * @param callback The function to call
+	 */
+	void on_snapshot_evolved(snapshot_callback callback);
+
+	/**
+	 * Runs shark for several models that share the same merger trees.
+	 *
+	 * Merger trees are imported and built only once using @p options, and an
+	 * in-memory image of them is captured before any galaxy is created. Each
+	 * model then evolves galaxies over its own copy of the trees, restored
+	 * from the image, using @p options overridden by its own model options.
+	 * Model options therefore cannot change any of the options used to build
+	 * merger trees. Unless a model sets its own execution.output_directory,
+	 * its outputs are written under <execution.output_directory>/<i>, where
+	 * i is the index of the model.
+	 *
+	 * @param options The base set of options
+	 * @param model_options For each model, the options (in name=value
+	 * form) overriding the base set of options
+	 * @param threads The number of threads used to run shark
+	 */
+	static void run_models(const Options &options, const std::vector<std::vector<std::string>> &model_options, unsigned int threads);
+
 private:
 	class impl;
 	std::unique_ptr<impl> pimpl;
@@ -51,6 +51,15 @@ public:
 
 	std::string tree_files_prefix {"tree."};
 
+	/// The format of the merger tree files
+	enum tree_files_format_t {
+		/// SURFS HDF5 files
+		SURFS_HDF5 = 0,
+		/// shark's columnar, memory-mappable files (see ColumnarTreeFile)
+		SURFS_COLUMNAR
+	};
+	tree_files_format_t tree_files_format = SURFS_HDF5;
+
 	std::map<int,double> redshifts;
 
 	bool hydrorun = false;
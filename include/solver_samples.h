@@ -0,0 +1,171 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Sampling of the ODE solutions of the galaxy evolution
+ */
+
+#ifndef SHARK_SOLVER_SAMPLES_H_
+#define SHARK_SOLVER_SAMPLES_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "baryon.h"
+#include "galaxy.h"
+
+namespace shark {
+
+/// The parameters of a single ODE solution of the evolution of a galaxy,
+/// stored in solver samples files as they are in memory
+struct solver_sample_record {
+	std::int64_t galaxy_id;
+	std::int32_t snapshot;
+	std::int32_t burst;
+	std::uint64_t evaluations;
+	double rgas;
+	double rstar;
+	double mcoolrate;
+	double zcool;
+	double jcold_halo;
+	double delta_t;
+	double redshift;
+	double vsubh;
+	double vgal;
+	BlackHole smbh;
+};
+
+/// A sampled ODE solution of the evolution of a galaxy: its parameters, and
+/// the values of the ODE system before and after being solved
+struct solver_sample {
+	std::uint64_t key;
+	solver_sample_record record;
+	std::vector<double> initial_values;
+	std::vector<double> final_values;
+};
+
+/**
+ * Keeps a sample of the ODE solutions made by a single thread during a
+ * snapshot. Solutions are selected by a key that depends only on the seed,
+ * the snapshot and the galaxy being evolved, so the solutions sampled don't
+ * depend on the number of threads used.
+ */
+class SolverSampleRecorder {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param seed The seed of this execution
+	 * @param max_samples The maximum number of solutions kept per snapshot
+	 */
+	SolverSampleRecorder(std::uint32_t seed, std::size_t max_samples);
+
+	/// Discards all samples, and starts sampling solutions of @p snapshot
+	void start_snapshot(int snapshot);
+
+	/**
+	 * Returns whether the ODE solution evolving galaxy @p galaxy_id might be
+	 * sampled, in which case it should be given to add().
+	 *
+	 * @param galaxy_id The ID of the galaxy being evolved
+	 * @param burst Whether the solution evolves a starburst
+	 * @param key Set to the key of the solution
+	 * @return Whether the solution should be given to add()
+	 */
+	bool should_sample(Galaxy::id_t galaxy_id, bool burst, std::uint64_t &key) const;
+
+	/// Adds @p sample, whose key was given by should_sample, if it is among
+	/// the samples with the smallest keys seen during this snapshot
+	void add(solver_sample &&sample);
+
+	/// @return The samples of the current snapshot, in no particular order
+	std::vector<solver_sample> &get_samples()
+	{
+		return samples;
+	}
+
+private:
+	std::uint32_t seed;
+	std::size_t max_samples;
+	int snapshot = -1;
+
+	// A max-heap, so the sample with the largest key comes first
+	std::vector<solver_sample> samples;
+};
+
+/**
+ * Samples ODE solutions of the galaxy evolution during an execution, and
+ * writes them into a binary file, snapshot after snapshot.
+ *
+ * Each thread records solutions into its own SolverSampleRecorder. At the
+ * end of each snapshot the solutions of all threads are merged, and those
+ * with the smallest keys are written.
+ */
+class SolverSampler {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param filename The name of the file to write
+	 * @param samples_per_snapshot The number of solutions written per snapshot
+	 * @param seed The seed of this execution
+	 * @param dimension The dimension of the ODE system being solved
+	 * @param threads The number of threads recording solutions
+	 */
+	SolverSampler(const std::string &filename, std::size_t samples_per_snapshot, std::uint32_t seed, std::uint32_t dimension, unsigned int threads);
+
+	/// @return The recorder used by thread @p thread_idx
+	SolverSampleRecorder &recorder(unsigned int thread_idx)
+	{
+		return recorders[thread_idx];
+	}
+
+	/// Starts sampling solutions made while evolving @p snapshot
+	void start_snapshot(int snapshot);
+
+	/// Writes the solutions sampled during the current snapshot
+	void write_snapshot();
+
+private:
+	std::string filename;
+	std::size_t samples_per_snapshot;
+	std::uint32_t dimension;
+	std::vector<SolverSampleRecorder> recorders;
+	std::ofstream f;
+};
+
+/**
+ * Reads all ODE solutions written by a SolverSampler.
+ *
+ * @param filename The name of the file to read
+ * @return The samples in the file, with their key set to 0
+ */
+std::vector<solver_sample> read_solver_samples(const std::string &filename);
+
+}  // namespace shark
+
+#endif // SHARK_SOLVER_SAMPLES_H_
@@ -42,12 +42,28 @@ namespace shark {
 /**
  * This structure keeps track of the properties of the halo gas,
  * which are necessary to implement a more sophisticated cooling model.
+ *
+ * The cooling model only requires the integral of the temperature, mass and
+ * cooling time history of the halo gas, which is accumulated here one
+ * timestep at a time instead of keeping the full history.
  */
 struct CoolingSubhaloTracking {
-	std::vector<double> deltat;
-	std::vector<double> temp;
-	std::vector<double> mass;
-	std::vector<double> tcooling;
+
+	/**
+	 * Adds the halo gas properties of a new timestep to the history.
+	 *
+	 * @param temp The temperature of the halo gas
+	 * @param mass The (comoving) mass of the halo gas
+	 * @param tcooling The cooling time of the halo gas
+	 * @param deltat The duration of the timestep
+	 */
+	void add(double temp, double mass, double tcooling, double deltat)
+	{
+		temp_mass_over_tcooling += temp * mass / tcooling * deltat;
+	}
+
+	/// Integral of temp * mass / tcooling over time
+	double temp_mass_over_tcooling {0};
 	double rheat {0};
 };
 
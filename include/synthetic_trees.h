@@ -0,0 +1,70 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Generation of synthetic merger trees
+ */
+
+#ifndef SHARK_SYNTHETIC_TREES_H_
+#define SHARK_SYNTHETIC_TREES_H_
+
+#include <cstddef>
+#include <string>
+
+namespace shark {
+
+/// Parameters controlling the generation of synthetic merger trees
+struct synthetic_trees_params {
+	/// The prefix of the files to write
+	std::string prefix;
+	/// The minimum number of nodes (subhalos across all snapshots) to generate
+	std::size_t n_nodes;
+	/// The number of snapshots
+	int n_snapshots;
+	/// The redshift of the first snapshot
+	double max_redshift;
+	/// The side of the simulated box [cMpc/h]
+	double box_size;
+	/// The fraction of nodes in trees rooted in a cluster-mass halo
+	double cluster_fraction;
+	/// The mass of the simulation particles [Msun/h]
+	double particle_mass;
+	/// The number of files (simulation batches) to write
+	unsigned int n_files;
+	/// The seed of the random number generator
+	unsigned int seed;
+};
+
+/**
+ * Generates synthetic merger trees in SURFS HDF5 format into
+ * <prefix>.<batch>.hdf5, their snapshot redshifts into
+ * <prefix>.redshifts.txt, and a configuration file with the matching
+ * simulation options into <prefix>.cfg. Trees are grown backwards in time
+ * from a root halo following a parametric Monte Carlo model, and are
+ * identical for the same parameters.
+ *
+ * @param params The parameters of the generation
+ */
+void generate_synthetic_trees(const synthetic_trees_params &params);
+
+}  // namespace shark
+
+#endif // SHARK_SYNTHETIC_TREES_H_
@@ -0,0 +1,167 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Lightweight tracing of the activity of each thread
+ */
+
+#ifndef SHARK_TRACE_H_
+#define SHARK_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "timer.h"
+
+namespace shark {
+
+/**
+ * Process-wide collector of trace spans.
+ *
+ * When enabled, each thread records the spans it finishes into its own ring
+ * buffer, so recording involves no synchronisation between threads. Once a
+ * buffer is full the oldest spans of that thread are overwritten. When
+ * disabled, spans cost a single relaxed atomic load.
+ *
+ * Recorded spans can be written as a Chrome trace-event JSON file, which can
+ * be opened with chrome://tracing or https://ui.perfetto.dev.
+ */
+class Tracer {
+
+public:
+
+	/// Default number of spans kept per thread
+	static constexpr std::size_t DEFAULT_EVENTS_PER_THREAD = 1024 * 1024;
+
+	/**
+	 * Enables tracing, discarding any previously recorded span.
+	 *
+	 * @param events_per_thread The maximum number of spans kept per thread
+	 */
+	static void enable(std::size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD);
+
+	/// Disables tracing, discarding all recorded spans
+	static void disable();
+
+	/// @return Whether spans are currently being recorded
+	static bool enabled()
+	{
+		return is_enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Records a span for the calling thread.
+	 *
+	 * @param name The name of the span, which must outlive the Tracer
+	 * (e.g., a string literal)
+	 * @param id An optional identifier shown with the span, or -1
+	 * @param start The time at which the span started
+	 * @param end The time at which the span ended
+	 */
+	static void record(const char *name, std::int64_t id, Timer::clock::time_point start, Timer::clock::time_point end);
+
+	/**
+	 * Writes all recorded spans into @p filename as a Chrome trace-event JSON
+	 * file. No spans should be recorded while this happens.
+	 *
+	 * @param filename The name of the file to write
+	 */
+	static void write(const std::string &filename);
+
+private:
+	static std::atomic<bool> is_enabled;
+};
+
+/**
+ * A span of time covering the lifetime of this object, recorded into the
+ * Tracer of the calling thread when tracing is enabled.
+ */
+class TraceSpan {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param name The name of the span, which must be a string literal
+	 * @param id An optional identifier shown with the span (e.g., a snapshot
+	 * or a merger tree ID)
+	 */
+	explicit TraceSpan(const char *name, std::int64_t id = -1) :
+		name(Tracer::enabled() ? name : nullptr), id(id)
+	{
+		if (this->name) {
+			start = Timer::clock::now();
+		}
+	}
+
+	~TraceSpan()
+	{
+		finish();
+	}
+
+	/// Ends this span before this object is destroyed
+	void finish()
+	{
+		if (name) {
+			Tracer::record(name, id, start, Timer::clock::now());
+			name = nullptr;
+		}
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+	const char *name;
+	std::int64_t id;
+	Timer::clock::time_point start;
+};
+
+/**
+ * Enables tracing for the lifetime of this object, and writes the recorded
+ * spans into a file when destroyed, even if an exception is being thrown.
+ */
+class TraceFile {
+
+public:
+
+	/**
+	 * Constructor
+	 *
+	 * @param filename The name of the trace file. If empty, tracing is not
+	 * enabled and no file is written.
+	 */
+	explicit TraceFile(const std::string &filename);
+	~TraceFile();
+
+	TraceFile(const TraceFile &) = delete;
+	TraceFile &operator=(const TraceFile &) = delete;
+
+private:
+	std::string filename;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TRACE_H_
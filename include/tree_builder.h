@@ -26,6 +26,7 @@
 #ifndef SHARK_TREE_BUILDER_H_
 #define SHARK_TREE_BUILDER_H_
 
+#include <utility>
 #include <vector>
 
 #include "components.h"
@@ -33,7 +34,9 @@
 #include "dark_matter_halos.h"
 #include "execution.h"
 #include "gas_cooling.h"
+#include "merger_tree_graph.h"
 #include "simulation.h"
+#include "subhalo.h"
 
 namespace shark {
 
@@ -53,6 +56,7 @@ public:
 protected:
 
 	ExecutionParameters &get_exec_params();
+	unsigned int get_threads() const;
 
 	virtual void loop_through_halos(std::vector<HaloPtr> &halos) = 0;
 
@@ -64,10 +68,10 @@ private:
 	void ensure_halo_mass_growth(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void spin_interpolated_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void define_central_subhalos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, DarkMatterHaloParameters &dark_matter_params);
-	SubhaloPtr define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhalo);
-	void define_accretion_rate_from_dm(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, GasCoolingParameters &gas_cooling_params, Cosmology &cosmology, TotalBaryon &AllBaryons);
-	void remove_satellite(HaloPtr &halo, SubhaloPtr &subhalo);
- 	void define_ages_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, const DarkMatterHalosPtr &darkmatterhalos);
+	SubhaloPtr define_central_subhalo(const HaloPtr &halo, SubhaloPtr &subhalo);
+	void define_accretion_rate_from_dm(const std::vector<MergerTreeGraph> &graphs, SimulationParameters &sim_params, GasCoolingParameters &gas_cooling_params, Cosmology &cosmology, TotalBaryon &AllBaryons);
+	void remove_satellite(const HaloPtr &halo, SubhaloPtr &subhalo);
+ 	void define_ages_halos(const std::vector<MergerTreeGraph> &graphs, SimulationParameters &sim_params, const DarkMatterHalosPtr &darkmatterhalos);
 	void ignore_late_massive_halos(std::vector<MergerTreePtr> &trees,  SimulationParameters sim_params, ExecutionParameters exec_params);
 
 private:
@@ -85,6 +89,23 @@ protected:
 	void loop_through_halos(std::vector<HaloPtr> &halos) override;
 	SubhaloPtr find_descendant_subhalo(const HaloPtr &halo, const SubhaloPtr &subhalo, const HaloPtr &descendant_halo);
 
+private:
+	void build_subhalo_index(const std::vector<HaloPtr> &halos);
+	std::pair<std::size_t, std::size_t> find_in_index(Subhalo::id_t id) const;
+	SubhaloPtr find_subhalo(const HaloPtr &halo, Subhalo::id_t id) const;
+	void remove_subhalo(const HaloPtr &halo, const SubhaloPtr &subhalo);
+
+	/// An entry in the subhalo index
+	struct indexed_subhalo {
+		Subhalo::id_t id;
+		SubhaloPtr subhalo;
+		/// Whether the subhalo has been removed from its host halo
+		bool removed;
+	};
+
+	/// All subhalos being linked, sorted by id
+	std::vector<indexed_subhalo> subhalo_index;
+
 };
 
 }  // namespace shark
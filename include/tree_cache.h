@@ -0,0 +1,216 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Binary cache of fully-built merger trees
+ */
+
+#ifndef SHARK_TREE_CACHE_H_
+#define SHARK_TREE_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "execution.h"
+#include "options.h"
+
+namespace shark {
+
+class TreeCacheStream;
+
+/**
+ * A versioned, binary cache of fully-built merger trees.
+ *
+ * For a given set of input files and options, reading the input halos and
+ * building merger trees out of them (linking, consolidation, central subhalo
+ * definitions, accretion rates and ages) always yields the same result.
+ * A TreeCache stores that result as flat arrays of halo and subhalo
+ * properties plus index-based links, which can be memory-mapped and turned
+ * back into MergerTree objects without going through the tree builder again.
+ *
+ * Cache files are named after a key derived from the names, sizes and
+ * modification times of the input files (or, optionally, from their
+ * checksums) and from the value of all options that influence how trees are
+ * built, so a cache is never used for a different set of inputs.
+ */
+class TreeCache {
+
+public:
+
+	/// Version of the on-disk format; it must be increased on every layout change
+	static const std::uint32_t VERSION = 2;
+
+	/**
+	 * Constructor
+	 *
+	 * @param cache_dir The directory where cache files are stored
+	 * @param options The options of this execution
+	 * @param exec_params The execution parameters of this execution
+	 * @param input_files The merger tree files used as input by this execution
+	 */
+	TreeCache(const std::string &cache_dir, const Options &options, const ExecutionParameters &exec_params, const std::vector<std::string> &input_files);
+
+	/**
+	 * Loads the merger trees from the cache file, if any.
+	 *
+	 * @param trees The vector where loaded trees will be stored
+	 * @param all_baryons The TotalBaryon object where the baryon bookkeeping
+	 * computed at tree-building time is loaded
+	 * @return Whether a valid cache file was found and loaded
+	 */
+	bool load(std::vector<MergerTreePtr> &trees, TotalBaryon &all_baryons) const;
+
+	/**
+	 * Stores the given merger trees in the cache file. Trees must not contain
+	 * galaxies yet.
+	 *
+	 * @param trees The merger trees to store
+	 * @param all_baryons The TotalBaryon object with the baryon bookkeeping
+	 * computed at tree-building time
+	 */
+	void store(const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons) const;
+
+	/**
+	 * Opens the cache file, if any, to load its merger trees one snapshot at
+	 * a time with a TreeCacheStream.
+	 *
+	 * @param all_baryons The TotalBaryon object where the baryon bookkeeping
+	 * computed at tree-building time is loaded
+	 * @return A stream over the cached trees, or null if no valid cache file
+	 * was found
+	 */
+	std::unique_ptr<TreeCacheStream> open_stream(TotalBaryon &all_baryons) const;
+
+	/// @return The name of the cache file used by this object
+	const std::string &get_filename() const
+	{
+		return filename;
+	}
+
+private:
+	std::uint64_t key;
+	std::string filename;
+};
+
+/**
+ * An in-memory image of fully-built merger trees.
+ *
+ * Images use the same compact representation as TreeCache files, and allow
+ * restoring independent copies of the original trees (and of the baryon
+ * bookkeeping computed while building them) any number of times, which is
+ * much cheaper than reading and building them again.
+ */
+class TreeImage {
+
+public:
+
+	/**
+	 * Captures an image of the given merger trees, which must not contain
+	 * galaxies yet.
+	 *
+	 * @param trees The merger trees to capture
+	 * @param all_baryons The TotalBaryon object with the baryon bookkeeping
+	 * computed at tree-building time
+	 */
+	TreeImage(const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons);
+	~TreeImage();
+
+	/**
+	 * Restores a new copy of the captured merger trees.
+	 *
+	 * @param all_baryons The TotalBaryon object where the captured baryon
+	 * bookkeeping is restored
+	 * @return The restored merger trees, in their original order
+	 */
+	std::vector<MergerTreePtr> restore(TotalBaryon &all_baryons) const;
+
+	/// @return The amount of memory used by this image, in bytes
+	std::size_t size() const;
+
+private:
+	class impl;
+	std::unique_ptr<impl> pimpl;
+};
+
+/**
+ * Loads the merger trees of a TreeCache one snapshot at a time.
+ *
+ * Trees are initially created with only their halos at their last snapshot.
+ * Halos (and their subhalos) of other snapshots are then loaded on demand,
+ * together with their descendants. Together with the release of halos from
+ * already-evolved snapshots, this allows evolving galaxies while keeping only
+ * a window of snapshots in memory.
+ */
+class TreeCacheStream {
+
+public:
+	~TreeCacheStream();
+
+	/// @return The merger trees in the cache
+	const std::vector<MergerTreePtr> &get_trees() const;
+
+	/**
+	 * Counts, for each tree, the halos between @p first_snapshot and
+	 * @p last_snapshot (inclusive) with a central subhalo without ascendants;
+	 * that is, where new galaxies are created.
+	 *
+	 * @return The counts, in the same order as get_trees()
+	 */
+	std::vector<std::size_t> count_first_halos(int first_snapshot, int last_snapshot) const;
+
+	/**
+	 * Returns the halos at @p snapshot with a central subhalo without
+	 * ascendants. The snapshot must have been loaded already.
+	 *
+	 * @param snapshot The snapshot of the halos
+	 * @return The halos, ordered by tree
+	 */
+	std::vector<HaloPtr> first_halos(int snapshot) const;
+
+	/**
+	 * Loads the halos of all trees at @p snapshot and their descendants,
+	 * linking them together.
+	 *
+	 * @param snapshot The snapshot to load
+	 */
+	void load_snapshot(int snapshot);
+
+	/**
+	 * Forgets about the halos loaded up to @p snapshot, which must have been
+	 * removed from their trees already.
+	 *
+	 * @param snapshot The last snapshot to forget
+	 */
+	void forget_snapshots(int snapshot);
+
+private:
+	class impl;
+	explicit TreeCacheStream(std::unique_ptr<impl> &&pimpl);
+	std::unique_ptr<impl> pimpl;
+	friend class TreeCache;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TREE_CACHE_H_
@@ -0,0 +1,165 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Prediction of the time needed to evolve merger trees out of their structure
+ */
+
+#ifndef SHARK_TREE_COST_H_
+#define SHARK_TREE_COST_H_
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "merger_tree.h"
+
+namespace shark {
+
+/// The structural features of a merger tree used to predict its cost
+struct tree_features {
+
+	/// The number of subhalos across all snapshots, i.e., the nodes of the tree
+	double subhalos = 0;
+
+	/// The largest number of subhalos the tree has in a single snapshot
+	double max_subhalos = 0;
+
+	/// The number of halo mergers, with a halo with n progenitors counting n - 1
+	double mergers = 0;
+
+	/// The number of snapshots spanned by the tree
+	double depth = 0;
+
+	/// The largest Mvir of the halos of the tree, in [10^12 Msun/h]
+	double max_mvir = 0;
+};
+
+/// @return The structural features of @p tree, out of the halos it currently has
+tree_features get_tree_features(const MergerTree &tree);
+
+/// The time it took to evolve a merger tree, together with its features
+struct tree_timing {
+	merger_tree_id_t tree_id;
+	tree_features features;
+	double seconds;
+};
+
+/// The per-tree timings recorded by an execution
+struct tree_timings {
+
+	/// The subvolumes (simulation batches) evolved by the execution
+	std::vector<unsigned int> subvolumes;
+
+	/// The timings of each tree
+	std::vector<tree_timing> trees;
+};
+
+/**
+ * Writes @p timings into @p filename as text, one tree per line.
+ *
+ * @param filename The name of the file to write
+ * @param timings The timings to write
+ */
+void write_tree_timings(const std::string &filename, const tree_timings &timings);
+
+/**
+ * Reads the timings written by write_tree_timings.
+ *
+ * @param filename The name of the file to read
+ * @return The timings in the file
+ */
+tree_timings read_tree_timings(const std::string &filename);
+
+/**
+ * A linear model predicting the time needed to evolve a merger tree out of
+ * its features, calibrated with the per-tree timings of previous executions.
+ *
+ * Models also keep the total predicted cost of the subvolumes evolved on
+ * their own by those executions, which coordinators use to hand out
+ * subvolumes costliest first. An object created with an empty filename is
+ * disabled.
+ */
+class TreeCostModel {
+
+public:
+
+	/// The number of weights of a model, the first one being the intercept
+	static constexpr std::size_t N_WEIGHTS = 6;
+
+	/// The name of each weight, as written in model files
+	static const std::array<const char *, N_WEIGHTS> WEIGHT_NAMES;
+
+	/// Constructs a disabled model
+	TreeCostModel() = default;
+
+	/**
+	 * Constructor
+	 *
+	 * @param filename The model file to load. If empty, the model is disabled
+	 */
+	explicit TreeCostModel(const std::string &filename);
+
+	/**
+	 * Fits a model to @p timings by least squares.
+	 *
+	 * @param timings The timings recorded by one or more executions
+	 * @return The fitted model
+	 */
+	static TreeCostModel fit(const std::vector<tree_timings> &timings);
+
+	/// @return Whether the model can predict costs at all
+	bool enabled() const
+	{
+		return is_enabled;
+	}
+
+	/// @return The predicted time to evolve a tree with @p features, in [s]
+	double predict(const tree_features &features) const;
+
+	/**
+	 * Looks up the predicted cost of evolving @p subvolume.
+	 *
+	 * @param subvolume The subvolume to look up
+	 * @param cost Set to the predicted cost of the subvolume, in [s]
+	 * @return Whether the cost of @p subvolume is known
+	 */
+	bool subvolume_cost(unsigned int subvolume, double &cost) const;
+
+	/// Writes this model into @p filename
+	void save(const std::string &filename) const;
+
+	/// @return The weights of this model, in WEIGHT_NAMES order
+	const std::array<double, N_WEIGHTS> &get_weights() const
+	{
+		return weights;
+	}
+
+private:
+	bool is_enabled = false;
+	std::array<double, N_WEIGHTS> weights {};
+	std::map<unsigned int, double> subvolume_costs;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TREE_COST_H_
@@ -28,12 +28,14 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <map>
 #include <numeric>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -295,6 +297,66 @@ typename Container::value_type sum(Container &c)
 /// Returns the maximum amount of memory used by this process
 std::size_t peak_rss();
 
+/// Returns the amount of memory currently used by this process
+std::size_t current_rss();
+
+/// Amount of bytes read and written by a process
+struct io_counters {
+	std::uint64_t bytes_read = 0;
+	std::uint64_t bytes_written = 0;
+
+	io_counters operator-(const io_counters &rhs) const
+	{
+		io_counters diff;
+		diff.bytes_read = bytes_read - rhs.bytes_read;
+		diff.bytes_written = bytes_written - rhs.bytes_written;
+		return diff;
+	}
+};
+
+/// Returns the amount of bytes read and written by this process so far
+/// through read/write system calls (i.e., not through memory-mapped files).
+/// Zeros are returned if this information is not available.
+io_counters current_io();
+
+/// A 64-bit FNV-1a hash, consuming full 64-bit words when possible
+class hasher {
+public:
+
+	/// Adds @p size bytes starting at @p data to the hash
+	void update(const void *data, std::size_t size);
+
+	/// Adds the contents of @p s to the hash
+	void update(const std::string &s);
+
+	/// Adds the textual representation of @p value to the hash
+	template <typename T>
+	void update_value(const T &value)
+	{
+		std::ostringstream os;
+		os << std::setprecision(17) << value;
+		update(os.str());
+	}
+
+	/// Adds the contents of file @p fname to the hash
+	void update_file(const std::string &fname);
+
+	/// @return The hash of all the data added so far
+	std::uint64_t digest() const
+	{
+		return h;
+	}
+
+private:
+	std::uint64_t h = 14695981039346656037ULL;
+
+	void mix(std::uint64_t value)
+	{
+		h ^= value;
+		h *= 1099511628211ULL;
+	}
+};
+
 }  // namespace shark
 
 #endif // SHARK_UTILS
\ No newline at end of file
@@ -190,6 +190,48 @@ def run_shark_hpc(particles, *args):
     return results
 
 
+def run_shark_models(particles, *args):
+    """
+    Evaluates all `particles` using a single shark instance, which builds
+    merger trees only once and evolves one model per particle over them.
+    Trees are kept in a tree cache under the auxiliary output directory,
+    so they are built only once for the whole PSO run.
+    """
+
+    opts, space, subvols, statTest = args
+
+    pid = multiprocessing.current_process().pid
+    shark_output_base = os.path.join(opts.outdir, 'output_%d' % pid)
+    models_fname = os.path.join(opts.outdir, 'models_%d.txt' % pid)
+    with open(models_fname, 'wt') as f:
+        for particle in particles:
+            f.write(' '.join(['-o "%s"' % option for option in _to_shark_options(particle, space)]) + '\n')
+
+    cmdline = [opts.shark_binary, opts.config, '-t', '0', '-m', models_fname,
+               '-o', 'execution.output_directory=%s' % shark_output_base,
+               '-o', 'execution.tree_cache_dir=%s' % os.path.join(opts.outdir, 'tree_cache'),
+               '-o', 'execution.simulation_batches=%s' % ' '.join(map(str, subvols))]
+    try:
+        _exec_shark('Executing shark models', cmdline)
+    except KeyboardInterrupt:
+        raise AbortedByUser
+
+    _, simu, model, _ = common.read_configuration(opts.config)
+    results = np.zeros([len(particles), len(opts.constraints)])
+    for i in range(len(particles)):
+        modeldir = common.get_shark_output_dir(os.path.join(shark_output_base, str(i)), simu, model)
+        results[i] = constraints.evaluate(opts.constraints, statTest, modeldir, subvols)
+    constraints.log_results(opts.constraints, results)
+
+    if not opts.keep:
+        shutil.rmtree(shark_output_base, ignore_errors=True)
+        os.remove(models_fname)
+
+    results = np.sum(results, axis=1)
+    logger.info('Particles %r evaluated to %r', particles, results)
+    return results
+
+
 def run_shark(particle, *args):
 
     opts, space, subvols, statTest = args
@@ -128,6 +128,8 @@ def pso_run_main(parser, args):
                           default='space.txt', type=_abspath)
     pso_opts.add_argument('-t', '--stat-test', help='Stat function used to calculate the value of a particle, defaults to student-t',
                           default='student-t', choices=list(analysis.stat_tests.keys()))
+    pso_opts.add_argument('-I', '--single-instance', help='Evaluate all particles of an iteration with a single shark instance, building merger trees only once',
+                          action='store_true')
     add_constraint_argument(pso_opts)
 
     hpc_opts = parser.add_argument_group('HPC options')
@@ -183,6 +185,9 @@ def pso_run_main(parser, args):
             opts.nodes = ss
         procs = 0
         f = execution.run_shark_hpc
+    elif opts.single_instance:
+        procs = 0
+        f = execution.run_shark_models
     else:
         n_cpus = multiprocessing.cpu_count()
         procs = min(n_cpus, ss)
@@ -202,6 +207,7 @@ def pso_run_main(parser, args):
     logger.info('    Lower bounds: %r', space['lb'])
     logger.info('    Upper bounds: %r', space['ub'])
     logger.info('    Test function: %s', opts.stat_test)
+    logger.info('    Single shark instance: %d', opts.single_instance)
     logger.info('Constraints:')
     for c in opts.constraints:
         logger.info('    %s', c)
@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Runs shark over synthetic merger trees of a few sizes
+# and reports its throughput
+#
+# ICRAR - International Centre for Radio Astronomy Research
+# (c) UWA - The University of Western Australia, 2019
+# Copyright by UWA (in the framework of the ICRAR)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+if [ $# -lt 1 ]; then
+	echo "Usage: $0 <config-file> [nodes ...]"
+	echo
+	echo "Generates synthetic merger trees with the given number of nodes"
+	echo "(defaults to 10000 30000 100000) using shark-bench-trees,"
+	echo "runs shark over each of them using the physical model in <config-file>,"
+	echo "and reports its throughput in galaxies evolved per second,"
+	echo "counting each galaxy once per snapshot it is evolved in."
+	echo
+	echo "The following environment variables are honoured:"
+	echo " * SHARK, SHARK_BENCH_TREES: the programs to use, if they're not in your PATH"
+	echo " * SHARK_BENCH_DIR: where trees, outputs and logs are written (default: ./shark-benchmark)."
+	echo "   Trees are generated only once, and reused in later executions"
+	echo " * SHARK_BENCH_SNAPSHOTS: number of snapshots of the trees (default: 50)"
+	echo " * SHARK_BENCH_THREADS: number of threads used by shark (default: all)"
+	exit 1
+fi
+
+shark="${SHARK:-shark}"
+bench_trees="${SHARK_BENCH_TREES:-shark-bench-trees}"
+bench_dir="${SHARK_BENCH_DIR:-shark-benchmark}"
+snapshots="${SHARK_BENCH_SNAPSHOTS:-50}"
+threads="${SHARK_BENCH_THREADS:-0}"
+
+config_file="$1"
+shift
+scales="$@"
+if [ -z "$scales" ]; then
+	scales="10000 30000 100000"
+fi
+
+# Extracts the value of a numeric member from JSON records
+_member() {
+	sed -n "s/.*\"$1\":\([-0-9.e+]*\).*/\1/p"
+}
+
+mkdir -p "$bench_dir" || exit 1
+status=0
+printf "%10s %10s %14s %14s %12s %12s\n" nodes galaxies galaxy_snaps evolution_s total_s galaxy_snaps/s
+for nodes in $scales; do
+	prefix="$bench_dir/trees_${nodes}_${snapshots}/tree"
+	if [ ! -f "$prefix.cfg" ]; then
+		"$bench_trees" -n $nodes -s $snapshots "$prefix" > "$bench_dir/trees_${nodes}_${snapshots}.log" || exit 1
+	fi
+
+	run_dir="$bench_dir/run_${nodes}_${snapshots}"
+	rm -rf "$run_dir"
+	mkdir -p "$run_dir"
+	metrics="$run_dir/metrics.jsonl"
+	"$shark" "$config_file" "$prefix.cfg" -t $threads \
+	    -o "execution.output_directory=$run_dir" "execution.metrics_file=$metrics" \
+	       execution.output_sf_histories=false execution.seed=1 > "$run_dir/shark.log" 2>&1
+	if [ $? -ne 0 ]; then
+		echo "shark failed for $nodes nodes, see $run_dir/shark.log"
+		status=1
+		continue
+	fi
+
+	# Galaxies are counted once per snapshot they are evolved in
+	grep '"type":"snapshot"' "$metrics" | _member galaxies > "$run_dir/galaxies.txt"
+	evolution_time=`grep '"type":"end"' "$metrics" | _member evolution_time`
+	total_time=`grep '"type":"end"' "$metrics" | sed -n 's/.*"type":"end","time":\([-0-9.e+]*\).*/\1/p'`
+	awk -v nodes=$nodes -v evolution_time=$evolution_time -v total_time=$total_time '
+	    { galaxy_snapshots += $1; galaxies = $1 }
+	    END { printf "%10d %10d %14d %14.3f %12.3f %12.1f\n", nodes, galaxies, galaxy_snapshots, evolution_time, total_time, galaxy_snapshots / evolution_time }
+	' "$run_dir/galaxies.txt"
+done
+exit $status
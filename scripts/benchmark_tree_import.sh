@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Compares the time and memory needed to read merger trees
+# in SURFS HDF5 and columnar formats for a given shark configuration
+#
+# ICRAR - International Centre for Radio Astronomy Research
+# (c) UWA - The University of Western Australia, 2018
+# Copyright by UWA (in the framework of the ICRAR)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+if [ $# -lt 1 ]; then
+	echo "Usage: $0 <config-file> [shark-convert-trees options]"
+	echo
+	echo "Columnar files must have been created first with shark-convert-trees."
+	echo "Set SHARK_CONVERT_TREES to point to the program if it's not in your PATH."
+	exit 1
+fi
+
+convert_trees="${SHARK_CONVERT_TREES:-shark-convert-trees}"
+
+# Each format is read in a separate process so peak memory usages are independent
+for format in hdf5 columnar; do
+	echo "== $format"
+	"$convert_trees" --benchmark "$@" -o "simulation.tree_files_format=$format" || exit 1
+done
@@ -0,0 +1,728 @@
+//
+// Main routine for the shark-bench-physics program
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Microbenchmarks of the physics kernels of shark, driven by the galaxies
+ * stored in a checkpoint
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <gsl/gsl_errno.h>
+
+#include "agn_feedback.h"
+#include "checkpoint.h"
+#include "cosmology.h"
+#include "dark_matter_halos.h"
+#include "disk_instability.h"
+#include "environment.h"
+#include "exceptions.h"
+#include "execution.h"
+#include "galaxy_mergers.h"
+#include "galaxy_writer.h"
+#include "gas_cooling.h"
+#include "halo.h"
+#include "logging.h"
+#include "merger_tree.h"
+#include "metrics.h"
+#include "numerical_constants.h"
+#include "ode_solver.h"
+#include "options.h"
+#include "physical_model.h"
+#include "recycling.h"
+#include "reincorporation.h"
+#include "reionisation.h"
+#include "simulation.h"
+#include "solver_samples.h"
+#include "star_formation.h"
+#include "stellar_feedback.h"
+#include "subhalo.h"
+#include "timer.h"
+#include "total_baryon.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace {
+
+/// Results are stored here so calls to the kernels cannot be optimised away
+volatile double sink;
+
+/// The time per call and counters measured for a single kernel
+class kernel_result {
+
+public:
+	explicit kernel_result(std::string name) :
+		name(std::move(name))
+	{
+	}
+
+	/// Adds a repetition that made @p n_calls calls in @p duration
+	void add_repetition(std::size_t n_calls, Timer::duration duration)
+	{
+		calls += n_calls;
+		total_duration += duration;
+		if (n_calls != 0) {
+			best_ns_per_call = std::min(best_ns_per_call, double(duration) / n_calls);
+		}
+	}
+
+	/// Adds @p value to counter @p counter_name
+	void add_counter(const std::string &counter_name, std::size_t value)
+	{
+		auto it = std::find_if(counters.begin(), counters.end(), [&](const std::pair<std::string, std::size_t> &counter) {
+			return counter.first == counter_name;
+		});
+		if (it == counters.end()) {
+			counters.emplace_back(counter_name, value);
+		}
+		else {
+			it->second += value;
+		}
+	}
+
+	double ns_per_call() const
+	{
+		if (calls == 0) {
+			return 0;
+		}
+		return double(total_duration) / calls;
+	}
+
+	double best() const
+	{
+		if (calls == 0) {
+			return 0;
+		}
+		return best_ns_per_call;
+	}
+
+	double per_call(std::size_t counter) const
+	{
+		if (calls == 0) {
+			return 0;
+		}
+		return double(counter) / calls;
+	}
+
+	std::string name;
+	std::size_t calls = 0;
+	Timer::duration total_duration = 0;
+	std::vector<std::pair<std::string, std::size_t>> counters;
+
+private:
+	double best_ns_per_call = std::numeric_limits<double>::max();
+};
+
+/// The results of solving again the ODE systems of sampled solutions
+struct replay_result {
+	explicit replay_result(std::string name) :
+		kernel(std::move(name))
+	{
+	}
+
+	kernel_result kernel;
+	double max_deviation = 0;
+	std::int64_t max_deviation_galaxy = -1;
+	int max_deviation_snapshot = -1;
+};
+
+/// The largest relative difference between the values of @p y1 and @p y2
+double max_relative_deviation(const std::vector<double> &y1, const std::vector<double> &y2)
+{
+	double deviation = 0;
+	for (std::size_t i = 0; i != y1.size(); i++) {
+		auto scale = std::max(std::abs(y1[i]), std::abs(y2[i]));
+		if (scale > 0) {
+			deviation = std::max(deviation, std::abs(y1[i] - y2[i]) / scale);
+		}
+	}
+	return deviation;
+}
+
+/// The parameters and initial values of the ODE system of a galaxy,
+/// as set by PhysicalModel::evolve_galaxy
+struct ode_sample {
+	BasicPhysicalModel::solver_params params;
+	std::vector<double> y;
+};
+
+/// Evaluates the ODE system of the ode_sample whose parameters are pointed
+/// to by @p data, so a single ODESolver can be used for all samples
+int sample_evaluator(double t, const double y[], double f[], void *data)
+{
+	auto params = *static_cast<BasicPhysicalModel::solver_params **>(data);
+	return basic_physicalmodel_evaluator(t, y, f, params);
+}
+
+/// The galaxies and subhalos of a snapshot the kernels are called for
+struct snapshot_state {
+	std::vector<MergerTreePtr> trees;
+	std::vector<HaloPtr> halos;
+	std::vector<std::pair<Subhalo *, Galaxy *>> galaxies;
+	std::vector<std::pair<Subhalo *, SubhaloPtr>> satellite_subhalos;
+	std::vector<std::pair<HaloPtr, Galaxy *>> centrals_with_mergers;
+};
+
+class PhysicsBenchmark {
+
+public:
+	PhysicsBenchmark(const Options &options, unsigned int threads) :
+		options(options), threads(threads),
+		cosmo_params(options), dark_matter_halo_params(options), exec_params(options),
+		gas_cooling_params(options), recycling_params(options), simulation_params(options),
+		star_formation_params(options), agn_params(options),
+		cosmology(make_cosmology(cosmo_params)),
+		dark_matter_halos(make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
+		simulation(simulation_params, cosmology)
+	{
+		create_physics_objects();
+	}
+
+	/**
+	 * Benchmarks all kernels over the galaxies stored in a checkpoint
+	 *
+	 * @param snapshot The snapshot the checkpoint was saved at
+	 * @param checkpoint_file The checkpoint file, or empty to use the one
+	 * saved by shark at @p snapshot
+	 * @param repetitions The number of times each kernel is benchmarked
+	 * @return The results of each kernel
+	 */
+	std::vector<kernel_result> run(int snapshot, const std::string &checkpoint_file, unsigned int repetitions);
+
+	/**
+	 * Solves again the ODE systems of sampled solutions, and compares their
+	 * results with the sampled ones
+	 *
+	 * @param samples The sampled solutions
+	 * @param step_type The GSL stepping function used to solve them
+	 * @param repetitions The number of times samples are solved
+	 * @return The results of solving galaxy and starburst solutions
+	 */
+	std::vector<replay_result> replay(const std::vector<solver_sample> &samples, const gsl_odeiv2_step_type *step_type, unsigned int repetitions);
+
+private:
+	Options options;
+	unsigned int threads;
+	CosmologicalParameters cosmo_params;
+	DarkMatterHaloParameters dark_matter_halo_params;
+	ExecutionParameters exec_params;
+	GasCoolingParameters gas_cooling_params;
+	RecyclingParameters recycling_params;
+	SimulationParameters simulation_params;
+	StarFormationParameters star_formation_params;
+	AGNFeedbackParameters agn_params;
+	CosmologyPtr cosmology;
+	DarkMatterHalosPtr dark_matter_halos;
+	Simulation simulation;
+	int snapshot = -1;
+	std::string checkpoint_file;
+	double z = 0;
+	double delta_t = 0;
+
+	// Built like in SharkRunner, with a single set of per-thread objects
+	EnvironmentPtr environment;
+	std::unique_ptr<GasCooling> gas_cooling;
+	std::shared_ptr<BasicPhysicalModel> physical_model;
+	std::unique_ptr<GalaxyMergers> galaxy_mergers;
+	std::unique_ptr<DiskInstability> disk_instability;
+
+	void create_physics_objects();
+	snapshot_state load_state();
+
+	std::vector<ode_sample> cooling_rate(kernel_result &result);
+	void star_formation_rate(const std::vector<ode_sample> &samples, kernel_result &result);
+	void molecular_gas(const snapshot_state &state, kernel_result &result);
+	void evaluator(std::vector<ode_sample> &samples, kernel_result &result);
+	void ode_solver(std::vector<ode_sample> &samples, kernel_result &result);
+	void environment_stripping(kernel_result &result);
+	void create_merger(kernel_result &result);
+	void disk_instability_evaluation(kernel_result &result);
+};
+
+void PhysicsBenchmark::create_physics_objects()
+{
+	DiskInstabilityParameters disk_instability_params(options);
+	EnvironmentParameters environment_params(options);
+	GalaxyMergerParameters merger_parameters(options);
+	ReionisationParameters reio_params(options);
+	ReincorporationParameters reinc_params(options);
+	StellarFeedbackParameters stellar_feedback_params(options);
+
+	StarFormation star_formation(star_formation_params, recycling_params, cosmology);
+	auto agnfeedback = make_agn_feedback(agn_params, cosmology, recycling_params, exec_params);
+	environment = make_environment(environment_params, dark_matter_halos, cosmology, cosmo_params, simulation_params);
+	auto reionisation = make_reionisation(reio_params);
+	auto reincorporation = make_reincorporation(reinc_params, dark_matter_halos);
+	StellarFeedback stellar_feedback {stellar_feedback_params};
+	gas_cooling = std::unique_ptr<GasCooling>(new GasCooling(gas_cooling_params, star_formation_params, exec_params, reionisation, cosmology, agnfeedback, dark_matter_halos, reincorporation, environment));
+
+	physical_model = std::make_shared<BasicPhysicalModel>(exec_params.ode_solver_precision, *gas_cooling, stellar_feedback, star_formation, *agnfeedback,
+			recycling_params, gas_cooling_params, agn_params);
+	galaxy_mergers = std::unique_ptr<GalaxyMergers>(new GalaxyMergers(merger_parameters, cosmology, cosmo_params, exec_params, agn_params, simulation_params, dark_matter_halos, physical_model, agnfeedback));
+	disk_instability = std::unique_ptr<DiskInstability>(new DiskInstability(disk_instability_params, merger_parameters, simulation_params, dark_matter_halos, physical_model, agnfeedback));
+}
+
+snapshot_state PhysicsBenchmark::load_state()
+{
+	snapshot_state state;
+	TotalBaryon all_baryons;
+	Checkpoint checkpoint(checkpoint_file, options, exec_params);
+	if (!checkpoint.load(snapshot, state.trees, all_baryons, threads)) {
+		throw invalid_argument("Checkpoint file " + checkpoint_file + " not found");
+	}
+
+	for (auto &tree: state.trees) {
+		for (auto &halo: tree->halos_at(snapshot)) {
+			state.halos.push_back(halo);
+			for (auto &subhalo: halo->all_subhalos()) {
+				for (auto &galaxy: subhalo->galaxies) {
+					state.galaxies.emplace_back(subhalo.get(), &galaxy);
+				}
+				if (subhalo->subhalo_type == Subhalo::SATELLITE) {
+					state.satellite_subhalos.emplace_back(subhalo.get(), halo->central_subhalo);
+				}
+			}
+			auto central_galaxy = halo->central_subhalo ? halo->central_subhalo->central_galaxy() : nullptr;
+			if (central_galaxy && halo->central_subhalo->type2_galaxies_count() != 0) {
+				state.centrals_with_mergers.emplace_back(halo, central_galaxy);
+			}
+		}
+	}
+	return state;
+}
+
+std::vector<ode_sample> PhysicsBenchmark::cooling_rate(kernel_result &result)
+{
+	auto state = load_state();
+	std::vector<double> mcoolrates(state.galaxies.size());
+
+	Timer t;
+	for (std::size_t i = 0; i != state.galaxies.size(); i++) {
+		mcoolrates[i] = gas_cooling->cooling_rate(*state.galaxies[i].first, *state.galaxies[i].second, z, delta_t);
+	}
+	result.add_repetition(state.galaxies.size(), t.get());
+
+	// The state left behind is the one the ODE system is solved for
+	std::vector<ode_sample> samples;
+	samples.reserve(state.galaxies.size());
+	for (std::size_t i = 0; i != state.galaxies.size(); i++) {
+		samples.push_back({{*physical_model, false, 0., 0., 0., 0., 0., 0., 0., 0., 0., {}}, std::vector<double>(BasicPhysicalModel::DIMENSION)});
+		auto &sample = samples.back();
+		physical_model->set_solver_state(sample.params, sample.y, *state.galaxies[i].first, *state.galaxies[i].second, z, delta_t, mcoolrates[i]);
+	}
+	return samples;
+}
+
+void PhysicsBenchmark::star_formation_rate(const std::vector<ode_sample> &samples, kernel_result &result)
+{
+	// Inputs are derived like in basic_physicalmodel_evaluator
+	auto &star_formation = physical_model->star_formation;
+	star_formation.reset_integration_intervals();
+	Timer t;
+	for (auto &sample: samples) {
+		auto &y = sample.y;
+		auto &params = sample.params;
+		double zcold = gas_cooling_params.pre_enrich_z;
+		double jgas = 2.0 * params.vgal * params.rgas / constants::RDISK_HALF_SCALE;
+		double jrate = 0;
+		if (y[1] > 0 && y[7] > 0) {
+			zcold = y[7] / y[1];
+			jgas = y[15] / y[1];
+		}
+		sink = star_formation.star_formation_rate(y[1], y[0], params.rgas, params.rstar, zcold, params.redshift, params.burst, params.vgal, jrate, jgas);
+	}
+	result.add_repetition(samples.size(), t.get());
+	result.add_counter("integration_intervals", star_formation.get_integration_intervals());
+}
+
+void PhysicsBenchmark::molecular_gas(const snapshot_state &state, kernel_result &result)
+{
+	auto &star_formation = physical_model->star_formation;
+	star_formation.reset_integration_intervals();
+	Timer t;
+	for (auto &galaxy: state.galaxies) {
+		sink = star_formation.get_molecular_gas(*galaxy.second, z, false).m_mol;
+	}
+	result.add_repetition(state.galaxies.size(), t.get());
+	result.add_counter("integration_intervals", star_formation.get_integration_intervals());
+}
+
+void PhysicsBenchmark::evaluator(std::vector<ode_sample> &samples, kernel_result &result)
+{
+	physical_model->star_formation.reset_integration_intervals();
+	std::vector<double> f(BasicPhysicalModel::DIMENSION);
+	Timer t;
+	for (auto &sample: samples) {
+		basic_physicalmodel_evaluator(0, sample.y.data(), f.data(), &sample.params);
+		sink = f[0];
+	}
+	result.add_repetition(samples.size(), t.get());
+	result.add_counter("integration_intervals", physical_model->star_formation.get_integration_intervals());
+}
+
+void PhysicsBenchmark::ode_solver(std::vector<ode_sample> &samples, kernel_result &result)
+{
+	BasicPhysicalModel::solver_params *params = nullptr;
+	ODESolver solver(sample_evaluator, BasicPhysicalModel::DIMENSION, exec_params.ode_solver_precision, &params);
+	std::vector<double> y;
+	std::size_t evaluations = 0;
+
+	physical_model->star_formation.reset_integration_intervals();
+	Timer t;
+	for (auto &sample: samples) {
+		params = &sample.params;
+		y = sample.y;
+		solver.evolve(y, delta_t);
+		evaluations += solver.num_evaluations();
+		sink = y[0];
+	}
+	result.add_repetition(samples.size(), t.get());
+	result.add_counter("ode_evaluations", evaluations);
+	result.add_counter("integration_intervals", physical_model->star_formation.get_integration_intervals());
+}
+
+void PhysicsBenchmark::environment_stripping(kernel_result &result)
+{
+	auto state = load_state();
+	Timer t;
+	for (auto &satellite: state.satellite_subhalos) {
+		environment->process_satellite_subhalo_environment(*satellite.first, satellite.second, z);
+	}
+	result.add_repetition(state.satellite_subhalos.size(), t.get());
+}
+
+void PhysicsBenchmark::create_merger(kernel_result &result)
+{
+	// Like in GalaxyMergers::merging_galaxies, type 2 satellites merging
+	// during this snapshot are merged into the central galaxy of their halo
+	auto state = load_state();
+	std::vector<std::pair<HaloPtr, std::pair<Galaxy *, const Galaxy *>>> mergers;
+	for (auto &central: state.centrals_with_mergers) {
+		for (auto &satellite: central.first->central_subhalo->type2_galaxies()) {
+			if (satellite.tmerge < delta_t) {
+				mergers.emplace_back(central.first, std::make_pair(central.second, &satellite));
+			}
+		}
+	}
+
+	Timer t;
+	for (auto &merger: mergers) {
+		galaxy_mergers->create_merger(*merger.second.first, *merger.second.second, merger.first, snapshot);
+	}
+	result.add_repetition(mergers.size(), t.get());
+}
+
+std::vector<replay_result> PhysicsBenchmark::replay(const std::vector<solver_sample> &samples, const gsl_odeiv2_step_type *step_type, unsigned int repetitions)
+{
+	for (auto &sample: samples) {
+		if (sample.initial_values.size() != std::size_t(BasicPhysicalModel::DIMENSION)) {
+			std::ostringstream os;
+			os << "Solver samples have " << sample.initial_values.size() << " values, expected " << BasicPhysicalModel::DIMENSION;
+			throw invalid_data(os.str());
+		}
+	}
+
+	std::vector<replay_result> results {
+		replay_result("PhysicalModel::evolve_galaxy"),
+		replay_result("PhysicalModel::evolve_galaxy_starburst")
+	};
+	BasicPhysicalModel::solver_params params {*physical_model, false, 0., 0., 0., 0., 0., 0., 0., 0., 0., {}};
+	ODESolver solver(basic_physicalmodel_evaluator, BasicPhysicalModel::DIMENSION, exec_params.ode_solver_precision, &params, step_type);
+	std::vector<double> y;
+
+	for (unsigned int i = 0; i != repetitions; i++) {
+		Timer repetition_t;
+		std::vector<Timer::duration> durations(results.size());
+		std::vector<std::size_t> calls(results.size());
+		for (auto &sample: samples) {
+			auto idx = sample.record.burst ? 1 : 0;
+			auto &result = results[idx];
+			params.restore(sample.record);
+			y = sample.initial_values;
+
+			Timer t;
+			try {
+				solver.evolve(y, sample.record.delta_t);
+			} catch (const math_error &e) {
+				result.kernel.add_counter("failures", 1);
+				continue;
+			}
+			durations[idx] += t.get();
+			calls[idx]++;
+
+			result.kernel.add_counter("ode_evaluations", solver.num_evaluations());
+			result.kernel.add_counter("sampled_ode_evaluations", sample.record.evaluations);
+			auto deviation = max_relative_deviation(y, sample.final_values);
+			if (deviation > result.max_deviation) {
+				result.max_deviation = deviation;
+				result.max_deviation_galaxy = sample.record.galaxy_id;
+				result.max_deviation_snapshot = sample.record.snapshot;
+			}
+		}
+		for (std::size_t idx = 0; idx != results.size(); idx++) {
+			results[idx].kernel.add_repetition(calls[idx], durations[idx]);
+		}
+		LOG(info) << "Finished repetition " << i + 1 << " of " << repetitions << " in " << repetition_t;
+	}
+	return results;
+}
+
+void PhysicsBenchmark::disk_instability_evaluation(kernel_result &result)
+{
+	auto state = load_state();
+	physical_model->reset_ode_evaluations();
+	Timer t;
+	for (auto &halo: state.halos) {
+		disk_instability->evaluate_disk_instability(halo, snapshot, delta_t);
+	}
+	result.add_repetition(state.halos.size(), t.get());
+	result.add_counter("starburst_ode_evaluations", physical_model->get_galaxy_starburst_ode_evaluations());
+	result.add_counter("integration_intervals", physical_model->get_star_formation_integration_intervals());
+}
+
+std::vector<kernel_result> PhysicsBenchmark::run(int snapshot, const std::string &checkpoint_file, unsigned int repetitions)
+{
+	this->snapshot = snapshot;
+	this->checkpoint_file = checkpoint_file;
+	if (checkpoint_file.empty()) {
+		auto writer = make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, agn_params, threads);
+		this->checkpoint_file = writer->get_output_directory_name(snapshot) + "/checkpoint.bin";
+	}
+	z = simulation_params.redshifts[snapshot];
+	delta_t = simulation.convert_snapshot_to_age(snapshot + 1) - simulation.convert_snapshot_to_age(snapshot);
+
+	std::vector<kernel_result> results {
+		kernel_result("GasCooling::cooling_rate"),
+		kernel_result("StarFormation::star_formation_rate"),
+		kernel_result("StarFormation::get_molecular_gas"),
+		kernel_result("basic_physicalmodel_evaluator"),
+		kernel_result("ODESolver::evolve"),
+		kernel_result("Environment::process_satellite_subhalo_environment"),
+		kernel_result("GalaxyMergers::create_merger"),
+		kernel_result("DiskInstability::evaluate_disk_instability")
+	};
+
+	// Kernels changing the galaxies they are called for start each
+	// repetition from a freshly loaded checkpoint
+	for (unsigned int i = 0; i != repetitions; i++) {
+		Timer t;
+		auto samples = cooling_rate(results[0]);
+		auto state = load_state();
+		star_formation_rate(samples, results[1]);
+		molecular_gas(state, results[2]);
+		evaluator(samples, results[3]);
+		ode_solver(samples, results[4]);
+		environment_stripping(results[5]);
+		create_merger(results[6]);
+		disk_instability_evaluation(results[7]);
+		LOG(info) << "Finished repetition " << i + 1 << " of " << repetitions << " in " << t;
+	}
+	return results;
+}
+
+void show_help(const char *prog, const boost::program_options::options_description &desc, std::ostream &out)
+{
+	using std::endl;
+	out << endl;
+	out << "Usage: " << prog << " [options] config-file [... config-file]" << endl;
+	out << endl;
+	out << "Benchmarks the physics kernels of shark by calling each of them for all the" << endl;
+	out << "galaxies, subhalos or halos stored in a checkpoint, and reports their time" << endl;
+	out << "per call and related counters. Options and configuration files must be those" << endl;
+	out << "of the execution that saved the checkpoint, including execution.seed." << endl;
+	out << endl;
+	out << "With -S, the ODE solutions sampled during an execution are instead solved" << endl;
+	out << "again, possibly using a different stepping function or different options" << endl;
+	out << "(e.g., execution.ode_solver_precision), reporting their time per solution," << endl;
+	out << "evaluations and the maximum relative deviation from the sampled results." << endl;
+	out << endl;
+	out << desc << endl;
+}
+
+void print_header()
+{
+	std::cout << std::left << std::setw(52) << "kernel" << std::right << std::setw(12) << "calls"
+	          << std::setw(14) << "ns/call" << std::setw(14) << "best ns/call" << "  counters/call" << std::endl;
+}
+
+/// Prints @p result (without ending the line), and adds it to @p record
+void print_result(const kernel_result &result, MetricsRecord &record)
+{
+	std::cout << std::left << std::setw(52) << result.name << std::right << std::setw(12) << result.calls
+	          << std::setw(14) << fixed<1>(result.ns_per_call()) << std::setw(14) << fixed<1>(result.best()) << ' ';
+	record.add("calls", result.calls)
+	      .add("ns_per_call", result.ns_per_call())
+	      .add("best_ns_per_call", result.best());
+	for (auto &counter: result.counters) {
+		std::cout << ' ' << counter.first << '=' << fixed<3>(result.per_call(counter.second));
+		record.add(counter.first + "_per_call", result.per_call(counter.second));
+	}
+}
+
+void setup_logging(int verbosity)
+{
+	namespace log = ::boost::log;
+	namespace trivial = ::boost::log::trivial;
+	verbosity = 5 - std::min(std::max(verbosity, 0), 5);
+	trivial::severity_level sev_lvl = logging_level = trivial::severity_level(verbosity);
+	log::core::get()->set_filter([sev_lvl](log::attribute_value_set const &s) {
+		return s["Severity"].extract<trivial::severity_level>() >= sev_lvl;
+	});
+}
+
+int run(int argc, char **argv)
+{
+	using std::string;
+	using std::vector;
+	namespace po = boost::program_options;
+
+	po::options_description visible_opts("shark-bench-physics options");
+	visible_opts.add_options()
+		("help,h",        "Show this help message")
+		("verbose,v",     po::value<int>()->default_value(2), "Verbosity level. Higher is more verbose")
+		("options,o",     po::value<vector<string>>()->multitoken()->default_value({}, ""),
+		                  "Space-separated additional options to override config file")
+		("snapshot,s",    po::value<int>(),
+		                  "Snapshot of the checkpoint to use, defaults to the last of execution.checkpoint_snapshots")
+		("checkpoint,c",  po::value<string>()->default_value(""),
+		                  "Checkpoint file to use, defaults to the one saved by shark at the given snapshot")
+		("repetitions,r", po::value<unsigned int>()->default_value(3), "Number of times each kernel is benchmarked")
+		("metrics,m",     po::value<string>()->default_value(""),
+		                  "Also append the results as JSON Lines records into this file")
+		("threads,t",     po::value<unsigned int>()->default_value(1), "Threads used to load the checkpoint")
+		("solver-samples,S", po::value<string>(),
+		                  "Instead of using a checkpoint, solve again the ODE solutions sampled in this file "
+		                  "(see execution.solver_samples_file) and compare their results")
+		("stepper",       po::value<string>()->default_value("rkck"),
+		                  "GSL stepping function used to solve sampled ODE solutions: rk2, rk4, rkf45, rkck, rk8pd or msadams");
+
+	po::positional_options_description pdesc;
+	pdesc.add("config-file", -1);
+
+	po::options_description all_opts;
+	all_opts.add(visible_opts);
+	all_opts.add_options()
+		("config-file", po::value<vector<string>>()->multitoken(), "SHArk config file(s)");
+
+	po::variables_map vm;
+	po::command_line_parser parser(argc, argv);
+	parser.options(all_opts).positional(pdesc);
+	po::store(parser.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") != 0) {
+		show_help(argv[0], visible_opts, std::cout);
+		return 0;
+	}
+	if (vm.count("config-file") == 0) {
+		show_help(argv[0], visible_opts, std::cerr);
+		return 1;
+	}
+
+	setup_logging(vm["verbose"].as<int>());
+	gsl_set_error_handler_off();
+
+	Options options;
+	for (auto &config_file: vm["config-file"].as<vector<string>>()) {
+		options.add_file(config_file);
+	}
+	for (auto &opt_spec: vm["options"].as<vector<string>>()) {
+		options.add(opt_spec);
+	}
+
+	auto repetitions = std::max(1u, vm["repetitions"].as<unsigned int>());
+	PhysicsBenchmark benchmark(options, std::max(1u, vm["threads"].as<unsigned int>()));
+	Metrics metrics(vm["metrics"].as<string>());
+	print_header();
+
+	if (vm.count("solver-samples") != 0) {
+		auto samples_file = vm["solver-samples"].as<string>();
+		auto samples = read_solver_samples(samples_file);
+		auto stepper = vm["stepper"].as<string>();
+		LOG(info) << "Replaying " << samples.size() << " ODE solutions from " << samples_file << " using " << stepper;
+		for (auto &result: benchmark.replay(samples, ODESolver::step_type(stepper), repetitions)) {
+			MetricsRecord record("replay");
+			record.add("kernel", result.kernel.name)
+			      .add("stepper", stepper)
+			      .add("repetitions", repetitions)
+			      .add("max_relative_deviation", result.max_deviation)
+			      .add("max_relative_deviation_galaxy", result.max_deviation_galaxy)
+			      .add("max_relative_deviation_snapshot", result.max_deviation_snapshot);
+			print_result(result.kernel, record);
+			std::cout << "  max_relative_deviation=" << std::scientific << std::setprecision(3) << result.max_deviation;
+			if (result.max_deviation_galaxy != -1) {
+				std::cout << " (galaxy " << result.max_deviation_galaxy << " at snapshot " << result.max_deviation_snapshot << ')';
+			}
+			std::cout << std::endl;
+			metrics.write(record);
+		}
+		return 0;
+	}
+
+	int snapshot;
+	if (vm.count("snapshot") != 0) {
+		snapshot = vm["snapshot"].as<int>();
+	}
+	else {
+		ExecutionParameters exec_params(options);
+		if (exec_params.checkpoint_snapshots.empty()) {
+			throw invalid_option("No --snapshot given, and execution.checkpoint_snapshots is empty");
+		}
+		snapshot = *exec_params.checkpoint_snapshots.rbegin();
+	}
+
+	for (auto &result: benchmark.run(snapshot, vm["checkpoint"].as<string>(), repetitions)) {
+		MetricsRecord record("kernel");
+		record.add("kernel", result.name)
+		      .add("snapshot", snapshot)
+		      .add("repetitions", repetitions);
+		print_result(result, record);
+		std::cout << std::endl;
+		metrics.write(record);
+	}
+	return 0;
+}
+
+}  // anonymous namespace
+
+}  // namespace shark
+
+int main(int argc, char **argv)
+{
+	try {
+		return shark::run(argc, argv);
+	} catch (const std::exception &e) {
+		std::cerr << "Error while running shark-bench-physics: " << e.what() << std::endl;
+		return 1;
+	}
+}
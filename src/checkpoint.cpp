@@ -0,0 +1,1076 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Checkpoint implementation
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+#include "checkpoint.h"
+#include "exceptions.h"
+#include "galaxy.h"
+#include "halo.h"
+#include "logging.h"
+#include "mapped_file.h"
+#include "merger_tree.h"
+#include "omp_utils.h"
+#include "subhalo.h"
+#include "timer.h"
+#include "total_baryon.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace {
+
+//
+// On-disk layout: header, trees, halos, subhalos, galaxies, galaxy histories,
+// black hole histories, halo links, subhalo links and global baryons. All
+// records are padded to multiples of 8 bytes so sections can be laid out one
+// after the other and read in place. Records are laid out tree after tree,
+// subhalos in the order of their halos (central subhalo first), and so on.
+// Links are expressed as indices into the corresponding section (-1 meaning
+// "no link"), and never leave the tree they belong to.
+//
+// Galaxy components are stored as they are in memory, so any change to them
+// requires increasing Checkpoint::VERSION.
+//
+constexpr char MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'C', 'K', 'P'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct checkpoint_header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order_mark;
+	std::uint64_t key;
+	std::uint32_t seed;
+	std::int32_t snapshot;
+	std::uint64_t n_trees;
+	std::uint64_t n_halos;
+	std::uint64_t n_subhalos;
+	std::uint64_t n_galaxies;
+	std::uint64_t n_histories;
+	std::uint64_t n_bh_histories;
+	std::uint64_t n_halo_links;
+	std::uint64_t n_subhalo_links;
+};
+
+struct checkpoint_tree {
+	std::int64_t first_halo;
+	std::int64_t n_halos;
+	std::int32_t id;
+	std::int32_t last_snapshot;
+};
+
+struct checkpoint_halo {
+	std::int64_t id;
+	std::int64_t descendant;
+	std::int64_t first_subhalo;
+	std::int64_t n_subhalos;
+	std::int64_t first_ascendant;
+	std::int64_t n_ascendants;
+	float position[3];
+	float velocity[3];
+	float mass_fraction_subhalos;
+	float Vvir;
+	float Mvir;
+	float Mgas;
+	float concentration;
+	float lambda;
+	float age_80;
+	float age_50;
+	float excess_jetfeedback;
+	std::int32_t snapshot;
+	std::uint8_t has_central;
+	std::uint8_t ignore_gal_formation;
+	std::uint8_t hydrostatic_eq;
+	std::uint8_t padding[5];
+};
+
+struct checkpoint_subhalo {
+	std::int64_t id;
+	std::int64_t descendant_id;
+	std::int64_t descendant_halo_id;
+	std::int64_t haloID;
+	std::int64_t descendant;
+	std::int64_t first_ascendant;
+	std::int64_t n_ascendants;
+	std::int64_t first_galaxy;
+	std::int64_t n_galaxies;
+	CoolingSubhaloTracking cooling_subhalo_tracking;
+	float position[3];
+	float velocity[3];
+	float L[3];
+	float Vvir;
+	float Mvir;
+	float Mgas;
+	float Vcirc;
+	float concentration;
+	float lambda;
+	float infall_t;
+	float Mvir_infall;
+	float rvir_infall;
+	float hot_halo_gas_r_rps;
+	float accreted_mass;
+	float cooling_rate;
+	float mean_galaxy_making_stellar_halo;
+	BaryonBase star_central_infall;
+	BaryonBase lost_galaxy_gas;
+	BaryonBase stellar_halo;
+	BaryonBase hot_halo_gas_stripped;
+	RotatingBaryonBase hot_halo_gas;
+	RotatingBaryonBase cold_halo_gas;
+	RotatingBaryonBase ejected_galaxy_gas;
+	std::int32_t Npart;
+	std::int32_t snapshot;
+	std::int32_t descendant_snapshot;
+	std::int32_t last_snapshot_identified;
+	std::int32_t subhalo_type;
+	std::uint8_t has_descendant;
+	std::uint8_t main_progenitor;
+	std::uint8_t IsInterpolated;
+	std::uint8_t padding[5];
+};
+
+struct checkpoint_galaxy {
+	std::int64_t first_history;
+	std::int64_t n_histories;
+	std::int64_t first_bh_history;
+	std::int64_t n_bh_histories;
+	Baryon bulge_stars;
+	Baryon bulge_gas;
+	Baryon disk_stars;
+	Baryon disk_gas;
+	BaryonBase galaxymergers_burst_stars;
+	BaryonBase galaxymergers_assembly_stars;
+	BaryonBase diskinstabilities_burst_stars;
+	BaryonBase diskinstabilities_assembly_stars;
+	BaryonBase ram_pressure_stripped_gas;
+	BaryonBase stars_tidal_stripped;
+	BlackHole smbh;
+	InteractionItem interaction;
+	float sfr_disk;
+	float sfr_bulge_mergers;
+	float sfr_bulge_diskins;
+	float sfr_z_disk;
+	float sfr_z_bulge_mergers;
+	float sfr_z_bulge_diskins;
+	float mean_stellar_age;
+	float total_stellar_mass_ever_formed;
+	float vmax;
+	float r_rps;
+	float tmerge;
+	float concentration_type2;
+	float msubhalo_type2;
+	float vvir_type2;
+	float lambda_type2;
+	float mheat_ratio;
+	std::int32_t id;
+	std::int32_t descendant_id;
+	std::int32_t birth_snapshot;
+	std::int32_t galaxy_type;
+	std::int32_t padding;
+};
+
+struct checkpoint_history {
+	HistoryItem item;
+	std::int32_t padding;
+};
+
+struct checkpoint_baryon_entry {
+	std::int32_t snapshot;
+	std::int32_t padding;
+	double mass;
+};
+
+template <typename T>
+struct is_checkpoint_record {
+	static constexpr bool value = std::is_trivially_copyable<T>::value && sizeof(T) % 8 == 0;
+};
+static_assert(is_checkpoint_record<checkpoint_header>::value, "invalid checkpoint_header layout");
+static_assert(is_checkpoint_record<checkpoint_tree>::value, "invalid checkpoint_tree layout");
+static_assert(is_checkpoint_record<checkpoint_halo>::value, "invalid checkpoint_halo layout");
+static_assert(is_checkpoint_record<checkpoint_subhalo>::value, "invalid checkpoint_subhalo layout");
+static_assert(is_checkpoint_record<checkpoint_galaxy>::value, "invalid checkpoint_galaxy layout");
+static_assert(is_checkpoint_record<checkpoint_history>::value, "invalid checkpoint_history layout");
+static_assert(is_checkpoint_record<BHHistoryItem>::value, "invalid BHHistoryItem layout");
+static_assert(is_checkpoint_record<checkpoint_baryon_entry>::value, "invalid checkpoint_baryon_entry layout");
+
+/// The number of records of each kind, or their offsets into each section
+struct record_counts {
+	std::uint64_t halos = 0;
+	std::uint64_t subhalos = 0;
+	std::uint64_t galaxies = 0;
+	std::uint64_t histories = 0;
+	std::uint64_t bh_histories = 0;
+	std::uint64_t halo_links = 0;
+	std::uint64_t subhalo_links = 0;
+
+	record_counts &operator+=(const record_counts &rhs)
+	{
+		halos += rhs.halos;
+		subhalos += rhs.subhalos;
+		galaxies += rhs.galaxies;
+		histories += rhs.histories;
+		bh_histories += rhs.bh_histories;
+		halo_links += rhs.halo_links;
+		subhalo_links += rhs.subhalo_links;
+		return *this;
+	}
+};
+
+/// All records of a checkpoint, except for the global baryons
+struct checkpoint_records {
+	checkpoint_records(std::size_t n_trees, const record_counts &counts) :
+		trees(n_trees), halos(counts.halos), subhalos(counts.subhalos), galaxies(counts.galaxies),
+		histories(counts.histories), bh_histories(counts.bh_histories),
+		halo_links(counts.halo_links), subhalo_links(counts.subhalo_links)
+	{
+	}
+
+	std::vector<checkpoint_tree> trees;
+	std::vector<checkpoint_halo> halos;
+	std::vector<checkpoint_subhalo> subhalos;
+	std::vector<checkpoint_galaxy> galaxies;
+	std::vector<checkpoint_history> histories;
+	std::vector<BHHistoryItem> bh_histories;
+	std::vector<std::int64_t> halo_links;
+	std::vector<std::int64_t> subhalo_links;
+};
+
+/// Pointers to the different sections of a checkpoint file
+struct checkpoint_sections {
+	const checkpoint_header *header;
+	const checkpoint_tree *trees;
+	const checkpoint_halo *halos;
+	const checkpoint_subhalo *subhalos;
+	const checkpoint_galaxy *galaxies;
+	const checkpoint_history *histories;
+	const BHHistoryItem *bh_histories;
+	const std::int64_t *halo_links;
+	const std::int64_t *subhalo_links;
+	std::size_t baryons_offset;
+};
+
+/// Calls @p f on all arrays of @p all_baryons, in their on-disk order
+template <typename TotalBaryonT, typename F>
+void for_each_baryon_array(TotalBaryonT &all_baryons, F &&f)
+{
+	f(all_baryons.mcold);
+	f(all_baryons.mstars);
+	f(all_baryons.mstars_burst_galaxymergers);
+	f(all_baryons.mstars_burst_diskinstabilities);
+	f(all_baryons.mhot_halo);
+	f(all_baryons.mcold_halo);
+	f(all_baryons.mejected_halo);
+	f(all_baryons.mlost_halo);
+	f(all_baryons.mBH);
+	f(all_baryons.mHI);
+	f(all_baryons.mH2);
+	f(all_baryons.mDM);
+	f(all_baryons.SFR_disk);
+	f(all_baryons.SFR_bulge);
+	f(all_baryons.max_BH);
+	f(all_baryons.major_mergers);
+	f(all_baryons.minor_mergers);
+	f(all_baryons.disk_instabil);
+}
+
+std::vector<checkpoint_baryon_entry> to_entries(const std::map<int, double> &baryons)
+{
+	std::vector<checkpoint_baryon_entry> entries(baryons.size());
+	std::transform(baryons.begin(), baryons.end(), entries.begin(), [](const std::pair<const int, double> &entry) {
+		checkpoint_baryon_entry c_entry {entry.first, 0, entry.second};
+		return c_entry;
+	});
+	return entries;
+}
+
+std::map<int, double> from_entries(const std::vector<checkpoint_baryon_entry> &entries)
+{
+	std::map<int, double> baryons;
+	for (auto &entry: entries) {
+		baryons[entry.snapshot] = entry.mass;
+	}
+	return baryons;
+}
+
+std::size_t align8(std::size_t offset)
+{
+	return (offset + 7) & ~std::size_t(7);
+}
+
+template <typename T>
+void write_records(std::ofstream &f, const std::vector<T> &records)
+{
+	f.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T));
+}
+
+/// Writes arrays as their size followed by their elements, padded to a multiple of 8 bytes
+class array_writer {
+public:
+	explicit array_writer(std::ofstream &f) : f(f) {}
+
+	template <typename T>
+	void operator()(const std::vector<T> &values)
+	{
+		std::uint64_t size = values.size();
+		f.write(reinterpret_cast<const char *>(&size), sizeof(size));
+		write_records(f, values);
+		const char zeros[8] = {0};
+		auto n_bytes = values.size() * sizeof(T);
+		f.write(zeros, align8(n_bytes) - n_bytes);
+	}
+
+private:
+	std::ofstream &f;
+};
+
+template <typename T>
+const T *read_records(const MappedFile &file, std::size_t &offset, std::uint64_t n_records)
+{
+	auto size = n_records * sizeof(T);
+	if (offset + size > file.size()) {
+		return nullptr;
+	}
+	auto records = file.at<T>(offset);
+	offset += size;
+	return records;
+}
+
+/// Reads arrays written by array_writer
+class array_reader {
+public:
+	array_reader(const MappedFile &file, std::size_t offset) : file(file), offset(offset) {}
+
+	template <typename T>
+	void operator()(std::vector<T> &values)
+	{
+		const std::uint64_t *size = read_records<std::uint64_t>(file, offset, 1);
+		const T *records = (size ? read_records<T>(file, offset, *size) : nullptr);
+		if (!records) {
+			valid = false;
+			return;
+		}
+		values.assign(records, records + *size);
+		offset = align8(offset);
+	}
+
+	bool finished() const
+	{
+		return valid && offset == file.size();
+	}
+
+private:
+	const MappedFile &file;
+	std::size_t offset;
+	bool valid = true;
+};
+
+/// Calls @p f on the central subhalo of @p halo (if any), and then on its satellites
+template <typename F>
+void for_each_subhalo(const Halo &halo, F &&f)
+{
+	if (halo.central_subhalo) {
+		f(halo.central_subhalo);
+	}
+	for (auto &subhalo: halo.satellite_subhalos) {
+		f(subhalo);
+	}
+}
+
+/// The first halo of @p tree that is part of a checkpoint at @p snapshot
+std::vector<HaloPtr>::const_iterator first_halo(const MergerTree &tree, int snapshot)
+{
+	return std::lower_bound(tree.get_halos().begin(), tree.get_halos().end(), snapshot, by_snapshot{});
+}
+
+template <typename T>
+std::uint64_t count_kept(const std::vector<std::shared_ptr<T>> &ascendants, int snapshot)
+{
+	return std::uint64_t(std::count_if(ascendants.begin(), ascendants.end(), [snapshot](const std::shared_ptr<T> &ascendant) {
+		return ascendant->snapshot >= snapshot;
+	}));
+}
+
+record_counts count_records(const MergerTree &tree, int snapshot)
+{
+	record_counts counts;
+	for (auto it = first_halo(tree, snapshot); it != tree.get_halos().end(); it++) {
+		auto &halo = *it;
+		counts.halos++;
+		counts.halo_links += count_kept(halo->ascendants, snapshot);
+		for_each_subhalo(*halo, [&](const SubhaloPtr &subhalo) {
+			counts.subhalos++;
+			counts.subhalo_links += count_kept(subhalo->ascendants, snapshot);
+			counts.galaxies += subhalo->galaxies.size();
+			for (auto &galaxy: subhalo->galaxies) {
+				counts.histories += galaxy.history.size();
+				counts.bh_histories += galaxy.bh_history.size();
+			}
+		});
+	}
+	return counts;
+}
+
+template <typename T>
+std::int64_t index_of(const std::unordered_map<const T *, std::int64_t> &indices, const std::shared_ptr<T> &component, bool &linked)
+{
+	if (!component) {
+		return -1;
+	}
+	auto it = indices.find(component.get());
+	if (it == indices.end()) {
+		linked = false;
+		return -1;
+	}
+	return it->second;
+}
+
+void fill_halo(checkpoint_halo &c_halo, const Halo &halo)
+{
+	c_halo.id = halo.id;
+	c_halo.n_subhalos = std::int64_t(halo.subhalo_count());
+	c_halo.has_central = bool(halo.central_subhalo);
+	c_halo.position[0] = halo.position.x;
+	c_halo.position[1] = halo.position.y;
+	c_halo.position[2] = halo.position.z;
+	c_halo.velocity[0] = halo.velocity.x;
+	c_halo.velocity[1] = halo.velocity.y;
+	c_halo.velocity[2] = halo.velocity.z;
+	c_halo.mass_fraction_subhalos = halo.mass_fraction_subhalos;
+	c_halo.Vvir = halo.Vvir;
+	c_halo.Mvir = halo.Mvir;
+	c_halo.Mgas = halo.Mgas;
+	c_halo.concentration = halo.concentration;
+	c_halo.lambda = halo.lambda;
+	c_halo.age_80 = halo.age_80;
+	c_halo.age_50 = halo.age_50;
+	c_halo.excess_jetfeedback = halo.excess_jetfeedback;
+	c_halo.snapshot = halo.snapshot;
+	c_halo.ignore_gal_formation = halo.ignore_gal_formation;
+	c_halo.hydrostatic_eq = halo.hydrostatic_eq;
+}
+
+void fill_subhalo(checkpoint_subhalo &c_subhalo, const Subhalo &subhalo)
+{
+	c_subhalo.id = subhalo.id;
+	c_subhalo.descendant_id = subhalo.descendant_id;
+	c_subhalo.descendant_halo_id = subhalo.descendant_halo_id;
+	c_subhalo.haloID = subhalo.haloID;
+	c_subhalo.n_galaxies = std::int64_t(subhalo.galaxies.size());
+	c_subhalo.cooling_subhalo_tracking = subhalo.cooling_subhalo_tracking;
+	c_subhalo.position[0] = subhalo.position.x;
+	c_subhalo.position[1] = subhalo.position.y;
+	c_subhalo.position[2] = subhalo.position.z;
+	c_subhalo.velocity[0] = subhalo.velocity.x;
+	c_subhalo.velocity[1] = subhalo.velocity.y;
+	c_subhalo.velocity[2] = subhalo.velocity.z;
+	c_subhalo.L[0] = subhalo.L.x;
+	c_subhalo.L[1] = subhalo.L.y;
+	c_subhalo.L[2] = subhalo.L.z;
+	c_subhalo.Vvir = subhalo.Vvir;
+	c_subhalo.Mvir = subhalo.Mvir;
+	c_subhalo.Mgas = subhalo.Mgas;
+	c_subhalo.Vcirc = subhalo.Vcirc;
+	c_subhalo.concentration = subhalo.concentration;
+	c_subhalo.lambda = subhalo.lambda;
+	c_subhalo.infall_t = subhalo.infall_t;
+	c_subhalo.Mvir_infall = subhalo.Mvir_infall;
+	c_subhalo.rvir_infall = subhalo.rvir_infall;
+	c_subhalo.hot_halo_gas_r_rps = subhalo.hot_halo_gas_r_rps;
+	c_subhalo.accreted_mass = subhalo.accreted_mass;
+	c_subhalo.cooling_rate = subhalo.cooling_rate;
+	c_subhalo.mean_galaxy_making_stellar_halo = subhalo.mean_galaxy_making_stellar_halo;
+	c_subhalo.star_central_infall = subhalo.star_central_infall;
+	c_subhalo.lost_galaxy_gas = subhalo.lost_galaxy_gas;
+	c_subhalo.stellar_halo = subhalo.stellar_halo;
+	c_subhalo.hot_halo_gas_stripped = subhalo.hot_halo_gas_stripped;
+	c_subhalo.hot_halo_gas = subhalo.hot_halo_gas;
+	c_subhalo.cold_halo_gas = subhalo.cold_halo_gas;
+	c_subhalo.ejected_galaxy_gas = subhalo.ejected_galaxy_gas;
+	c_subhalo.Npart = subhalo.Npart;
+	c_subhalo.snapshot = subhalo.snapshot;
+	c_subhalo.descendant_snapshot = subhalo.descendant_snapshot;
+	c_subhalo.last_snapshot_identified = subhalo.last_snapshot_identified;
+	c_subhalo.subhalo_type = subhalo.subhalo_type;
+	c_subhalo.has_descendant = subhalo.has_descendant;
+	c_subhalo.main_progenitor = subhalo.main_progenitor;
+	c_subhalo.IsInterpolated = subhalo.IsInterpolated;
+}
+
+void fill_galaxy(checkpoint_galaxy &c_galaxy, const Galaxy &galaxy)
+{
+	c_galaxy.n_histories = std::int64_t(galaxy.history.size());
+	c_galaxy.n_bh_histories = std::int64_t(galaxy.bh_history.size());
+	c_galaxy.bulge_stars = galaxy.bulge_stars;
+	c_galaxy.bulge_gas = galaxy.bulge_gas;
+	c_galaxy.disk_stars = galaxy.disk_stars;
+	c_galaxy.disk_gas = galaxy.disk_gas;
+	c_galaxy.galaxymergers_burst_stars = galaxy.galaxymergers_burst_stars;
+	c_galaxy.galaxymergers_assembly_stars = galaxy.galaxymergers_assembly_stars;
+	c_galaxy.diskinstabilities_burst_stars = galaxy.diskinstabilities_burst_stars;
+	c_galaxy.diskinstabilities_assembly_stars = galaxy.diskinstabilities_assembly_stars;
+	c_galaxy.ram_pressure_stripped_gas = galaxy.ram_pressure_stripped_gas;
+	c_galaxy.stars_tidal_stripped = galaxy.stars_tidal_stripped;
+	c_galaxy.smbh = galaxy.smbh;
+	c_galaxy.interaction = galaxy.interaction;
+	c_galaxy.sfr_disk = galaxy.sfr_disk;
+	c_galaxy.sfr_bulge_mergers = galaxy.sfr_bulge_mergers;
+	c_galaxy.sfr_bulge_diskins = galaxy.sfr_bulge_diskins;
+	c_galaxy.sfr_z_disk = galaxy.sfr_z_disk;
+	c_galaxy.sfr_z_bulge_mergers = galaxy.sfr_z_bulge_mergers;
+	c_galaxy.sfr_z_bulge_diskins = galaxy.sfr_z_bulge_diskins;
+	c_galaxy.mean_stellar_age = galaxy.mean_stellar_age;
+	c_galaxy.total_stellar_mass_ever_formed = galaxy.total_stellar_mass_ever_formed;
+	c_galaxy.vmax = galaxy.vmax;
+	c_galaxy.r_rps = galaxy.r_rps;
+	c_galaxy.tmerge = galaxy.tmerge;
+	c_galaxy.concentration_type2 = galaxy.concentration_type2;
+	c_galaxy.msubhalo_type2 = galaxy.msubhalo_type2;
+	c_galaxy.vvir_type2 = galaxy.vvir_type2;
+	c_galaxy.lambda_type2 = galaxy.lambda_type2;
+	c_galaxy.mheat_ratio = galaxy.mheat_ratio;
+	c_galaxy.id = galaxy.id;
+	c_galaxy.descendant_id = galaxy.descendant_id;
+	c_galaxy.birth_snapshot = galaxy.birth_snapshot;
+	c_galaxy.galaxy_type = galaxy.galaxy_type;
+}
+
+/// Lays out the halos of @p tree from @p snapshot onwards as the records of
+/// tree @p tree_idx, starting at @p offsets. Ascendants from earlier
+/// snapshots are dropped.
+///
+/// @return Whether all links of the tree could be laid out
+bool add_tree_records(const MergerTree &tree, std::size_t tree_idx, int snapshot, record_counts offsets, checkpoint_records &records)
+{
+	auto first = first_halo(tree, snapshot);
+
+	// Assign an index to each halo and subhalo first
+	std::unordered_map<const Halo *, std::int64_t> halo_indices;
+	std::unordered_map<const Subhalo *, std::int64_t> subhalo_indices;
+	auto halo_idx = std::int64_t(offsets.halos);
+	auto subhalo_idx = std::int64_t(offsets.subhalos);
+	for (auto it = first; it != tree.get_halos().end(); it++) {
+		halo_indices.emplace(it->get(), halo_idx++);
+		for_each_subhalo(**it, [&](const SubhaloPtr &subhalo) {
+			subhalo_indices.emplace(subhalo.get(), subhalo_idx++);
+		});
+	}
+
+	auto &c_tree = records.trees[tree_idx];
+	c_tree.first_halo = std::int64_t(offsets.halos);
+	c_tree.n_halos = std::int64_t(halo_indices.size());
+	c_tree.id = tree.id;
+	c_tree.last_snapshot = tree.last_snapshot;
+
+	bool linked = true;
+	for (auto it = first; it != tree.get_halos().end(); it++) {
+		auto &halo = *it;
+		auto &c_halo = records.halos[offsets.halos++];
+		fill_halo(c_halo, *halo);
+		c_halo.descendant = index_of(halo_indices, halo->descendant, linked);
+		c_halo.first_ascendant = std::int64_t(offsets.halo_links);
+		for (auto &ascendant: halo->ascendants) {
+			if (ascendant->snapshot >= snapshot) {
+				records.halo_links[offsets.halo_links++] = index_of(halo_indices, ascendant, linked);
+			}
+		}
+		c_halo.n_ascendants = std::int64_t(offsets.halo_links) - c_halo.first_ascendant;
+		c_halo.first_subhalo = std::int64_t(offsets.subhalos);
+
+		for_each_subhalo(*halo, [&](const SubhaloPtr &subhalo) {
+			auto &c_subhalo = records.subhalos[offsets.subhalos++];
+			fill_subhalo(c_subhalo, *subhalo);
+			c_subhalo.descendant = index_of(subhalo_indices, subhalo->descendant, linked);
+			c_subhalo.first_ascendant = std::int64_t(offsets.subhalo_links);
+			for (auto &ascendant: subhalo->ascendants) {
+				if (ascendant->snapshot >= snapshot) {
+					records.subhalo_links[offsets.subhalo_links++] = index_of(subhalo_indices, ascendant, linked);
+				}
+			}
+			c_subhalo.n_ascendants = std::int64_t(offsets.subhalo_links) - c_subhalo.first_ascendant;
+			c_subhalo.first_galaxy = std::int64_t(offsets.galaxies);
+
+			for (auto &galaxy: subhalo->galaxies) {
+				auto &c_galaxy = records.galaxies[offsets.galaxies++];
+				fill_galaxy(c_galaxy, galaxy);
+				c_galaxy.first_history = std::int64_t(offsets.histories);
+				for (auto &item: galaxy.history) {
+					records.histories[offsets.histories++].item = item;
+				}
+				c_galaxy.first_bh_history = std::int64_t(offsets.bh_histories);
+				for (auto &item: galaxy.bh_history) {
+					records.bh_histories[offsets.bh_histories++] = item;
+				}
+			}
+		});
+	}
+	return linked;
+}
+
+HaloPtr make_halo(const checkpoint_halo &c_halo)
+{
+	auto halo = std::make_shared<Halo>(c_halo.id, c_halo.snapshot);
+	halo->position = {c_halo.position[0], c_halo.position[1], c_halo.position[2]};
+	halo->velocity = {c_halo.velocity[0], c_halo.velocity[1], c_halo.velocity[2]};
+	halo->mass_fraction_subhalos = c_halo.mass_fraction_subhalos;
+	halo->Vvir = c_halo.Vvir;
+	halo->Mvir = c_halo.Mvir;
+	halo->Mgas = c_halo.Mgas;
+	halo->concentration = c_halo.concentration;
+	halo->lambda = c_halo.lambda;
+	halo->age_80 = c_halo.age_80;
+	halo->age_50 = c_halo.age_50;
+	halo->excess_jetfeedback = c_halo.excess_jetfeedback;
+	halo->ignore_gal_formation = c_halo.ignore_gal_formation;
+	halo->hydrostatic_eq = c_halo.hydrostatic_eq;
+	return halo;
+}
+
+SubhaloPtr make_subhalo(const checkpoint_subhalo &c_subhalo)
+{
+	auto subhalo = std::make_shared<Subhalo>(c_subhalo.id, c_subhalo.snapshot);
+	subhalo->position = {c_subhalo.position[0], c_subhalo.position[1], c_subhalo.position[2]};
+	subhalo->velocity = {c_subhalo.velocity[0], c_subhalo.velocity[1], c_subhalo.velocity[2]};
+	subhalo->L = {c_subhalo.L[0], c_subhalo.L[1], c_subhalo.L[2]};
+	subhalo->descendant_id = c_subhalo.descendant_id;
+	subhalo->descendant_halo_id = c_subhalo.descendant_halo_id;
+	subhalo->haloID = c_subhalo.haloID;
+	subhalo->cooling_subhalo_tracking = c_subhalo.cooling_subhalo_tracking;
+	subhalo->Vvir = c_subhalo.Vvir;
+	subhalo->Mvir = c_subhalo.Mvir;
+	subhalo->Mgas = c_subhalo.Mgas;
+	subhalo->Vcirc = c_subhalo.Vcirc;
+	subhalo->concentration = c_subhalo.concentration;
+	subhalo->lambda = c_subhalo.lambda;
+	subhalo->infall_t = c_subhalo.infall_t;
+	subhalo->Mvir_infall = c_subhalo.Mvir_infall;
+	subhalo->rvir_infall = c_subhalo.rvir_infall;
+	subhalo->hot_halo_gas_r_rps = c_subhalo.hot_halo_gas_r_rps;
+	subhalo->accreted_mass = c_subhalo.accreted_mass;
+	subhalo->cooling_rate = c_subhalo.cooling_rate;
+	subhalo->mean_galaxy_making_stellar_halo = c_subhalo.mean_galaxy_making_stellar_halo;
+	subhalo->star_central_infall = c_subhalo.star_central_infall;
+	subhalo->lost_galaxy_gas = c_subhalo.lost_galaxy_gas;
+	subhalo->stellar_halo = c_subhalo.stellar_halo;
+	subhalo->hot_halo_gas_stripped = c_subhalo.hot_halo_gas_stripped;
+	subhalo->hot_halo_gas = c_subhalo.hot_halo_gas;
+	subhalo->cold_halo_gas = c_subhalo.cold_halo_gas;
+	subhalo->ejected_galaxy_gas = c_subhalo.ejected_galaxy_gas;
+	subhalo->Npart = c_subhalo.Npart;
+	subhalo->descendant_snapshot = c_subhalo.descendant_snapshot;
+	subhalo->last_snapshot_identified = c_subhalo.last_snapshot_identified;
+	subhalo->subhalo_type = Subhalo::subhalo_type_t(c_subhalo.subhalo_type);
+	subhalo->has_descendant = c_subhalo.has_descendant;
+	subhalo->main_progenitor = c_subhalo.main_progenitor;
+	subhalo->IsInterpolated = c_subhalo.IsInterpolated;
+	return subhalo;
+}
+
+void add_galaxy(Subhalo &subhalo, const checkpoint_galaxy &c_galaxy, const checkpoint_sections &sections)
+{
+	subhalo.galaxies.emplace_back(c_galaxy.id);
+	auto &galaxy = subhalo.galaxies.back();
+	galaxy.bulge_stars = c_galaxy.bulge_stars;
+	galaxy.bulge_gas = c_galaxy.bulge_gas;
+	galaxy.disk_stars = c_galaxy.disk_stars;
+	galaxy.disk_gas = c_galaxy.disk_gas;
+	galaxy.galaxymergers_burst_stars = c_galaxy.galaxymergers_burst_stars;
+	galaxy.galaxymergers_assembly_stars = c_galaxy.galaxymergers_assembly_stars;
+	galaxy.diskinstabilities_burst_stars = c_galaxy.diskinstabilities_burst_stars;
+	galaxy.diskinstabilities_assembly_stars = c_galaxy.diskinstabilities_assembly_stars;
+	galaxy.ram_pressure_stripped_gas = c_galaxy.ram_pressure_stripped_gas;
+	galaxy.stars_tidal_stripped = c_galaxy.stars_tidal_stripped;
+	galaxy.smbh = c_galaxy.smbh;
+	galaxy.interaction = c_galaxy.interaction;
+	galaxy.sfr_disk = c_galaxy.sfr_disk;
+	galaxy.sfr_bulge_mergers = c_galaxy.sfr_bulge_mergers;
+	galaxy.sfr_bulge_diskins = c_galaxy.sfr_bulge_diskins;
+	galaxy.sfr_z_disk = c_galaxy.sfr_z_disk;
+	galaxy.sfr_z_bulge_mergers = c_galaxy.sfr_z_bulge_mergers;
+	galaxy.sfr_z_bulge_diskins = c_galaxy.sfr_z_bulge_diskins;
+	galaxy.mean_stellar_age = c_galaxy.mean_stellar_age;
+	galaxy.total_stellar_mass_ever_formed = c_galaxy.total_stellar_mass_ever_formed;
+	galaxy.vmax = c_galaxy.vmax;
+	galaxy.r_rps = c_galaxy.r_rps;
+	galaxy.tmerge = c_galaxy.tmerge;
+	galaxy.concentration_type2 = c_galaxy.concentration_type2;
+	galaxy.msubhalo_type2 = c_galaxy.msubhalo_type2;
+	galaxy.vvir_type2 = c_galaxy.vvir_type2;
+	galaxy.lambda_type2 = c_galaxy.lambda_type2;
+	galaxy.mheat_ratio = c_galaxy.mheat_ratio;
+	galaxy.descendant_id = c_galaxy.descendant_id;
+	galaxy.birth_snapshot = c_galaxy.birth_snapshot;
+	galaxy.galaxy_type = Galaxy::galaxy_type_t(c_galaxy.galaxy_type);
+
+	galaxy.history.reserve(c_galaxy.n_histories);
+	for (std::int64_t i = 0; i != c_galaxy.n_histories; i++) {
+		galaxy.history.push_back(sections.histories[c_galaxy.first_history + i].item);
+	}
+	auto bh_history = sections.bh_histories + c_galaxy.first_bh_history;
+	galaxy.bh_history.assign(bh_history, bh_history + c_galaxy.n_bh_histories);
+}
+
+/// Whether the [first, first + count) ranges of @p records are consecutive
+/// and cover exactly @p n_targets elements
+template <typename Record>
+bool is_contiguous(const Record *records, std::uint64_t n_records, std::int64_t Record::*first, std::int64_t Record::*count, std::uint64_t n_targets)
+{
+	std::int64_t next = 0;
+	for (std::uint64_t i = 0; i != n_records; i++) {
+		if (records[i].*first != next || records[i].*count < 0) {
+			return false;
+		}
+		next += records[i].*count;
+	}
+	return std::uint64_t(next) == n_targets;
+}
+
+/// Checks that records are laid out as expected, so each tree can be created
+/// independently from the rest
+bool is_laid_out(const checkpoint_sections &sections)
+{
+	const auto &header = *sections.header;
+	return is_contiguous(sections.trees, header.n_trees, &checkpoint_tree::first_halo, &checkpoint_tree::n_halos, header.n_halos) &&
+	       is_contiguous(sections.halos, header.n_halos, &checkpoint_halo::first_subhalo, &checkpoint_halo::n_subhalos, header.n_subhalos) &&
+	       is_contiguous(sections.halos, header.n_halos, &checkpoint_halo::first_ascendant, &checkpoint_halo::n_ascendants, header.n_halo_links) &&
+	       is_contiguous(sections.subhalos, header.n_subhalos, &checkpoint_subhalo::first_galaxy, &checkpoint_subhalo::n_galaxies, header.n_galaxies) &&
+	       is_contiguous(sections.subhalos, header.n_subhalos, &checkpoint_subhalo::first_ascendant, &checkpoint_subhalo::n_ascendants, header.n_subhalo_links) &&
+	       is_contiguous(sections.galaxies, header.n_galaxies, &checkpoint_galaxy::first_history, &checkpoint_galaxy::n_histories, header.n_histories) &&
+	       is_contiguous(sections.galaxies, header.n_galaxies, &checkpoint_galaxy::first_bh_history, &checkpoint_galaxy::n_bh_histories, header.n_bh_histories);
+}
+
+/// Creates tree @p tree_idx, with all its halos, subhalos and galaxies linked
+/// together. Halos and subhalos are stored at their index in @p halos and
+/// @p subhalos, respectively.
+///
+/// @return Whether all links of the tree point to halos and subhalos of the tree
+bool make_tree(const checkpoint_sections &sections, std::size_t tree_idx, std::vector<HaloPtr> &halos, std::vector<SubhaloPtr> &subhalos, MergerTreePtr &tree)
+{
+	const auto &c_tree = sections.trees[tree_idx];
+	auto first_halo = c_tree.first_halo;
+	auto last_halo = first_halo + c_tree.n_halos;
+	if (first_halo == last_halo) {
+		tree = std::make_shared<MergerTree>(c_tree.id);
+		tree->last_snapshot = c_tree.last_snapshot;
+		return true;
+	}
+	auto first_subhalo = sections.halos[first_halo].first_subhalo;
+	auto last_subhalo = sections.halos[last_halo - 1].first_subhalo + sections.halos[last_halo - 1].n_subhalos;
+
+	// First create all objects, then link them together
+	for (auto i = first_halo; i != last_halo; i++) {
+		const auto &c_halo = sections.halos[i];
+		auto &halo = halos[i];
+		halo = make_halo(c_halo);
+		halo->satellite_subhalos.reserve(c_halo.n_subhalos);
+		for (std::int64_t j = 0; j != c_halo.n_subhalos; j++) {
+			auto subhalo_idx = c_halo.first_subhalo + j;
+			const auto &c_subhalo = sections.subhalos[subhalo_idx];
+			auto subhalo = make_subhalo(c_subhalo);
+			subhalo->galaxies.reserve(c_subhalo.n_galaxies);
+			for (std::int64_t k = 0; k != c_subhalo.n_galaxies; k++) {
+				add_galaxy(*subhalo, sections.galaxies[c_subhalo.first_galaxy + k], sections);
+			}
+			subhalo->host_halo = halo;
+			subhalos[subhalo_idx] = subhalo;
+			if (j == 0 && c_halo.has_central) {
+				halo->central_subhalo = std::move(subhalo);
+			}
+			else {
+				halo->satellite_subhalos.emplace_back(std::move(subhalo));
+			}
+		}
+	}
+
+	bool linked = true;
+	auto link = [&linked](std::int64_t idx, std::int64_t first, std::int64_t last, bool optional) {
+		if ((idx < first || idx >= last) && !(optional && idx == -1)) {
+			linked = false;
+			return false;
+		}
+		return idx != -1;
+	};
+	for (auto i = first_halo; i != last_halo; i++) {
+		const auto &c_halo = sections.halos[i];
+		auto &halo = halos[i];
+		if (link(c_halo.descendant, first_halo, last_halo, true)) {
+			halo->descendant = halos[c_halo.descendant];
+		}
+		halo->ascendants.reserve(c_halo.n_ascendants);
+		for (std::int64_t j = 0; j != c_halo.n_ascendants; j++) {
+			auto ascendant = sections.halo_links[c_halo.first_ascendant + j];
+			if (link(ascendant, first_halo, last_halo, false)) {
+				halo->ascendants.push_back(halos[ascendant]);
+			}
+		}
+	}
+	for (auto i = first_subhalo; i != last_subhalo; i++) {
+		const auto &c_subhalo = sections.subhalos[i];
+		auto &subhalo = subhalos[i];
+		if (link(c_subhalo.descendant, first_subhalo, last_subhalo, true)) {
+			subhalo->descendant = subhalos[c_subhalo.descendant];
+		}
+		subhalo->ascendants.reserve(c_subhalo.n_ascendants);
+		for (std::int64_t j = 0; j != c_subhalo.n_ascendants; j++) {
+			auto ascendant = sections.subhalo_links[c_subhalo.first_ascendant + j];
+			if (link(ascendant, first_subhalo, last_subhalo, false)) {
+				subhalo->ascendants.push_back(subhalos[ascendant]);
+			}
+		}
+	}
+
+	tree = std::make_shared<MergerTree>(c_tree.id);
+	tree->last_snapshot = c_tree.last_snapshot;
+	for (auto i = first_halo; i != last_halo; i++) {
+		halos[i]->merger_tree = tree;
+		tree->add_halo(halos[i]);
+	}
+	tree->index_snapshots();
+	return linked;
+}
+
+/// Finds the sections of checkpoint @p file, throwing an exception if it is not valid
+checkpoint_sections read_sections(const MappedFile &file, const std::string &filename)
+{
+	if (file.size() < sizeof(checkpoint_header)) {
+		throw invalid_data(filename + " is not a checkpoint file");
+	}
+	const auto &header = *file.at<checkpoint_header>(0);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byte_order_mark != BYTE_ORDER_MARK) {
+		throw invalid_data(filename + " is not a checkpoint file for this platform");
+	}
+	if (header.version != Checkpoint::VERSION) {
+		std::ostringstream os;
+		os << filename << " has version " << header.version << ", but only version " << Checkpoint::VERSION << " is supported";
+		throw invalid_data(os.str());
+	}
+
+	checkpoint_sections sections;
+	std::size_t offset = sizeof(checkpoint_header);
+	sections.header = &header;
+	sections.trees = read_records<checkpoint_tree>(file, offset, header.n_trees);
+	sections.halos = read_records<checkpoint_halo>(file, offset, header.n_halos);
+	sections.subhalos = read_records<checkpoint_subhalo>(file, offset, header.n_subhalos);
+	sections.galaxies = read_records<checkpoint_galaxy>(file, offset, header.n_galaxies);
+	sections.histories = read_records<checkpoint_history>(file, offset, header.n_histories);
+	sections.bh_histories = read_records<BHHistoryItem>(file, offset, header.n_bh_histories);
+	sections.halo_links = read_records<std::int64_t>(file, offset, header.n_halo_links);
+	sections.subhalo_links = read_records<std::int64_t>(file, offset, header.n_subhalo_links);
+	sections.baryons_offset = offset;
+	if (!sections.trees || !sections.halos || !sections.subhalos || !sections.galaxies || !sections.histories ||
+	    !sections.bh_histories || !sections.halo_links || !sections.subhalo_links || !is_laid_out(sections)) {
+		throw invalid_data("Checkpoint " + filename + " is corrupted");
+	}
+	return sections;
+}
+
+/// Options that don't change the results of an execution
+bool is_result_neutral_option(const std::string &name)
+{
+	for (auto &option: {"execution.seed", "execution.checkpoint_snapshots",
+	                    "execution.release_past_snapshots", "execution.tree_cache_dir",
+	                    "execution.tree_cache_checksums",
+	                    "execution.metrics_file", "execution.trace_file",
+	                    "execution.solver_samples_file", "execution.solver_samples_per_snapshot",
+	                    "execution.tree_timings_file", "execution.tree_cost_model"}) {
+		if (name == option) {
+			return true;
+		}
+	}
+	return false;
+}
+
+}  // anonymous namespace
+
+const std::uint32_t Checkpoint::VERSION;
+
+Checkpoint::Checkpoint(const std::string &filename, const Options &options, const ExecutionParameters &exec_params) :
+	filename(filename), seed(exec_params.seed)
+{
+	// All options influence the evolution, except for those that are known
+	// not to change results. The seed might have been randomly generated
+	hasher h;
+	h.update_value(VERSION);
+	for (auto &option: options.get_all()) {
+		if (!is_result_neutral_option(option.first)) {
+			h.update(option.first);
+			h.update(option.second);
+		}
+	}
+	h.update_value(exec_params.seed);
+	key = h.digest();
+}
+
+void Checkpoint::save(int snapshot, const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons, unsigned int threads) const
+{
+	Timer t;
+
+	// Records are laid out tree after tree, so once the number of records of
+	// each tree is known, trees can be laid out independently
+	std::vector<record_counts> tree_offsets(trees.size());
+	omp_dynamic_for(std::size_t(0), trees.size(), threads, 100, [&](std::size_t i, unsigned int thread_idx) {
+		tree_offsets[i] = count_records(*trees[i], snapshot);
+	});
+	record_counts totals;
+	for (auto &offsets: tree_offsets) {
+		auto counts = offsets;
+		offsets = totals;
+		totals += counts;
+	}
+
+	checkpoint_records records(trees.size(), totals);
+	std::vector<char> linked(trees.size());
+	omp_dynamic_for(std::size_t(0), trees.size(), threads, 100, [&](std::size_t i, unsigned int thread_idx) {
+		linked[i] = add_tree_records(*trees[i], i, snapshot, tree_offsets[i], records);
+	});
+	auto unlinked = std::find(linked.begin(), linked.end(), 0);
+	if (unlinked != linked.end()) {
+		std::ostringstream os;
+		os << trees[std::distance(linked.begin(), unlinked)] << " is linked to halos of other trees, cannot save checkpoint";
+		throw invalid_data(os.str());
+	}
+
+	checkpoint_header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byte_order_mark = BYTE_ORDER_MARK;
+	header.key = key;
+	header.seed = seed;
+	header.snapshot = snapshot;
+	header.n_trees = trees.size();
+	header.n_halos = totals.halos;
+	header.n_subhalos = totals.subhalos;
+	header.n_galaxies = totals.galaxies;
+	header.n_histories = totals.histories;
+	header.n_bh_histories = totals.bh_histories;
+	header.n_halo_links = totals.halo_links;
+	header.n_subhalo_links = totals.subhalo_links;
+
+	// Write into a temporary file first, then move it into place, so an
+	// interrupted execution never leaves a half-written checkpoint behind
+	boost::filesystem::path checkpoint_path(filename);
+	auto checkpoint_dir = checkpoint_path.parent_path();
+	if (!checkpoint_dir.empty() && !boost::filesystem::exists(checkpoint_dir)) {
+		boost::filesystem::create_directories(checkpoint_dir);
+	}
+	std::ostringstream tmp_filename;
+	tmp_filename << filename << ".tmp." << std::random_device()();
+	{
+		std::ofstream f(tmp_filename.str(), std::ios::binary | std::ios::trunc);
+		f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		write_records(f, records.trees);
+		write_records(f, records.halos);
+		write_records(f, records.subhalos);
+		write_records(f, records.galaxies);
+		write_records(f, records.histories);
+		write_records(f, records.bh_histories);
+		write_records(f, records.halo_links);
+		write_records(f, records.subhalo_links);
+		array_writer write_array(f);
+		for_each_baryon_array(all_baryons, write_array);
+		write_array(to_entries(all_baryons.baryon_total_created));
+		write_array(to_entries(all_baryons.baryon_total_lost));
+		if (!f) {
+			std::remove(tmp_filename.str().c_str());
+			throw exception("Error while writing checkpoint " + tmp_filename.str());
+		}
+	}
+	boost::filesystem::rename(tmp_filename.str(), checkpoint_path);
+
+	LOG(info) << "Saved checkpoint at snapshot " << snapshot << " with " << trees.size() << " merger trees ("
+	          << totals.halos << " halos, " << totals.subhalos << " subhalos, " << totals.galaxies << " galaxies) into "
+	          << filename << " (" << memory_amount(boost::filesystem::file_size(checkpoint_path)) << ") in " << t;
+}
+
+bool Checkpoint::load(int snapshot, std::vector<MergerTreePtr> &trees, TotalBaryon &all_baryons, unsigned int threads) const
+{
+	if (!boost::filesystem::exists(filename)) {
+		LOG(info) << "No checkpoint found at " << filename;
+		return false;
+	}
+
+	Timer t;
+	MappedFile file(filename);
+	auto sections = read_sections(file, filename);
+	const auto &header = *sections.header;
+	if (header.key != key) {
+		std::ostringstream os;
+		os << "Checkpoint " << filename << " was saved by an execution with ";
+		if (header.seed != seed) {
+			os << "a different seed (" << header.seed << ", this execution uses " << seed << ")";
+		}
+		else {
+			os << "different options";
+		}
+		throw invalid_data(os.str());
+	}
+	if (header.snapshot != snapshot) {
+		std::ostringstream os;
+		os << "Checkpoint " << filename << " was saved at snapshot " << header.snapshot << ", not " << snapshot;
+		throw invalid_data(os.str());
+	}
+
+	// Trees don't share any halo or subhalo, so they are created in parallel
+	std::vector<HaloPtr> halos(header.n_halos);
+	std::vector<SubhaloPtr> subhalos(header.n_subhalos);
+	std::vector<MergerTreePtr> loaded_trees(header.n_trees);
+	std::vector<char> linked(header.n_trees);
+	omp_dynamic_for(std::size_t(0), std::size_t(header.n_trees), threads, 100, [&](std::size_t i, unsigned int thread_idx) {
+		linked[i] = make_tree(sections, i, halos, subhalos, loaded_trees[i]);
+	});
+
+	TotalBaryon loaded_baryons;
+	std::vector<checkpoint_baryon_entry> baryons_created;
+	std::vector<checkpoint_baryon_entry> baryons_lost;
+	array_reader read_array(file, sections.baryons_offset);
+	for_each_baryon_array(loaded_baryons, read_array);
+	read_array(baryons_created);
+	read_array(baryons_lost);
+	if (!read_array.finished() || std::find(linked.begin(), linked.end(), 0) != linked.end()) {
+		throw invalid_data("Checkpoint " + filename + " is corrupted");
+	}
+	loaded_baryons.baryon_total_created = from_entries(baryons_created);
+	loaded_baryons.baryon_total_lost = from_entries(baryons_lost);
+
+	trees = std::move(loaded_trees);
+	all_baryons = std::move(loaded_baryons);
+	LOG(info) << "Loaded checkpoint at snapshot " << snapshot << " with " << trees.size() << " merger trees ("
+	          << header.n_halos << " halos, " << header.n_subhalos << " subhalos, " << header.n_galaxies << " galaxies) from "
+	          << filename << " in " << t;
+	return true;
+}
+
+}  // namespace shark
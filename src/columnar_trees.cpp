@@ -0,0 +1,296 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Columnar merger tree files implementation
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#include "columnar_trees.h"
+#include "exceptions.h"
+#include "halo.h"
+#include "logging.h"
+#include "subhalo.h"
+#include "timer.h"
+#include "hdf5/io/reader.h"
+
+namespace shark {
+
+namespace {
+
+constexpr char MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'C', 'O', 'L'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+//
+// File layout: header, snapshot offsets table and columns, each of them
+// starting at an 8-byte boundary. The offsets table has one entry per
+// snapshot in [min_snapshot, max_snapshot + 1], the last one being the total
+// number of rows.
+//
+struct columnar_header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order_mark;
+	std::uint64_t n_rows;
+	std::uint32_t number_of_files;
+	std::uint32_t has_gas_mass;
+	std::int32_t min_snapshot;
+	std::int32_t max_snapshot;
+	std::uint64_t column_offsets[ColumnarTreeFile::N_COLUMNS];
+};
+static_assert(std::is_trivially_copyable<columnar_header>::value && sizeof(columnar_header) % 8 == 0, "invalid columnar_header layout");
+
+std::size_t align8(std::size_t offset)
+{
+	return (offset + 7) & ~std::size_t(7);
+}
+
+/// The number of bytes taken by each row of @p column
+std::size_t row_size(ColumnarTreeFile::column_t column)
+{
+	switch (column) {
+	case ColumnarTreeFile::POSITION:
+	case ColumnarTreeFile::VELOCITY:
+	case ColumnarTreeFile::ANGULAR_MOMENTUM:
+		return 3 * sizeof(float);
+	case ColumnarTreeFile::NODE_MASS:
+	case ColumnarTreeFile::GAS_MASS:
+	case ColumnarTreeFile::MAXIMUM_CIRCULAR_VELOCITY:
+		return sizeof(float);
+	case ColumnarTreeFile::PARTICLE_NUMBER:
+	case ColumnarTreeFile::SNAPSHOT_NUMBER:
+	case ColumnarTreeFile::IS_MAIN_PROGENITOR:
+	case ColumnarTreeFile::IS_INTERPOLATED:
+		return sizeof(int);
+	case ColumnarTreeFile::NODE_INDEX:
+	case ColumnarTreeFile::DESCENDANT_INDEX:
+		return sizeof(Subhalo::id_t);
+	case ColumnarTreeFile::HOST_INDEX:
+	case ColumnarTreeFile::DESCENDANT_HOST:
+		return sizeof(Halo::id_t);
+	default:
+		throw invalid_argument("unknown column");
+	}
+}
+
+const columnar_header &get_header(const MappedFile &file)
+{
+	return *file.at<columnar_header>(0);
+}
+
+const std::uint64_t *get_snapshot_offsets(const MappedFile &file)
+{
+	return file.at<std::uint64_t>(sizeof(columnar_header));
+}
+
+/// Writes the rows of @p values (@p width elements each) in @p order,
+/// padded to a multiple of 8 bytes
+template <typename T>
+void write_column(std::ofstream &f, const std::vector<T> &values, const std::vector<std::size_t> &order, std::size_t width)
+{
+	std::vector<T> sorted;
+	sorted.reserve(values.size());
+	for (auto row: order) {
+		for (std::size_t j = 0; j != width; j++) {
+			sorted.push_back(values[row * width + j]);
+		}
+	}
+	auto size = sorted.size() * sizeof(T);
+	const char zeros[8] = {0};
+	f.write(reinterpret_cast<const char *>(sorted.data()), size);
+	f.write(zeros, align8(size) - size);
+}
+
+}  // anonymous namespace
+
+ColumnarTreeFile::ColumnarTreeFile(const std::string &fname) :
+	file(fname)
+{
+	if (file.size() < sizeof(columnar_header)) {
+		throw invalid_data(fname + " is not a columnar tree file");
+	}
+	auto &header = get_header(file);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byte_order_mark != BYTE_ORDER_MARK) {
+		throw invalid_data(fname + " is not a columnar tree file for this platform");
+	}
+	if (header.version != VERSION) {
+		std::ostringstream os;
+		os << fname << " has version " << header.version << ", but only version " << VERSION << " is supported";
+		throw invalid_data(os.str());
+	}
+
+	// The offsets table and all columns must lie entirely within the file
+	if (header.n_rows > 0) {
+		if (header.max_snapshot < header.min_snapshot) {
+			throw invalid_data(fname + " has an invalid snapshot range");
+		}
+		auto n_offsets = std::uint64_t(header.max_snapshot - header.min_snapshot) + 2;
+		if (sizeof(columnar_header) + n_offsets * sizeof(std::uint64_t) > file.size()) {
+			throw invalid_data(fname + " is truncated");
+		}
+		auto snapshot_offsets = get_snapshot_offsets(file);
+		for (std::uint64_t i = 0; i != n_offsets; i++) {
+			if (snapshot_offsets[i] > header.n_rows) {
+				throw invalid_data(fname + " has an invalid snapshot offsets table");
+			}
+		}
+	}
+	for (int column = 0; column != N_COLUMNS; column++) {
+		auto offset = header.column_offsets[column];
+		auto size = row_size(column_t(column));
+		if (offset > file.size() || header.n_rows > (file.size() - offset) / size) {
+			throw invalid_data(fname + " is truncated");
+		}
+	}
+}
+
+std::size_t ColumnarTreeFile::size() const
+{
+	return get_header(file).n_rows;
+}
+
+unsigned int ColumnarTreeFile::number_of_files() const
+{
+	return get_header(file).number_of_files;
+}
+
+bool ColumnarTreeFile::has_gas_mass() const
+{
+	return get_header(file).has_gas_mass != 0;
+}
+
+std::size_t ColumnarTreeFile::first_row_from(int snapshot) const
+{
+	auto &header = get_header(file);
+	if (header.n_rows == 0 || snapshot <= header.min_snapshot) {
+		return 0;
+	}
+	if (snapshot > header.max_snapshot) {
+		return header.n_rows;
+	}
+	return get_snapshot_offsets(file)[snapshot - header.min_snapshot];
+}
+
+std::size_t ColumnarTreeFile::column_offset(column_t column) const
+{
+	return get_header(file).column_offsets[column];
+}
+
+std::size_t write_columnar_trees(const std::string &hdf5_fname, const std::string &columnar_fname, bool gas_mass)
+{
+	Timer t;
+	hdf5::Reader batch_file(hdf5_fname);
+	auto number_of_files = batch_file.read_attribute<unsigned int>("fileInfo/numberOfFiles");
+	auto position = batch_file.read_dataset_v_2<float>("haloTrees/position");
+	auto velocity = batch_file.read_dataset_v_2<float>("haloTrees/velocity");
+	auto L = batch_file.read_dataset_v_2<float>("haloTrees/angularMomentum");
+	auto Mvir = batch_file.read_dataset_v<float>("haloTrees/nodeMass");
+	std::vector<float> Mgas(Mvir.size());
+	if (gas_mass) {
+		Mgas = batch_file.read_dataset_v<float>("haloTrees/Mgas");
+	}
+	auto Npart = batch_file.read_dataset_v<int>("haloTrees/particleNumber");
+	auto Vcirc = batch_file.read_dataset_v<float>("haloTrees/maximumCircularVelocity");
+	auto snap = batch_file.read_dataset_v<int>("haloTrees/snapshotNumber");
+	auto nodeIndex = batch_file.read_dataset_v<Subhalo::id_t>("haloTrees/nodeIndex");
+	auto descIndex = batch_file.read_dataset_v<Subhalo::id_t>("haloTrees/descendantIndex");
+	auto hostIndex = batch_file.read_dataset_v<Halo::id_t>("haloTrees/hostIndex");
+	auto descHost = batch_file.read_dataset_v<Halo::id_t>("haloTrees/descendantHost");
+	auto IsMain = batch_file.read_dataset_v<int>("haloTrees/isMainProgenitor");
+	auto IsInterpolated = batch_file.read_dataset_v<int>("haloTrees/isInterpolated");
+	auto n_rows = Mvir.size();
+	LOG(info) << "Read " << n_rows << " subhalos from " << hdf5_fname << " in " << t;
+
+	// Sort rows by snapshot and host
+	std::vector<std::size_t> order(n_rows);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+		return std::make_pair(snap[lhs], hostIndex[lhs]) < std::make_pair(snap[rhs], hostIndex[rhs]);
+	});
+
+	columnar_header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = ColumnarTreeFile::VERSION;
+	header.byte_order_mark = BYTE_ORDER_MARK;
+	header.n_rows = n_rows;
+	header.number_of_files = number_of_files;
+	header.has_gas_mass = gas_mass;
+	if (n_rows > 0) {
+		header.min_snapshot = snap[order.front()];
+		header.max_snapshot = snap[order.back()];
+	}
+
+	std::vector<std::uint64_t> snapshot_offsets;
+	if (n_rows > 0) {
+		snapshot_offsets.resize(header.max_snapshot - header.min_snapshot + 2);
+		for (int snapshot = header.min_snapshot; snapshot <= header.max_snapshot + 1; snapshot++) {
+			auto first = std::lower_bound(order.begin(), order.end(), snapshot, [&](std::size_t row, int s) {
+				return snap[row] < s;
+			});
+			snapshot_offsets[snapshot - header.min_snapshot] = std::uint64_t(std::distance(order.begin(), first));
+		}
+	}
+
+	// Columns are written after the header and offsets table, so we calculate
+	// their offsets first, then write everything sequentially
+	std::size_t offset = sizeof(columnar_header) + snapshot_offsets.size() * sizeof(std::uint64_t);
+	for (int column = 0; column != ColumnarTreeFile::N_COLUMNS; column++) {
+		header.column_offsets[column] = offset;
+		offset += align8(n_rows * row_size(ColumnarTreeFile::column_t(column)));
+	}
+
+	std::ofstream f(columnar_fname, std::ios::binary | std::ios::trunc);
+	f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char *>(snapshot_offsets.data()), snapshot_offsets.size() * sizeof(std::uint64_t));
+	write_column(f, position, order, 3);
+	write_column(f, velocity, order, 3);
+	write_column(f, L, order, 3);
+	write_column(f, Mvir, order, 1);
+	write_column(f, Mgas, order, 1);
+	write_column(f, Npart, order, 1);
+	write_column(f, Vcirc, order, 1);
+	write_column(f, snap, order, 1);
+	write_column(f, nodeIndex, order, 1);
+	write_column(f, descIndex, order, 1);
+	write_column(f, hostIndex, order, 1);
+	write_column(f, descHost, order, 1);
+	write_column(f, IsMain, order, 1);
+	write_column(f, IsInterpolated, order, 1);
+	if (!f) {
+		f.close();
+		std::remove(columnar_fname.c_str());
+		throw exception("Error while writing " + columnar_fname);
+	}
+
+	LOG(info) << "Wrote " << n_rows << " subhalos into " << columnar_fname << " in " << t;
+	return n_rows;
+}
+
+}  // namespace shark
@@ -57,7 +57,7 @@ DiskInstability::DiskInstability(DiskInstabilityParameters parameters,
 	// no-op
 }
 
-void DiskInstability::evaluate_disk_instability (HaloPtr &halo, int snapshot, double delta_t){
+void DiskInstability::evaluate_disk_instability (const HaloPtr &halo, int snapshot, double delta_t){
 
 	double z = simparams.redshifts[snapshot];
 
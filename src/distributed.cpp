@@ -0,0 +1,648 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Distributed execution implementation
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <boost/filesystem.hpp>
+
+#ifndef _WIN32
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif // _WIN32
+
+#include "cosmology.h"
+#include "dark_matter_halos.h"
+#include "distributed.h"
+#include "exceptions.h"
+#include "execution.h"
+#include "galaxy_writer.h"
+#include "logging.h"
+#include "merger_tree_reader.h"
+#include "options.h"
+#include "shark_runner.h"
+#include "simulation.h"
+#include "timer.h"
+#include "tree_cost.h"
+#include "utils.h"
+
+namespace shark {
+
+static_assert(std::is_trivially_copyable<snapshot_baryons>::value, "invalid snapshot_baryons layout");
+
+snapshot_baryons get_snapshot_baryons(int batch, int snapshot, const TotalBaryon &all_baryons)
+{
+	if (all_baryons.mcold.empty()) {
+		throw exception("No global quantities have been tracked yet");
+	}
+
+	auto find_or_zero = [](const std::map<int, double> &m, int snapshot) {
+		auto it = m.find(snapshot);
+		return it == m.end() ? 0. : it->second;
+	};
+
+	snapshot_baryons baryons;
+	baryons.batch = batch;
+	baryons.snapshot = snapshot;
+	baryons.mcold = all_baryons.mcold.back();
+	baryons.mstars = all_baryons.mstars.back();
+	baryons.mstars_burst_galaxymergers = all_baryons.mstars_burst_galaxymergers.back();
+	baryons.mstars_burst_diskinstabilities = all_baryons.mstars_burst_diskinstabilities.back();
+	baryons.mhot_halo = all_baryons.mhot_halo.back();
+	baryons.mcold_halo = all_baryons.mcold_halo.back();
+	baryons.mejected_halo = all_baryons.mejected_halo.back();
+	baryons.mBH = all_baryons.mBH.back();
+	baryons.mHI = all_baryons.mHI.back();
+	baryons.mH2 = all_baryons.mH2.back();
+	baryons.mDM = all_baryons.mDM.back();
+	baryons.SFR_disk = all_baryons.SFR_disk.back();
+	baryons.SFR_bulge = all_baryons.SFR_bulge.back();
+	baryons.max_BH = all_baryons.max_BH.back();
+	baryons.major_mergers = all_baryons.major_mergers.back();
+	baryons.minor_mergers = all_baryons.minor_mergers.back();
+	baryons.disk_instabil = all_baryons.disk_instabil.back();
+	baryons.baryon_total_created = find_or_zero(all_baryons.baryon_total_created, snapshot + 1);
+	baryons.baryon_total_lost = find_or_zero(all_baryons.baryon_total_lost, snapshot);
+	return baryons;
+}
+
+void LocalTransport::publish(const std::vector<work_batch> &batches)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->batches.assign(batches.begin(), batches.end());
+	baryons.clear();
+	results.clear();
+}
+
+bool LocalTransport::claim(work_batch &batch)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (batches.empty()) {
+		return false;
+	}
+	batch = std::move(batches.front());
+	batches.pop_front();
+	return true;
+}
+
+void LocalTransport::send(const snapshot_baryons &baryons)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->baryons.push_back(baryons);
+}
+
+void LocalTransport::finish(int batch, const std::string &error)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	results.push_back({batch, error});
+}
+
+void LocalTransport::receive(std::vector<snapshot_baryons> &baryons, std::vector<batch_result> &results)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::move(this->baryons.begin(), this->baryons.end(), std::back_inserter(baryons));
+	std::move(this->results.begin(), this->results.end(), std::back_inserter(results));
+	this->baryons.clear();
+	this->results.clear();
+}
+
+namespace {
+
+// Files exchanged through a DirectoryTransport. Batches are text files
+// with their ID, cost and seed in a first line, and their subvolumes in a
+// second one. Global quantities are snapshot_baryons as they are in memory,
+// and results contain the error of the batch, if any.
+constexpr const char *QUEUE_DIR = "queue";
+constexpr const char *CLAIMED_DIR = "claimed";
+constexpr const char *RESULTS_DIR = "results";
+constexpr const char *BATCH_SUFFIX = ".batch";
+constexpr const char *BARYONS_SUFFIX = ".baryons";
+constexpr const char *RESULT_SUFFIX = ".result";
+
+bool has_suffix(const std::string &name, const std::string &suffix)
+{
+	return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string read_file(const std::string &fname)
+{
+	std::ifstream f(fname, std::ios::binary);
+	if (!f) {
+		throw exception("Cannot open " + fname);
+	}
+	return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+std::vector<std::string> list_directory(const std::string &dirname)
+{
+	std::vector<std::string> names;
+	for (auto &entry: boost::filesystem::directory_iterator(dirname)) {
+		names.push_back(entry.path().filename().string());
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+}  // anonymous namespace
+
+DirectoryTransport::DirectoryTransport(const std::string &directory) :
+	directory(directory)
+{
+}
+
+void DirectoryTransport::write_file(const std::string &name, const std::string &contents)
+{
+	auto fname = directory + "/" + name;
+	auto tmp_fname = fname + "." + boost::filesystem::unique_path().string() + ".tmp";
+	{
+		std::ofstream f(tmp_fname, std::ios::binary | std::ios::trunc);
+		f.write(contents.data(), contents.size());
+		if (!f) {
+			throw exception("Error while writing " + tmp_fname);
+		}
+	}
+	boost::filesystem::rename(tmp_fname, fname);
+}
+
+void DirectoryTransport::publish(const std::vector<work_batch> &batches)
+{
+	auto queue_dir = boost::filesystem::path(directory) / QUEUE_DIR;
+	for (auto dirname: {QUEUE_DIR, CLAIMED_DIR, RESULTS_DIR}) {
+		boost::filesystem::remove_all(boost::filesystem::path(directory) / dirname);
+	}
+	boost::filesystem::create_directories(boost::filesystem::path(directory) / CLAIMED_DIR);
+	boost::filesystem::create_directories(boost::filesystem::path(directory) / RESULTS_DIR);
+	received.clear();
+
+	// Batches are written into a staging directory that is then renamed,
+	// so workers see either no queue or all of it. Names are zero-padded
+	// so batches are claimed in the order they are published
+	auto staging_dir = queue_dir.string() + "." + boost::filesystem::unique_path().string() + ".tmp";
+	boost::filesystem::create_directories(staging_dir);
+	for (std::size_t i = 0; i != batches.size(); i++) {
+		auto &batch = batches[i];
+		char name[32];
+		std::snprintf(name, sizeof(name), "%08zu", i);
+		std::ofstream f(staging_dir + "/" + name + BATCH_SUFFIX);
+		f.precision(17);
+		f << batch.id << ' ' << batch.cost << ' ' << batch.seed << '\n';
+		for (auto subvolume: batch.subvolumes) {
+			f << subvolume << ' ';
+		}
+		f << '\n';
+		if (!f) {
+			throw exception("Error while writing batch " + std::to_string(batch.id) + " into " + staging_dir);
+		}
+	}
+	boost::filesystem::rename(staging_dir, queue_dir);
+}
+
+bool DirectoryTransport::claim(work_batch &batch)
+{
+	auto queue_dir = directory + "/" + QUEUE_DIR;
+	auto claimed_dir = directory + "/" + CLAIMED_DIR;
+	if (!boost::filesystem::exists(queue_dir)) {
+		throw exception("No batches have been published in " + directory);
+	}
+
+	// Renaming is atomic, so only one worker succeeds in claiming each batch.
+	// Others have to try with the next one
+	while (true) {
+		bool any = false;
+		for (auto &name: list_directory(queue_dir)) {
+			if (!has_suffix(name, BATCH_SUFFIX)) {
+				continue;
+			}
+			any = true;
+			boost::system::error_code error;
+			boost::filesystem::rename(queue_dir + "/" + name, claimed_dir + "/" + name, error);
+			if (error) {
+				continue;
+			}
+
+			std::istringstream is(read_file(claimed_dir + "/" + name));
+			batch = work_batch();
+			is >> batch.id >> batch.cost >> batch.seed;
+			unsigned int subvolume;
+			while (is >> subvolume) {
+				batch.subvolumes.push_back(subvolume);
+			}
+			if (batch.subvolumes.empty()) {
+				throw invalid_data("Batch file " + name + " has no subvolumes");
+			}
+			return true;
+		}
+		if (!any) {
+			return false;
+		}
+	}
+}
+
+void DirectoryTransport::send(const snapshot_baryons &baryons)
+{
+	std::ostringstream os;
+	os << RESULTS_DIR << '/' << baryons.batch << '.' << baryons.snapshot << BARYONS_SUFFIX;
+	write_file(os.str(), std::string(reinterpret_cast<const char *>(&baryons), sizeof(baryons)));
+}
+
+void DirectoryTransport::finish(int batch, const std::string &error)
+{
+	write_file(std::string(RESULTS_DIR) + "/" + std::to_string(batch) + RESULT_SUFFIX, error);
+}
+
+void DirectoryTransport::receive(std::vector<snapshot_baryons> &baryons, std::vector<batch_result> &results)
+{
+	auto results_dir = directory + "/" + RESULTS_DIR;
+	auto names = list_directory(results_dir);
+
+	// Workers send global quantities before their results,
+	// so by reading all quantities first they are never received later
+	for (auto &name: names) {
+		if (!has_suffix(name, BARYONS_SUFFIX) || !received.insert(name).second) {
+			continue;
+		}
+		auto contents = read_file(results_dir + "/" + name);
+		if (contents.size() != sizeof(snapshot_baryons)) {
+			throw invalid_data(name + " has " + std::to_string(contents.size()) + " bytes, expected " + std::to_string(sizeof(snapshot_baryons)));
+		}
+		snapshot_baryons snapshot;
+		std::copy(contents.begin(), contents.end(), reinterpret_cast<char *>(&snapshot));
+		baryons.push_back(snapshot);
+	}
+	for (auto &name: names) {
+		if (!has_suffix(name, RESULT_SUFFIX) || !received.insert(name).second) {
+			continue;
+		}
+		auto batch = std::stoi(name.substr(0, name.size() - std::char_traits<char>::length(RESULT_SUFFIX)));
+		results.push_back({batch, read_file(results_dir + "/" + name)});
+	}
+}
+
+Coordinator::Coordinator(Transport &transport, int min_snapshot, int max_snapshot, std::chrono::steady_clock::duration worker_timeout) :
+	transport(transport),
+	min_snapshot(min_snapshot),
+	max_snapshot(max_snapshot),
+	worker_timeout(worker_timeout)
+{
+}
+
+void Coordinator::publish(std::vector<work_batch> batches)
+{
+	std::stable_sort(batches.begin(), batches.end(), [](const work_batch &lhs, const work_batch &rhs) {
+		return lhs.cost > rhs.cost;
+	});
+
+	pending_batches.clear();
+	batch_baryons.clear();
+	snapshot_batches.clear();
+	for (auto &batch: batches) {
+		pending_batches.emplace(batch.id, batch.subvolumes);
+	}
+	n_batches = batches.size();
+	transport.publish(batches);
+	last_received = std::chrono::steady_clock::now();
+	LOG(info) << "Published " << n_batches << " batches for workers to evolve";
+}
+
+bool Coordinator::receive()
+{
+	std::vector<snapshot_baryons> baryons;
+	std::vector<batch_result> results;
+	transport.receive(baryons, results);
+
+	// Workers send global quantities after each snapshot, so a long silence
+	// means the remaining ones died or lost their connection to the transport
+	auto now = std::chrono::steady_clock::now();
+	if (!baryons.empty() || !results.empty()) {
+		last_received = now;
+	}
+	else if (worker_timeout != std::chrono::steady_clock::duration::zero() && !pending_batches.empty() &&
+	         now - last_received > worker_timeout) {
+		std::ostringstream os;
+		os << "Nothing received from workers in "
+		   << std::chrono::duration_cast<std::chrono::seconds>(now - last_received).count()
+		   << " [s], giving up on the unfinished subvolumes:";
+		for (auto &batch: pending_batches) {
+			for (auto subvolume: batch.second) {
+				os << ' ' << subvolume;
+			}
+		}
+		throw exception(os.str());
+	}
+
+	for (auto &snapshot: baryons) {
+		batch_baryons[snapshot.batch][snapshot.snapshot] = snapshot;
+		if (++snapshot_batches[snapshot.snapshot] != n_batches) {
+			continue;
+		}
+		BaryonBase mstars;
+		for (auto &batch: batch_baryons) {
+			mstars += batch.second.at(snapshot.snapshot).mstars;
+		}
+		LOG(info) << "Snapshot " << snapshot.snapshot << " evolved by all " << n_batches
+		          << " batches, total stellar mass: " << mstars.mass << " [Msun/h]";
+	}
+
+	for (auto &result: results) {
+		if (!result.error.empty()) {
+			throw exception("Batch " + std::to_string(result.batch) + " failed: " + result.error);
+		}
+		pending_batches.erase(result.batch);
+		LOG(info) << "Batch " << result.batch << " finished, " << pending_batches.size() << " batches left";
+	}
+	return pending_batches.empty();
+}
+
+TotalBaryon Coordinator::get_total_baryons() const
+{
+	TotalBaryon all_baryons;
+	for (int snapshot = min_snapshot; snapshot < max_snapshot; snapshot++) {
+		snapshot_baryons total {};
+		for (auto &batch: batch_baryons) {
+			auto it = batch.second.find(snapshot);
+			if (it == batch.second.end()) {
+				throw exception("Batch " + std::to_string(batch.first) + " did not send global quantities for snapshot " + std::to_string(snapshot));
+			}
+			auto &b = it->second;
+			total.mcold += b.mcold;
+			total.mstars += b.mstars;
+			total.mstars_burst_galaxymergers += b.mstars_burst_galaxymergers;
+			total.mstars_burst_diskinstabilities += b.mstars_burst_diskinstabilities;
+			total.mhot_halo += b.mhot_halo;
+			total.mcold_halo += b.mcold_halo;
+			total.mejected_halo += b.mejected_halo;
+			total.mBH += b.mBH;
+			total.mHI += b.mHI;
+			total.mH2 += b.mH2;
+			total.mDM += b.mDM;
+			total.SFR_disk += b.SFR_disk;
+			total.SFR_bulge += b.SFR_bulge;
+			total.max_BH = std::max(total.max_BH, b.max_BH);
+			total.major_mergers += b.major_mergers;
+			total.minor_mergers += b.minor_mergers;
+			total.disk_instabil += b.disk_instabil;
+			total.baryon_total_created += b.baryon_total_created;
+			total.baryon_total_lost += b.baryon_total_lost;
+		}
+
+		all_baryons.mcold.push_back(total.mcold);
+		all_baryons.mstars.push_back(total.mstars);
+		all_baryons.mstars_burst_galaxymergers.push_back(total.mstars_burst_galaxymergers);
+		all_baryons.mstars_burst_diskinstabilities.push_back(total.mstars_burst_diskinstabilities);
+		all_baryons.mhot_halo.push_back(total.mhot_halo);
+		all_baryons.mcold_halo.push_back(total.mcold_halo);
+		all_baryons.mejected_halo.push_back(total.mejected_halo);
+		all_baryons.mBH.push_back(total.mBH);
+		all_baryons.mHI.push_back(total.mHI);
+		all_baryons.mH2.push_back(total.mH2);
+		all_baryons.mDM.push_back(total.mDM);
+		all_baryons.SFR_disk.push_back(total.SFR_disk);
+		all_baryons.SFR_bulge.push_back(total.SFR_bulge);
+		all_baryons.max_BH.push_back(total.max_BH);
+		all_baryons.major_mergers.push_back(total.major_mergers);
+		all_baryons.minor_mergers.push_back(total.minor_mergers);
+		all_baryons.disk_instabil.push_back(total.disk_instabil);
+		all_baryons.baryon_total_created[snapshot + 1] = total.baryon_total_created;
+		all_baryons.baryon_total_lost[snapshot] = total.baryon_total_lost;
+	}
+	return all_baryons;
+}
+
+namespace {
+
+/// Worker processes started in this machine, which are terminated
+/// if they are still running when this object is destroyed
+class LocalWorkers {
+
+public:
+	LocalWorkers(unsigned int n, const Options &options, Transport &transport, unsigned int threads)
+	{
+#ifdef _WIN32
+		if (n != 0) {
+			throw invalid_argument("Local workers are not supported in this platform");
+		}
+#else
+		// Avoid children flushing the parent's buffered output
+		std::cout.flush();
+		std::cerr.flush();
+		for (unsigned int i = 0; i != n; i++) {
+			auto pid = ::fork();
+			if (pid == -1) {
+				throw exception("Cannot start local worker");
+			}
+			if (pid == 0) {
+				int status = 0;
+				try {
+					run_worker(options, transport, threads);
+				} catch (const std::exception &e) {
+					LOG(error) << "Local worker failed: " << e.what();
+					status = 1;
+				}
+				std::cout.flush();
+				std::cerr.flush();
+				::_exit(status);
+			}
+			pids.push_back(pid);
+		}
+#endif // _WIN32
+	}
+
+	~LocalWorkers()
+	{
+#ifndef _WIN32
+		for (auto pid: pids) {
+			::kill(pid, SIGTERM);
+		}
+		wait();
+#endif // _WIN32
+	}
+
+	/// @return The number of workers still running
+	std::size_t running()
+	{
+#ifndef _WIN32
+		pids.erase(std::remove_if(pids.begin(), pids.end(), [](pid_t pid) {
+			int status;
+			return ::waitpid(pid, &status, WNOHANG) == pid;
+		}), pids.end());
+#endif // _WIN32
+		return pids.size();
+	}
+
+	/// Waits for all workers to finish
+	void wait()
+	{
+#ifndef _WIN32
+		for (auto pid: pids) {
+			int status;
+			::waitpid(pid, &status, 0);
+		}
+		pids.clear();
+#endif // _WIN32
+	}
+
+private:
+#ifndef _WIN32
+	std::vector<pid_t> pids;
+#else
+	std::vector<int> pids;
+#endif // _WIN32
+};
+
+}  // anonymous namespace
+
+void run_coordinator(const Options &options, Transport &transport, unsigned int local_workers, unsigned int threads, std::chrono::steady_clock::duration worker_timeout)
+{
+	Timer t;
+	ExecutionParameters exec_params(options);
+	if (exec_params.output_format != Options::HDF5) {
+		throw invalid_option("Distributed executions require execution.output_format to be hdf5");
+	}
+	CosmologicalParameters cosmo_params(options);
+	DarkMatterHaloParameters dark_matter_halo_params(options);
+	SimulationParameters simulation_params(options);
+	auto cosmology = make_cosmology(cosmo_params);
+	auto dark_matter_halos = make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params);
+
+	// One batch per subvolume, all evolved with the same seed
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, 1);
+	auto fnames = reader.get_filenames(exec_params.simulation_batches);
+	std::vector<work_batch> batches;
+	for (std::size_t i = 0; i != fnames.size(); i++) {
+		boost::system::error_code error;
+		auto size = boost::filesystem::file_size(fnames[i], error);
+		if (error) {
+			throw invalid_data("Cannot find tree file " + fnames[i]);
+		}
+		work_batch batch;
+		batch.id = int(i);
+		batch.cost = double(size);
+		batch.seed = exec_params.seed;
+		batch.subvolumes.push_back(exec_params.simulation_batches[i]);
+		batches.emplace_back(std::move(batch));
+	}
+
+	// Costs predicted by the tree cost model are used instead of file sizes,
+	// but only if they are known for all subvolumes so they can be compared
+	TreeCostModel cost_model(exec_params.tree_cost_model);
+	std::vector<double> model_costs;
+	for (auto &batch: batches) {
+		double cost;
+		if (!cost_model.subvolume_cost(batch.subvolumes.front(), cost)) {
+			break;
+		}
+		model_costs.push_back(cost);
+	}
+	if (cost_model.enabled() && model_costs.size() == batches.size()) {
+		LOG(info) << "Using costs predicted by tree cost model " << exec_params.tree_cost_model;
+		for (std::size_t i = 0; i != batches.size(); i++) {
+			batches[i].cost = model_costs[i];
+		}
+	}
+	else if (cost_model.enabled()) {
+		LOG(warning) << "Tree cost model " << exec_params.tree_cost_model << " doesn't know the cost of all subvolumes, using tree file sizes instead";
+	}
+
+	Coordinator coordinator(transport, simulation_params.min_snapshot, simulation_params.max_snapshot, worker_timeout);
+	coordinator.publish(std::move(batches));
+
+	LocalWorkers workers(local_workers, options, transport, threads);
+	while (!coordinator.receive()) {
+		if (local_workers != 0 && workers.running() == 0 && !coordinator.receive()) {
+			throw exception("All local workers finished before all batches were evolved");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	workers.wait();
+
+	HDF5GalaxyWriter writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, AGNFeedbackParameters(options));
+	auto all_baryons = coordinator.get_total_baryons();
+	auto fname = writer.write_global(simulation_params.max_snapshot, all_baryons);
+	LOG(info) << "Global quantities of all batches written into " << fname;
+	LOG(info) << "All batches evolved in " << t;
+}
+
+unsigned int run_worker(const Options &options, Transport &transport, unsigned int threads)
+{
+	ExecutionParameters exec_params(options);
+	unsigned int evolved = 0;
+	work_batch batch;
+	while (transport.claim(batch)) {
+		Timer t;
+		std::ostringstream os;
+		std::copy(batch.subvolumes.begin(), batch.subvolumes.end(), std::ostream_iterator<unsigned int>(os, " "));
+		LOG(info) << "Evolving batch " << batch.id << " with subvolumes " << os.str();
+
+		Options batch_options(options);
+		batch_options.add("execution.simulation_batches=" + os.str());
+		batch_options.add("execution.seed=" + std::to_string(batch.seed));
+
+		// Batches evolved by the same worker don't overwrite each other's files
+		auto suffix = "." + std::to_string(batch.id);
+		if (!exec_params.metrics_file.empty()) {
+			batch_options.add("execution.metrics_file=" + exec_params.metrics_file + suffix);
+		}
+		if (!exec_params.solver_samples_file.empty()) {
+			batch_options.add("execution.solver_samples_file=" + exec_params.solver_samples_file + suffix);
+		}
+		if (!exec_params.tree_timings_file.empty()) {
+			batch_options.add("execution.tree_timings_file=" + exec_params.tree_timings_file + suffix);
+		}
+
+		std::string error;
+		try {
+			SharkRunner runner(batch_options, threads);
+			runner.on_snapshot_evolved([&](int snapshot, const TotalBaryon &all_baryons) {
+				transport.send(get_snapshot_baryons(batch.id, snapshot, all_baryons));
+			});
+			runner.run();
+		} catch (const std::exception &e) {
+			error = e.what();
+			if (error.empty()) {
+				error = "unknown error";
+			}
+		}
+		transport.finish(batch.id, error);
+		if (!error.empty()) {
+			throw exception("Batch " + std::to_string(batch.id) + " failed: " + error);
+		}
+		LOG(info) << "Batch " << batch.id << " evolved in " << t;
+		evolved++;
+	}
+	LOG(info) << "No batches left to evolve, " << evolved << " batches evolved by this worker";
+	return evolved;
+}
+
+}  // namespace shark
@@ -21,15 +21,21 @@
  * @file
  */
 
+#include <algorithm>
 #include <cmath>
+#include <exception>
 #include <memory>
+#include <unordered_map>
 
 #include "evolve_halos.h"
 #include "halo.h"
 #include "logging.h"
+#include "merger_tree.h"
 #include "numerical_constants.h"
+#include "omp_utils.h"
 #include "subhalo.h"
 #include "total_baryon.h"
+#include "trace.h"
 
 namespace shark {
 
@@ -83,11 +89,21 @@ void adjust_main_galaxy(const SubhaloPtr &parent, const SubhaloPtr &descendant)
 
 }
 
-void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons)
-{
-	unsigned int subhalos_without_descendant = 0;
-	double baryon_mass_loss = 0;
+namespace {
+
+/// The baryon mass of a subhalo without descendant, and the merger tree it belonged to
+struct baryon_mass_loss {
+	const MergerTree *tree;
+	double mass;
+};
+
+}  // anonymous namespace
 
+/// Transfers the galaxies of @p halos, recording the baryon mass of the
+/// subhalos without descendant in @p baryon_mass_losses
+static void transfer_galaxies(const halo_range &halos, std::vector<baryon_mass_loss> &baryon_mass_losses)
+{
+#ifndef NDEBUG
 	// Make sure descendants are completely empty
 	for(auto &halo: halos){
 		for(auto &subhalo: halo->all_subhalos()) {
@@ -97,6 +113,7 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 			assert(subhalo->descendant->galaxy_count() == 0);
 		}
 	}
+#endif // NDEBUG
 
 	for(auto &halo: halos){
 		for(auto &subhalo: halo->all_subhalos()) {
@@ -117,8 +134,7 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 			auto descendant_subhalo = subhalo->descendant;
 
 			if (!descendant_subhalo) {
-				subhalos_without_descendant++;
-				baryon_mass_loss += subhalo->total_baryon_mass();
+				baryon_mass_losses.push_back({halo->merger_tree.get(), subhalo->total_baryon_mass()});
 				continue;
 			}
 
@@ -167,19 +183,60 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 			subhalo->descendant->check_subhalo_galaxy_composition();
 		}
 	}
+}
+
+void transfer_galaxies_to_next_snapshot(const std::vector<MergerTreePtr> &trees, const std::vector<halo_range> &halo_groups, int snapshot,
+		TotalBaryon &AllBaryons, unsigned int threads)
+{
+	std::vector<std::vector<baryon_mass_loss>> baryon_mass_losses(halo_groups.size());
+	std::vector<std::exception_ptr> errors(halo_groups.size());
+	omp_dynamic_for(std::size_t(0), halo_groups.size(), threads, 1, [&](std::size_t i, unsigned int thread_idx) {
+		TraceSpan span("transfer_partition", i);
+		try {
+			transfer_galaxies(halo_groups[i], baryon_mass_losses[i]);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+	for (auto &error: errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Groups contain the halos of each tree one after the other, so sorting
+	// losses by tree (keeping their order within each tree) makes them add up
+	// in the order of @p trees, regardless of how trees were grouped
+	std::vector<baryon_mass_loss> losses;
+	for (auto &group_losses: baryon_mass_losses) {
+		losses.insert(losses.end(), group_losses.begin(), group_losses.end());
+	}
+	auto subhalos_without_descendant = losses.size();
 
 	if (subhalos_without_descendant != 0) {
-		AllBaryons.baryon_total_lost[snapshot] = baryon_mass_loss;
+		std::unordered_map<const MergerTree *, std::size_t> tree_indices;
+		tree_indices.reserve(trees.size());
+		for (std::size_t i = 0; i != trees.size(); i++) {
+			tree_indices.emplace(trees[i].get(), i);
+		}
+		std::stable_sort(losses.begin(), losses.end(), [&tree_indices](const baryon_mass_loss &lhs, const baryon_mass_loss &rhs) {
+			return tree_indices.at(lhs.tree) < tree_indices.at(rhs.tree);
+		});
+		double total_loss = 0;
+		for (auto &loss: losses) {
+			total_loss += loss.mass;
+		}
+		AllBaryons.baryon_total_lost[snapshot] = total_loss;
 		LOG(warning) << "Found " << subhalos_without_descendant << " subhalos without descendant while transferring galaxies.";
 	}
 
 }
 
-void reset_instantaneous_galaxy_properties(const std::vector<HaloPtr> &halos, int snapshot)
+void reset_instantaneous_galaxy_properties(const std::vector<HaloPtr> &halos, int snapshot, unsigned int threads)
 {
 	// This function resets to 0 all galaxy properties that are instantaneous to the snapshot. This is done after the writing.
 
-	for(auto &halo: halos){
+	omp_static_for(halos, threads, [](const HaloPtr &halo, unsigned int thread_idx) {
 		for(auto &subhalo: halo->all_subhalos()) {
 
 			// Make sure all SFRs and BH accretion rates (in mass and metals) are set to 0 for the next snapshot
@@ -197,13 +254,43 @@ void reset_instantaneous_galaxy_properties(const std::vector<HaloPtr> &halos, in
 				galaxy.interaction.restore_interaction_item();
 			}
 		}
-	}
+	});
+
+}
 
+void record_galaxy_histories(const Halo &halo, int snapshot)
+{
+	for (auto &subhalo: halo.all_subhalos()){
+		for (auto &galaxy: subhalo->galaxies){
+
+			//define and save SF history item
+			HistoryItem hist_galaxy;
+			hist_galaxy.sfr_disk            = galaxy.sfr_disk;
+			hist_galaxy.sfr_bulge_mergers   = galaxy.sfr_bulge_mergers;
+			hist_galaxy.sfr_bulge_diskins   = galaxy.sfr_bulge_diskins;
+			hist_galaxy.sfr_z_disk          = galaxy.sfr_z_disk;
+			hist_galaxy.sfr_z_bulge_mergers = galaxy.sfr_z_bulge_mergers;
+			hist_galaxy.sfr_z_bulge_diskins = galaxy.sfr_z_bulge_diskins;
+			hist_galaxy.snapshot            = snapshot;
+			galaxy.history.emplace_back(hist_galaxy);
+
+			//define and save BH history item
+			BHHistoryItem bh_hist_galaxy;
+			bh_hist_galaxy.macc_hh 		= galaxy.smbh.macc_hh;
+			bh_hist_galaxy.macc_sb	 	= galaxy.smbh.macc_sb;
+			bh_hist_galaxy.massembly 	= galaxy.smbh.massembly;
+			bh_hist_galaxy.mbh 		= galaxy.smbh.mass;
+			bh_hist_galaxy.spin 		= galaxy.smbh.spin;
+			bh_hist_galaxy.snapshot 	= snapshot;
+			galaxy.bh_history.emplace_back(bh_hist_galaxy);
+		}
+	}
 }
 
-void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat){
+namespace {
 
+/// The global baryon amounts tracked at each snapshot
+struct baryon_totals {
 
 	BaryonBase mcold_total;
 	BaryonBase mhothalo_total;
@@ -227,115 +314,138 @@ void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, S
 	int number_minor_mergers = 0;
 	int number_disk_instabil = 0;
 
+	baryon_totals &operator+=(const baryon_totals &other)
+	{
+		mcold_total += other.mcold_total;
+		mhothalo_total += other.mhothalo_total;
+		mcoldhalo_total += other.mcoldhalo_total;
+		mejectedhalo_total += other.mejectedhalo_total;
+		mlosthalo_total += other.mlosthalo_total;
+		mstars_total += other.mstars_total;
+		mstars_bursts_galaxymergers += other.mstars_bursts_galaxymergers;
+		mstars_bursts_diskinstabilities += other.mstars_bursts_diskinstabilities;
+		MBH_total += other.MBH_total;
+		mHI_total += other.mHI_total;
+		mH2_total += other.mH2_total;
+		mDM_total += other.mDM_total;
+		SMBH_max = std::max(SMBH_max, other.SMBH_max);
+		SFR_total_disk += other.SFR_total_disk;
+		SFR_total_burst += other.SFR_total_burst;
+		number_major_mergers += other.number_major_mergers;
+		number_minor_mergers += other.number_minor_mergers;
+		number_disk_instabil += other.number_disk_instabil;
+		return *this;
+	}
+};
+
+void add_halo_totals(baryon_totals &totals, const Halo &halo, const molgas_per_galaxy &molgas, double deltat, double mean_age)
+{
+	// accumulate dark matter mass
+	totals.mDM_total.mass += halo.Mvir;
+
+	for (auto &subhalo: halo.all_subhalos()){
+
+		// Accumulate subhalo baryons
+		totals.mhothalo_total.mass += subhalo->hot_halo_gas.mass;
+		totals.mhothalo_total.mass_metals += subhalo->hot_halo_gas.mass_metals;
+
+		totals.mcoldhalo_total.mass += subhalo->cold_halo_gas.mass;
+		totals.mcoldhalo_total.mass_metals += subhalo->cold_halo_gas.mass_metals;
+
+		totals.mejectedhalo_total.mass += subhalo->ejected_galaxy_gas.mass;
+		totals.mejectedhalo_total.mass_metals += subhalo->ejected_galaxy_gas.mass_metals;
+
+		totals.mlosthalo_total.mass += subhalo->lost_galaxy_gas.mass;
+		totals.mlosthalo_total.mass_metals += subhalo->lost_galaxy_gas.mass_metals;
+
+		for (auto &galaxy: subhalo->galaxies){
+
+			totals.number_major_mergers += galaxy.interaction.major_mergers;
+			totals.number_minor_mergers += galaxy.interaction.minor_mergers;
+			totals.number_disk_instabil += galaxy.interaction.disk_instabilities;
+
+			galaxy.mean_stellar_age += (galaxy.sfr_disk + galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins) * deltat * mean_age;
+			galaxy.total_stellar_mass_ever_formed += (galaxy.sfr_disk + galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins) * deltat;
+
+			//Accumulate galaxy baryons
+			auto &molecular_gas = molgas.at(galaxy.id);
+
+			totals.mHI_total.mass += molecular_gas.m_atom + molecular_gas.m_atom_b;
+			totals.mH2_total.mass += molecular_gas.m_mol + molecular_gas.m_mol_b;
+
+			totals.mcold_total.mass += galaxy.disk_gas.mass + galaxy.bulge_gas.mass;
+			totals.mcold_total.mass_metals += galaxy.disk_gas.mass_metals + galaxy.bulge_gas.mass_metals;
+
+			totals.mstars_total.mass += galaxy.disk_stars.mass + galaxy.bulge_stars.mass;
+			totals.mstars_total.mass_metals += galaxy.disk_stars.mass_metals + galaxy.bulge_stars.mass_metals;
+
+			totals.mstars_bursts_galaxymergers.mass += galaxy.galaxymergers_burst_stars.mass;
+			totals.mstars_bursts_galaxymergers.mass_metals += galaxy.galaxymergers_burst_stars.mass_metals;
+			totals.mstars_bursts_diskinstabilities.mass += galaxy.diskinstabilities_burst_stars.mass;
+			totals.mstars_bursts_diskinstabilities.mass_metals += galaxy.diskinstabilities_burst_stars.mass_metals;
+
+			totals.SFR_total_disk  += galaxy.sfr_disk;
+			totals.SFR_total_burst += galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins;
+
+			totals.MBH_total.mass += galaxy.smbh.mass;
+
+			if(galaxy.smbh.mass > totals.SMBH_max){
+				totals.SMBH_max = galaxy.smbh.mass;
+			}
+		}
+	}
+}
+
+}  // anonymous namespace
+
+void track_total_baryons(Cosmology &cosmology, SimulationParameters simulation_params, const std::vector<MergerTreePtr> &trees,
+		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads){
+
 	double z1 = simulation_params.redshifts[snapshot];
 	double z2 = simulation_params.redshifts[snapshot+1];
 
 	double mean_age = 0.5 * (cosmology.convert_redshift_to_age(z1) + cosmology.convert_redshift_to_age(z2));
 
-	// Loop over all halos and subhalos to write galaxy properties
-	for (auto &halo: halos){
-
-		// accumulate dark matter mass
-		mDM_total.mass += halo->Mvir;
-        
-		for (auto &subhalo: halo->all_subhalos()){
-        
-			// Accumulate subhalo baryons
-			mhothalo_total.mass += subhalo->hot_halo_gas.mass;
-			mhothalo_total.mass_metals += subhalo->hot_halo_gas.mass_metals;
-        
-			mcoldhalo_total.mass += subhalo->cold_halo_gas.mass;
-			mcoldhalo_total.mass_metals += subhalo->cold_halo_gas.mass_metals;
-        
-			mejectedhalo_total.mass += subhalo->ejected_galaxy_gas.mass;
-			mejectedhalo_total.mass_metals += subhalo->ejected_galaxy_gas.mass_metals;
-
-			mlosthalo_total.mass += subhalo->lost_galaxy_gas.mass;
-			mlosthalo_total.mass_metals += subhalo->lost_galaxy_gas.mass_metals;
-        
-			for (auto &galaxy: subhalo->galaxies){
-       
-				number_major_mergers += galaxy.interaction.major_mergers;
-				number_minor_mergers += galaxy.interaction.minor_mergers;
-				number_disk_instabil += galaxy.interaction.disk_instabilities;
-
-				galaxy.mean_stellar_age += (galaxy.sfr_disk + galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins) * deltat * mean_age;
-				galaxy.total_stellar_mass_ever_formed += (galaxy.sfr_disk + galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins) * deltat;
-
-				if(execparams.output_sf_histories){
-
-					//define and save SF history item
-					HistoryItem hist_galaxy;
-					hist_galaxy.sfr_disk            = galaxy.sfr_disk;
-					hist_galaxy.sfr_bulge_mergers   = galaxy.sfr_bulge_mergers;
-					hist_galaxy.sfr_bulge_diskins   = galaxy.sfr_bulge_diskins;
-					hist_galaxy.sfr_z_disk          = galaxy.sfr_z_disk;
-					hist_galaxy.sfr_z_bulge_mergers = galaxy.sfr_z_bulge_mergers;
-					hist_galaxy.sfr_z_bulge_diskins = galaxy.sfr_z_bulge_diskins;
-					hist_galaxy.snapshot            = snapshot;
-					galaxy.history.emplace_back(hist_galaxy);
-
-					//define and save BH history item
-					BHHistoryItem bh_hist_galaxy;
-					bh_hist_galaxy.macc_hh 		= galaxy.smbh.macc_hh;
-					bh_hist_galaxy.macc_sb	 	= galaxy.smbh.macc_sb;
-					bh_hist_galaxy.massembly 	= galaxy.smbh.massembly;
-					bh_hist_galaxy.mbh 		= galaxy.smbh.mass; 
-					bh_hist_galaxy.spin 		= galaxy.smbh.spin;
-				        bh_hist_galaxy.snapshot 	= snapshot;	
-					galaxy.bh_history.emplace_back(bh_hist_galaxy);
-				}
-        
-				//Accumulate galaxy baryons
-				auto &molecular_gas = molgas.at(galaxy.id);
-        
-				mHI_total.mass += molecular_gas.m_atom + molecular_gas.m_atom_b;
-				mH2_total.mass += molecular_gas.m_mol + molecular_gas.m_mol_b;
-        
-				mcold_total.mass += galaxy.disk_gas.mass + galaxy.bulge_gas.mass;
-				mcold_total.mass_metals += galaxy.disk_gas.mass_metals + galaxy.bulge_gas.mass_metals;
-        
-				mstars_total.mass += galaxy.disk_stars.mass + galaxy.bulge_stars.mass;
-				mstars_total.mass_metals += galaxy.disk_stars.mass_metals + galaxy.bulge_stars.mass_metals;
-        
-				mstars_bursts_galaxymergers.mass += galaxy.galaxymergers_burst_stars.mass;
-				mstars_bursts_galaxymergers.mass_metals += galaxy.galaxymergers_burst_stars.mass_metals;
-				mstars_bursts_diskinstabilities.mass += galaxy.diskinstabilities_burst_stars.mass;
-				mstars_bursts_diskinstabilities.mass_metals += galaxy.diskinstabilities_burst_stars.mass_metals;
-
-				SFR_total_disk  += galaxy.sfr_disk;
-				SFR_total_burst += galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins;
-        
-				MBH_total.mass += galaxy.smbh.mass;
-
-				if(galaxy.smbh.mass > SMBH_max){
-					SMBH_max = galaxy.smbh.mass;
-				}
-        
+	// Trees are split in blocks of a fixed size which are accumulated in parallel,
+	// and then added together in order, so totals don't depend on the number of threads
+	constexpr std::size_t trees_per_block = 1024;
+	auto n_blocks = (trees.size() + trees_per_block - 1) / trees_per_block;
+	std::vector<baryon_totals> block_totals(n_blocks);
+	omp_dynamic_for(std::size_t(0), n_blocks, threads, 1, [&](std::size_t block, unsigned int thread_idx) {
+		auto first = trees.begin() + block * trees_per_block;
+		auto last = trees.begin() + std::min(trees.size(), (block + 1) * trees_per_block);
+		for (auto tree = first; tree != last; tree++) {
+			for (auto &halo: (*tree)->halos_at(snapshot)) {
+				add_halo_totals(block_totals[block], *halo, molgas, deltat, mean_age);
 			}
 		}
+	});
+
+	baryon_totals totals;
+	for (auto &block_total: block_totals) {
+		totals += block_total;
 	}
 
-	AllBaryons.mstars.push_back(mstars_total);
-	AllBaryons.mstars_burst_galaxymergers.push_back(mstars_bursts_galaxymergers);
-	AllBaryons.mstars_burst_diskinstabilities.push_back(mstars_bursts_diskinstabilities);
-	AllBaryons.mcold.push_back(mcold_total);
-	AllBaryons.mHI.push_back(mHI_total);
-	AllBaryons.mH2.push_back(mH2_total);
-	AllBaryons.mBH.push_back(MBH_total);
-	AllBaryons.SFR_disk.push_back(SFR_total_disk);
-	AllBaryons.SFR_bulge.push_back(SFR_total_burst);
-
-	AllBaryons.major_mergers.push_back(number_major_mergers);
-	AllBaryons.minor_mergers.push_back(number_minor_mergers);
-	AllBaryons.disk_instabil.push_back(number_disk_instabil);
-
-	AllBaryons.mhot_halo.push_back(mhothalo_total);
-	AllBaryons.mcold_halo.push_back(mcoldhalo_total);
-	AllBaryons.mejected_halo.push_back(mejectedhalo_total);
-
-	AllBaryons.mDM.push_back(mDM_total);
-	AllBaryons.max_BH.push_back(SMBH_max);
+	AllBaryons.mstars.push_back(totals.mstars_total);
+	AllBaryons.mstars_burst_galaxymergers.push_back(totals.mstars_bursts_galaxymergers);
+	AllBaryons.mstars_burst_diskinstabilities.push_back(totals.mstars_bursts_diskinstabilities);
+	AllBaryons.mcold.push_back(totals.mcold_total);
+	AllBaryons.mHI.push_back(totals.mHI_total);
+	AllBaryons.mH2.push_back(totals.mH2_total);
+	AllBaryons.mBH.push_back(totals.MBH_total);
+	AllBaryons.SFR_disk.push_back(totals.SFR_total_disk);
+	AllBaryons.SFR_bulge.push_back(totals.SFR_total_burst);
+
+	AllBaryons.major_mergers.push_back(totals.number_major_mergers);
+	AllBaryons.minor_mergers.push_back(totals.number_minor_mergers);
+	AllBaryons.disk_instabil.push_back(totals.number_disk_instabil);
+
+	AllBaryons.mhot_halo.push_back(totals.mhothalo_total);
+	AllBaryons.mcold_halo.push_back(totals.mcoldhalo_total);
+	AllBaryons.mejected_halo.push_back(totals.mejectedhalo_total);
+
+	AllBaryons.mDM.push_back(totals.mDM_total);
+	AllBaryons.max_BH.push_back(totals.SMBH_max);
 }
 
 } // namespace shark
@@ -55,6 +55,24 @@ ExecutionParameters::ExecutionParameters(const Options &options)
 
 	options.load("execution.output_bh_histories", output_bh_histories);
 	options.load("execution.snapshots_bh_histories", snapshots_bh_histories);
+
+	options.load("execution.tree_cache_dir", tree_cache_dir);
+	options.load("execution.tree_cache_checksums", tree_cache_checksums);
+	options.load("execution.release_past_snapshots", release_past_snapshots);
+	options.load("execution.stream_snapshots", stream_snapshots);
+	options.load("execution.output_properties", output_properties);
+	options.load("execution.output_block_size", output_block_size);
+	options.load("execution.checkpoint_snapshots", checkpoint_snapshots);
+	options.load("execution.metrics_file", metrics_file);
+	options.load("execution.solver_samples_file", solver_samples_file);
+	options.load("execution.solver_samples_per_snapshot", solver_samples_per_snapshot);
+	options.load("execution.tree_timings_file", tree_timings_file);
+	options.load("execution.tree_cost_model", tree_cost_model);
+
+	// Streamed snapshots need to be released once evolved
+	if (stream_snapshots) {
+		release_past_snapshots = true;
+	}
 }
 
 bool ExecutionParameters::output_snapshot(int snapshot)
@@ -67,4 +85,55 @@ int ExecutionParameters::last_output_snapshot()
 	return *output_snapshots.rbegin();
 }
 
+bool ExecutionParameters::checkpoint_snapshot(int snapshot) const
+{
+	return checkpoint_snapshots.find(snapshot) != checkpoint_snapshots.end();
+}
+
+/// Matches @p name against @p pattern, where * matches any number of characters
+static bool matches(const char *pattern, const char *name)
+{
+	const char *star = nullptr;
+	const char *star_name = nullptr;
+	while (*name) {
+		if (*pattern == '*') {
+			star = pattern++;
+			star_name = name;
+		}
+		else if (*pattern == *name) {
+			pattern++;
+			name++;
+		}
+		else if (star) {
+			pattern = star + 1;
+			name = ++star_name;
+		}
+		else {
+			return false;
+		}
+	}
+	while (*pattern == '*') {
+		pattern++;
+	}
+	return *pattern == 0;
+}
+
+bool ExecutionParameters::output_property(const std::string &name) const
+{
+	bool has_inclusions = false;
+	bool included = false;
+	for (auto &property: output_properties) {
+		if (property[0] == '!') {
+			if (matches(property.c_str() + 1, name.c_str())) {
+				return false;
+			}
+		}
+		else {
+			has_inclusions = true;
+			included = included || matches(property.c_str(), name.c_str());
+		}
+	}
+	return !has_inclusions || included;
+}
+
 } // namespace shark
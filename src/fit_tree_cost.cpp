@@ -0,0 +1,158 @@
+//
+// Main routine for the shark-fit-tree-cost program
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Calibrates a tree cost model out of the per-tree timings recorded by
+ * previous executions
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "logging.h"
+#include "tree_cost.h"
+
+namespace shark {
+
+namespace {
+
+void show_help(const char *prog, const boost::program_options::options_description &desc, std::ostream &out)
+{
+	using std::endl;
+	out << endl;
+	out << "Usage: " << prog << " [options] timings-file [... timings-file]" << endl;
+	out << endl;
+	out << "Fits a model predicting the time needed to evolve each merger tree out of its" << endl;
+	out << "structure, using the per-tree timings written by previous executions through" << endl;
+	out << "execution.tree_timings_file. The model is written into the output file, to" << endl;
+	out << "be given to later executions through execution.tree_cost_model." << endl;
+	out << endl;
+	out << desc << endl;
+}
+
+void setup_logging(int verbosity)
+{
+	namespace log = ::boost::log;
+	namespace trivial = ::boost::log::trivial;
+	verbosity = 5 - std::min(std::max(verbosity, 0), 5);
+	trivial::severity_level sev_lvl = logging_level = trivial::severity_level(verbosity);
+	log::core::get()->set_filter([sev_lvl](log::attribute_value_set const &s) {
+		return s["Severity"].extract<trivial::severity_level>() >= sev_lvl;
+	});
+}
+
+int run(int argc, char **argv)
+{
+	using std::string;
+	using std::vector;
+	namespace po = boost::program_options;
+
+	po::options_description visible_opts("shark-fit-tree-cost options");
+	visible_opts.add_options()
+		("help,h",    "Show this help message")
+		("verbose,v", po::value<int>()->default_value(3), "Verbosity level. Higher is more verbose")
+		("output,o",  po::value<string>()->default_value("tree_cost_model.txt"), "File where the model is written");
+
+	po::positional_options_description pdesc;
+	pdesc.add("timings-file", -1);
+
+	po::options_description all_opts;
+	all_opts.add(visible_opts);
+	all_opts.add_options()
+		("timings-file", po::value<vector<string>>()->multitoken(), "Tree timings file(s)");
+
+	po::variables_map vm;
+	po::command_line_parser parser(argc, argv);
+	parser.options(all_opts).positional(pdesc);
+	po::store(parser.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") != 0) {
+		show_help(argv[0], visible_opts, std::cout);
+		return 0;
+	}
+	if (vm.count("timings-file") == 0) {
+		show_help(argv[0], visible_opts, std::cerr);
+		return 1;
+	}
+
+	setup_logging(vm["verbose"].as<int>());
+
+	vector<tree_timings> timings;
+	for (auto &timings_file: vm["timings-file"].as<vector<string>>()) {
+		timings.emplace_back(read_tree_timings(timings_file));
+		LOG(info) << "Read timings of " << timings.back().trees.size() << " merger trees from " << timings_file;
+	}
+
+	auto model = TreeCostModel::fit(timings);
+	for (std::size_t i = 0; i != TreeCostModel::N_WEIGHTS; i++) {
+		std::cout << std::left << std::setw(14) << TreeCostModel::WEIGHT_NAMES[i]
+		          << std::right << std::scientific << std::setprecision(6) << model.get_weights()[i] << '\n';
+	}
+
+	// How much of the variance of the measured times the model explains
+	double n_trees = 0, total_seconds = 0, total_predicted = 0;
+	for (auto &execution_timings: timings) {
+		for (auto &timing: execution_timings.trees) {
+			n_trees++;
+			total_seconds += timing.seconds;
+			total_predicted += model.predict(timing.features);
+		}
+	}
+	double mean_seconds = total_seconds / n_trees;
+	double residuals = 0, variance = 0;
+	for (auto &execution_timings: timings) {
+		for (auto &timing: execution_timings.trees) {
+			auto residual = timing.seconds - model.predict(timing.features);
+			residuals += residual * residual;
+			variance += (timing.seconds - mean_seconds) * (timing.seconds - mean_seconds);
+		}
+	}
+	std::cout << std::fixed << std::setprecision(3)
+	          << "Measured time: " << total_seconds << " [s], predicted time: " << total_predicted << " [s]"
+	          << ", R^2: " << (variance == 0 ? 1 : 1 - residuals / variance) << std::endl;
+
+	auto output = vm["output"].as<string>();
+	model.save(output);
+	LOG(info) << "Tree cost model written into " << output;
+	return 0;
+}
+
+}  // anonymous namespace
+
+}  // namespace shark
+
+int main(int argc, char **argv)
+{
+	try {
+		return shark::run(argc, argv);
+	} catch (const std::exception &e) {
+		std::cerr << "Error while running shark-fit-tree-cost: " << e.what() << std::endl;
+		return 1;
+	}
+}
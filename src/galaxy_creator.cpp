@@ -43,28 +43,37 @@ GalaxyCreator::GalaxyCreator(CosmologyPtr cosmology, GasCoolingParameters cool_p
 void GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons)
 {
 	int galaxies_added = 0;
-	double total_baryon = 0.0;
 
-	Galaxy::id_t galaxy_id = 0;
 	auto timer = Timer();
 	for(int snapshot = sim_params.min_snapshot; snapshot <= sim_params.max_snapshot - 1; snapshot++) {
-		auto z = sim_params.redshifts[snapshot];
+		std::vector<HaloPtr> halos;
 		for(auto &merger_tree: merger_trees) {
-			for(auto &halo: merger_tree->halos_at(snapshot)) {
-				if (create_galaxies(halo, z, galaxy_id)) {
-					galaxy_id++;
-					galaxies_added++;
-					total_baryon += halo->central_subhalo->hot_halo_gas.mass;
-				}
-			}
+			auto snapshot_halos = merger_tree->halos_at(snapshot);
+			halos.insert(halos.end(), snapshot_halos.begin(), snapshot_halos.end());
 		}
-		// Keep track of the total amount of baryons integrated from the first snapshot to the current one.
-		AllBaryons.baryon_total_created[snapshot] += total_baryon;
+		galaxies_added += create_galaxies(halos, snapshot, AllBaryons);
 	}
 
 	LOG(info) << "Created " << galaxies_added << " initial galaxies in " << timer;
 }
 
+int GalaxyCreator::create_galaxies(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons)
+{
+	int galaxies_added = 0;
+	auto z = sim_params.redshifts[snapshot];
+	for(auto &halo: halos) {
+		if (create_galaxies(halo, z, next_galaxy_id)) {
+			next_galaxy_id++;
+			galaxies_added++;
+			total_baryon += halo->central_subhalo->hot_halo_gas.mass;
+		}
+	}
+
+	// Keep track of the total amount of baryons integrated from the first snapshot to the current one.
+	AllBaryons.baryon_total_created[snapshot] += total_baryon;
+	return galaxies_added;
+}
+
 bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t galaxy_id)
 {
 
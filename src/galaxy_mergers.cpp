@@ -233,7 +233,7 @@ void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary
 	}
 }
 
-void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z, int snapshot)
+void GalaxyMergers::merging_subhalos(const HaloPtr &halo, double z, int snapshot)
 {
 	auto central_subhalo = halo->central_subhalo;
 
@@ -327,7 +327,7 @@ void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z, int snapshot)
 
 }
 
-void GalaxyMergers::merging_galaxies(HaloPtr &halo, int snapshot, double delta_t){
+void GalaxyMergers::merging_galaxies(const HaloPtr &halo, int snapshot, double delta_t){
 
 	/**
 	 * This function determines which galaxies are merging in this snapshot by comparing tmerge with the duration of the snapshot.
@@ -401,7 +401,7 @@ void GalaxyMergers::merging_galaxies(HaloPtr &halo, int snapshot, double delta_t
 
 }
 
-void GalaxyMergers::create_merger(Galaxy &central, const Galaxy &satellite, HaloPtr &halo, int snapshot) const
+void GalaxyMergers::create_merger(Galaxy &central, const Galaxy &satellite, const HaloPtr &halo, int snapshot) const
 {
 	/**
 	 * This function classifies the merger and transfer all the baryon masses to the right component of the central.
@@ -580,7 +580,7 @@ void GalaxyMergers::create_merger(Galaxy &central, const Galaxy &satellite, Halo
 
 }
 
-void GalaxyMergers::create_starbursts(HaloPtr &halo, double z, double delta_t){
+void GalaxyMergers::create_starbursts(const HaloPtr &halo, double z, double delta_t){
 
 	for (auto &subhalo: halo->all_subhalos()){
 		for (auto &galaxy: subhalo->galaxies){
@@ -623,7 +623,7 @@ void GalaxyMergers::create_starbursts(HaloPtr &halo, double z, double delta_t){
 
 }
 
-double GalaxyMergers::bulge_size_merger(double mass_ratio, double mgas_ratio, const Galaxy &central, const Galaxy &satellite, HaloPtr &halo, double z) const
+double GalaxyMergers::bulge_size_merger(double mass_ratio, double mgas_ratio, const Galaxy &central, const Galaxy &satellite, const HaloPtr &halo, double z) const
 {
 	/**
 	 * This function calculates the bulge sizes resulting from a galaxy mergers following Cole et al. (2000). This assumes
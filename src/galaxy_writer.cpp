@@ -23,7 +23,10 @@
  * Galaxy writer classes implementations
  */
 
+#include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <initializer_list>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -41,39 +44,50 @@
 #include "halo.h"
 #include "git_revision.h"
 #include "logging.h"
+#include "omp_utils.h"
 #include "star_formation.h"
 #include "subhalo.h"
 #include "timer.h"
 #include "total_baryon.h"
+#include "trace.h"
 #include "utils.h"
 
 
 namespace shark {
 
-GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  CosmologyPtr cosmology, DarkMatterHalosPtr darkmatterhalo, SimulationParameters sim_params, AGNFeedbackParameters agn_params):
+GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  CosmologyPtr cosmology, DarkMatterHalosPtr darkmatterhalo, SimulationParameters sim_params, AGNFeedbackParameters agn_params, unsigned int threads):
 	exec_params(std::move(exec_params)),
 	cosmo_params(std::move(cosmo_params)),
 	cosmology(std::move(cosmology)),
 	darkmatterhalo(std::move(darkmatterhalo)),
 	sim_params(std::move(sim_params)),
-	agn_params(std::move(agn_params))
+	agn_params(std::move(agn_params)),
+	threads(threads)
 {
 	//no-opt
 }
 
-std::string GalaxyWriter::get_output_directory(int snapshot)
+std::string GalaxyWriter::get_output_directory_name(int snapshot) const
 {
-	using namespace boost::filesystem;
-	using std::string;
-
-	string batch_dir = "multiple_batches";
+	std::string batch_dir = "multiple_batches";
 	if (exec_params.simulation_batches.size() == 1) {
 		batch_dir = std::to_string(exec_params.simulation_batches[0]);
 	}
 
-	string output_dir = exec_params.output_directory + "/" + sim_params.sim_name +
-	                    "/" + exec_params.name_model + "/" + std::to_string(snapshot) +
-	                    "/" + batch_dir;
+	return get_model_directory_name() + "/" + std::to_string(snapshot) + "/" + batch_dir;
+}
+
+std::string GalaxyWriter::get_model_directory_name() const
+{
+	return exec_params.output_directory + "/" + sim_params.sim_name + "/" + exec_params.name_model;
+}
+
+std::string GalaxyWriter::get_output_directory(int snapshot)
+{
+	using namespace boost::filesystem;
+	using std::string;
+
+	string output_dir = get_output_directory_name(snapshot);
 
 	// Make sure the directory structure exists
 	path dirname(output_dir);
@@ -86,6 +100,7 @@ std::string GalaxyWriter::get_output_directory(int snapshot)
 
 void HDF5GalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
 {
+	TraceSpan span("write_snapshot", snapshot);
 	hdf5::Writer file(get_output_directory(snapshot) + "/galaxies.hdf5");
 	write_header(file, snapshot);
 	write_galaxies(file, snapshot, halos, molgas_per_gal);
@@ -95,6 +110,20 @@ void HDF5GalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, To
 
 }
 
+std::string HDF5GalaxyWriter::write_global(int snapshot, TotalBaryon &AllBaryons)
+{
+	boost::filesystem::path dirname(get_model_directory_name());
+	if (!boost::filesystem::exists(dirname)) {
+		boost::filesystem::create_directories(dirname);
+	}
+
+	auto fname = dirname.string() + "/global.hdf5";
+	hdf5::Writer file(fname);
+	write_header(file, snapshot);
+	write_global_properties(file, snapshot, AllBaryons);
+	return fname;
+}
+
 void HDF5GalaxyWriter::write_header(hdf5::Writer &file, int snapshot){
 
 	std::string comment;
@@ -175,170 +204,554 @@ std::size_t report_vsize(const std::vector<T> &v, std::ostringstream &os, const
 	return amount;
 }
 
+/// Resizes @p column to @p size if any of the datasets in @p names is written
+template <typename T>
+static inline
+void resize_if_written(std::vector<T> &column, std::size_t size, const ExecutionParameters &exec_params, std::initializer_list<const char *> names)
+{
+	if (std::any_of(names.begin(), names.end(), [&exec_params](const char *name) { return exec_params.output_property(name); })) {
+		column.resize(size);
+	}
+}
+
+/// Sets element @p i of @p column, unless it is not written
+template <typename T, typename V>
+static inline
+void set_value(std::vector<T> &column, std::size_t i, const V &value)
+{
+	if (!column.empty()) {
+		column[i] = value;
+	}
+}
+
+/// Writes the columns selected by ExecutionParameters::output_properties,
+/// keeping track of the names of those written. If a chunk size is set,
+/// columns are written as extendible datasets instead, and subsequent blocks
+/// of columns are appended to them
+class SelectedColumnsWriter {
+
+public:
+	SelectedColumnsWriter(hdf5::Writer &file, const ExecutionParameters &exec_params) :
+		file(file), exec_params(exec_params)
+	{
+	}
+
+	void set_chunk_size(std::size_t chunk_size)
+	{
+		this->chunk_size = chunk_size;
+	}
+
+	template <typename T>
+	void write(const std::string &name, const std::vector<T> &column, const std::string &comment)
+	{
+		if (!exec_params.output_property(name)) {
+			return;
+		}
+		if (chunk_size == 0) {
+			file.write_dataset(name, column, comment);
+		}
+		else {
+			if (first_block) {
+				file.create_extendible_dataset<T>(name, chunk_size, comment);
+			}
+			file.append_dataset(name, column);
+		}
+		if (first_block) {
+			written_columns.push_back(name);
+		}
+	}
+
+	void finish_block()
+	{
+		first_block = false;
+	}
+
+	const std::vector<std::string> &get_written_columns() const
+	{
+		return written_columns;
+	}
+
+private:
+	hdf5::Writer &file;
+	const ExecutionParameters &exec_params;
+	std::size_t chunk_size = 0;
+	bool first_block = true;
+	std::vector<std::string> written_columns;
+};
+
+/// Returns the number of galaxies of @p halo that are written for @p snapshot
+static
+std::size_t count_written_galaxies(const Halo &halo, int snapshot)
+{
+	std::size_t n_galaxies = 0;
+	for (auto &subhalo: halo.all_subhalos()) {
+		n_galaxies += std::count_if(subhalo->galaxies.begin(), subhalo->galaxies.end(), [snapshot](const Galaxy &galaxy) {
+			return galaxy.birth_snapshot != snapshot;
+		});
+	}
+	return n_galaxies;
+}
+
+/// Buffers holding the columns of halo, subhalo and galaxy properties
+/// written by the HDF5GalaxyWriter, in halo order
+struct GalaxyColumns {
+
+	// Halo, subhalo and galaxy identifiers
+	std::vector<Subhalo::id_t> descendant_id;
+	std::vector<int> main;
+	std::vector<Subhalo::id_t> id;
+	std::vector<Halo::id_t> host_id;
+	std::vector<Galaxy::id_t> id_galaxy;
+	std::vector<Galaxy::id_t> descendant_id_galaxy;
+	std::vector<Halo::id_t> halo_id;
+
+	// Galaxy properties
+	std::vector<float> mstars_disk;
+	std::vector<float> mstars_bulge;
+	std::vector<float> mstars_burst_mergers;
+	std::vector<float> mstars_burst_diskinstabilities;
+	std::vector<float> mstars_bulge_mergers_assembly;
+	std::vector<float> mstars_bulge_diskins_assembly;
+	std::vector<float> mstars_stripped;
+	std::vector<float> mgas_disk;
+	std::vector<float> mgas_bulge;
+	std::vector<float> mgas_stripped;
+
+	std::vector<float> mstars_metals_disk;
+	std::vector<float> mstars_metals_bulge;
+	std::vector<float> mstars_metals_burst_mergers;
+	std::vector<float> mstars_metals_burst_diskinstabilities;
+	std::vector<float> mstars_metals_bulge_mergers_assembly;
+	std::vector<float> mstars_metals_bulge_diskins_assembly;
+	std::vector<float> mstars_metals_stripped;
+	std::vector<float> mgas_metals_disk;
+	std::vector<float> mgas_metals_bulge;
+	std::vector<float> mgas_stripped_metals;
+
+	std::vector<float> mmol_disk;
+	std::vector<float> mmol_bulge;
+	std::vector<float> matom_disk;
+	std::vector<float> matom_bulge;
+
+	std::vector<float> mBH;
+	std::vector<float> mBH_assembly;
+	std::vector<float> mBH_acc_hh;
+	std::vector<float> mBH_acc_sb;
+	std::vector<float> bh_spin;
+
+	std::vector<float> sfr_disk;
+	std::vector<float> sfr_burst;
+	std::vector<float> sfr_burst_mergers;
+	std::vector<float> sfr_burst_diskins;
+	std::vector<float> mean_stellar_age;
+
+	std::vector<float> rdisk_gas;
+	std::vector<float> rbulge_gas;
+	std::vector<float> r_stripped_ism;
+	std::vector<float> sAM_disk_gas;
+	std::vector<float> sAM_disk_gas_atom;
+	std::vector<float> sAM_disk_gas_mol;
+	std::vector<float> sAM_bulge_gas;
+
+	std::vector<float> rdisk_star;
+	std::vector<float> rbulge_star;
+	std::vector<float> sAM_disk_star;
+	std::vector<float> sAM_bulge_star;
+
+	std::vector<float> redshift_of_merger;
+
+	std::vector<float> mhot;
+	std::vector<float> mhot_metals;
+
+	std::vector<float> mreheated;
+	std::vector<float> mreheated_metals;
+
+	std::vector<float> mhot_stripped;
+	std::vector<float> mhot_stripped_metals;
+	std::vector<float> r_stripped;
+
+	std::vector<float> stellar_halo;
+	std::vector<float> stellar_halo_metals;
+	std::vector<float> mean_stellar_mass_galaxies_ihsc;
+
+	std::vector<float> mlost;
+	std::vector<float> mlost_metals;
+
+	std::vector<float> cooling_rate;
+	std::vector<int> on_hydrostatic_eq;
+
+	std::vector<float> mvir_hosthalo;
+	std::vector<float> mvir_subhalo;
+	std::vector<float> vmax_subhalo;
+	std::vector<float> vvir_hosthalo;
+	std::vector<float> vvir_subhalo;
+	std::vector<float> mvir_infall_subhalo;
+
+	std::vector<float> cnfw_subhalo;
+	std::vector<float> lambda_subhalo;
+
+	std::vector<float> halo_m;
+	std::vector<float> halo_v;
+	std::vector<float> halo_lambda;
+	std::vector<float> halo_concentration;
+	std::vector<float> age_80_halo;
+	std::vector<float> age_50_halo;
+	std::vector<float> halo_final_m;
+
+	std::vector<float> infall_time_subhalo;
+
+	std::vector<float> position_x;
+	std::vector<float> position_y;
+	std::vector<float> position_z;
+
+	std::vector<float> velocity_x;
+	std::vector<float> velocity_y;
+	std::vector<float> velocity_z;
+
+	std::vector<float> L_x;
+	std::vector<float> L_y;
+	std::vector<float> L_z;
+
+	std::vector<float> L_x_subhalo;
+	std::vector<float> L_y_subhalo;
+	std::vector<float> L_z_subhalo;
+
+	std::vector<int> type;
+
+	std::vector<Halo::id_t> id_halo;
+	std::vector<Halo::id_t> id_halo_tree;
+	std::vector<Subhalo::id_t> id_subhalo;
+	std::vector<Subhalo::id_t> id_subhalo_tree;
+
+	/// Resizes the columns that are written according to @p exec_params to
+	/// hold the given number of halos, subhalos and galaxies. Columns that are
+	/// not written are left empty, and are not filled
+	void resize(std::size_t n_halos, std::size_t n_subhalos, std::size_t n_galaxies, const ExecutionParameters &exec_params)
+	{
+		resize_if_written(halo_m, n_halos, exec_params, {"halo/mvir", "halo/vvir"});
+		resize_if_written(halo_v, n_halos, exec_params, {});
+		resize_if_written(halo_lambda, n_halos, exec_params, {"halo/lambda"});
+		resize_if_written(halo_concentration, n_halos, exec_params, {"halo/concentration"});
+		resize_if_written(age_80_halo, n_halos, exec_params, {"halo/age_80"});
+		resize_if_written(age_50_halo, n_halos, exec_params, {"halo/age_50"});
+		resize_if_written(halo_id, n_halos, exec_params, {"halo/halo_id"});
+		resize_if_written(halo_final_m, n_halos, exec_params, {"halo/final_z0_mvir"});
+		resize_if_written(host_id, n_subhalos, exec_params, {"subhalo/host_id"});
+		resize_if_written(descendant_id, n_subhalos, exec_params, {"subhalo/descendant_id"});
+		resize_if_written(infall_time_subhalo, n_subhalos, exec_params, {"subhalo/infall_time_subhalo"});
+		resize_if_written(main, n_subhalos, exec_params, {"subhalo/main_progenitor"});
+		resize_if_written(id, n_subhalos, exec_params, {"subhalo/id"});
+		resize_if_written(L_x_subhalo, n_subhalos, exec_params, {"subhalo/l_x"});
+		resize_if_written(L_y_subhalo, n_subhalos, exec_params, {"subhalo/l_y"});
+		resize_if_written(L_z_subhalo, n_subhalos, exec_params, {"subhalo/l_z"});
+		resize_if_written(id_galaxy, n_galaxies, exec_params, {"galaxies/id_galaxy"});
+		resize_if_written(descendant_id_galaxy, n_galaxies, exec_params, {"galaxies/descendant_id_galaxy"});
+		resize_if_written(mstars_disk, n_galaxies, exec_params, {"galaxies/mstars_disk"});
+		resize_if_written(mstars_bulge, n_galaxies, exec_params, {"galaxies/mstars_bulge"});
+		resize_if_written(mstars_burst_mergers, n_galaxies, exec_params, {"galaxies/mstars_burst_mergers"});
+		resize_if_written(mstars_burst_diskinstabilities, n_galaxies, exec_params, {"galaxies/mstars_burst_diskinstabilities"});
+		resize_if_written(mstars_bulge_mergers_assembly, n_galaxies, exec_params, {"galaxies/mstars_bulge_mergers_assembly"});
+		resize_if_written(mstars_bulge_diskins_assembly, n_galaxies, exec_params, {"galaxies/mstars_bulge_diskins_assembly"});
+		resize_if_written(mstars_stripped, n_galaxies, exec_params, {"galaxies/mstars_tidally_stripped"});
+		resize_if_written(mgas_disk, n_galaxies, exec_params, {"galaxies/mgas_disk"});
+		resize_if_written(mgas_bulge, n_galaxies, exec_params, {"galaxies/mgas_bulge"});
+		resize_if_written(mgas_stripped, n_galaxies, exec_params, {"galaxies/mism_stripped"});
+		resize_if_written(mstars_metals_disk, n_galaxies, exec_params, {"galaxies/mstars_metals_disk"});
+		resize_if_written(mstars_metals_bulge, n_galaxies, exec_params, {"galaxies/mstars_metals_bulge"});
+		resize_if_written(mstars_metals_burst_mergers, n_galaxies, exec_params, {"galaxies/mstars_metals_burst_mergers"});
+		resize_if_written(mstars_metals_burst_diskinstabilities, n_galaxies, exec_params, {"galaxies/mstars_metals_burst_diskinstabilities"});
+		resize_if_written(mstars_metals_bulge_mergers_assembly, n_galaxies, exec_params, {"galaxies/mstars_metals_bulge_mergers_assembly"});
+		resize_if_written(mstars_metals_bulge_diskins_assembly, n_galaxies, exec_params, {"galaxies/mstars_metals_bulge_diskins_assembly"});
+		resize_if_written(mstars_metals_stripped, n_galaxies, exec_params, {"galaxies/mstars_metals_tidally_stripped"});
+		resize_if_written(mgas_metals_disk, n_galaxies, exec_params, {"galaxies/mgas_metals_disk"});
+		resize_if_written(mgas_metals_bulge, n_galaxies, exec_params, {"galaxies/mgas_metals_bulge"});
+		resize_if_written(mgas_stripped_metals, n_galaxies, exec_params, {"galaxies/mism_metals_stripped"});
+		resize_if_written(mmol_disk, n_galaxies, exec_params, {"galaxies/mmol_disk"});
+		resize_if_written(mmol_bulge, n_galaxies, exec_params, {"galaxies/mmol_bulge"});
+		resize_if_written(matom_disk, n_galaxies, exec_params, {"galaxies/matom_disk"});
+		resize_if_written(matom_bulge, n_galaxies, exec_params, {"galaxies/matom_bulge"});
+		resize_if_written(mBH, n_galaxies, exec_params, {"galaxies/m_bh"});
+		resize_if_written(mBH_assembly, n_galaxies, exec_params, {"galaxies/m_bh_assembly"});
+		resize_if_written(mBH_acc_hh, n_galaxies, exec_params, {"galaxies/bh_accretion_rate_hh"});
+		resize_if_written(mBH_acc_sb, n_galaxies, exec_params, {"galaxies/bh_accretion_rate_sb"});
+		resize_if_written(bh_spin, n_galaxies, exec_params, {"galaxies/bh_spin"});
+		resize_if_written(sfr_disk, n_galaxies, exec_params, {"galaxies/sfr_disk"});
+		resize_if_written(sfr_burst, n_galaxies, exec_params, {"galaxies/sfr_burst"});
+		resize_if_written(sfr_burst_mergers, n_galaxies, exec_params, {"galaxies/sfr_burst_mergers"});
+		resize_if_written(sfr_burst_diskins, n_galaxies, exec_params, {"galaxies/sfr_burst_diskins"});
+		resize_if_written(mean_stellar_age, n_galaxies, exec_params, {"galaxies/mean_stellar_age"});
+		resize_if_written(rdisk_gas, n_galaxies, exec_params, {"galaxies/rgas_disk"});
+		resize_if_written(rbulge_gas, n_galaxies, exec_params, {"galaxies/rgas_bulge"});
+		resize_if_written(r_stripped_ism, n_galaxies, exec_params, {"galaxies/r_ism_stripped"});
+		resize_if_written(sAM_disk_gas, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_disk_gas"});
+		resize_if_written(sAM_disk_gas_atom, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_disk_gas_atom"});
+		resize_if_written(sAM_disk_gas_mol, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_disk_gas_mol"});
+		resize_if_written(sAM_bulge_gas, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_bulge_gas"});
+		resize_if_written(rdisk_star, n_galaxies, exec_params, {"galaxies/rstar_disk"});
+		resize_if_written(rbulge_star, n_galaxies, exec_params, {"galaxies/rstar_bulge"});
+		resize_if_written(sAM_disk_star, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_disk_star"});
+		resize_if_written(sAM_bulge_star, n_galaxies, exec_params, {"galaxies/specific_angular_momentum_bulge_star"});
+		resize_if_written(redshift_of_merger, n_galaxies, exec_params, {"galaxies/redshift_merger"});
+		resize_if_written(mhot, n_galaxies, exec_params, {"galaxies/mhot"});
+		resize_if_written(mhot_metals, n_galaxies, exec_params, {"galaxies/mhot_metals"});
+		resize_if_written(mreheated, n_galaxies, exec_params, {"galaxies/mreheated"});
+		resize_if_written(mreheated_metals, n_galaxies, exec_params, {"galaxies/mreheated_metals"});
+		resize_if_written(mhot_stripped, n_galaxies, exec_params, {"galaxies/mhot_stripped"});
+		resize_if_written(mhot_stripped_metals, n_galaxies, exec_params, {"galaxies/mhot_metals_stripped"});
+		resize_if_written(r_stripped, n_galaxies, exec_params, {"galaxies/r_halo_stripped"});
+		resize_if_written(stellar_halo, n_galaxies, exec_params, {"galaxies/mstellar_halo"});
+		resize_if_written(stellar_halo_metals, n_galaxies, exec_params, {"galaxies/mstellar_halo_metals"});
+		resize_if_written(mean_stellar_mass_galaxies_ihsc, n_galaxies, exec_params, {"galaxies/mean_mstellar_galaxies_stellarhalo"});
+		resize_if_written(mlost, n_galaxies, exec_params, {"galaxies/mlost"});
+		resize_if_written(mlost_metals, n_galaxies, exec_params, {"galaxies/mlost_metals"});
+		resize_if_written(cooling_rate, n_galaxies, exec_params, {"galaxies/cooling_rate"});
+		resize_if_written(on_hydrostatic_eq, n_galaxies, exec_params, {"galaxies/on_hydrostatic_eq"});
+		resize_if_written(mvir_hosthalo, n_galaxies, exec_params, {"galaxies/mvir_hosthalo"});
+		resize_if_written(mvir_subhalo, n_galaxies, exec_params, {"galaxies/mvir_subhalo"});
+		resize_if_written(vmax_subhalo, n_galaxies, exec_params, {"galaxies/vmax_subhalo"});
+		resize_if_written(vvir_hosthalo, n_galaxies, exec_params, {"galaxies/vvir_hosthalo"});
+		resize_if_written(vvir_subhalo, n_galaxies, exec_params, {"galaxies/vvir_subhalo"});
+		resize_if_written(mvir_infall_subhalo, n_galaxies, exec_params, {"galaxies/mvir_infall_subhalo"});
+		resize_if_written(cnfw_subhalo, n_galaxies, exec_params, {"galaxies/cnfw_subhalo"});
+		resize_if_written(lambda_subhalo, n_galaxies, exec_params, {"galaxies/lambda_subhalo"});
+		resize_if_written(position_x, n_galaxies, exec_params, {"galaxies/position_x"});
+		resize_if_written(position_y, n_galaxies, exec_params, {"galaxies/position_y"});
+		resize_if_written(position_z, n_galaxies, exec_params, {"galaxies/position_z"});
+		resize_if_written(velocity_x, n_galaxies, exec_params, {"galaxies/velocity_x"});
+		resize_if_written(velocity_y, n_galaxies, exec_params, {"galaxies/velocity_y"});
+		resize_if_written(velocity_z, n_galaxies, exec_params, {"galaxies/velocity_z"});
+		resize_if_written(L_x, n_galaxies, exec_params, {"galaxies/l_x"});
+		resize_if_written(L_y, n_galaxies, exec_params, {"galaxies/l_y"});
+		resize_if_written(L_z, n_galaxies, exec_params, {"galaxies/l_z"});
+		resize_if_written(type, n_galaxies, exec_params, {"galaxies/type"});
+		resize_if_written(id_halo, n_galaxies, exec_params, {"galaxies/id_halo"});
+		resize_if_written(id_halo_tree, n_galaxies, exec_params, {"galaxies/id_halo_tree"});
+		resize_if_written(id_subhalo, n_galaxies, exec_params, {"galaxies/id_subhalo"});
+		resize_if_written(id_subhalo_tree, n_galaxies, exec_params, {"galaxies/id_subhalo_tree"});
+	}
+
+	/// Reports the memory used by each column into @p os, returning the total
+	std::size_t report_memory(std::ostringstream &os) const
+	{
+		std::size_t total = 0;
+#define REPORT(x) total += report_vsize(x, os, #x)
+		REPORT(descendant_id);
+		REPORT(main);
+		REPORT(id);
+		REPORT(halo_id);
+		REPORT(id_galaxy);
+		REPORT(descendant_id_galaxy);
+		REPORT(host_id);
+		REPORT(halo_m);
+		REPORT(halo_v);
+		REPORT(halo_lambda);
+		REPORT(halo_concentration);
+		REPORT(age_50_halo);
+		REPORT(age_80_halo);
+		REPORT(halo_final_m);
+		REPORT(infall_time_subhalo);
+		REPORT(mstars_disk);
+		REPORT(mstars_bulge);
+		REPORT(mstars_burst_mergers);
+		REPORT(mstars_burst_diskinstabilities);
+		REPORT(mstars_bulge_mergers_assembly);
+		REPORT(mstars_bulge_diskins_assembly);
+		REPORT(mstars_stripped);
+		REPORT(mgas_disk);
+		REPORT(mgas_bulge);
+		REPORT(mgas_stripped);
+		REPORT(mstars_metals_disk);
+		REPORT(mstars_metals_bulge);
+		REPORT(mstars_metals_burst_mergers);
+		REPORT(mstars_metals_burst_diskinstabilities);
+		REPORT(mstars_metals_bulge_mergers_assembly);
+		REPORT(mstars_metals_bulge_diskins_assembly);
+		REPORT(mstars_metals_stripped);
+		REPORT(mean_stellar_age);
+		REPORT(mgas_metals_disk);
+		REPORT(mgas_metals_bulge);
+		REPORT(mgas_stripped_metals);
+		REPORT(mmol_disk);
+		REPORT(mmol_bulge);
+		REPORT(matom_disk);
+		REPORT(matom_bulge);
+		REPORT(mBH);
+		REPORT(mBH_assembly);
+		REPORT(mBH_acc_hh);
+		REPORT(mBH_acc_sb);
+		REPORT(bh_spin);
+		REPORT(sfr_disk);
+		REPORT(sfr_burst);
+		REPORT(sfr_burst_mergers);
+		REPORT(sfr_burst_diskins);
+		REPORT(rdisk_gas);
+		REPORT(rbulge_gas);
+		REPORT(r_stripped_ism);
+		REPORT(sAM_disk_gas);
+		REPORT(sAM_disk_gas_atom);
+		REPORT(sAM_disk_gas_mol);
+		REPORT(sAM_bulge_gas);
+		REPORT(rdisk_star);
+		REPORT(rbulge_star);
+		REPORT(sAM_disk_star);
+		REPORT(sAM_bulge_star);
+		REPORT(mhot);
+		REPORT(mhot_metals);
+		REPORT(mreheated);
+		REPORT(mreheated_metals);
+		REPORT(mlost);
+		REPORT(mlost_metals);
+		REPORT(stellar_halo);
+		REPORT(stellar_halo_metals);
+		REPORT(mean_stellar_mass_galaxies_ihsc);
+		REPORT(cooling_rate);
+		REPORT(on_hydrostatic_eq);
+		REPORT(mhot_stripped);
+		REPORT(mhot_stripped_metals);
+		REPORT(mvir_hosthalo);
+		REPORT(mvir_subhalo);
+		REPORT(vmax_subhalo);
+		REPORT(vvir_hosthalo);
+		REPORT(vvir_subhalo);
+		REPORT(cnfw_subhalo);
+		REPORT(r_stripped);
+		REPORT(lambda_subhalo);
+		REPORT(mvir_infall_subhalo);
+		REPORT(L_x_subhalo);
+		REPORT(L_y_subhalo);
+		REPORT(L_z_subhalo);
+		REPORT(position_x);
+		REPORT(position_y);
+		REPORT(position_z);
+		REPORT(velocity_x);
+		REPORT(velocity_y);
+		REPORT(velocity_z);
+		REPORT(L_x);
+		REPORT(L_y);
+		REPORT(L_z);
+		REPORT(type);
+		REPORT(id_halo);
+		REPORT(id_subhalo);
+#undef REPORT
+		return total;
+	}
+};
+
 void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal){
 
+	SelectedColumnsWriter writer(file, exec_params);
+	if (exec_params.output_block_size != 0) {
+		write_galaxies_in_blocks(writer, snapshot, halos, molgas_per_gal);
+	}
+	else {
+		Timer t;
+
+		GalaxyColumns columns;
+		auto n_subhalos = fill_galaxy_columns(columns, snapshot, halos, 0, halos.size(), 0, molgas_per_gal);
+
+		std::ostringstream os;
+		std::size_t total = columns.report_memory(os);
+		LOG(info) << "Total amount of memory used by the writing process: " << memory_amount(total);
+		if (LOG_ENABLED(debug)) {
+			LOG(debug) << "Detailed amounts follow: " << os.str();
+		}
+
+		LOG(info) << "Galaxies pivoted and memory reported in " << t;
+
+		t = Timer();
+		write_galaxy_columns(writer, columns);
+		LOG(info) << "Galaxies data of " << halos.size() << " halos and " << n_subhalos << " subhalos written in " << t;
+	}
+
+	std::string comment = "names of the halo, subhalo and galaxy properties written in this file";
+	file.write_dataset("run_info/output_properties", writer.get_written_columns(), comment);
+}
+
+void HDF5GalaxyWriter::write_galaxies_in_blocks(SelectedColumnsWriter &writer, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal)
+{
 	Timer t;
 
+	// Columns are created as extendible datasets, and the galaxies of
+	// consecutive halos are gathered and appended to them in blocks of up to
+	// output_block_size galaxies (unless a single halo has more galaxies),
+	// keeping the memory used by the writer bounded
+	std::size_t block_size = exec_params.output_block_size;
+	writer.set_chunk_size(block_size);
+
+	GalaxyColumns columns;
+	std::size_t first_halo = 0;
+	std::size_t first_subhalo = 0;
+	std::size_t n_blocks = 0;
+	std::size_t max_memory = 0;
+	do {
+		std::size_t last_halo = first_halo;
+		std::size_t n_galaxies = 0;
+		while (last_halo != halos.size()) {
+			auto halo_galaxies = count_written_galaxies(*halos[last_halo], snapshot);
+			if (last_halo != first_halo && n_galaxies + halo_galaxies > block_size) {
+				break;
+			}
+			n_galaxies += halo_galaxies;
+			last_halo++;
+		}
 
-	using std::string;
-	using std::vector;
+		first_subhalo += fill_galaxy_columns(columns, snapshot, halos, first_halo, last_halo, first_subhalo, molgas_per_gal);
+		std::ostringstream os;
+		max_memory = std::max(max_memory, columns.report_memory(os));
+		write_galaxy_columns(writer, columns);
 
-	string comment;
+		first_halo = last_halo;
+		n_blocks++;
+	} while (first_halo != halos.size());
+
+	LOG(info) << "Galaxies data of " << halos.size() << " halos and " << first_subhalo << " subhalos written in " << n_blocks
+	          << " blocks of up to " << block_size << " galaxies in " << t << ", using up to " << memory_amount(max_memory) << " of memory";
+}
 
+std::size_t HDF5GalaxyWriter::fill_galaxy_columns(GalaxyColumns &columns, int snapshot, const std::vector<HaloPtr> &halos, std::size_t first_halo, std::size_t last_halo, std::size_t first_subhalo, const molgas_per_galaxy &molgas_per_gal)
+{
+	TraceSpan span("gather_galaxies");
 	// compute universe age at this redshift:
 	double age_uni = std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot]));
 
-	// Crate all subhalo properties to write.
-
-	vector<Subhalo::id_t> descendant_id;
-	vector<int> main;
-	vector<Subhalo::id_t> id;
-	vector<Halo::id_t> host_id;
-	vector<Galaxy::id_t> id_galaxy;
-	vector<Galaxy::id_t> descendant_id_galaxy;
-	vector<Halo::id_t> halo_id;
-
-	// Create all galaxies properties to write
-	vector<float> mstars_disk;
-	vector<float> mstars_bulge;
-	vector<float> mstars_burst_mergers;
-	vector<float> mstars_burst_diskinstabilities;
-	vector<float> mstars_bulge_mergers_assembly;
-	vector<float> mstars_bulge_diskins_assembly;
-	vector<float> mstars_stripped;
-	vector<float> mgas_disk;
-	vector<float> mgas_bulge;
-	vector<float> mgas_stripped;
-
-	vector<float> mstars_metals_disk;
-	vector<float> mstars_metals_bulge;
-	vector<float> mstars_metals_burst_mergers;
-	vector<float> mstars_metals_burst_diskinstabilities;
-	vector<float> mstars_metals_bulge_mergers_assembly;
-	vector<float> mstars_metals_bulge_diskins_assembly;
-	vector<float> mstars_metals_stripped;
-	vector<float> mgas_metals_disk;
-	vector<float> mgas_metals_bulge;
-	vector<float> mgas_stripped_metals;
-
-	vector<float> mmol_disk;
-	vector<float> mmol_bulge;
-	vector<float> matom_disk;
-	vector<float> matom_bulge;
-
-	vector<float> mBH;
-	vector<float> mBH_assembly;
-	vector<float> mBH_acc_hh;
-	vector<float> mBH_acc_sb;
-	vector<float> bh_spin;
-
-	vector<float> sfr_disk;
-	vector<float> sfr_burst;
-	vector<float> sfr_burst_mergers;
-	vector<float> sfr_burst_diskins;
-	vector<float> mean_stellar_age;
-
-	vector<float> rdisk_gas;
-	vector<float> rbulge_gas;
-	vector<float> r_stripped_ism;
-	vector<float> sAM_disk_gas;
-	vector<float> sAM_disk_gas_atom;
-	vector<float> sAM_disk_gas_mol;
-	vector<float> sAM_bulge_gas;
-
-	vector<float> rdisk_star;
-	vector<float> rbulge_star;
-	vector<float> sAM_disk_star;
-	vector<float> sAM_bulge_star;
-
-	vector<float> redshift_of_merger;
-
-	vector<float> mhot;
-	vector<float> mhot_metals;
-
-	vector<float> mreheated;
-	vector<float> mreheated_metals;
-
-	vector<float> mhot_stripped;
-	vector<float> mhot_stripped_metals;
-	vector<float> r_stripped;
-
-	vector<float> stellar_halo;
-	vector<float> stellar_halo_metals;
-	vector<float> mean_stellar_mass_galaxies_ihsc;
-
-	vector<float> mlost;
-	vector<float> mlost_metals;
-
-	vector<float> cooling_rate;
-	vector<int> on_hydrostatic_eq;
-
-	vector<float> mvir_hosthalo;
-	vector<float> mvir_subhalo;
-	vector<float> vmax_subhalo;
-	vector<float> vvir_hosthalo;
-	vector<float> vvir_subhalo;
-	vector<float> mvir_infall_subhalo;
-
-	vector<float> cnfw_subhalo;
-	vector<float> lambda_subhalo;
-
-	vector<float> halo_m;
-	vector<float> halo_v;
-	vector<float> halo_lambda;
-	vector<float> halo_concentration;
-	vector<float> age_80_halo;
-	vector<float> age_50_halo;
-	vector<float> halo_final_m;
-
-	vector<float> infall_time_subhalo;
-
-	vector<float> position_x;
-	vector<float> position_y;
-	vector<float> position_z;
-
-	vector<float> velocity_x;
-	vector<float> velocity_y;
-	vector<float> velocity_z;
-
-	vector<float> L_x;
-	vector<float> L_y;
-	vector<float> L_z;
-
-	vector<float> L_x_subhalo;
-	vector<float> L_y_subhalo;
-	vector<float> L_z_subhalo;
-
-	vector<int> type;
-
-	vector<Halo::id_t> id_halo;
-	vector<Halo::id_t> id_halo_tree;
-	vector<Subhalo::id_t> id_subhalo;
-	vector<Subhalo::id_t> id_subhalo_tree;
-
-	Halo::id_t j = 1;
-	Subhalo::id_t i = 1;
+	// Subhalos and galaxies are laid out in halo order. Calculating where
+	// each halo's subhalos and galaxies go lets threads fill the columns for
+	// different halos independently, giving the same result as a serial loop
+	auto n_halos = last_halo - first_halo;
+	std::vector<std::size_t> subhalo_offsets(n_halos + 1, 0);
+	std::vector<std::size_t> galaxy_offsets(n_halos + 1, 0);
+	for (std::size_t h = 0; h != n_halos; h++) {
+		auto &halo = *halos[first_halo + h];
+		subhalo_offsets[h + 1] = subhalo_offsets[h] + halo.subhalo_count();
+		galaxy_offsets[h + 1] = galaxy_offsets[h] + count_written_galaxies(halo, snapshot);
+	}
+	columns.resize(n_halos, subhalo_offsets.back(), galaxy_offsets.back(), exec_params);
+
+	// Exceptions cannot be thrown from within the parallel loop
+	std::atomic<bool> negative_descendant_id {false};
 
-	// Loop over all halos and subhalos to write galaxy properties
-	for (auto &halo: halos){
+	omp_dynamic_for(std::size_t(0), n_halos, threads, 100, [&](std::size_t h, unsigned int thread_idx) {
 
+		auto &halo = halos[first_halo + h];
+		auto s = subhalo_offsets[h];
+		auto g = galaxy_offsets[h];
 
 		// assign properties of host halo
 		auto mhalo = halo->Mvir;
 		auto vhalo = halo->Vvir;
 
-		halo_m.push_back(mhalo);
-		halo_v.push_back(vhalo);
-		halo_lambda.push_back(halo->lambda);
-		halo_concentration.push_back(halo->concentration);
-		age_80_halo.push_back(halo->age_80);
-		age_50_halo.push_back(halo->age_50);
-		halo_id.push_back(halo->id);
-		halo_final_m.push_back(halo->final_halo()->Mvir);
+		set_value(columns.halo_m, h, mhalo);
+		set_value(columns.halo_v, h, vhalo);
+		set_value(columns.halo_lambda, h, halo->lambda);
+		set_value(columns.halo_concentration, h, halo->concentration);
+		set_value(columns.age_80_halo, h, halo->age_80);
+		set_value(columns.age_50_halo, h, halo->age_50);
+		set_value(columns.halo_id, h, halo->id);
+		set_value(columns.halo_final_m, h, halo->final_halo()->Mvir);
 
 		for (auto &subhalo: halo->all_subhalos()){
 
-			host_id.push_back(halo->id);
+			set_value(columns.host_id, s, halo->id);
 
 			// assign properties of host subhalo (note that if these subhalos have descendants, then we assign those properties)
 			auto msubhalo = subhalo->Mvir;
@@ -357,102 +770,102 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 			auto stripped_subhalo = subhalo->hot_halo_gas_stripped;
 			auto r_rps_halo = subhalo->hot_halo_gas_r_rps;
 
-			descendant_id.push_back(subhalo->descendant_id);
-			infall_time_subhalo.push_back(subhalo->infall_t);
+			set_value(columns.descendant_id, s, subhalo->descendant_id);
+			set_value(columns.infall_time_subhalo, s, subhalo->infall_t);
 
 			int m = 0;
 			if(subhalo->main_progenitor){
 				m = 1;
 			}
-			main.push_back(m);
-			id.push_back(subhalo->id);
+			set_value(columns.main, s, m);
+			set_value(columns.id, s, subhalo->id);
 
-			L_x_subhalo.push_back(subhalo->L.x);
-			L_y_subhalo.push_back(subhalo->L.y);
-			L_z_subhalo.push_back(subhalo->L.z);
+			set_value(columns.L_x_subhalo, s, subhalo->L.x);
+			set_value(columns.L_y_subhalo, s, subhalo->L.y);
+			set_value(columns.L_z_subhalo, s, subhalo->L.z);
 
 			for (auto &galaxy: subhalo->galaxies){
 				//ignore this galaxy if it will appear for the first time in the coming snapshot.
 				if(galaxy.birth_snapshot == snapshot) continue;
 
 				if(halo->hydrostatic_eq){
-					on_hydrostatic_eq.push_back(1);
+					set_value(columns.on_hydrostatic_eq, g, 1);
 				}
 				else{
-					on_hydrostatic_eq.push_back(0);
+					set_value(columns.on_hydrostatic_eq, g, 0);
 				}
 
 
-				id_halo_tree.push_back(halo->id);
-				id_subhalo_tree.push_back(subhalo->id);
+				set_value(columns.id_halo_tree, g, halo->id);
+				set_value(columns.id_subhalo_tree, g, subhalo->id);
 
 				//Calculate molecular gas mass of disk and bulge, and specific angular momentum in atomic/molecular disk.
 				auto &molecular_gas = molgas_per_gal.at(galaxy.id);
 				// Gas components separated into HI and H2.
-				mmol_disk.push_back(molecular_gas.m_mol);
-				mmol_bulge.push_back(molecular_gas.m_mol_b);
-				matom_disk.push_back(molecular_gas.m_atom);
-				matom_bulge.push_back(molecular_gas.m_atom_b);
+				set_value(columns.mmol_disk, g, molecular_gas.m_mol);
+				set_value(columns.mmol_bulge, g, molecular_gas.m_mol_b);
+				set_value(columns.matom_disk, g, molecular_gas.m_atom);
+				set_value(columns.matom_bulge, g, molecular_gas.m_atom_b);
 
 				// Stellar components
-				mstars_disk.push_back(galaxy.disk_stars.mass);
-				mstars_bulge.push_back(galaxy.bulge_stars.mass);
-				mstars_burst_mergers.push_back(galaxy.galaxymergers_burst_stars.mass);
-				mstars_bulge_mergers_assembly.push_back(galaxy.galaxymergers_assembly_stars.mass);
-				mstars_burst_diskinstabilities.push_back(galaxy.diskinstabilities_burst_stars.mass);
-				mstars_bulge_diskins_assembly.push_back(galaxy.diskinstabilities_assembly_stars.mass);
-				mstars_stripped.push_back(galaxy.stars_tidal_stripped.mass);
+				set_value(columns.mstars_disk, g, galaxy.disk_stars.mass);
+				set_value(columns.mstars_bulge, g, galaxy.bulge_stars.mass);
+				set_value(columns.mstars_burst_mergers, g, galaxy.galaxymergers_burst_stars.mass);
+				set_value(columns.mstars_bulge_mergers_assembly, g, galaxy.galaxymergers_assembly_stars.mass);
+				set_value(columns.mstars_burst_diskinstabilities, g, galaxy.diskinstabilities_burst_stars.mass);
+				set_value(columns.mstars_bulge_diskins_assembly, g, galaxy.diskinstabilities_assembly_stars.mass);
+				set_value(columns.mstars_stripped, g, galaxy.stars_tidal_stripped.mass);
 				auto age = 0;
 				if(galaxy.total_stellar_mass_ever_formed > 0){
 					age = age_uni - galaxy.mean_stellar_age / galaxy.total_stellar_mass_ever_formed;
 				}
-				mean_stellar_age.push_back(age);
+				set_value(columns.mean_stellar_age, g, age);
 
 				// Gas components
-				mgas_disk.push_back(galaxy.disk_gas.mass);
-				mgas_bulge.push_back(galaxy.bulge_gas.mass);
-				mgas_stripped.push_back(galaxy.ram_pressure_stripped_gas.mass);
+				set_value(columns.mgas_disk, g, galaxy.disk_gas.mass);
+				set_value(columns.mgas_bulge, g, galaxy.bulge_gas.mass);
+				set_value(columns.mgas_stripped, g, galaxy.ram_pressure_stripped_gas.mass);
 
 				// Metals of the stellar components.
-				mstars_metals_disk.push_back(galaxy.disk_stars.mass_metals);
-				mstars_metals_bulge.push_back(galaxy.bulge_stars.mass_metals);
-				mstars_metals_burst_mergers.push_back(galaxy.galaxymergers_burst_stars.mass_metals);
-				mstars_metals_bulge_mergers_assembly.push_back(galaxy.galaxymergers_assembly_stars.mass_metals);
-				mstars_metals_burst_diskinstabilities.push_back(galaxy.diskinstabilities_burst_stars.mass);
-				mstars_metals_bulge_diskins_assembly.push_back(galaxy.diskinstabilities_burst_stars.mass_metals);
-				mstars_metals_stripped.push_back(galaxy.stars_tidal_stripped.mass_metals);
+				set_value(columns.mstars_metals_disk, g, galaxy.disk_stars.mass_metals);
+				set_value(columns.mstars_metals_bulge, g, galaxy.bulge_stars.mass_metals);
+				set_value(columns.mstars_metals_burst_mergers, g, galaxy.galaxymergers_burst_stars.mass_metals);
+				set_value(columns.mstars_metals_bulge_mergers_assembly, g, galaxy.galaxymergers_assembly_stars.mass_metals);
+				set_value(columns.mstars_metals_burst_diskinstabilities, g, galaxy.diskinstabilities_burst_stars.mass);
+				set_value(columns.mstars_metals_bulge_diskins_assembly, g, galaxy.diskinstabilities_burst_stars.mass_metals);
+				set_value(columns.mstars_metals_stripped, g, galaxy.stars_tidal_stripped.mass_metals);
 
 				// Metals of the gas components.
-				mgas_metals_disk.push_back(galaxy.disk_gas.mass_metals);
-				mgas_metals_bulge.push_back(galaxy.bulge_gas.mass_metals);
-				mgas_stripped_metals.push_back(galaxy.ram_pressure_stripped_gas.mass_metals);
+				set_value(columns.mgas_metals_disk, g, galaxy.disk_gas.mass_metals);
+				set_value(columns.mgas_metals_bulge, g, galaxy.bulge_gas.mass_metals);
+				set_value(columns.mgas_stripped_metals, g, galaxy.ram_pressure_stripped_gas.mass_metals);
 
 				// SFRs in disks and bulges.
-				sfr_disk.push_back(galaxy.sfr_disk);
-				sfr_burst.push_back(galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins);
-				sfr_burst_mergers.push_back(galaxy.sfr_bulge_mergers);
-				sfr_burst_diskins.push_back(galaxy.sfr_bulge_diskins);
+				set_value(columns.sfr_disk, g, galaxy.sfr_disk);
+				set_value(columns.sfr_burst, g, galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins);
+				set_value(columns.sfr_burst_mergers, g, galaxy.sfr_bulge_mergers);
+				set_value(columns.sfr_burst_diskins, g, galaxy.sfr_bulge_diskins);
 
 				// Black hole properties.
-				mBH.push_back(galaxy.smbh.mass);
-				mBH_assembly.push_back(galaxy.smbh.massembly);
-				mBH_acc_hh.push_back(galaxy.smbh.macc_hh);
-				mBH_acc_sb.push_back(galaxy.smbh.macc_sb);
-				bh_spin.push_back(galaxy.smbh.spin);
+				set_value(columns.mBH, g, galaxy.smbh.mass);
+				set_value(columns.mBH_assembly, g, galaxy.smbh.massembly);
+				set_value(columns.mBH_acc_hh, g, galaxy.smbh.macc_hh);
+				set_value(columns.mBH_acc_sb, g, galaxy.smbh.macc_sb);
+				set_value(columns.bh_spin, g, galaxy.smbh.spin);
 
 				// Sizes and specific angular momentum of disks and bulges.
-				rdisk_gas.push_back(galaxy.disk_gas.rscale);
-				rbulge_gas.push_back(galaxy.bulge_gas.rscale);
-				r_stripped_ism.push_back(galaxy.r_rps);
-				sAM_disk_gas.push_back(galaxy.disk_gas.sAM);
-				sAM_disk_gas_atom.push_back(molecular_gas.j_atom);
-				sAM_disk_gas_mol.push_back(molecular_gas.j_mol);
-				sAM_bulge_gas.push_back(galaxy.bulge_gas.sAM);
-
-				rdisk_star.push_back(galaxy.disk_stars.rscale);
-				rbulge_star.push_back(galaxy.bulge_stars.rscale);
-				sAM_disk_star.push_back(galaxy.disk_stars.sAM);
-				sAM_bulge_star.push_back(galaxy.bulge_stars.sAM);
+				set_value(columns.rdisk_gas, g, galaxy.disk_gas.rscale);
+				set_value(columns.rbulge_gas, g, galaxy.bulge_gas.rscale);
+				set_value(columns.r_stripped_ism, g, galaxy.r_rps);
+				set_value(columns.sAM_disk_gas, g, galaxy.disk_gas.sAM);
+				set_value(columns.sAM_disk_gas_atom, g, molecular_gas.j_atom);
+				set_value(columns.sAM_disk_gas_mol, g, molecular_gas.j_mol);
+				set_value(columns.sAM_bulge_gas, g, galaxy.bulge_gas.sAM);
+
+				set_value(columns.rdisk_star, g, galaxy.disk_stars.rscale);
+				set_value(columns.rbulge_star, g, galaxy.bulge_stars.rscale);
+				set_value(columns.sAM_disk_star, g, galaxy.disk_stars.sAM);
+				set_value(columns.sAM_bulge_star, g, galaxy.bulge_stars.sAM);
 
 				// Halo properties below.
 				double mhot_gal = 0;
@@ -501,24 +914,24 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 					}
 				}
 
-				cooling_rate.push_back(rcool);
-				mhot_stripped.push_back(mhalo_stripped);
-				mhot_stripped_metals.push_back(mhalo_stripped_metals);
-				r_stripped.push_back(r_rps_subhalo);
+				set_value(columns.cooling_rate, g, rcool);
+				set_value(columns.mhot_stripped, g, mhalo_stripped);
+				set_value(columns.mhot_stripped_metals, g, mhalo_stripped_metals);
+				set_value(columns.r_stripped, g, r_rps_subhalo);
 
-				mhot.push_back(mhot_gal);
-				mhot_metals.push_back(mzhot_gal);
-				mreheated.push_back(mreheat);
-				mreheated_metals.push_back(mzreheat);
-				mlost.push_back(lostm);
-				mlost_metals.push_back(lostzm);
+				set_value(columns.mhot, g, mhot_gal);
+				set_value(columns.mhot_metals, g, mzhot_gal);
+				set_value(columns.mreheated, g, mreheat);
+				set_value(columns.mreheated_metals, g, mzreheat);
+				set_value(columns.mlost, g, lostm);
+				set_value(columns.mlost_metals, g, lostzm);
 
-				stellar_halo.push_back(mstellarhalo);
-				stellar_halo_metals.push_back(mzstellarhalo);
-				mean_stellar_mass_galaxies_ihsc.push_back(ms_mean_stellarhalo);
+				set_value(columns.stellar_halo, g, mstellarhalo);
+				set_value(columns.stellar_halo_metals, g, mzstellarhalo);
+				set_value(columns.mean_stellar_mass_galaxies_ihsc, g, ms_mean_stellarhalo);
 
-				mvir_hosthalo.push_back(mhalo);
-				vvir_hosthalo.push_back(vhalo);
+				set_value(columns.mvir_hosthalo, g, mhalo);
+				set_value(columns.vvir_hosthalo, g, vhalo);
 
 				double mvir_gal = 0 ;
 				double c_sub = 0;
@@ -535,11 +948,11 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 					pos      = subhalo->position;
 					vel      = subhalo->velocity;
 					L        = subhalo->L.unit() * galaxy.angular_momentum();
-					vvir_subhalo.push_back(vvir_sh);
-					mvir_subhalo.push_back(mvir_gal);
-					cnfw_subhalo.push_back(c_sub);
-					lambda_subhalo.push_back(l_sub);
-					redshift_of_merger.push_back(-1);
+					set_value(columns.vvir_subhalo, g, vvir_sh);
+					set_value(columns.mvir_subhalo, g, mvir_gal);
+					set_value(columns.cnfw_subhalo, g, c_sub);
+					set_value(columns.lambda_subhalo, g, l_sub);
+					set_value(columns.redshift_of_merger, g, -1);
 					if(galaxy.descendant_id < 0 && snapshot < sim_params.max_snapshot){
 						galaxy.descendant_id = galaxy.id;
 					}
@@ -550,476 +963,374 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 				else{
 					// In case of type 2 galaxies assign negative positions, velocities and angular momentum.
 					darkmatterhalo->generate_random_orbits(pos, vel, L, galaxy.angular_momentum(), halo, galaxy);
-					mvir_subhalo.push_back(galaxy.msubhalo_type2);
-					cnfw_subhalo.push_back(galaxy.concentration_type2);
-					lambda_subhalo.push_back(galaxy.lambda_type2);
-					vvir_subhalo.push_back(galaxy.vvir_type2);
+					set_value(columns.mvir_subhalo, g, galaxy.msubhalo_type2);
+					set_value(columns.cnfw_subhalo, g, galaxy.concentration_type2);
+					set_value(columns.lambda_subhalo, g, galaxy.lambda_type2);
+					set_value(columns.vvir_subhalo, g, galaxy.vvir_type2);
 
 					// calculate the age of the universe by the time this galaxy will merge.
 					double tmerge  = cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot-1]) + galaxy.tmerge;
 					double redshift_merger = cosmology->convert_age_to_redshift_lcdm(tmerge);
-					redshift_of_merger.push_back(redshift_merger);
+					set_value(columns.redshift_of_merger, g, redshift_merger);
 
 					if(galaxy.descendant_id < 0 ){
 						galaxy.descendant_id = galaxy.id;
 					}
 
 				}
-				mvir_infall_subhalo.push_back(m_infall);
+				set_value(columns.mvir_infall_subhalo, g, m_infall);
 
 				//force the descendant Id to be = -1 if this is the last snapshot. If not, check that all descendant_ids are positive.
 				if(snapshot == sim_params.max_snapshot){
 					galaxy.descendant_id = -1;
 				}
 				else if (galaxy.descendant_id < 0){
-					std::ostringstream os;
-					os << "Descendant_id of galaxy to be written is negative";
-					throw invalid_argument(os.str());
+					negative_descendant_id = true;
 				}
 
-				id_galaxy.push_back(galaxy.id);
-				descendant_id_galaxy.push_back(galaxy.descendant_id);
+				set_value(columns.id_galaxy, g, galaxy.id);
+				set_value(columns.descendant_id_galaxy, g, galaxy.descendant_id);
 
-				vmax_subhalo.push_back(galaxy.vmax);
+				set_value(columns.vmax_subhalo, g, galaxy.vmax);
 
 				// Galaxy position and velocity.
-				position_x.push_back(pos.x);
-				position_y.push_back(pos.y);
-				position_z.push_back(pos.z);
+				set_value(columns.position_x, g, pos.x);
+				set_value(columns.position_y, g, pos.y);
+				set_value(columns.position_z, g, pos.z);
 
-				velocity_x.push_back(vel.x);
-				velocity_y.push_back(vel.y);
-				velocity_z.push_back(vel.z);
+				set_value(columns.velocity_x, g, vel.x);
+				set_value(columns.velocity_y, g, vel.y);
+				set_value(columns.velocity_z, g, vel.z);
 
-				L_x.push_back(cosmology->comoving_to_physical_angularmomentum(L.x,sim_params.redshifts[snapshot]));
-				L_y.push_back(cosmology->comoving_to_physical_angularmomentum(L.y,sim_params.redshifts[snapshot]));
-				L_z.push_back(cosmology->comoving_to_physical_angularmomentum(L.z,sim_params.redshifts[snapshot]));
+				set_value(columns.L_x, g, cosmology->comoving_to_physical_angularmomentum(L.x,sim_params.redshifts[snapshot]));
+				set_value(columns.L_y, g, cosmology->comoving_to_physical_angularmomentum(L.y,sim_params.redshifts[snapshot]));
+				set_value(columns.L_z, g, cosmology->comoving_to_physical_angularmomentum(L.z,sim_params.redshifts[snapshot]));
 
-				type.push_back(t);
+				set_value(columns.type, g, t);
 
-				id_halo.push_back(j);
-				id_subhalo.push_back(i);
+				set_value(columns.id_halo, g, Halo::id_t(first_halo + h + 1));
+				set_value(columns.id_subhalo, g, Subhalo::id_t(first_subhalo + s + 1));
+				g++;
 			}
-			i++;
+			s++;
 		}
-		j++;
-	}
+	});
 
-	std::ostringstream os;
-	std::size_t total = 0;
-#define REPORT(x) total += report_vsize(x, os, #x)
-	REPORT(descendant_id);
-	REPORT(main);
-	REPORT(id);
-	REPORT(halo_id);
-	REPORT(id_galaxy);
-	REPORT(descendant_id_galaxy);
-	REPORT(host_id);
-	REPORT(halo_m);
-	REPORT(halo_v);
-	REPORT(halo_lambda);
-	REPORT(halo_concentration);
-	REPORT(age_50_halo);
-	REPORT(age_80_halo);
-	REPORT(halo_final_m);
-	REPORT(infall_time_subhalo);
-	REPORT(mstars_disk);
-	REPORT(mstars_bulge);
-	REPORT(mstars_burst_mergers);
-	REPORT(mstars_burst_diskinstabilities);
-	REPORT(mstars_bulge_mergers_assembly);
-	REPORT(mstars_bulge_diskins_assembly);
-	REPORT(mstars_stripped);
-	REPORT(mgas_disk);
-	REPORT(mgas_bulge);
-	REPORT(mgas_stripped);
-	REPORT(mstars_metals_disk);
-	REPORT(mstars_metals_bulge);
-	REPORT(mstars_metals_burst_mergers);
-	REPORT(mstars_metals_burst_diskinstabilities);
-	REPORT(mstars_metals_bulge_mergers_assembly);
-	REPORT(mstars_metals_bulge_diskins_assembly);
-	REPORT(mstars_metals_stripped);
-	REPORT(mean_stellar_age);
-	REPORT(mgas_metals_disk);
-	REPORT(mgas_metals_bulge);
-	REPORT(mgas_stripped_metals);
-	REPORT(mmol_disk);
-	REPORT(mmol_bulge);
-	REPORT(matom_disk);
-	REPORT(matom_bulge);
-	REPORT(mBH);
-	REPORT(mBH_assembly);
-	REPORT(mBH_acc_hh);
-	REPORT(mBH_acc_sb);
-	REPORT(bh_spin);
-	REPORT(sfr_disk);
-	REPORT(sfr_burst);
-	REPORT(sfr_burst_mergers);
-	REPORT(sfr_burst_diskins);
-	REPORT(rdisk_gas);
-	REPORT(rbulge_gas);
-	REPORT(r_stripped_ism);
-	REPORT(sAM_disk_gas);
-	REPORT(sAM_disk_gas_atom);
-	REPORT(sAM_disk_gas_mol);
-	REPORT(sAM_bulge_gas);
-	REPORT(rdisk_star);
-	REPORT(rbulge_star);
-	REPORT(sAM_disk_star);
-	REPORT(sAM_bulge_star);
-	REPORT(mhot);
-	REPORT(mhot_metals);
-	REPORT(mreheated);
-	REPORT(mreheated_metals);
-	REPORT(mlost);
-	REPORT(mlost_metals);
-	REPORT(stellar_halo);
-	REPORT(stellar_halo_metals);
-	REPORT(mean_stellar_mass_galaxies_ihsc);
-	REPORT(cooling_rate);
-	REPORT(on_hydrostatic_eq);
-	REPORT(mhot_stripped);
-	REPORT(mhot_stripped_metals);
-	REPORT(mvir_hosthalo);
-	REPORT(mvir_subhalo);
-	REPORT(vmax_subhalo);
-	REPORT(vvir_hosthalo);
-	REPORT(vvir_subhalo);
-	REPORT(cnfw_subhalo);
-	REPORT(r_stripped);
-	REPORT(lambda_subhalo);
-	REPORT(mvir_infall_subhalo);
-	REPORT(L_x_subhalo);
-	REPORT(L_y_subhalo);
-	REPORT(L_z_subhalo);
-	REPORT(position_x);
-	REPORT(position_y);
-	REPORT(position_z);
-	REPORT(velocity_x);
-	REPORT(velocity_y);
-	REPORT(velocity_z);
-	REPORT(L_x);
-	REPORT(L_y);
-	REPORT(L_z);
-	REPORT(type);
-	REPORT(id_halo);
-	REPORT(id_subhalo);
-
-	LOG(info) << "Total amount of memory used by the writing process: " << memory_amount(total);
-	if (LOG_ENABLED(debug)) {
-		LOG(debug) << "Detailed amounts follow: " << os.str();
+	if (negative_descendant_id) {
+		throw invalid_argument("Descendant_id of galaxy to be written is negative");
 	}
+	return subhalo_offsets.back();
+}
 
-	LOG(info) << "Galaxies pivoted and memory reported in " << t;
-
-	t = Timer();
+void HDF5GalaxyWriter::write_galaxy_columns(SelectedColumnsWriter &writer, const GalaxyColumns &columns)
+{
+	TraceSpan span("write_galaxy_columns");
+	std::string comment;
 
 	//Write halo properties.
 
 	comment = "halo id in the tree (unique to entire halo catalogue)";
-	file.write_dataset("halo/halo_id", halo_id, comment);
+	writer.write("halo/halo_id", columns.halo_id, comment);
 
 	comment = "virial mass of halo [Msun/h]";
-	file.write_dataset("halo/mvir", halo_m, comment);
+	writer.write("halo/mvir", columns.halo_m, comment);
 
 	comment = "virial velocity of halo [km/s]";
-	file.write_dataset("halo/vvir", halo_m, comment);
+	writer.write("halo/vvir", columns.halo_m, comment);
 
 	comment = "halo concentration";
-	file.write_dataset("halo/concentration", halo_concentration, comment);
+	writer.write("halo/concentration", columns.halo_concentration, comment);
 
 	comment = "halo spin";
-	file.write_dataset("halo/lambda", halo_lambda, comment);
+	writer.write("halo/lambda", columns.halo_lambda, comment);
 
 	comment = "redshift at which the halo had 80% of its current mass";
-	file.write_dataset("halo/age_80", age_80_halo, comment);
+	writer.write("halo/age_80", columns.age_80_halo, comment);
 
 	comment = "redshift at which the halo had 50% of its current mass";
-	file.write_dataset("halo/age_50", age_50_halo, comment);
+	writer.write("halo/age_50", columns.age_50_halo, comment);
 
 	comment = "virial mass of the halo in which this halo will end up in by z=0 [Msun/h]";
-	file.write_dataset("halo/final_z0_mvir", halo_final_m, comment);
+	writer.write("halo/final_z0_mvir", columns.halo_final_m, comment);
 
 	//Write subhalo properties.
 	comment = "Subhalo id";
-	file.write_dataset("subhalo/id", id, comment);
+	writer.write("subhalo/id", columns.id, comment);
 
 	comment = "=1 if subhalo is the main progenitor' =0 otherwise.";
-	file.write_dataset("subhalo/main_progenitor", main, comment);
+	writer.write("subhalo/main_progenitor", columns.main, comment);
 
 	comment = "id of the subhalo that is the descendant of this subhalo";
-	file.write_dataset("subhalo/descendant_id", descendant_id, comment);
+	writer.write("subhalo/descendant_id", columns.descendant_id, comment);
 
 	comment = "id of the host halo of this subhalo";
-	file.write_dataset("subhalo/host_id", host_id, comment);
+	writer.write("subhalo/host_id", columns.host_id, comment);
 
 	comment = "redshift at which the subhalo became a SATELLITE (only well defined for satellite subhalos)";
-	file.write_dataset("subhalo/infall_time_subhalo", infall_time_subhalo, comment);
+	writer.write("subhalo/infall_time_subhalo", columns.infall_time_subhalo, comment);
 
 	//Subhalo AM vector
 	comment = "total angular momentum component x of subhalo [Msun pMpc km/s]. From VELOCIraptor.";
-	file.write_dataset("subhalo/l_x", L_x_subhalo,  comment);
+	writer.write("subhalo/l_x", columns.L_x_subhalo, comment);
 	comment = "total angular momentum component y of galaxy [Msun pMpc km/s]. From VELOCIraptor.";
-	file.write_dataset("subhalo/l_y", L_y_subhalo, comment);
+	writer.write("subhalo/l_y", columns.L_y_subhalo, comment);
 	comment = "total angular momentum component z of galaxy [Msun pMpc km/s]. From VELOCIraptor.";
-	file.write_dataset("subhalo/l_z", L_z_subhalo, comment);
+	writer.write("subhalo/l_z", columns.L_z_subhalo, comment);
 
 	//Write galaxy properties.
 
 	comment = "stellar mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_disk", mstars_disk, comment);
+	writer.write("galaxies/mstars_disk", columns.mstars_disk, comment);
 
 	comment = "stellar mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge", mstars_bulge, comment);
+	writer.write("galaxies/mstars_bulge", columns.mstars_bulge, comment);
 
 	comment = "stellar mass formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_mergers", mstars_burst_mergers, comment);
+	writer.write("galaxies/mstars_burst_mergers", columns.mstars_burst_mergers, comment);
 
 	comment = "stellar mass formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_diskinstabilities", mstars_burst_diskinstabilities, comment);
+	writer.write("galaxies/mstars_burst_diskinstabilities", columns.mstars_burst_diskinstabilities, comment);
 
 	comment = "stellar mass in the bulge brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_mergers_assembly", mstars_bulge_mergers_assembly, comment);
+	writer.write("galaxies/mstars_bulge_mergers_assembly", columns.mstars_bulge_mergers_assembly, comment);
 
 	comment = "stellar mass in the bulge brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_diskins_assembly", mstars_bulge_diskins_assembly, comment);
+	writer.write("galaxies/mstars_bulge_diskins_assembly", columns.mstars_bulge_diskins_assembly, comment);
 
 	comment = "stellar mass that was tidally stripped from this galaxy [Msun/h]";
-	file.write_dataset("galaxies/mstars_tidally_stripped", mstars_stripped, comment);
+	writer.write("galaxies/mstars_tidally_stripped", columns.mstars_stripped, comment);
 
 	comment = "total gas mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_disk", mgas_disk, comment);
+	writer.write("galaxies/mgas_disk", columns.mgas_disk, comment);
 
 	comment = "gas mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_bulge", mgas_bulge, comment);
+	writer.write("galaxies/mgas_bulge", columns.mgas_bulge, comment);
 
 	comment = "gas mass that has been stripped out of the ISM due to ram pressure stripping [Msun/h]";
-	file.write_dataset("galaxies/mism_stripped", mgas_stripped, comment);
+	writer.write("galaxies/mism_stripped", columns.mgas_stripped, comment);
 
 	comment = "mass of metals locked in stars in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_disk",mstars_metals_disk, comment);
+	writer.write("galaxies/mstars_metals_disk", columns.mstars_metals_disk, comment);
 
 	comment = "mass of metals locked in stars in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge", mstars_metals_bulge, comment);
+	writer.write("galaxies/mstars_metals_bulge", columns.mstars_metals_bulge, comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_mergers", mstars_metals_burst_mergers, comment);
+	writer.write("galaxies/mstars_metals_burst_mergers", columns.mstars_metals_burst_mergers, comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_diskinstabilities", mstars_metals_burst_diskinstabilities, comment);
+	writer.write("galaxies/mstars_metals_burst_diskinstabilities", columns.mstars_metals_burst_diskinstabilities, comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_mergers_assembly", mstars_metals_bulge_mergers_assembly, comment);
+	writer.write("galaxies/mstars_metals_bulge_mergers_assembly", columns.mstars_metals_bulge_mergers_assembly, comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_diskins_assembly", mstars_metals_bulge_diskins_assembly, comment);
+	writer.write("galaxies/mstars_metals_bulge_diskins_assembly", columns.mstars_metals_bulge_diskins_assembly, comment);
 
 	comment = "mass of metals locked in stars that was tidally stripped from this galaxy [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_tidally_stripped", mstars_metals_stripped, comment);
+	writer.write("galaxies/mstars_metals_tidally_stripped", columns.mstars_metals_stripped, comment);
 
 	comment = "stellar mass-weighted stellar age [Gyr]";
-	file.write_dataset("galaxies/mean_stellar_age", mean_stellar_age, comment);
+	writer.write("galaxies/mean_stellar_age", columns.mean_stellar_age, comment);
 
 	comment = "mass of metals locked in the gas of the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_disk", mgas_metals_disk, comment);
+	writer.write("galaxies/mgas_metals_disk", columns.mgas_metals_disk, comment);
 
 	comment = "mass of metals locked in the gas of the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_bulge", mgas_metals_bulge, comment);
+	writer.write("galaxies/mgas_metals_bulge", columns.mgas_metals_bulge, comment);
 
 	comment = "mass of metals that has been stripped out of the ISM due to ram pressure stripping [Msun/h]";
-	file.write_dataset("galaxies/mism_metals_stripped", mgas_stripped_metals, comment);
+	writer.write("galaxies/mism_metals_stripped", columns.mgas_stripped_metals, comment);
 
 	comment = "molecular gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/mmol_disk",mmol_disk, comment);
+	writer.write("galaxies/mmol_disk", columns.mmol_disk, comment);
 
 	comment ="molecular gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mmol_bulge",mmol_bulge, comment);
+	writer.write("galaxies/mmol_bulge", columns.mmol_bulge, comment);
 
 	comment = "atomic gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/matom_disk",matom_disk, comment);
+	writer.write("galaxies/matom_disk", columns.matom_disk, comment);
 
 	comment ="atomic gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/matom_bulge",matom_bulge, comment);
+	writer.write("galaxies/matom_bulge", columns.matom_bulge, comment);
 
 	comment = "star formation rate in the disk [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_disk", sfr_disk, comment);
+	writer.write("galaxies/sfr_disk", columns.sfr_disk, comment);
 
 	comment = "star formation rate in the bulge [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_burst", sfr_burst, comment);
+	writer.write("galaxies/sfr_burst", columns.sfr_burst, comment);
 
 	comment = "star formation rate in the bulge driven by galaxy mergers [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_burst_mergers", sfr_burst_mergers, comment);
+	writer.write("galaxies/sfr_burst_mergers", columns.sfr_burst_mergers, comment);
 
 	comment = "star formation rate in the bulge driven by disk instabilities [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_burst_diskins", sfr_burst_diskins, comment);
+	writer.write("galaxies/sfr_burst_diskins", columns.sfr_burst_diskins, comment);
 
 	comment = "black hole mass [Msun/h]";
-	file.write_dataset("galaxies/m_bh", mBH, comment);
+	writer.write("galaxies/m_bh", columns.mBH, comment);
 
 	comment = "black hole mass that comes from assembly (BH-BH mergers) [Msun/h]";
-	file.write_dataset("galaxies/m_bh_assembly", mBH_assembly, comment);
+	writer.write("galaxies/m_bh_assembly", columns.mBH_assembly, comment);
 
 	comment = "accretion rate onto the black hole during the hot halo mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_hh", mBH_acc_hh, comment);
+	writer.write("galaxies/bh_accretion_rate_hh", columns.mBH_acc_hh, comment);
 
 	comment = "accretion rate onto the black hole during the starburst mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_sb", mBH_acc_sb, comment);
+	writer.write("galaxies/bh_accretion_rate_sb", columns.mBH_acc_sb, comment);
 
 	comment = "black hole spin [dimensionless]";
-	file.write_dataset("galaxies/bh_spin", bh_spin, comment);
+	writer.write("galaxies/bh_spin", columns.bh_spin, comment);
 
 	comment = "half-mass radius of the stellar disk [cMpc/h]";
-	file.write_dataset("galaxies/rstar_disk", rdisk_star, comment);
+	writer.write("galaxies/rstar_disk", columns.rdisk_star, comment);
 
 	comment = "half-mass radius of the stellar bulge [cMpc/h]";
-	file.write_dataset("galaxies/rstar_bulge", rbulge_star, comment);
+	writer.write("galaxies/rstar_bulge", columns.rbulge_star, comment);
 
 	comment = "specific angular momentum of the stellar disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_star", sAM_disk_star, comment);
+	writer.write("galaxies/specific_angular_momentum_disk_star", columns.sAM_disk_star, comment);
 
 	comment = "specific angular momentum of the stellar bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_star", sAM_bulge_star, comment);
+	writer.write("galaxies/specific_angular_momentum_bulge_star", columns.sAM_bulge_star, comment);
 
 	comment = "half-mass radius of the gas disk [cMpc/h]";
-	file.write_dataset("galaxies/rgas_disk", rdisk_gas, comment);
+	writer.write("galaxies/rgas_disk", columns.rdisk_gas, comment);
 
 	comment = "half-mass radius of the gas bulge [cMpc/h]";
-	file.write_dataset("galaxies/rgas_bulge", rbulge_gas, comment);
+	writer.write("galaxies/rgas_bulge", columns.rbulge_gas, comment);
 
 	comment = "ram pressure stripping radius of the ISM [cMpc/h]";
-	file.write_dataset("galaxies/r_ism_stripped", r_stripped_ism, comment);
+	writer.write("galaxies/r_ism_stripped", columns.r_stripped_ism, comment);
 
 	comment = "specific angular momentum of the gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas", sAM_disk_gas, comment);
+	writer.write("galaxies/specific_angular_momentum_disk_gas", columns.sAM_disk_gas, comment);
 
 	comment = "specific angular momentum of the atomic gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_atom", sAM_disk_gas_atom, comment);
+	writer.write("galaxies/specific_angular_momentum_disk_gas_atom", columns.sAM_disk_gas_atom, comment);
 
 	comment = "specific angular momentum of the molecular gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_mol", sAM_disk_gas_mol, comment);
+	writer.write("galaxies/specific_angular_momentum_disk_gas_mol", columns.sAM_disk_gas_mol, comment);
 
 	comment = "specific angular momentum of the gas bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_gas", sAM_bulge_gas, comment);
+	writer.write("galaxies/specific_angular_momentum_bulge_gas", columns.sAM_bulge_gas, comment);
 
 	comment = "redshift at which this galaxy will merge onto a central galaxy (only relevant for type 2 galaxies)";
-	file.write_dataset("galaxies/redshift_merger", redshift_of_merger, comment);
+	writer.write("galaxies/redshift_merger", columns.redshift_of_merger, comment);
 
 	comment = "hot gas mass in the halo [Msun/h]";
-	file.write_dataset("galaxies/mhot", mhot, comment);
+	writer.write("galaxies/mhot", columns.mhot, comment);
 
 	comment = "mass of metals locked in the hot halo gas [Msun/h]";
-	file.write_dataset("galaxies/mhot_metals", mhot_metals, comment);
+	writer.write("galaxies/mhot_metals", columns.mhot_metals, comment);
 
 	comment = "gas mass in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated", mreheated, comment);
+	writer.write("galaxies/mreheated", columns.mreheated, comment);
 
 	comment = "mass of metals locked in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated_metals", mreheated_metals, comment);
+	writer.write("galaxies/mreheated_metals", columns.mreheated_metals, comment);
 
 	comment = "gas mass in the lost gas component - due to QSO feedback [Msun/h]";
-	file.write_dataset("galaxies/mlost", mlost, comment);
+	writer.write("galaxies/mlost", columns.mlost, comment);
 
 	comment = "mass of metals locked in the lost gas component - due to QSO feedback [Msun/h]";
-	file.write_dataset("galaxies/mlost_metals", mlost_metals, comment);
+	writer.write("galaxies/mlost_metals", columns.mlost_metals, comment);
 
 	comment = "stellar mass in the halo built by tidal stripping [Msun/h]";
-	file.write_dataset("galaxies/mstellar_halo", stellar_halo, comment);
+	writer.write("galaxies/mstellar_halo", columns.stellar_halo, comment);
 
 	comment = "mass of metals locked up in the stellar halo built by tidal stripping [Msun/h]";
-	file.write_dataset("galaxies/mstellar_halo_metals", stellar_halo_metals, comment);
+	writer.write("galaxies/mstellar_halo_metals", columns.stellar_halo_metals, comment);
 
 	comment = "mass weighted stellar mass of the galaxies that contributed to building the stellar halo [Msun/h]";
-	file.write_dataset("galaxies/mean_mstellar_galaxies_stellarhalo", mean_stellar_mass_galaxies_ihsc, comment);
+	writer.write("galaxies/mean_mstellar_galaxies_stellarhalo", columns.mean_stellar_mass_galaxies_ihsc, comment);
 
 	comment = "cooling rate of the hot halo component [Msun/Gyr/h].";
-	file.write_dataset("galaxies/cooling_rate", cooling_rate, comment);
+	writer.write("galaxies/cooling_rate", columns.cooling_rate, comment);
 
 	comment = "is halo on quasi hydrostatic equilibrium (=1 for true, =0 for false).";
-	file.write_dataset("galaxies/on_hydrostatic_eq", on_hydrostatic_eq, comment);
+	writer.write("galaxies/on_hydrostatic_eq", columns.on_hydrostatic_eq, comment);
 
 	comment = "gas mass that has been stripped out of this subhalo due to ram pressure stripping [Msun/h].";
-	file.write_dataset("galaxies/mhot_stripped", mhot_stripped, comment);
+	writer.write("galaxies/mhot_stripped", columns.mhot_stripped, comment);
 
 	comment = "mass of metals that has been stripped out of this subhalo due to ram pressure stripping [Msun/h].";
-	file.write_dataset("galaxies/mhot_metals_stripped", mhot_stripped_metals, comment);
+	writer.write("galaxies/mhot_metals_stripped", columns.mhot_stripped_metals, comment);
 
 	comment = "Dark matter mass of the host halo in which this galaxy resides [Msun/h]";
-	file.write_dataset("galaxies/mvir_hosthalo", mvir_hosthalo, comment);
+	writer.write("galaxies/mvir_hosthalo", columns.mvir_hosthalo, comment);
 
 	comment = "Dark matter mass of the subhalo in which this galaxy resides [Msun/h]. In the case of type 2 satellites, this corresponds to the mass its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/mvir_subhalo", mvir_subhalo, comment);
+	writer.write("galaxies/mvir_subhalo", columns.mvir_subhalo, comment);
 
 	comment = "Maximum circular velocity of this galaxy [km/s]";
-	file.write_dataset("galaxies/vmax_subhalo", vmax_subhalo, comment);
+	writer.write("galaxies/vmax_subhalo", columns.vmax_subhalo, comment);
 
 	comment = "Virial velocity of the dark matter subhalo in which this galaxy resides [km/s]. In the case of type 2 satellites, this corresponds to the virial velocity its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/vvir_subhalo", vvir_subhalo, comment);
+	writer.write("galaxies/vvir_subhalo", columns.vvir_subhalo, comment);
 
 	comment = "Virial velocity of the dark matter host halo in which this galaxy resides [km/s].";
-	file.write_dataset("galaxies/vvir_hosthalo", vvir_hosthalo, comment);
+	writer.write("galaxies/vvir_hosthalo", columns.vvir_hosthalo, comment);
 
 	comment = "ram pressure stripping radius of the halo gas [cMpc/h]";
-	file.write_dataset("galaxies/r_halo_stripped", r_stripped, comment);
+	writer.write("galaxies/r_halo_stripped", columns.r_stripped, comment);
 
 	comment = "NFW concentration parameter of the dark matter subhalo in which this galaxy resides [dimensionless]. In the case of type 2 satellites, this corresponds to the concentration its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/cnfw_subhalo", cnfw_subhalo, comment);
+	writer.write("galaxies/cnfw_subhalo", columns.cnfw_subhalo, comment);
 
 	comment = "Spin parameter of the dark matter subhalo in which this galaxy resides [dimensionless].  In the case of type 2 satellites, this corresponds to the lambda its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/lambda_subhalo", lambda_subhalo, comment);
+	writer.write("galaxies/lambda_subhalo", columns.lambda_subhalo, comment);
 
 	comment = "Dark matter mass at infall of the host halo in which this galaxy reside when it was last central [Msun/h]";
-	file.write_dataset("galaxies/mvir_infall_subhalo", mvir_infall_subhalo, comment);
+	writer.write("galaxies/mvir_infall_subhalo", columns.mvir_infall_subhalo, comment);
 
 	//Galaxy position
 	comment = "position component x of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_x", position_x, comment);
+	writer.write("galaxies/position_x", columns.position_x, comment);
 	comment = "position component y of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_y", position_y, comment);
+	writer.write("galaxies/position_y", columns.position_y, comment);
 	comment = "position component z of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_z", position_z, comment);
+	writer.write("galaxies/position_z", columns.position_z, comment);
 
 	//Galaxy velocity
 	comment = "peculiar velocity component x of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_x", velocity_x, comment);
+	writer.write("galaxies/velocity_x", columns.velocity_x, comment);
 	comment = "peculiar velocity component y of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_y", velocity_y, comment);
+	writer.write("galaxies/velocity_y", columns.velocity_y, comment);
 	comment = "peculiar velocity component z of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_z", velocity_z, comment);
+	writer.write("galaxies/velocity_z", columns.velocity_z, comment);
 
 	//Galaxy AM vector
 	comment = "total angular momentum component x of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_x", L_x,  comment);
+	writer.write("galaxies/l_x", columns.L_x, comment);
 	comment = "total angular momentum component y of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_y", L_y, comment);
+	writer.write("galaxies/l_y", columns.L_y, comment);
 	comment = "total angular momentum component z of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_z", L_z, comment);
+	writer.write("galaxies/l_z", columns.L_z, comment);
 
 	//Galaxy type.
 	comment = "galaxy type; =0 for centrals; =1 for satellites that reside in well identified subhalos; =2 for orphan satellites";
-	file.write_dataset("galaxies/type", type, comment);
+	writer.write("galaxies/type", columns.type, comment);
 
 	//Galaxy IDs.
 	comment = "subhalo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_subhalo", id_subhalo, comment);
+	writer.write("galaxies/id_subhalo", columns.id_subhalo, comment);
 
 	comment = "halo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_halo", id_halo, comment);
+	writer.write("galaxies/id_halo", columns.id_halo, comment);
 
 	comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
-	file.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+	writer.write("galaxies/id_galaxy", columns.id_galaxy, comment);
 
 	comment = "descendant galaxy ID. Different to galaxy id only if galaxy is type 2 and merges on the next snapshot.";
-	file.write_dataset("galaxies/descendant_id_galaxy", descendant_id_galaxy, comment);
+	writer.write("galaxies/descendant_id_galaxy", columns.descendant_id_galaxy, comment);
 
 	comment = "subhalo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_subhalo_tree", id_subhalo_tree, comment);
+	writer.write("galaxies/id_subhalo_tree", columns.id_subhalo_tree, comment);
 
 	comment = "halo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_halo_tree", id_halo_tree, comment);
-
-	LOG(info) << "Galaxies data written in " << t;
+	writer.write("galaxies/id_halo_tree", columns.id_halo_tree, comment);
 
+	writer.finish_block();
 }
 
 void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons){
@@ -1133,6 +1444,7 @@ void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot
 }
 
 void HDF5GalaxyWriter::write_sf_histories (int snapshot, const std::vector<HaloPtr> &halos){
+	TraceSpan span("write_sf_histories");
 
 
 	using std::string;
@@ -1316,6 +1628,7 @@ void HDF5GalaxyWriter::write_sf_histories (int snapshot, const std::vector<HaloP
 }
 
 void HDF5GalaxyWriter::write_bh_histories (int snapshot, const std::vector<HaloPtr> &halos){
+	TraceSpan span("write_bh_histories");
 
 
 	using std::string;
@@ -1445,6 +1758,7 @@ void HDF5GalaxyWriter::write_bh_histories (int snapshot, const std::vector<HaloP
 
 void ASCIIGalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
 {
+	TraceSpan span("write_snapshot", snapshot);
 
 	using std::vector;
 	using std::string;
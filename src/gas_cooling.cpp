@@ -449,19 +449,12 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
 		tcool = cooling_time(Tvir, logl,nh_density); //cooling time at notional density in Gyr.
 
 		/**
-		 * Push back the cooling properties at this timestep.
+		 * Add the cooling properties at this timestep.
+		 * In the case of mass we convert back to comoving units.
 		 */
-		subhalo.cooling_subhalo_tracking.tcooling.push_back(tcool);
-		subhalo.cooling_subhalo_tracking.temp.push_back(Tvir);
-		subhalo.cooling_subhalo_tracking.deltat.push_back(deltat);
-		//In the case of mass we convert back to comoving units.
-		subhalo.cooling_subhalo_tracking.mass.push_back(cosmology->physical_to_comoving_mass(mhot));
+		subhalo.cooling_subhalo_tracking.add(Tvir, cosmology->physical_to_comoving_mass(mhot), tcool, deltat);
 
-		double integral = 0.0;//will save integral(T*M/tcool)
-
-		for(unsigned i=0;i<subhalo.cooling_subhalo_tracking.deltat.size();++i){
-			integral += subhalo.cooling_subhalo_tracking.temp[i]*subhalo.cooling_subhalo_tracking.mass[i]/subhalo.cooling_subhalo_tracking.tcooling[i]*subhalo.cooling_subhalo_tracking.deltat[i];
-		}
+		double integral = subhalo.cooling_subhalo_tracking.temp_mass_over_tcooling;//integral(T*M/tcool)
 		tcharac = integral/(Tvir*mhot/tcool) *constants::GYR2S; //available time for cooling in seconds.
 	}
 
@@ -51,6 +51,22 @@ DataSet DataSet::create(shark::hdf5::AbstractGroup& parent, const std::string& n
 	                          H5P_DEFAULT, H5P_DEFAULT));
 }
 
+DataSet DataSet::create(shark::hdf5::AbstractGroup& parent, const std::string& name, const DataType& dataType,
+                        const shark::hdf5::DataSpace& dataSpace, const std::vector<hsize_t>& chunk_dimensions) {
+	auto plist = H5Pcreate(H5P_DATASET_CREATE);
+	if (plist < 0) {
+		throw hdf5_api_error("H5Pcreate");
+	}
+	if (H5Pset_chunk(plist, static_cast<int>(chunk_dimensions.size()), chunk_dimensions.data()) < 0) {
+		H5Pclose(plist);
+		throw hdf5_api_error("H5Pset_chunk", "Unable to set chunk size for dataset " + name);
+	}
+	auto handle = H5Dcreate2(parent.getId(), name.c_str(), dataType.getId(), dataSpace.getId(), H5P_DEFAULT,
+	                         plist, H5P_DEFAULT);
+	H5Pclose(plist);
+	return DataSet(handle);
+}
+
 DataSpace DataSet::getSpace() const {
 	return DataSpace(*this);
 }
@@ -73,5 +89,11 @@ DataSet::write(const void* buf, const DataType& memDataType, const DataSpace& me
 	}
 }
 
+void DataSet::setExtent(const std::vector<hsize_t>& dimensions) {
+	if (H5Dset_extent(getId(), dimensions.data()) < 0) {
+		throw hdf5_api_error("H5Dset_extent", "Unable to change the extent of dataset " + getName());
+	}
+}
+
 } // namespace hdf5
 } // namespace shark
\ No newline at end of file
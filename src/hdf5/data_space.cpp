@@ -51,6 +51,11 @@ DataSpace DataSpace::create(std::vector<hsize_t> dimensions) {
 	return DataSpace(H5Screate_simple(rank, dimensions.data(), nullptr));
 }
 
+DataSpace DataSpace::create(std::vector<hsize_t> dimensions, std::vector<hsize_t> max_dimensions) {
+	auto rank = static_cast<int>(dimensions.size());
+	return DataSpace(H5Screate_simple(rank, dimensions.data(), max_dimensions.data()));
+}
+
 int DataSpace::getSimpleExtentNdims() const {
 	return H5Sget_simple_extent_ndims(getId());
 }
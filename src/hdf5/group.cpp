@@ -77,6 +77,11 @@ DataSet AbstractGroup::createDataSet(const std::string& name, const DataType& da
 	return DataSet::create(*this, name, dataType, dataSpace);
 }
 
+DataSet AbstractGroup::createDataSet(const std::string& name, const DataType& dataType, const DataSpace& dataSpace,
+                                     const std::vector<hsize_t>& chunk_dimensions) {
+	return DataSet::create(*this, name, dataType, dataSpace, chunk_dimensions);
+}
+
 /*** Group ***/
 
 Group::Group(hid_t handle) : AbstractGroup(H5I_GROUP, handle) {}
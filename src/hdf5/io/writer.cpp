@@ -100,6 +100,13 @@ DataSet create_entity<H5G_DATASET>(AbstractGroup& file_or_group, const std::stri
 	return file_or_group.createDataSet(name, dataType, dataSpace);
 }
 
+template<>
+inline
+DataSet create_entity<H5G_DATASET>(AbstractGroup& file_or_group, const std::string& name, const DataType& dataType,
+                                   const DataSpace& dataSpace, const std::vector<hsize_t>& chunk_dimensions) {
+	return file_or_group.createDataSet(name, dataType, dataSpace, chunk_dimensions);
+}
+
 template<H5G_obj_t E, typename ... Ts>
 typename entity_traits<E>::rettype
 get_or_create_entity(AbstractGroup& file_or_group, const std::string& name, Ts&& ...create_args) {
@@ -155,6 +162,22 @@ DataSet Writer::get_or_create_dataset(const std::vector<std::string>& path, cons
 	return get_or_create_entity<H5G_DATASET>(group, dataset_name, dataType, dataSpace);
 }
 
+DataSet Writer::create_extendible_dataset(const std::vector<std::string>& path, const DataType& dataType,
+                                          hsize_t chunk_size) {
+	const auto dataSpace = DataSpace::create({0}, {H5S_UNLIMITED});
+	const std::vector<hsize_t> chunk_dimensions {chunk_size};
+	if (path.size() == 1) {
+		check_dataset_name(path[0]);
+		return get_or_create_entity<H5G_DATASET>(hdf5_file.value(), path[0], dataType, dataSpace, chunk_dimensions);
+	}
+
+	std::vector<std::string> group_paths(path.begin(), path.end() - 1);
+	auto& dataset_name = path.back();
+	check_dataset_name(dataset_name);
+	Group group = get_or_create_group(group_paths);
+	return get_or_create_entity<H5G_DATASET>(group, dataset_name, dataType, dataSpace, chunk_dimensions);
+}
+
 }  // namespace hdf5
 
 }  // namespace shark
\ No newline at end of file
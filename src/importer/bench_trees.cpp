@@ -0,0 +1,119 @@
+//
+// Main routine for the shark-bench-trees program
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+// All rights reserved
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+// MA 02111-1307  USA
+//
+
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "synthetic_trees.h"
+
+namespace shark {
+namespace importer {
+
+void show_help(const char *prog, const boost::program_options::options_description &desc, std::ostream &out)
+{
+	using std::endl;
+	out << endl;
+	out << "Usage: " << prog << " [options] tree-files-prefix" << endl;
+	out << endl;
+	out << "Generates synthetic merger trees in SURFS HDF5 format into <prefix>.<batch>.hdf5," << endl;
+	out << "their snapshot redshifts into <prefix>.redshifts.txt, and a configuration file" << endl;
+	out << "with the matching simulation options into <prefix>.cfg, which can be given to" << endl;
+	out << "shark after a configuration file with the physical model options, e.g.:" << endl;
+	out << endl;
+	out << " $> " << prog << " -n 100000 trees/tree" << endl;
+	out << " $> shark sample.cfg trees/tree.cfg" << endl;
+	out << endl;
+	out << "Trees are grown backwards in time from a root halo following a parametric" << endl;
+	out << "Monte Carlo model, and are identical for the same options." << endl;
+	out << endl;
+	out << desc << endl;
+}
+
+int run(int argc, char **argv)
+{
+	using std::string;
+	namespace po = boost::program_options;
+
+	synthetic_trees_params params;
+	po::options_description visible_opts("shark-bench-trees options");
+	visible_opts.add_options()
+		("help,h",             "Show this help message")
+		("nodes,n",            po::value<std::size_t>(&params.n_nodes)->default_value(100000),
+		                       "Minimum number of nodes (subhalos across all snapshots) to generate")
+		("snapshots,s",        po::value<int>(&params.n_snapshots)->default_value(100),
+		                       "Number of snapshots")
+		("max-redshift,z",     po::value<double>(&params.max_redshift)->default_value(15),
+		                       "Redshift of the first snapshot. Snapshots are equally spaced in ln(1 + z)")
+		("box-size,l",         po::value<double>(&params.box_size)->default_value(100),
+		                       "Side of the simulated box [cMpc/h]")
+		("cluster-fraction,c", po::value<double>(&params.cluster_fraction)->default_value(0.1),
+		                       "Fraction of nodes in trees rooted in a cluster-mass (1e14 to 1e15 Msun/h) halo. "
+		                       "Since cluster trees are large, at least one is generated if not zero")
+		("particle-mass,m",    po::value<double>(&params.particle_mass)->default_value(1e9),
+		                       "Mass of the simulation particles [Msun/h]; subhalos have at least 20 particles")
+		("files,f",            po::value<unsigned int>(&params.n_files)->default_value(1),
+		                       "Number of files (simulation batches) to write")
+		("seed,S",             po::value<unsigned int>(&params.seed)->default_value(1),
+		                       "Seed of the random number generator");
+
+	po::positional_options_description pdesc;
+	pdesc.add("prefix", 1);
+
+	po::options_description all_opts;
+	all_opts.add(visible_opts);
+	all_opts.add_options()
+		("prefix", po::value<string>(&params.prefix), "Tree files prefix");
+
+	po::variables_map vm;
+	po::command_line_parser parser(argc, argv);
+	parser.options(all_opts).positional(pdesc);
+	po::store(parser.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") != 0) {
+		show_help(argv[0], visible_opts, std::cout);
+		return 0;
+	}
+	if (vm.count("prefix") == 0) {
+		show_help(argv[0], visible_opts, std::cerr);
+		return 1;
+	}
+
+	generate_synthetic_trees(params);
+	return 0;
+}
+
+} // namespace importer
+} // namespace shark
+
+int main(int argc, char *argv[]) {
+	try {
+		return shark::importer::run(argc, argv);
+	} catch (const std::exception &e) {
+		std::cerr << "Error while running shark-bench-trees: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,212 @@
+//
+// Main routine for the shark-convert-trees program
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+// All rights reserved
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+// MA 02111-1307  USA
+//
+
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "columnar_trees.h"
+#include "cosmology.h"
+#include "dark_matter_halos.h"
+#include "exceptions.h"
+#include "halo.h"
+#include "execution.h"
+#include "gas_cooling.h"
+#include "merger_tree.h"
+#include "merger_tree_reader.h"
+#include "options.h"
+#include "simulation.h"
+#include "timer.h"
+#include "total_baryon.h"
+#include "tree_builder.h"
+#include "tree_cache.h"
+#include "utils.h"
+#include "hdf5/io/reader.h"
+
+namespace shark {
+namespace importer {
+
+void show_help(const char *prog, const boost::program_options::options_description &desc, std::ostream &out)
+{
+	using std::endl;
+	out << endl;
+	out << "Usage: " << prog << " [options] tree-files-prefix" << endl;
+	out << "       " << prog << " --benchmark [-o option ...] config-file [... config-file]" << endl;
+	out << endl;
+	out << "In its first form, converts SURFS HDF5 merger tree files <prefix>.<batch>.hdf5" << endl;
+	out << "into columnar tree files <prefix>.<batch>.columns, which can then be read by" << endl;
+	out << "shark by setting simulation.tree_files_format = columnar." << endl;
+	out << endl;
+	out << "In its second form, reads the halos of the given shark configuration and" << endl;
+	out << "reports the time and peak memory needed to do so. Run once per format to compare." << endl;
+	out << "It then also builds merger trees out of them, and compares the time needed to" << endl;
+	out << "read and build them against the time needed to restore them from an in-memory image." << endl;
+	out << endl;
+	out << desc << endl;
+}
+
+int convert(const std::string &prefix, std::vector<unsigned int> batches, bool gas_mass)
+{
+	if (batches.empty()) {
+		hdf5::Reader batchfile_0(prefix + ".0.hdf5");
+		auto nbatches = batchfile_0.read_attribute<unsigned int>("fileInfo/numberOfFiles");
+		for (unsigned int batch = 0; batch != nbatches; batch++) {
+			batches.push_back(batch);
+		}
+	}
+
+	for (auto batch: batches) {
+		Timer t;
+		auto base = prefix + "." + std::to_string(batch);
+		auto n_rows = write_columnar_trees(base + ".hdf5", base + ".columns", gas_mass);
+		std::cout << "Converted " << n_rows << " subhalos from " << base << ".hdf5 in " << t << std::endl;
+	}
+	return 0;
+}
+
+int benchmark(const std::vector<std::string> &config_files, const std::vector<std::string> &option_specs, unsigned int threads)
+{
+	Options options;
+	for (auto &config_file: config_files) {
+		options.add_file(config_file);
+	}
+	for (auto &opt_spec: option_specs) {
+		options.add(opt_spec);
+	}
+
+	CosmologicalParameters cosmo_params(options);
+	DarkMatterHaloParameters dark_matter_halo_params(options);
+	ExecutionParameters exec_params(options);
+	SimulationParameters simulation_params(options);
+	auto cosmology = make_cosmology(cosmo_params);
+	auto dark_matter_halos = make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params);
+
+	auto rss_before = peak_rss();
+	Timer t;
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
+	auto halos = reader.read_halos(exec_params.simulation_batches);
+	auto elapsed = t.get();
+	auto n_subhalos = std::accumulate(halos.begin(), halos.end(), std::size_t(0), [](std::size_t n, const HaloPtr &halo) {
+		return n + halo->subhalo_count();
+	});
+
+	std::cout << "Read " << halos.size() << " halos (" << n_subhalos << " subhalos) from " << simulation_params.tree_files_prefix << std::endl;
+	std::cout << "Import time: " << ns_time(elapsed) << std::endl;
+	std::cout << "Peak RSS before import: " << memory_amount(rss_before) << std::endl;
+	std::cout << "Peak RSS after import: " << memory_amount(peak_rss()) << std::endl;
+
+	// Building trees out of the halos completes the import of a shark run,
+	// which can be avoided by restoring them from an image instead
+	Timer build_t;
+	TotalBaryon all_baryons;
+	HaloBasedTreeBuilder tree_builder(exec_params, threads);
+	auto trees = tree_builder.build_trees(halos, simulation_params, GasCoolingParameters(options), dark_matter_halo_params, dark_matter_halos, cosmology, all_baryons);
+	elapsed += build_t.get();
+	std::cout << "Built " << trees.size() << " merger trees in " << build_t << std::endl;
+	std::cout << "Total import and build time: " << ns_time(elapsed) << std::endl;
+
+	Timer capture_t;
+	TreeImage image(trees, all_baryons);
+	std::cout << "Captured tree image (" << memory_amount(image.size()) << ") in " << capture_t << std::endl;
+
+	const int n_restores = 5;
+	Timer::duration restore_time = 0;
+	for (int i = 0; i != n_restores; i++) {
+		TotalBaryon restored_baryons;
+		Timer restore_t;
+		auto restored = image.restore(restored_baryons);
+		restore_time += restore_t.get();
+		for (auto &tree: restored) {
+			tree->release_halos(tree->last_snapshot);
+		}
+	}
+	std::cout << "Tree image restore time (mean of " << n_restores << "): " << ns_time(restore_time / n_restores) << std::endl;
+	std::cout << "Speedup of restore over import and build: " << fixed<1>(double(elapsed) / (restore_time / n_restores)) << "x" << std::endl;
+	return 0;
+}
+
+int run(int argc, char **argv)
+{
+	using std::string;
+	using std::vector;
+	namespace po = boost::program_options;
+
+	po::options_description visible_opts("shark-convert-trees options");
+	visible_opts.add_options()
+		("help,h",      "Show this help message")
+		("batches,b",   po::value<vector<unsigned int>>()->multitoken()->default_value({}, "all"),
+		                "Batches to convert, defaults to all")
+		("gas-mass,g",  "Convert gas masses too (hydrodynamical simulations only)")
+		("benchmark",   "Benchmark the import of halos for the given configuration files")
+		("threads,t",   po::value<unsigned int>()->default_value(1), "Threads to use while benchmarking")
+		("options,o",   po::value<vector<string>>()->multitoken()->default_value({}, ""),
+		                "Space-separated additional options to override config file");
+
+	po::positional_options_description pdesc;
+	pdesc.add("inputs", -1);
+
+	po::options_description all_opts;
+	all_opts.add(visible_opts);
+	all_opts.add_options()
+		("inputs", po::value<vector<string>>()->multitoken(), "Tree files prefix or config file(s)");
+
+	po::variables_map vm;
+	po::command_line_parser parser(argc, argv);
+	parser.options(all_opts).positional(pdesc);
+	po::store(parser.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") != 0) {
+		show_help(argv[0], visible_opts, std::cout);
+		return 0;
+	}
+	if (vm.count("inputs") == 0) {
+		show_help(argv[0], visible_opts, std::cerr);
+		return 1;
+	}
+
+	auto inputs = vm["inputs"].as<vector<string>>();
+	if (vm.count("benchmark") != 0) {
+		return benchmark(inputs, vm["options"].as<vector<string>>(), vm["threads"].as<unsigned int>());
+	}
+	if (inputs.size() != 1) {
+		throw invalid_argument("Only one tree files prefix can be converted at a time");
+	}
+	return convert(inputs[0], vm["batches"].as<vector<unsigned int>>(), vm.count("gas-mass") != 0);
+}
+
+} // namespace importer
+} // namespace shark
+
+int main(int argc, char *argv[]) {
+	try {
+		return shark::importer::run(argc, argv);
+	} catch (const std::exception &e) {
+		std::cerr << "Error while running shark-convert-trees: " << e.what() << std::endl;
+		return 1;
+	}
+}
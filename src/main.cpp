@@ -24,9 +24,12 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <ios>
 #include <iostream>
 #include <ostream>
+#include <string>
 #include <vector>
 
 #include "config.h"
@@ -38,6 +41,7 @@
 #include <boost/program_options.hpp>
 #include <gsl/gsl_errno.h>
 
+#include "distributed.h"
 #include "galaxy.h"
 #include "merger_tree.h"
 #include "logging.h"
@@ -46,6 +50,7 @@
 #include "subhalo.h"
 #include "git_revision.h"
 #include "timer.h"
+#include "trace.h"
 
 namespace shark {
 
@@ -134,7 +139,25 @@ boost::program_options::variables_map parse_cmdline(int argc, char **argv) {
 		("threads,t",   po::value<unsigned int>()->default_value(1), "OpenMP threads, defaults to 1. 0 means use OpenMP default number of threads")
 #endif // SHARK_OPENMP
 		("options,o",   po::value<vector<string>>()->multitoken()->default_value({}, ""),
-		                "Space-separated additional options to override config file");
+		                "Space-separated additional options to override config file")
+		("models,m",    po::value<string>(),
+		                "File with one model per line, each given as a set of options overriding the configuration. "
+		                "All models are evolved over the same merger trees, which are built only once")
+		("restart,r",   "Resume the execution from its latest checkpoint (see execution.checkpoint_snapshots), "
+		                "or run from the beginning if none is found")
+		("coordinate",  po::value<string>(),
+		                "Coordinate a distributed execution through the given directory, handing out one batch per "
+		                "subvolume to workers and writing the global quantities of all of them")
+		("work",        po::value<string>(),
+		                "Work for the distributed execution coordinated through the given directory, "
+		                "evolving batches until none is left")
+		("workers,w",   po::value<unsigned int>()->default_value(0),
+		                "When coordinating, number of worker processes to start in this machine")
+		("worker-timeout", po::value<unsigned int>()->default_value(0),
+		                "When coordinating, seconds to wait for workers to send anything before failing, naming the "
+		                "unfinished subvolumes; 0 waits forever. Workers send something after each snapshot, so this "
+		                "must be longer than the slowest snapshot. Without it, workers other than those started with "
+		                "-w that die or lose access to the coordination directory make the coordinator wait forever");
 
 	po::positional_options_description pdesc;
 	pdesc.add("config-file", -1);
@@ -201,6 +224,31 @@ Options read_options(const boost::program_options::variables_map &vm, unsigned i
 	return options;
 }
 
+/// Reads the options of each model, one model per line. Lines have the same
+/// syntax as a command line, where any -o is optional
+std::vector<std::vector<std::string>> read_models(const std::string &fname)
+{
+	std::ifstream f(fname);
+	if (!f) {
+		throw boost::program_options::error("Cannot open models file " + fname);
+	}
+
+	std::vector<std::vector<std::string>> models;
+	std::string line;
+	while (std::getline(f, line)) {
+		std::vector<std::string> model_options;
+		for (auto &arg: boost::program_options::split_unix(line)) {
+			if (arg != "-o") {
+				model_options.push_back(arg);
+			}
+		}
+		if (!model_options.empty()) {
+			models.emplace_back(std::move(model_options));
+		}
+	}
+	return models;
+}
+
 int main(int argc, char **argv) {
 
 	try {
@@ -216,7 +264,38 @@ int main(int argc, char **argv) {
 		Timer timer;
 		unsigned int threads;
 		auto options = read_options(vm, threads);
-		SharkRunner(options, threads).run();
+		if (vm.count("models") != 0 && vm.count("restart") != 0) {
+			throw boost::program_options::error("--restart cannot be used together with --models");
+		}
+		auto distributed = vm.count("coordinate") + vm.count("work");
+		if (distributed > 1 || (distributed != 0 && (vm.count("models") != 0 || vm.count("restart") != 0))) {
+			throw boost::program_options::error("--coordinate, --work, --models and --restart cannot be used together");
+		}
+
+		// The trace is written once shark finishes, even if it fails
+		std::string trace_file;
+		options.load("execution.trace_file", trace_file);
+		{
+			TraceFile trace(trace_file);
+			if (vm.count("coordinate") != 0) {
+				DirectoryTransport transport(vm["coordinate"].as<std::string>());
+				run_coordinator(options, transport, vm["workers"].as<unsigned int>(), threads,
+				                std::chrono::seconds(vm["worker-timeout"].as<unsigned int>()));
+			}
+			else if (vm.count("work") != 0) {
+				DirectoryTransport transport(vm["work"].as<std::string>());
+				run_worker(options, transport, threads);
+			}
+			else if (vm.count("models") != 0) {
+				SharkRunner::run_models(options, read_models(vm["models"].as<std::string>()), threads);
+			}
+			else if (vm.count("restart") != 0) {
+				SharkRunner(options, threads).restart();
+			}
+			else {
+				SharkRunner(options, threads).run();
+			}
+		}
 		LOG(info) << "Successfully finished in " << timer;
 		LOG(info) << "Maximum memory usage: " << memory_amount(peak_rss());
 
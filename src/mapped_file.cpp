@@ -0,0 +1,105 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * MappedFile implementation
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif // _WIN32
+
+#include "exceptions.h"
+#include "mapped_file.h"
+
+namespace shark {
+
+#ifndef _WIN32
+
+static void throw_errno(const std::string &what, const std::string &fname)
+{
+	std::ostringstream os;
+	os << "Error while " << what << " " << fname << ": " << std::strerror(errno);
+	throw exception(os.str());
+}
+
+MappedFile::MappedFile(const std::string &fname)
+{
+	int fd = ::open(fname.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw_errno("opening", fname);
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) == -1) {
+		::close(fd);
+		throw_errno("inspecting", fname);
+	}
+
+	m_size = std::size_t(st.st_size);
+	if (m_size == 0) {
+		::close(fd);
+		return;
+	}
+
+	void *addr = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) {
+		throw_errno("mapping", fname);
+	}
+	m_data = static_cast<const char *>(addr);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data && m_buffer.empty()) {
+		::munmap(const_cast<char *>(m_data), m_size);
+	}
+}
+
+#else // windows
+
+MappedFile::MappedFile(const std::string &fname)
+{
+	std::ifstream f(fname, std::ios::binary | std::ios::ate);
+	if (!f) {
+		throw exception("Error while opening " + fname);
+	}
+	m_size = std::size_t(f.tellg());
+	m_buffer.resize(m_size);
+	f.seekg(0);
+	f.read(m_buffer.data(), m_size);
+	m_data = m_buffer.data();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif // _WIN32
+
+}  // namespace shark
@@ -0,0 +1,58 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+
+#include "halo.h"
+#include "merger_tree.h"
+#include "subhalo.h"
+
+namespace shark {
+
+void MergerTree::release_halos(int snapshot)
+{
+	auto unlink = [](const SubhaloPtr &subhalo) {
+		if (subhalo->descendant) {
+			subhalo->descendant->ascendants.clear();
+		}
+		subhalo->descendant.reset();
+		subhalo->ascendants.clear();
+		subhalo->host_halo.reset();
+	};
+
+	auto last = std::upper_bound(halos.begin(), halos.end(), snapshot, by_snapshot{});
+	for (auto it = halos.begin(); it != last; it++) {
+		auto &halo = *it;
+		for (auto &subhalo: halo->all_subhalos()) {
+			unlink(subhalo);
+		}
+		if (halo->descendant) {
+			halo->descendant->ascendants.clear();
+		}
+		halo->descendant.reset();
+		halo->ascendants.clear();
+		halo->central_subhalo.reset();
+		halo->satellite_subhalos.clear();
+		halo->merger_tree.reset();
+	}
+	halos.erase(halos.begin(), last);
+	index_snapshots();
+}
+
+}  // namespace shark
@@ -0,0 +1,92 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * MergerTreeGraph implementation
+ */
+
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+#include "exceptions.h"
+#include "halo.h"
+#include "merger_tree.h"
+#include "merger_tree_graph.h"
+#include "subhalo.h"
+
+namespace shark {
+
+constexpr MergerTreeGraph::handle_t MergerTreeGraph::none;
+
+MergerTreeGraph::MergerTreeGraph(const MergerTree &tree) :
+	halos(&tree.get_halos())
+{
+	auto &tree_halos = tree.get_halos();
+	if (tree_halos.size() > std::size_t(std::numeric_limits<handle_t>::max())) {
+		std::ostringstream os;
+		os << tree << " has too many halos (" << tree_halos.size() << ") to create a graph for it";
+		throw invalid_argument(os.str());
+	}
+
+	auto n_halos = handle_t(tree_halos.size());
+	std::unordered_map<const Halo *, handle_t> handles;
+	handles.reserve(tree_halos.size());
+	for (handle_t h = 0; h != n_halos; h++) {
+		handles.emplace(tree_halos[h].get(), h);
+	}
+	auto handle_of = [&handles](const HaloPtr &halo) {
+		if (!halo) {
+			return none;
+		}
+		auto it = handles.find(halo.get());
+		return it == handles.end() ? none : it->second;
+	};
+
+	// Halos are sorted by snapshot, so each snapshot is a contiguous slice
+	if (n_halos > 0) {
+		first_snapshot = tree_halos.front()->snapshot;
+		auto last_snapshot = tree_halos.back()->snapshot;
+		snapshot_offsets.resize(last_snapshot - first_snapshot + 2);
+		handle_t h = 0;
+		for (int snapshot = first_snapshot; snapshot <= last_snapshot + 1; snapshot++) {
+			while (h != n_halos && tree_halos[h]->snapshot < snapshot) {
+				h++;
+			}
+			snapshot_offsets[snapshot - first_snapshot] = h;
+		}
+	}
+
+	descendants.reserve(n_halos);
+	main_progenitors.reserve(n_halos);
+	progenitor_offsets.reserve(n_halos + 1);
+	progenitor_offsets.push_back(0);
+	for (auto &halo: tree_halos) {
+		descendants.push_back(handle_of(halo->descendant));
+		for (auto &ascendant: halo->ascendants) {
+			progenitor_handles.push_back(handle_of(ascendant));
+		}
+		progenitor_offsets.push_back(handle_t(progenitor_handles.size()));
+		main_progenitors.push_back(halo->central_subhalo ? handle_of(halo->main_progenitor()) : none);
+	}
+}
+
+}  // namespace shark
@@ -31,6 +31,7 @@
 #include <vector>
 #include <tuple>
 
+#include "columnar_trees.h"
 #include "dark_matter_halos.h"
 #include "exceptions.h"
 #include "halo.h"
@@ -40,6 +41,7 @@
 #include "simulation.h"
 #include "subhalo.h"
 #include "timer.h"
+#include "trace.h"
 #include "utils.h"
 #include "hdf5/io/reader.h"
 
@@ -58,22 +60,43 @@ SURFSReader::SURFSReader(const std::string &prefix, DarkMatterHalosPtr dark_matt
 const std::string SURFSReader::get_filename(unsigned int batch)
 {
 	std::ostringstream os;
-	os << prefix << "." << batch << ".hdf5";
+	os << prefix << "." << batch;
+	if (simulation_params.tree_files_format == SimulationParameters::SURFS_COLUMNAR) {
+		os << ".columns";
+	}
+	else {
+		os << ".hdf5";
+	}
 	return os.str();
 }
 
+unsigned int SURFSReader::get_number_of_files()
+{
+	auto batch0_fname = get_filename(0);
+	LOG(debug) << "Opening " << batch0_fname << " for reading";
+	if (simulation_params.tree_files_format == SimulationParameters::SURFS_COLUMNAR) {
+		return ColumnarTreeFile(batch0_fname).number_of_files();
+	}
+	hdf5::Reader batchfile_0(batch0_fname);
+	return batchfile_0.read_attribute<unsigned int>("fileInfo/numberOfFiles");
+}
+
+const std::vector<std::string> SURFSReader::get_filenames(const std::vector<unsigned int> &batches)
+{
+	std::vector<std::string> filenames;
+	for (auto batch: batches) {
+		filenames.push_back(get_filename(batch));
+	}
+	return filenames;
+}
+
 const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> batches)
 {
+	TraceSpan span("read_halos");
 
 	// Check that batch numbers are within boundaries
 	// (supposing that the file for batch 0 always exists)
-	unsigned int nbatches;
-	{
-		auto batch0_fname = get_filename(0);
-		LOG(debug) << "Opening " << batch0_fname << " for reading";
-		hdf5::Reader batchfile_0(batch0_fname);
-		nbatches = batchfile_0.read_attribute<unsigned int>("fileInfo/numberOfFiles");
-	}
+	unsigned int nbatches = get_number_of_files();
 
 	for(auto batch: batches) {
 		if (batch >= nbatches) {
@@ -96,10 +119,63 @@ const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> bat
 	return all_halos;
 }
 
+/// Pointers to the per-subhalo input data, regardless of where it comes from.
+/// Vector quantities have three elements per subhalo.
+struct SubhaloColumns {
+	std::size_t first = 0;
+	std::size_t n_subhalos = 0;
+	const float *position = nullptr;
+	const float *velocity = nullptr;
+	const float *L = nullptr;
+	const float *Mvir = nullptr;
+	const float *Mgas = nullptr;
+	const int *Npart = nullptr;
+	const float *Vcirc = nullptr;
+	const int *snap = nullptr;
+	const Subhalo::id_t *nodeIndex = nullptr;
+	const Subhalo::id_t *descIndex = nullptr;
+	const Halo::id_t *hostIndex = nullptr;
+	const Halo::id_t *descHost = nullptr;
+	const int *IsMain = nullptr;
+	const int *IsInterpolated = nullptr;
+};
+
 const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 {
+	TraceSpan span("read_subhalos", batch);
 	Timer t;
 	const auto fname = get_filename(batch);
+
+	if (simulation_params.tree_files_format == SimulationParameters::SURFS_COLUMNAR) {
+
+		// Columns are used directly from the mapped file, and the rows
+		// for snapshots we don't care about are not even looked at
+		ColumnarTreeFile tree_file(fname);
+		if (simulation_params.hydrorun && !tree_file.has_gas_mass()) {
+			throw invalid_data(fname + " has no gas masses, but simulation.hydrorun is true");
+		}
+
+		SubhaloColumns columns;
+		columns.first = tree_file.first_row_from(simulation_params.min_snapshot);
+		columns.n_subhalos = tree_file.size();
+		columns.position = tree_file.column<float>(ColumnarTreeFile::POSITION);
+		columns.velocity = tree_file.column<float>(ColumnarTreeFile::VELOCITY);
+		columns.L = tree_file.column<float>(ColumnarTreeFile::ANGULAR_MOMENTUM);
+		columns.Mvir = tree_file.column<float>(ColumnarTreeFile::NODE_MASS);
+		columns.Mgas = tree_file.column<float>(ColumnarTreeFile::GAS_MASS);
+		columns.Npart = tree_file.column<int>(ColumnarTreeFile::PARTICLE_NUMBER);
+		columns.Vcirc = tree_file.column<float>(ColumnarTreeFile::MAXIMUM_CIRCULAR_VELOCITY);
+		columns.snap = tree_file.column<int>(ColumnarTreeFile::SNAPSHOT_NUMBER);
+		columns.nodeIndex = tree_file.column<Subhalo::id_t>(ColumnarTreeFile::NODE_INDEX);
+		columns.descIndex = tree_file.column<Subhalo::id_t>(ColumnarTreeFile::DESCENDANT_INDEX);
+		columns.hostIndex = tree_file.column<Halo::id_t>(ColumnarTreeFile::HOST_INDEX);
+		columns.descHost = tree_file.column<Halo::id_t>(ColumnarTreeFile::DESCENDANT_HOST);
+		columns.IsMain = tree_file.column<int>(ColumnarTreeFile::IS_MAIN_PROGENITOR);
+		columns.IsInterpolated = tree_file.column<int>(ColumnarTreeFile::IS_INTERPOLATED);
+		LOG(info) << "Mapped " << columns.n_subhalos << " subhalos from " << fname << " in " << t;
+		return create_subhalos(columns, fname);
+	}
+
 	hdf5::Reader batch_file(fname);
 
 	//Read position and velocities first.
@@ -129,8 +205,30 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 	std::vector<int> IsCentre = batch_file.read_dataset_v<int>("haloTrees/isDHaloCentre");
 	std::vector<int> IsInterpolated = batch_file.read_dataset_v<int>("haloTrees/isInterpolated");
 
-	auto n_subhalos = Mvir.size();
-	LOG(info) << "Read raw data of " << n_subhalos << " subhalos from " << fname << " in " << t;
+	SubhaloColumns columns;
+	columns.n_subhalos = Mvir.size();
+	columns.position = position.data();
+	columns.velocity = velocity.data();
+	columns.L = L.data();
+	columns.Mvir = Mvir.data();
+	columns.Mgas = Mgas.data();
+	columns.Npart = Npart.data();
+	columns.Vcirc = Vcirc.data();
+	columns.snap = snap.data();
+	columns.nodeIndex = nodeIndex.data();
+	columns.descIndex = descIndex.data();
+	columns.hostIndex = hostIndex.data();
+	columns.descHost = descHost.data();
+	columns.IsMain = IsMain.data();
+	columns.IsInterpolated = IsInterpolated.data();
+	LOG(info) << "Read raw data of " << columns.n_subhalos << " subhalos from " << fname << " in " << t;
+	return create_subhalos(columns, fname);
+}
+
+const std::vector<SubhaloPtr> SURFSReader::create_subhalos(const SubhaloColumns &columns, const std::string &fname)
+{
+	TraceSpan span("create_subhalos");
+	auto n_subhalos = columns.n_subhalos;
 	if (n_subhalos == 0) {
 		return {};
 	}
@@ -140,14 +238,28 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 	os << "After reading we should be using ~" << memory_amount(n_subhalos * (sizeof(Subhalo) + sizeof(SubhaloPtr))) << " of memory";
 	LOG(info) << os.str();
 
-	t = Timer();
+	Timer t;
 	std::vector<std::vector<SubhaloPtr>> t_subhalos(threads);
 	for (auto &subhalos: t_subhalos) {
 		subhalos.reserve(n_subhalos / threads);
 	}
 
-	omp_static_for(0, n_subhalos, threads, [&](std::size_t i, unsigned int thread_idx) {
-
+	const auto *position = columns.position;
+	const auto *velocity = columns.velocity;
+	const auto *L = columns.L;
+	const auto *Mvir = columns.Mvir;
+	const auto *Mgas = columns.Mgas;
+	const auto *Npart = columns.Npart;
+	const auto *Vcirc = columns.Vcirc;
+	const auto *snap = columns.snap;
+	const auto *nodeIndex = columns.nodeIndex;
+	const auto *descIndex = columns.descIndex;
+	const auto *hostIndex = columns.hostIndex;
+	const auto *descHost = columns.descHost;
+	const auto *IsMain = columns.IsMain;
+	const auto *IsInterpolated = columns.IsInterpolated;
+
+	omp_static_for(columns.first, n_subhalos, threads, [&](std::size_t i, unsigned int thread_idx) {
 		if (snap[i] < simulation_params.min_snapshot) {
 			return;
 		}
@@ -252,12 +364,15 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 
 const std::vector<HaloPtr> SURFSReader::read_halos(unsigned int batch)
 {
+	TraceSpan span("read_batch", batch);
 
 	std::vector<SubhaloPtr> subhalos = read_subhalos(batch);
 
 	// Sort subhalos by host index (which intrinsically sorts them by snapshot
-	// since host indices numbers are prefixed with the snapshot number)
-	std::sort(subhalos.begin(), subhalos.end(), [](const SubhaloPtr &lhs, const SubhaloPtr &rhs) {
+	// since host indices numbers are prefixed with the snapshot number).
+	// The sort is stable so subhalos keep their relative input order within
+	// their host regardless of the tree files format
+	std::stable_sort(subhalos.begin(), subhalos.end(), [](const SubhaloPtr &lhs, const SubhaloPtr &rhs) {
 		return lhs->haloID < rhs->haloID;
 	});
 	LOG(info) << "Sorted subhalos by haloID, creating Halos now";
@@ -0,0 +1,126 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Metrics implementation
+ */
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "metrics.h"
+
+namespace shark {
+
+MetricsRecord::MetricsRecord(const std::string &type)
+{
+	os << '{';
+	write_value("type");
+	os << ':';
+	write_value(type);
+}
+
+std::string MetricsRecord::str() const
+{
+	return os.str() + '}';
+}
+
+void MetricsRecord::write_value(bool value)
+{
+	os << (value ? "true" : "false");
+}
+
+void MetricsRecord::write_value(const char *value)
+{
+	write_value(std::string(value));
+}
+
+void MetricsRecord::write_value(const std::string &value)
+{
+	os << '"';
+	for (char c: value) {
+		switch (c) {
+		case '"':
+			os << "\\\"";
+			break;
+		case '\\':
+			os << "\\\\";
+			break;
+		case '\n':
+			os << "\\n";
+			break;
+		case '\t':
+			os << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+			}
+			else {
+				os << c;
+			}
+		}
+	}
+	os << '"';
+}
+
+void MetricsRecord::write_double(double value)
+{
+	if (!std::isfinite(value)) {
+		os << "null";
+		return;
+	}
+	os << std::setprecision(std::numeric_limits<double>::digits10) << value;
+}
+
+Metrics::Metrics(const std::string &filename) :
+	filename(filename)
+{
+	if (filename.empty()) {
+		return;
+	}
+
+	auto metrics_dir = boost::filesystem::path(filename).parent_path();
+	if (!metrics_dir.empty() && !boost::filesystem::exists(metrics_dir)) {
+		boost::filesystem::create_directories(metrics_dir);
+	}
+	f.open(filename, std::ios::out | std::ios::app);
+	if (!f) {
+		throw invalid_option("Cannot open metrics file " + filename);
+	}
+}
+
+void Metrics::write(const MetricsRecord &record)
+{
+	if (!enabled()) {
+		return;
+	}
+	f << record.str() << std::endl;
+	if (!f) {
+		throw exception("Error while writing into metrics file " + filename);
+	}
+}
+
+}  // namespace shark
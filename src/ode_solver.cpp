@@ -23,6 +23,7 @@
  * ODE Solver class implementation
  */
 
+#include <map>
 #include <sstream>
 
 #include "exceptions.h"
@@ -48,13 +49,13 @@ static int ode_gsl_evaluator(double t, const double y[], double f[], void *data)
 	}
 }
 
-ODESolver::ODESolver(ode_evaluator evaluator, size_t dimension, double precision, void *params)
+ODESolver::ODESolver(ode_evaluator evaluator, size_t dimension, double precision, void *params, const gsl_odeiv2_step_type *step_type)
 {
 	wrapped_params.evaluator = evaluator;
 	wrapped_params.user_params = params;
 	ode_system = std::unique_ptr<gsl_odeiv2_system>(new gsl_odeiv2_system{ode_gsl_evaluator, nullptr, dimension, &wrapped_params});
 	// "42" is a dummy hstart, we need something != 0
-	driver.reset(gsl_odeiv2_driver_alloc_y_new(ode_system.get(), gsl_odeiv2_step_rkck, 42, 0, precision));
+	driver.reset(gsl_odeiv2_driver_alloc_y_new(ode_system.get(), step_type, 42, 0, precision));
 }
 
 void ODESolver::evolve(std::vector<double> &y, double delta_t)
@@ -99,6 +100,23 @@ void ODESolver::evolve(std::vector<double> &y, double delta_t)
 	throw math_error(os.str());
 }
 
+const gsl_odeiv2_step_type *ODESolver::step_type(const std::string &name)
+{
+	static const std::map<std::string, const gsl_odeiv2_step_type *> step_types {
+		{"rk2", gsl_odeiv2_step_rk2},
+		{"rk4", gsl_odeiv2_step_rk4},
+		{"rkf45", gsl_odeiv2_step_rkf45},
+		{"rkck", gsl_odeiv2_step_rkck},
+		{"rk8pd", gsl_odeiv2_step_rk8pd},
+		{"msadams", gsl_odeiv2_step_msadams}
+	};
+	auto it = step_types.find(name);
+	if (it == step_types.end()) {
+		throw invalid_argument("Unsupported ODE stepping function: " + name);
+	}
+	return it->second;
+}
+
 std::size_t ODESolver::num_evaluations()
 {
 	return driver->n;
@@ -96,6 +96,16 @@ void Options::add(const std::string &optspec)
 	store_option(name, value);
 }
 
+Options::options_t Options::get_group(const std::string &group) const
+{
+	auto prefix = group + '.';
+	options_t group_options;
+	for (auto it = options.lower_bound(prefix); it != options.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+		group_options.insert(*it);
+	}
+	return group_options;
+}
+
 void Options::check_valid_name(const std::string &name)
 {
 	auto tokens = tokenize(name, ".");
@@ -337,6 +347,11 @@ std::vector<double> Options::get<std::vector<double>>(const std::string &name, c
 	return values;
 }
 
+template<>
+std::vector<std::string> Options::get<std::vector<std::string>>(const std::string &name, const std::string &value) const {
+	return tokenize(value, " ");
+}
+
 template<>
 std::set<int> Options::get<std::set<int>>(const std::string &name, const std::string &value) const {
 	return _read_ranges<std::set<int>>(name, value);
@@ -33,7 +33,6 @@
 
 namespace shark {
 
-static
 int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *data) {
 
 	/** Functions describing the time derivatives of:
@@ -29,27 +29,37 @@
 #include <memory>
 #include <numeric>
 #include <ostream>
+#include <string>
 #include <vector>
 
+#include "checkpoint.h"
 #include "components/algorithms.h"
+#include "config.h"
 #include "evolve_halos.h"
 #include "execution.h"
 #include "disk_instability.h"
 #include "environment.h"
+#include "exceptions.h"
 #include "galaxy_creator.h"
 #include "galaxy_mergers.h"
 #include "galaxy_writer.h"
+#include "git_revision.h"
 #include "logging.h"
 #include "merger_tree.h"
 #include "merger_tree_reader.h"
+#include "metrics.h"
 #include "omp_utils.h"
 #include "options.h"
 #include "physical_model.h"
 #include "shark_runner.h"
+#include "solver_samples.h"
 #include "subhalo.h"
 #include "timer.h"
 #include "total_baryon.h"
+#include "trace.h"
 #include "tree_builder.h"
+#include "tree_cache.h"
+#include "tree_cost.h"
 #include "utils.h"
 
 namespace shark {
@@ -93,6 +103,8 @@ struct evolution_times {
 	}
 };
 
+struct SnapshotStatistics;
+
 /// impl class definition
 class SharkRunner::impl {
 public:
@@ -107,19 +119,37 @@ public:
 	    simulation_params(options), star_formation_params(options),
 	    cosmology(make_cosmology(cosmo_params)),
 	    dark_matter_halos(make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
-	    writer(make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, AGNFeedbackParameters(options))),
+	    writer(make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, AGNFeedbackParameters(options), threads)),
 	    simulation(simulation_params, cosmology),
-	    star_formation(star_formation_params, recycling_params, cosmology)
+	    star_formation(star_formation_params, recycling_params, cosmology),
+	    metrics(exec_params.metrics_file),
+	    tree_cost_model(exec_params.tree_cost_model)
 	{
+		if (!exec_params.solver_samples_file.empty()) {
+			solver_sampler = std::unique_ptr<SolverSampler>(new SolverSampler(exec_params.solver_samples_file,
+			    exec_params.solver_samples_per_snapshot, exec_params.seed, BasicPhysicalModel::DIMENSION, threads));
+		}
 		create_per_thread_objects();
 	}
 
 	/// @see SharkRunner::run
 	void run();
 
+	/// @see SharkRunner::restart
+	void restart();
+
 	/// @see SharkRunner::report_total_times
 	void report_total_times();
 
+	std::vector<MergerTreePtr> import_trees();
+	std::unique_ptr<TreeImage> capture_trees(const std::vector<MergerTreePtr> &trees) const;
+	std::vector<MergerTreePtr> restore_trees(const TreeImage &image);
+	void evolve_trees(const std::vector<MergerTreePtr> &merger_trees);
+	void write_start_metrics(const std::string &mode);
+
+	/// @see SharkRunner::on_snapshot_evolved
+	SharkRunner::snapshot_callback snapshot_evolved;
+
 private:
 	Options options;
 	unsigned int threads;
@@ -141,11 +171,31 @@ private:
 	std::vector<PerThreadObjects> thread_objects;
 	TotalBaryon all_baryons;
 	Timer::duration evolution_time_total = 0;
+	Metrics metrics;
+	std::unique_ptr<SolverSampler> solver_sampler;
+	TreeCostModel tree_cost_model;
+	Timer execution_t;
+
+	// The timings of each tree of each partition, if recorded
+	std::vector<std::vector<tree_timing>> partition_tree_timings;
+
+	// All halos of a snapshot, in tree partition order, kept between snapshots
+	std::vector<HaloPtr> collected_halos;
+	int collected_halos_snapshot = -1;
 
 	void create_per_thread_objects();
-	std::vector<MergerTreePtr> import_trees();
-	void log_snapshot_statistics(int snapshot, const std::vector<HaloPtr> &halos, const Timer &t) const;
-	void evolve_merger_trees(const std::vector<std::vector<MergerTreePtr>> &all_trees, int snapshot);
+	std::vector<MergerTreePtr> build_trees(SURFSReader &reader);
+	std::unique_ptr<TreeCacheStream> open_tree_stream();
+	void evolve_streamed_trees();
+	void run_from_beginning();
+	void evolve_snapshots(const std::vector<MergerTreePtr> &merger_trees, int first_snapshot);
+	std::vector<double> estimate_tree_costs(const std::vector<MergerTreePtr> &merger_trees) const;
+	void save_tree_timings() const;
+	Checkpoint make_checkpoint(int snapshot) const;
+	void check_checkpoint_options() const;
+	SnapshotStatistics log_snapshot_statistics(int snapshot, const std::vector<HaloPtr> &halos, const Timer &t) const;
+	void write_trees_metrics(const std::string &source, const std::vector<MergerTreePtr> &trees, const Timer &t, const io_counters &io_start);
+	void evolve_merger_trees(const std::vector<MergerTreePtr> &trees, const std::vector<std::vector<MergerTreePtr>> &all_trees, int snapshot);
 	evolution_times evolve_merger_tree(const MergerTreePtr &tree, unsigned int thread_idx, int snapshot, double z, double delta_t);
 	molgas_per_galaxy get_molecular_gas(const std::vector<HaloPtr> &halos, double z, bool calc_j);
 	void add_to_total(const std::vector<evolution_times> &snapshot_evolution_times);
@@ -164,11 +214,21 @@ void SharkRunner::run()
 	pimpl->run();
 }
 
+void SharkRunner::restart()
+{
+	pimpl->restart();
+}
+
 void SharkRunner::report_total_times()
 {
 	pimpl->report_total_times();
 }
 
+void SharkRunner::on_snapshot_evolved(snapshot_callback callback)
+{
+	pimpl->snapshot_evolved = std::move(callback);
+}
+
 struct SnapshotStatistics {
 
 	int snapshot;
@@ -180,6 +240,7 @@ struct SnapshotStatistics {
 	std::size_t n_subhalos;
 	std::size_t n_galaxies;
 	Timer::duration duration_millis;
+	std::size_t rss;
 
 	double galaxy_ode_evaluations_per_galaxy() const {
 		if (n_galaxies == 0) {
@@ -226,7 +287,8 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const SnapshotStati
 	   << " (" << fixed<3>(stats.starburst_ode_evaluations_per_galaxy()) << " [evals/gal])" << "\n"
 	   << "  Star formation integration intervals: " << stats.starform_integration_intervals
 	   << " (" << fixed<3>(stats.starform_integration_intervals_per_galaxy_ode_evaluations()) << " [ints/eval])\n"
-	   << "  Time:                                 " << fixed<3>(stats.duration_millis / 1000.) << " [s]";
+	   << "  Time:                                 " << fixed<3>(stats.duration_millis / 1000.) << " [s]\n"
+	   << "  Memory usage:                         " << memory_amount(stats.rss);
 	return os;
 }
 
@@ -240,6 +302,52 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const evolution_tim
 	return os;
 }
 
+/// Converts @p duration into seconds, as written in metrics files
+static double seconds(Timer::duration duration)
+{
+	return double(duration) / 1e9;
+}
+
+void SharkRunner::impl::write_start_metrics(const std::string &mode)
+{
+	if (!metrics.enabled()) {
+		return;
+	}
+	MetricsRecord record("start");
+	record.add("mode", mode)
+	      .add("version", SHARK_VERSION)
+	      .add("git_sha1", git_sha1())
+	      .add("hostname", gethostname())
+	      .add("threads", threads)
+	      .add("seed", exec_params.seed)
+	      .add("simulation_batches", exec_params.simulation_batches)
+	      .add("min_snapshot", simulation_params.min_snapshot)
+	      .add("max_snapshot", simulation_params.max_snapshot)
+	      .add("output_directory", exec_params.output_directory)
+	      .add("name_model", exec_params.name_model);
+	metrics.write(record);
+}
+
+void SharkRunner::impl::write_trees_metrics(const std::string &source, const std::vector<MergerTreePtr> &trees, const Timer &t, const io_counters &io_start)
+{
+	if (!metrics.enabled()) {
+		return;
+	}
+	auto n_halos = std::accumulate(trees.begin(), trees.end(), std::size_t(0), [](std::size_t n_halos, const MergerTreePtr &tree) {
+		return n_halos + tree->get_halos().size();
+	});
+	auto io = current_io() - io_start;
+	MetricsRecord record("trees");
+	record.add("source", source)
+	      .add("time", seconds(t.get()))
+	      .add("trees", trees.size())
+	      .add("halos", n_halos)
+	      .add("rss", current_rss())
+	      .add("bytes_read", io.bytes_read)
+	      .add("bytes_written", io.bytes_written);
+	metrics.write(record);
+}
+
 void SharkRunner::impl::create_per_thread_objects()
 {
 	AGNFeedbackParameters agn_params(options);
@@ -262,24 +370,70 @@ void SharkRunner::impl::create_per_thread_objects()
 				recycling_params, gas_cooling_params, agn_params);
 		GalaxyMergers galaxy_mergers(merger_parameters, cosmology, cosmo_params, exec_params, agn_params, simulation_params, dark_matter_halos, physical_model, agnfeedback);
 		DiskInstability disk_instability(disk_instability_params, merger_parameters, simulation_params, dark_matter_halos, physical_model, agnfeedback);
+		if (solver_sampler) {
+			physical_model->set_sample_recorder(&solver_sampler->recorder(i));
+		}
 		thread_objects.emplace_back(std::move(physical_model), std::move(galaxy_mergers), std::move(disk_instability));
 	}
 }
 
+std::vector<MergerTreePtr> SharkRunner::impl::build_trees(SURFSReader &reader)
+{
+	HaloBasedTreeBuilder tree_builder(exec_params, threads);
+	auto halos = reader.read_halos(exec_params.simulation_batches);
+	return tree_builder.build_trees(halos, simulation_params, gas_cooling_params, dark_matter_halo_params, dark_matter_halos, cosmology, all_baryons);
+}
+
 std::vector<MergerTreePtr> SharkRunner::impl::import_trees()
 {
+	TraceSpan span("import_trees");
 	Timer t;
+	auto io_start = current_io();
 	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
-	HaloBasedTreeBuilder tree_builder(exec_params, threads);
-	auto halos = reader.read_halos(exec_params.simulation_batches);
-	auto trees = tree_builder.build_trees(halos, simulation_params, gas_cooling_params, dark_matter_halo_params, dark_matter_halos, cosmology, all_baryons);
+
+	// Fully-built trees might be cached already from a previous execution
+	std::unique_ptr<TreeCache> tree_cache;
+	if (!exec_params.tree_cache_dir.empty()) {
+		tree_cache.reset(new TreeCache(exec_params.tree_cache_dir, options, exec_params, reader.get_filenames(exec_params.simulation_batches)));
+	}
+
+	std::vector<MergerTreePtr> trees;
+	std::string source = "cache";
+	if (!tree_cache || !tree_cache->load(trees, all_baryons)) {
+		trees = build_trees(reader);
+		source = "build";
+
+		// A failure to cache the trees is not fatal
+		if (tree_cache) {
+			try {
+				tree_cache->store(trees, all_baryons);
+			} catch (const std::exception &e) {
+				LOG(warning) << "Error while storing merger trees in tree cache: " << e.what();
+			}
+		}
+	}
 	LOG(info) << trees.size() << " Merger trees imported in " << t;
+	write_trees_metrics(source, trees, t, io_start);
+	return trees;
+}
 
-	// Create the first generation of galaxies if halo is first appearing
-	LOG(info) << "Creating initial galaxies in central subhalos across all merger trees";
-	GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params);
-	galaxy_creator.create_galaxies(trees, all_baryons);
+std::unique_ptr<TreeImage> SharkRunner::impl::capture_trees(const std::vector<MergerTreePtr> &trees) const
+{
+	TraceSpan span("capture_trees");
+	Timer t;
+	std::unique_ptr<TreeImage> image(new TreeImage(trees, all_baryons));
+	LOG(info) << "Captured an image of " << trees.size() << " merger trees (" << memory_amount(image->size()) << ") in " << t;
+	return image;
+}
 
+std::vector<MergerTreePtr> SharkRunner::impl::restore_trees(const TreeImage &image)
+{
+	TraceSpan span("restore_trees");
+	Timer t;
+	auto io_start = current_io();
+	auto trees = image.restore(all_baryons);
+	LOG(info) << trees.size() << " Merger trees restored in " << t;
+	write_trees_metrics("image", trees, t, io_start);
 	return trees;
 }
 
@@ -330,6 +484,7 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 	auto &galaxy_mergers = objs.galaxy_mergers;
 	auto &disk_instability = objs.disk_instability;
 
+	TraceSpan span("evolve_merger_tree", tree->id);
 	evolution_times times;
 
 	/*here loop over the halos this merger tree has at this time.*/
@@ -372,10 +527,17 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 		times.subhalos_mergers += t4.get();
 	}
 
+	// Histories are recorded once all of this tree's halos are evolved
+	if (exec_params.output_sf_histories) {
+		for(auto &halo: tree->halos_at(snapshot)) {
+			record_galaxy_histories(*halo, snapshot);
+		}
+	}
+
 	return times;
 }
 
-void SharkRunner::impl::log_snapshot_statistics(int snapshot, const std::vector<HaloPtr> &halos, const Timer &t) const
+SnapshotStatistics SharkRunner::impl::log_snapshot_statistics(int snapshot, const std::vector<HaloPtr> &halos, const Timer &t) const
 {
 	auto duration_millis = t.get() / 1000 / 1000;
 
@@ -398,8 +560,9 @@ void SharkRunner::impl::log_snapshot_statistics(int snapshot, const std::vector<
 	});
 
 	SnapshotStatistics stats {snapshot, threads, starform_integration_intervals, galaxy_ode_evaluations, starburst_ode_evaluations,
-							  n_halos, n_subhalos, n_galaxies, duration_millis};
+							  n_halos, n_subhalos, n_galaxies, duration_millis, current_rss()};
 	LOG(info) << "Statistics for snapshot " << snapshot << "\n" << stats;
+	return stats;
 }
 
 std::vector<HaloPtr> all_halos_at_snapshot(const std::vector<std::vector<MergerTreePtr>> &all_trees, int snapshot)
@@ -414,13 +577,37 @@ std::vector<HaloPtr> all_halos_at_snapshot(const std::vector<std::vector<MergerT
 	return halos_at_snapshot;
 }
 
-void SharkRunner::impl::evolve_merger_trees(const std::vector<std::vector<MergerTreePtr>> &all_trees, int snapshot)
+/// Splits @p halos, collected with all_halos_at_snapshot, into the halos of each tree partition
+static std::vector<halo_range> partition_halos(const std::vector<std::vector<MergerTreePtr>> &all_trees, const std::vector<HaloPtr> &halos, int snapshot)
+{
+	std::vector<halo_range> halo_groups;
+	halo_groups.reserve(all_trees.size());
+	auto first = halos.begin();
+	for (auto &merger_trees: all_trees) {
+		std::size_t n_halos = 0;
+		for (auto &tree: merger_trees) {
+			auto tree_halos = tree->halos_at(snapshot);
+			n_halos += std::distance(tree_halos.begin(), tree_halos.end());
+		}
+		halo_groups.emplace_back(first, first + n_halos);
+		first += n_halos;
+	}
+	assert(first == halos.end());
+	return halo_groups;
+}
+
+void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &trees, const std::vector<std::vector<MergerTreePtr>> &all_trees, int snapshot)
 {
+	TraceSpan span("evolve_snapshot", snapshot);
 	Timer snapshot_evolution_t;
+	auto io_start = current_io();
 
 	for(auto &o: thread_objects) {
 		o.physical_model->reset_ode_evaluations();
 	}
+	if (solver_sampler) {
+		solver_sampler->start_snapshot(snapshot);
+	}
 
 	// Calculate the initial and final time for the evolution start at this snapshot.
 	auto z = simulation_params.redshifts[snapshot];
@@ -434,59 +621,159 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<std::vector<Merger
 	os << ". Redshift: " << z << " -> " << z_end << ", time: " << ti << " -> " << tf;
 	LOG(info) << os.str();
 
+	TraceSpan evolution_span("evolve_galaxies");
 	Timer evolution_t;
 	std::vector<evolution_times> times(threads);
-	omp_static_for(all_trees, threads, [&](const std::vector<MergerTreePtr> &merger_trees, unsigned int thread_idx) {
-		for (auto &tree: merger_trees) {
-			times[thread_idx] += evolve_merger_tree(tree, thread_idx, snapshot, simulation_params.redshifts[snapshot], delta_t);
+	std::vector<Timer::duration> busy_times(threads);
+	omp_static_for(0, all_trees.size(), threads, [&](std::size_t partition, unsigned int thread_idx) {
+		TraceSpan partition_span("evolve_partition", thread_idx);
+		Timer busy_t;
+		auto &merger_trees = all_trees[partition];
+		for (std::size_t i = 0; i != merger_trees.size(); i++) {
+			Timer tree_t;
+			times[thread_idx] += evolve_merger_tree(merger_trees[i], thread_idx, snapshot, simulation_params.redshifts[snapshot], delta_t);
+			if (!partition_tree_timings.empty()) {
+				partition_tree_timings[partition][i].seconds += seconds(tree_t.get());
+			}
 		}
+		busy_times[thread_idx] += busy_t.get();
 	});
 	auto evolution_duration = evolution_t.get();
+	evolution_span.finish();
 	evolution_time_total += evolution_duration;
 	LOG(info) << "Evolved galaxies in " << ns_time(evolution_duration);
 	LOG(info) << "Detailed times: " << sum(times);
 	add_to_total(times);
+	if (solver_sampler) {
+		solver_sampler->write_snapshot();
+	}
 
-	// Collect this snapshot's halos across all merger trees
-	auto all_halos_this_snapshot = all_halos_at_snapshot(all_trees, snapshot);
+	// Collect this snapshot's halos across all merger trees,
+	// unless they were already collected by the previous snapshot
+	std::vector<HaloPtr> all_halos_this_snapshot;
+	if (collected_halos_snapshot == snapshot) {
+		all_halos_this_snapshot = std::move(collected_halos);
+	}
+	else {
+		all_halos_this_snapshot = all_halos_at_snapshot(all_trees, snapshot);
+	}
 
 	bool write_galaxies = exec_params.output_snapshot(snapshot + 1);
 
+	TraceSpan molgas_span("molecular_gas");
 	Timer molgas_t;
 	auto molgas_per_gal = get_molecular_gas(all_halos_this_snapshot, z, write_galaxies);
-	LOG(info) << "Calculated molecular gas in " << molgas_t;
+	auto molgas_duration = molgas_t.get();
+	molgas_span.finish();
+	LOG(info) << "Calculated molecular gas in " << ns_time(molgas_duration);
 
 	/*track all baryons of this snapshot*/
+	TraceSpan tracking_span("track_baryons");
 	Timer tracking_t;
-	track_total_baryons(*cosmology, exec_params, simulation_params, all_halos_this_snapshot, all_baryons, snapshot, molgas_per_gal, delta_t);
-	LOG(info) << "Total baryon amounts tracked in " << tracking_t;
+	track_total_baryons(*cosmology, simulation_params, trees, all_baryons, snapshot, molgas_per_gal, delta_t, threads);
+	auto tracking_duration = tracking_t.get();
+	tracking_span.finish();
+	LOG(info) << "Total baryon amounts tracked in " << ns_time(tracking_duration);
 
-	log_snapshot_statistics(snapshot, all_halos_this_snapshot, snapshot_evolution_t);
+	auto stats = log_snapshot_statistics(snapshot, all_halos_this_snapshot, snapshot_evolution_t);
 
 	/*transfer galaxies from this halo->subhalos to the next snapshot's halo->subhalos*/
 	LOG(debug) << "Transferring all galaxies for snapshot " << snapshot << " into next snapshot";
-	transfer_galaxies_to_next_snapshot(all_halos_this_snapshot, snapshot, all_baryons);
+	TraceSpan transfer_span("transfer_galaxies");
+	Timer transfer_t;
+	transfer_galaxies_to_next_snapshot(trees, partition_halos(all_trees, all_halos_this_snapshot, snapshot), snapshot, all_baryons, threads);
 
 	// Collect next snapshot's halos across all merger trees
-	// We keep them sorted so when output files are created the order in which
-	// information appears is the same regardless of how many threads were used
 	auto all_halos_next_snapshot = all_halos_at_snapshot(all_trees, snapshot + 1);
-	sort_by_id(all_halos_next_snapshot);
+	auto transfer_duration = transfer_t.get();
+	transfer_span.finish();
 
+	TraceSpan write_span("write_galaxies");
+	Timer write_t;
 	if (write_galaxies)
 	{
+		// We sort them so when output files are created the order in which
+		// information appears is the same regardless of how many threads were used
+		auto sorted_halos = all_halos_next_snapshot;
+		sort_by_id(sorted_halos);
+
 		// Note that the output is being done at "snapshot + 1". This is because
 		// we don't evolve galaxies AT snapshot "i" but FROM snapshot "i" TO
 		// snapshot "i+1", and therefore at this point in time (after the actual
 		// evolution) we consider our galaxies to be at snapshot "i+1"
 		LOG(info) << "Write output files for evolution from snapshot " << snapshot << " to " << snapshot + 1;
-		writer->write(snapshot + 1, all_halos_next_snapshot, all_baryons, molgas_per_gal);
+		writer->write(snapshot + 1, sorted_halos, all_baryons, molgas_per_gal);
 	}
+	auto write_duration = write_t.get();
+	write_span.finish();
 
 	/*reset instantaneous galaxy properties to 0 to initiate calculation at subsequent snapshot*/
 	LOG(debug) << "Reseting all instantaneous galaxy properties to 0 at snapshot " << snapshot;
-	reset_instantaneous_galaxy_properties(all_halos_next_snapshot, snapshot);
+	TraceSpan reset_span("reset_galaxies");
+	Timer reset_t;
+	reset_instantaneous_galaxy_properties(all_halos_next_snapshot, snapshot, threads);
+	auto reset_duration = reset_t.get();
+	reset_span.finish();
+
+	// These are this snapshot's halos when evolving the next one
+	collected_halos = std::move(all_halos_next_snapshot);
+	collected_halos_snapshot = snapshot + 1;
+
+	// Halos and subhalos of this snapshot are not needed anymore
+	Timer::duration release_duration = 0;
+	if (exec_params.release_past_snapshots) {
+		TraceSpan release_span("release_halos");
+		Timer release_t;
+		all_halos_this_snapshot.clear();
+		omp_static_for(all_trees, threads, [&](const std::vector<MergerTreePtr> &merger_trees, unsigned int thread_idx) {
+			for (auto &tree: merger_trees) {
+				tree->release_halos(snapshot);
+			}
+		});
+		release_duration = release_t.get();
+		LOG(info) << "Released halos of snapshot " << snapshot << " in " << ns_time(release_duration) << ", memory usage is now " << memory_amount(current_rss());
+	}
 
+	if (metrics.enabled()) {
+		auto total_times = sum(times);
+		std::vector<double> thread_busy, thread_idle;
+		for (auto busy_time: busy_times) {
+			thread_busy.push_back(seconds(busy_time));
+			thread_idle.push_back(seconds(evolution_duration - busy_time));
+		}
+		auto io = current_io() - io_start;
+		MetricsRecord record("snapshot");
+		record.add("snapshot", snapshot)
+		      .add("redshift", z)
+		      .add("halos", stats.n_halos)
+		      .add("subhalos", stats.n_subhalos)
+		      .add("galaxies", stats.n_galaxies)
+		      .add("time", seconds(snapshot_evolution_t.get()))
+		      .add("evolution_time", seconds(evolution_duration))
+		      .add("galaxy_mergers_time", seconds(total_times.galaxy_mergers))
+		      .add("disk_instability_time", seconds(total_times.disk_instability_evaluation))
+		      .add("galaxy_evolution_time", seconds(total_times.galaxy_evolution))
+		      .add("subhalos_mergers_time", seconds(total_times.subhalos_mergers))
+		      .add("molgas_time", seconds(molgas_duration))
+		      .add("tracking_time", seconds(tracking_duration))
+		      .add("transfer_time", seconds(transfer_duration))
+		      .add("write_time", seconds(write_duration))
+		      .add("reset_time", seconds(reset_duration))
+		      .add("release_time", seconds(release_duration))
+		      .add("thread_busy_time", thread_busy)
+		      .add("thread_idle_time", thread_idle)
+		      .add("galaxy_ode_evaluations", stats.galaxy_ode_evaluations)
+		      .add("starburst_ode_evaluations", stats.starburst_ode_evaluations)
+		      .add("starform_integration_intervals", stats.starform_integration_intervals)
+		      .add("rss", current_rss())
+		      .add("bytes_read", io.bytes_read)
+		      .add("bytes_written", io.bytes_written);
+		metrics.write(record);
+	}
+
+	if (snapshot_evolved) {
+		snapshot_evolved(snapshot, all_baryons);
+	}
 }
 
 void SharkRunner::impl::report_total_times()
@@ -497,58 +784,339 @@ void SharkRunner::impl::report_total_times()
 	}
 	LOG(info) << "Total evolution times, combined: " << sum(total_evolution_times);
 	LOG(info) << "Total evolution walltime: " << ns_time(evolution_time_total);
+
+	if (metrics.enabled()) {
+		auto total_times = sum(total_evolution_times);
+		MetricsRecord record("end");
+		record.add("time", seconds(execution_t.get()))
+		      .add("evolution_time", seconds(evolution_time_total))
+		      .add("galaxy_mergers_time", seconds(total_times.galaxy_mergers))
+		      .add("disk_instability_time", seconds(total_times.disk_instability_evaluation))
+		      .add("galaxy_evolution_time", seconds(total_times.galaxy_evolution))
+		      .add("subhalos_mergers_time", seconds(total_times.subhalos_mergers))
+		      .add("peak_rss", peak_rss());
+		metrics.write(record);
+	}
 }
 
-/// Produce similarly-weighted partitions of merger trees based on galaxy count
-static std::vector<std::vector<MergerTreePtr>> partition_trees(std::vector<MergerTreePtr> &trees, unsigned int n_partitions)
+/// Produce similarly-weighted partitions of merger trees based on their estimated costs
+static std::vector<std::vector<MergerTreePtr>> partition_trees(const std::vector<MergerTreePtr> &trees, const std::vector<double> &tree_costs, unsigned int n_partitions)
 {
 	Timer partitioning_t;
 
-	// Small structure to cache the result from tree->galaxy_count()
-	struct tree_and_count {
-		tree_and_count(MergerTreePtr &tree)
-		    : tree(tree), galaxy_count(tree->galaxy_count())
+	struct tree_and_cost {
+		tree_and_cost(const MergerTreePtr &tree, double cost)
+		    : tree(tree), cost(cost)
 		{
 		}
 		MergerTreePtr tree;
-		size_t galaxy_count;
+		double cost;
 	};
 
-	// Sort merger trees by galaxy count
-	std::vector<tree_and_count> trees_and_counts(trees.begin(), trees.end());
-	sort(trees_and_counts.begin(), trees_and_counts.end(), [](const tree_and_count &lhs, const tree_and_count &rhs) {
-		return lhs.galaxy_count > rhs.galaxy_count;
+	// Sort merger trees by cost
+	std::vector<tree_and_cost> trees_and_costs;
+	trees_and_costs.reserve(trees.size());
+	for (std::size_t i = 0; i != trees.size(); i++) {
+		trees_and_costs.emplace_back(trees[i], tree_costs[i]);
+	}
+	sort(trees_and_costs.begin(), trees_and_costs.end(), [](const tree_and_cost &lhs, const tree_and_cost &rhs) {
+		return lhs.cost > rhs.cost;
 	});
 
 	// simple greedy partitioning
 	std::vector<std::vector<MergerTreePtr>> partitions(n_partitions);
-	std::vector<size_t> galaxy_counts(n_partitions);
-	for (auto &tree_and_count: trees_and_counts) {
-		auto distance = std::distance(galaxy_counts.begin(), std::min_element(galaxy_counts.begin(), galaxy_counts.end()));
+	std::vector<double> costs(n_partitions);
+	for (auto &tree_and_cost: trees_and_costs) {
+		auto distance = std::distance(costs.begin(), std::min_element(costs.begin(), costs.end()));
 		assert(distance >= 0);
 		auto target = size_t(distance);
-		partitions[target].push_back(tree_and_count.tree);
-		galaxy_counts[target] += tree_and_count.galaxy_count;
+		partitions[target].push_back(tree_and_cost.tree);
+		costs[target] += tree_and_cost.cost;
 	}
 
 	LOG(info) << "Created tree partitions in " << partitioning_t;
 	return partitions;
 }
 
-void SharkRunner::impl::run() {
+std::unique_ptr<TreeCacheStream> SharkRunner::impl::open_tree_stream()
+{
+	if (exec_params.tree_cache_dir.empty()) {
+		throw invalid_option("execution.stream_snapshots requires execution.tree_cache_dir to be set");
+	}
 
-	std::vector<MergerTreePtr> merger_trees = import_trees();
-	auto tree_partitions = partition_trees(merger_trees, threads);
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
+	TreeCache tree_cache(exec_params.tree_cache_dir, options, exec_params, reader.get_filenames(exec_params.simulation_batches));
+	auto stream = tree_cache.open_stream(all_baryons);
+	if (stream) {
+		return stream;
+	}
+
+	// Trees can only be built out of the full history of all halos,
+	// so they need to be built and cached once before they can be streamed
+	LOG(warning) << "Merger trees need to be built fully in memory before they can be streamed";
+	{
+		auto trees = build_trees(reader);
+		tree_cache.store(trees, all_baryons);
+		for (auto &tree: trees) {
+			tree->release_halos(simulation_params.max_snapshot);
+		}
+	}
+	stream = tree_cache.open_stream(all_baryons);
+	if (!stream) {
+		throw exception("Merger trees could not be streamed from " + tree_cache.get_filename());
+	}
+	return stream;
+}
+
+void SharkRunner::impl::evolve_streamed_trees()
+{
+	auto stream = open_tree_stream();
+	auto min_snapshot = simulation_params.min_snapshot;
+	auto max_snapshot = simulation_params.max_snapshot;
+	if (tree_cost_model.enabled() || !exec_params.tree_timings_file.empty()) {
+		LOG(warning) << "Tree cost models and timings are not supported with execution.stream_snapshots, ignoring them";
+	}
+	auto first_halos = stream->count_first_halos(min_snapshot, max_snapshot - 1);
+	auto tree_partitions = partition_trees(stream->get_trees(), std::vector<double>(first_halos.begin(), first_halos.end()), threads);
+
+	// Galaxies of each snapshot are created before the previous one is evolved,
+	// as if all of them were created upfront
+	GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params);
+	stream->load_snapshot(min_snapshot);
+	galaxy_creator.create_galaxies(stream->first_halos(min_snapshot), min_snapshot, all_baryons);
+	for(int snapshot = min_snapshot; snapshot <= max_snapshot - 1; snapshot++) {
+		if (snapshot + 1 <= max_snapshot - 1) {
+			stream->load_snapshot(snapshot + 1);
+			galaxy_creator.create_galaxies(stream->first_halos(snapshot + 1), snapshot + 1, all_baryons);
+		}
+		evolve_merger_trees(stream->get_trees(), tree_partitions, snapshot);
+		stream->forget_snapshots(snapshot);
+	}
+}
+
+Checkpoint SharkRunner::impl::make_checkpoint(int snapshot) const
+{
+	return Checkpoint(writer->get_output_directory_name(snapshot) + "/checkpoint.bin", options, exec_params);
+}
+
+std::vector<double> SharkRunner::impl::estimate_tree_costs(const std::vector<MergerTreePtr> &merger_trees) const
+{
+	std::vector<double> tree_costs;
+	tree_costs.reserve(merger_trees.size());
+	for (auto &tree: merger_trees) {
+		if (tree_cost_model.enabled()) {
+			tree_costs.push_back(tree_cost_model.predict(get_tree_features(*tree)));
+		}
+		else {
+			tree_costs.push_back(double(tree->galaxy_count()));
+		}
+	}
+	return tree_costs;
+}
+
+void SharkRunner::impl::save_tree_timings() const
+{
+	tree_timings timings;
+	timings.subvolumes = exec_params.simulation_batches;
+	for (auto &partition_timings: partition_tree_timings) {
+		timings.trees.insert(timings.trees.end(), partition_timings.begin(), partition_timings.end());
+	}
+	std::sort(timings.trees.begin(), timings.trees.end(), [](const tree_timing &lhs, const tree_timing &rhs) {
+		return lhs.tree_id < rhs.tree_id;
+	});
+	write_tree_timings(exec_params.tree_timings_file, timings);
+	LOG(info) << "Timings of " << timings.trees.size() << " merger trees written into " << exec_params.tree_timings_file;
+}
+
+void SharkRunner::impl::evolve_snapshots(const std::vector<MergerTreePtr> &merger_trees, int first_snapshot)
+{
+	// Trees are weighted by their predicted cost if a tree cost model is given,
+	// and by their initial galaxy count otherwise. Partitions don't change
+	// results, since global quantities are added up in merger tree order
+	auto tree_partitions = partition_trees(merger_trees, estimate_tree_costs(merger_trees), threads);
+
+	// Features are taken now, before any halos are released
+	partition_tree_timings.clear();
+	if (!exec_params.tree_timings_file.empty()) {
+		for (auto &partition: tree_partitions) {
+			std::vector<tree_timing> partition_timings;
+			partition_timings.reserve(partition.size());
+			for (auto &tree: partition) {
+				partition_timings.push_back({tree->id, get_tree_features(*tree), 0});
+			}
+			partition_tree_timings.emplace_back(std::move(partition_timings));
+		}
+	}
 
 	// Go, go, go!
 	// Note that we evolve galaxies in merger tress in the snapshot range [min, max)
 	// This is because at snapshot "i" we don't evolve galaxies AT snapshot "i",
 	// but rather FROM snapshot "i" TO snapshot "i+1".
-	for(int snapshot = simulation_params.min_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
-		evolve_merger_trees(tree_partitions, snapshot);
+	for(int snapshot = first_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
+		evolve_merger_trees(merger_trees, tree_partitions, snapshot);
+
+		// Like outputs, checkpoints are taken at "snapshot + 1".
+		// A failure to save a checkpoint is not fatal
+		if (exec_params.checkpoint_snapshot(snapshot + 1)) {
+			try {
+				TraceSpan checkpoint_span("save_checkpoint", snapshot + 1);
+				Timer checkpoint_t;
+				make_checkpoint(snapshot + 1).save(snapshot + 1, merger_trees, all_baryons, threads);
+				if (metrics.enabled()) {
+					MetricsRecord record("checkpoint");
+					record.add("snapshot", snapshot + 1).add("time", seconds(checkpoint_t.get()));
+					metrics.write(record);
+				}
+			} catch (const std::exception &e) {
+				LOG(warning) << "Error while saving checkpoint at snapshot " << snapshot + 1 << ": " << e.what();
+			}
+		}
+	}
+
+	if (!partition_tree_timings.empty()) {
+		save_tree_timings();
+	}
+}
+
+void SharkRunner::impl::evolve_trees(const std::vector<MergerTreePtr> &merger_trees)
+{
+	// Create the first generation of galaxies if halo is first appearing
+	LOG(info) << "Creating initial galaxies in central subhalos across all merger trees";
+	{
+		TraceSpan span("create_galaxies");
+		GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params);
+		galaxy_creator.create_galaxies(merger_trees, all_baryons);
 	}
 
+	evolve_snapshots(merger_trees, simulation_params.min_snapshot);
+}
+
+void SharkRunner::impl::check_checkpoint_options() const
+{
+	if (exec_params.stream_snapshots && !exec_params.checkpoint_snapshots.empty()) {
+		throw invalid_option("execution.checkpoint_snapshots cannot be used together with execution.stream_snapshots");
+	}
+}
+
+void SharkRunner::impl::restart()
+{
+	check_checkpoint_options();
+	write_start_metrics("restart");
+
+	// Resume from the latest checkpoint found
+	for (auto it = exec_params.checkpoint_snapshots.rbegin(); it != exec_params.checkpoint_snapshots.rend(); it++) {
+		auto snapshot = *it;
+		if (snapshot < simulation_params.min_snapshot || snapshot > simulation_params.max_snapshot) {
+			continue;
+		}
+		TraceSpan checkpoint_span("load_checkpoint", snapshot);
+		Timer t;
+		auto io_start = current_io();
+		std::vector<MergerTreePtr> trees;
+		bool loaded = make_checkpoint(snapshot).load(snapshot, trees, all_baryons, threads);
+		checkpoint_span.finish();
+		if (loaded) {
+			LOG(info) << "Restarting evolution from snapshot " << snapshot;
+			write_trees_metrics("checkpoint", trees, t, io_start);
+			evolve_snapshots(trees, snapshot);
+			report_total_times();
+			return;
+		}
+	}
+
+	LOG(warning) << "No checkpoint found to restart from, running from the beginning";
+	run_from_beginning();
+}
+
+void SharkRunner::impl::run() {
+	write_start_metrics("run");
+	run_from_beginning();
+}
+
+void SharkRunner::impl::run_from_beginning()
+{
+	check_checkpoint_options();
+	if (!exec_params.checkpoint_snapshots.empty() && options.get_group("execution").count("execution.seed") == 0) {
+		LOG(warning) << "Checkpoints are taken without an explicit seed. To restart from them "
+		             << "execution.seed=" << exec_params.seed << " must be given";
+	}
+
+	if (exec_params.stream_snapshots) {
+		evolve_streamed_trees();
+	}
+	else {
+		evolve_trees(import_trees());
+	}
 	report_total_times();
 }
 
+/// Options used to build merger trees, which cannot be changed per model
+static bool is_tree_building_option(const std::string &name)
+{
+	for (auto &group: {"cosmology.", "dark_matter_halo.", "simulation."}) {
+		if (name.compare(0, std::char_traits<char>::length(group), group) == 0) {
+			return true;
+		}
+	}
+	for (auto &option: {"execution.seed", "execution.simulation_batches", "execution.output_snapshots",
+	                    "execution.skip_missing_descendants", "execution.ensure_mass_growth",
+	                    "execution.ignore_late_massive_halos", "execution.ignore_npart_threshold",
+	                    "execution.ignore_below_z", "execution.tree_cache_dir", "execution.tree_cache_checksums",
+	                    "execution.stream_snapshots"}) {
+		if (name == option) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void SharkRunner::run_models(const Options &options, const std::vector<std::vector<std::string>> &model_options, unsigned int threads)
+{
+	ExecutionParameters exec_params(options);
+	if (exec_params.stream_snapshots) {
+		throw invalid_option("execution.stream_snapshots cannot be used when running several models");
+	}
+
+	// All models need to use the seed the trees were built with
+	Options base_options(options);
+	base_options.add("execution.seed=" + std::to_string(exec_params.seed));
+
+	std::vector<Options> all_options;
+	for (std::size_t i = 0; i != model_options.size(); i++) {
+		Options model(base_options);
+		model.add("execution.output_directory=" + exec_params.output_directory + "/" + std::to_string(i));
+		for (auto &optspec: model_options[i]) {
+			std::string name, value;
+			Options::parse_option(optspec, name, value);
+			if (is_tree_building_option(name)) {
+				throw invalid_option("Option " + name + " is used to build merger trees and cannot be changed for model " + std::to_string(i));
+			}
+			model.add(optspec);
+		}
+		all_options.emplace_back(std::move(model));
+	}
+
+	// Trees are imported by the first model, which captures an image of them
+	// before creating any galaxy. The rest restore their trees from it
+	Timer t;
+	std::unique_ptr<TreeImage> image;
+	for (std::size_t i = 0; i != all_options.size(); i++) {
+		Timer model_t;
+		LOG(info) << "Running model " << i << " of " << all_options.size();
+		impl model(all_options[i], threads);
+		model.write_start_metrics("model");
+		if (!image) {
+			auto trees = model.import_trees();
+			image = model.capture_trees(trees);
+			model.evolve_trees(trees);
+		}
+		else {
+			model.evolve_trees(model.restore_trees(*image));
+		}
+		model.report_total_times();
+		LOG(info) << "Model " << i << " finished in " << model_t;
+	}
+	LOG(info) << all_options.size() << " models finished in " << t;
+}
+
 } // namespace shark
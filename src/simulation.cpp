@@ -36,6 +36,21 @@
 
 namespace shark {
 
+template <>
+SimulationParameters::tree_files_format_t
+Options::get<SimulationParameters::tree_files_format_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "hdf5") {
+		return SimulationParameters::SURFS_HDF5;
+	}
+	else if (lvalue == "columnar") {
+		return SimulationParameters::SURFS_COLUMNAR;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are hdf5 and columnar";
+	throw invalid_option(os.str());
+}
+
 SimulationParameters::SimulationParameters(const Options &options)
 {
 
@@ -49,6 +64,7 @@ SimulationParameters::SimulationParameters(const Options &options)
 	options.load("simulation.max_snapshot", max_snapshot, true);
 	options.load("simulation.sim_name", sim_name);
 	options.load("simulation.tree_files_prefix", tree_files_prefix, true);
+	options.load("simulation.tree_files_format", tree_files_format);
 	options.load("simulation.redshift_file",redshift_file, true);
 	options.load("simulation.hydrorun", hydrorun, false);
 
@@ -0,0 +1,214 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Solver samples implementation
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "solver_samples.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace {
+
+// Solver samples files start with a header, followed by one record per
+// sampled solution. Each record is a solver_sample_record followed by the
+// initial and final values of the ODE system (header.dimension values each).
+//
+// Records contain a BlackHole as it is in memory, so any change to it
+// requires increasing VERSION.
+//
+constexpr char MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'S', 'S', 'F'};
+constexpr std::uint32_t VERSION = 1;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct solver_samples_header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order_mark;
+	std::uint32_t dimension;
+	std::uint32_t seed;
+};
+
+static_assert(std::is_trivially_copyable<solver_samples_header>::value, "invalid solver_samples_header layout");
+static_assert(std::is_trivially_copyable<solver_sample_record>::value, "invalid solver_sample_record layout");
+
+/// Orders samples by key, breaking ties deterministically
+bool sample_less(const solver_sample &s1, const solver_sample &s2)
+{
+	if (s1.key != s2.key) {
+		return s1.key < s2.key;
+	}
+	if (s1.record.galaxy_id != s2.record.galaxy_id) {
+		return s1.record.galaxy_id < s2.record.galaxy_id;
+	}
+	return s1.initial_values < s2.initial_values;
+}
+
+}  // anonymous namespace
+
+SolverSampleRecorder::SolverSampleRecorder(std::uint32_t seed, std::size_t max_samples) :
+	seed(seed), max_samples(max_samples)
+{
+}
+
+void SolverSampleRecorder::start_snapshot(int snapshot)
+{
+	this->snapshot = snapshot;
+	samples.clear();
+}
+
+bool SolverSampleRecorder::should_sample(Galaxy::id_t galaxy_id, bool burst, std::uint64_t &key) const
+{
+	if (max_samples == 0) {
+		return false;
+	}
+	std::int64_t values[] = {seed, snapshot, galaxy_id, burst ? 1 : 0};
+	hasher h;
+	h.update(values, sizeof(values));
+	key = h.digest();
+	return samples.size() < max_samples || key <= samples.front().key;
+}
+
+void SolverSampleRecorder::add(solver_sample &&sample)
+{
+	sample.record.snapshot = snapshot;
+	if (samples.size() < max_samples) {
+		samples.emplace_back(std::move(sample));
+		std::push_heap(samples.begin(), samples.end(), sample_less);
+		return;
+	}
+	if (!sample_less(sample, samples.front())) {
+		return;
+	}
+	std::pop_heap(samples.begin(), samples.end(), sample_less);
+	samples.back() = std::move(sample);
+	std::push_heap(samples.begin(), samples.end(), sample_less);
+}
+
+SolverSampler::SolverSampler(const std::string &filename, std::size_t samples_per_snapshot, std::uint32_t seed, std::uint32_t dimension, unsigned int threads) :
+	filename(filename),
+	samples_per_snapshot(samples_per_snapshot),
+	dimension(dimension)
+{
+	for (unsigned int i = 0; i != threads; i++) {
+		recorders.emplace_back(seed, samples_per_snapshot);
+	}
+
+	auto samples_dir = boost::filesystem::path(filename).parent_path();
+	if (!samples_dir.empty() && !boost::filesystem::exists(samples_dir)) {
+		boost::filesystem::create_directories(samples_dir);
+	}
+	f.open(filename, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		throw invalid_option("Cannot open solver samples file " + filename);
+	}
+
+	solver_samples_header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byte_order_mark = BYTE_ORDER_MARK;
+	header.dimension = dimension;
+	header.seed = seed;
+	f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void SolverSampler::start_snapshot(int snapshot)
+{
+	for (auto &recorder: recorders) {
+		recorder.start_snapshot(snapshot);
+	}
+}
+
+void SolverSampler::write_snapshot()
+{
+	std::vector<solver_sample> samples;
+	for (auto &recorder: recorders) {
+		auto &recorder_samples = recorder.get_samples();
+		std::move(recorder_samples.begin(), recorder_samples.end(), std::back_inserter(samples));
+		recorder_samples.clear();
+	}
+	std::sort(samples.begin(), samples.end(), sample_less);
+	if (samples.size() > samples_per_snapshot) {
+		samples.erase(samples.begin() + samples_per_snapshot, samples.end());
+	}
+
+	for (auto &sample: samples) {
+		if (sample.initial_values.size() != dimension || sample.final_values.size() != dimension) {
+			throw exception("Sampled ODE solution has an unexpected dimension");
+		}
+		f.write(reinterpret_cast<const char *>(&sample.record), sizeof(sample.record));
+		f.write(reinterpret_cast<const char *>(sample.initial_values.data()), dimension * sizeof(double));
+		f.write(reinterpret_cast<const char *>(sample.final_values.data()), dimension * sizeof(double));
+	}
+	f.flush();
+	if (!f) {
+		throw exception("Error while writing solver samples file " + filename);
+	}
+	LOG(debug) << "Wrote " << samples.size() << " solver samples into " << filename;
+}
+
+std::vector<solver_sample> read_solver_samples(const std::string &filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		throw invalid_argument("Cannot open solver samples file " + filename);
+	}
+
+	solver_samples_header header;
+	f.read(reinterpret_cast<char *>(&header), sizeof(header));
+	if (!f || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byte_order_mark != BYTE_ORDER_MARK) {
+		throw invalid_data(filename + " is not a solver samples file");
+	}
+	if (header.version != VERSION) {
+		throw invalid_data(filename + " has version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION));
+	}
+
+	std::vector<solver_sample> samples;
+	while (true) {
+		solver_sample sample;
+		sample.key = 0;
+		f.read(reinterpret_cast<char *>(&sample.record), sizeof(sample.record));
+		if (f.gcount() == 0 && f.eof()) {
+			break;
+		}
+		sample.initial_values.resize(header.dimension);
+		sample.final_values.resize(header.dimension);
+		f.read(reinterpret_cast<char *>(sample.initial_values.data()), header.dimension * sizeof(double));
+		f.read(reinterpret_cast<char *>(sample.final_values.data()), header.dimension * sizeof(double));
+		if (!f) {
+			throw invalid_data(filename + " is truncated");
+		}
+		samples.emplace_back(std::move(sample));
+	}
+	return samples;
+}
+
+}  // namespace shark
@@ -0,0 +1,594 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Synthetic merger trees implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "numerical_constants.h"
+#include "synthetic_trees.h"
+#include "timer.h"
+#include "hdf5/io/writer.h"
+
+namespace shark {
+
+namespace {
+
+// Parameters of the model used to generate merger trees. Trees are grown
+// backwards in time from their root halo: at each snapshot the central
+// subhalo of each halo gets a main progenitor following an exponential mass
+// accretion history (Wechsler et al. 2002), plus merging progenitors drawn
+// from a power-law conditional mass function, as in Monte Carlo
+// extended Press-Schechter trees. Merging progenitors either merge directly
+// or live for a while as satellite subhalos, which are eventually traced back
+// to the central subhalo of a separate halo (i.e., when they fell in).
+
+/// The minimum number of particles of a subhalo
+constexpr double MIN_PARTICLES = 20;
+
+/// The slope of the mass functions from which masses are drawn
+constexpr double MASS_FUNCTION_SLOPE = -1.9;
+
+/// The rate of the exponential mass growth of main branches, M(z) = M0 exp(-rate z)
+constexpr double GROWTH_RATE = 1.0;
+
+/// The logarithmic scatter of the mass growth of main branches
+constexpr double GROWTH_SCATTER = 0.3;
+
+/// The fraction of the mass accreted by main branches that comes from
+/// resolved mergers, the rest being smooth accretion
+constexpr double MERGER_FRACTION = 0.6;
+
+/// The fraction of the mass of root halos that is in satellite subhalos
+constexpr double SATELLITE_FRACTION = 0.1;
+
+/// The probability of merging progenitors to be satellites of the main
+/// progenitor halo instead of separate halos
+constexpr double SATELLITE_MERGER_PROBABILITY = 0.5;
+
+/// The time satellite subhalos are satellites for, in units of ln(1 + z)
+constexpr double SATELLITE_LIFETIME = 0.3;
+
+/// The fraction of their mass satellite subhalos lose per unit of ln(1 + z)
+constexpr double STRIPPING_RATE = 0.5;
+
+/// The mass range of the root halos of field trees, the lower limit given in particles
+constexpr double FIELD_MIN_PARTICLES = 100;
+constexpr double FIELD_MAX_MASS = 1e14;
+
+/// The mass range of the root halos of cluster trees
+constexpr double CLUSTER_MIN_MASS = 1e14;
+constexpr double CLUSTER_MAX_MASS = 1e15;
+
+/// The median and logarithmic scatter of the halo spin distribution
+constexpr double SPIN_MEDIAN = 0.035;
+constexpr double SPIN_SCATTER = 0.5;
+
+/// The velocity dispersion of root halos, in km/s
+constexpr double ROOT_VELOCITY_DISPERSION = 300;
+
+/// Halo and subhalo IDs are prefixed with their snapshot, as in SURFS
+constexpr std::int64_t SNAPSHOT_ID_FACTOR = 1000000000000;
+
+/// Cosmology used to calculate virial velocities and spins (Planck15, as in sample.cfg)
+constexpr double OMEGA_M = 0.3121;
+constexpr double OMEGA_L = 0.6879;
+constexpr double HUBBLE_H = 0.6751;
+
+
+struct synthetic_subhalo {
+	std::size_t host;
+	std::int64_t descendant;
+	bool main_progenitor;
+	float mass;
+	float vmax;
+	float position[3];
+	float velocity[3];
+	float L[3];
+};
+
+struct synthetic_halo {
+	int snapshot;
+	float position[3];
+	float velocity[3];
+	/// The subhalos of this halo, the first being the central one
+	std::vector<std::size_t> subhalos;
+};
+
+struct synthetic_tree {
+	std::vector<synthetic_halo> halos;
+	std::vector<synthetic_subhalo> subhalos;
+};
+
+/// Grows merger trees according to the model described above
+class TreeGenerator {
+
+public:
+	TreeGenerator(const synthetic_trees_params &params, const std::vector<double> &redshifts) :
+		params(params),
+		redshifts(redshifts),
+		min_mass(MIN_PARTICLES * params.particle_mass)
+	{
+	}
+
+	synthetic_tree generate(std::size_t tree_index, unsigned int file, bool cluster)
+	{
+		std::seed_seq seed {params.seed, static_cast<unsigned int>(tree_index)};
+		rng.seed(seed);
+
+		double mass;
+		if (cluster) {
+			mass = draw_mass(CLUSTER_MIN_MASS, CLUSTER_MAX_MASS);
+		}
+		else {
+			mass = draw_mass(std::min(FIELD_MIN_PARTICLES * params.particle_mass, FIELD_MAX_MASS), FIELD_MAX_MASS);
+		}
+
+		// Trees of each file are laid out in a slab of the box, like the
+		// subvolumes of a simulation
+		synthetic_tree tree;
+		std::normal_distribution<double> root_velocity(0, ROOT_VELOCITY_DISPERSION);
+		float position[3], velocity[3];
+		auto slab_size = params.box_size / params.n_files;
+		position[0] = float(slab_size * (file + uniform()));
+		position[1] = float(params.box_size * uniform());
+		position[2] = float(params.box_size * uniform());
+		for (auto &v: velocity) {
+			v = float(root_velocity(rng));
+		}
+		auto root = add_halo(tree, params.n_snapshots - 1, position, velocity);
+
+		auto satellite_masses = draw_masses(SATELLITE_FRACTION * mass, SATELLITE_FRACTION * mass);
+		for (auto satellite_mass: satellite_masses) {
+			mass -= satellite_mass;
+		}
+		add_subhalo(tree, root, mass, -1, false);
+		for (auto satellite_mass: satellite_masses) {
+			add_subhalo(tree, root, satellite_mass, -1, false);
+		}
+
+		std::vector<std::size_t> halos {root};
+		for (int snapshot = params.n_snapshots - 1; snapshot > 0 && !halos.empty(); snapshot--) {
+			std::vector<std::size_t> progenitors;
+			for (auto halo: halos) {
+				add_progenitors(tree, halo, progenitors);
+			}
+			halos = std::move(progenitors);
+		}
+		return tree;
+	}
+
+private:
+	const synthetic_trees_params &params;
+	const std::vector<double> &redshifts;
+	double min_mass;
+	std::mt19937_64 rng;
+
+	double uniform()
+	{
+		return std::uniform_real_distribution<double>(0, 1)(rng);
+	}
+
+	double gaussian(double sigma)
+	{
+		if (sigma == 0) {
+			return 0;
+		}
+		return std::normal_distribution<double>(0, sigma)(rng);
+	}
+
+	double hubble_parameter(int snapshot) const
+	{
+		auto z = redshifts[snapshot];
+		return HUBBLE_H * 100 * std::sqrt(OMEGA_M * std::pow(1 + z, 3) + OMEGA_L);
+	}
+
+	double virial_velocity(double mass, int snapshot) const
+	{
+		return std::cbrt(10 * constants::G * hubble_parameter(snapshot) * mass);
+	}
+
+	double virial_radius(double mass, int snapshot) const
+	{
+		return virial_velocity(mass, snapshot) / (10 * hubble_parameter(snapshot));
+	}
+
+	/// Draws a mass from the mass function between @p lower and @p upper
+	double draw_mass(double lower, double upper)
+	{
+		constexpr double k = MASS_FUNCTION_SLOPE + 1;
+		auto lower_k = std::pow(lower, k);
+		return std::pow(lower_k + uniform() * (std::pow(upper, k) - lower_k), 1 / k);
+	}
+
+	/// Draws resolved masses of up to @p upper until they add up to @p total
+	std::vector<double> draw_masses(double total, double upper)
+	{
+		std::vector<double> masses;
+		if (upper < min_mass) {
+			return masses;
+		}
+		while (true) {
+			auto mass = draw_mass(min_mass, upper);
+			if (mass > total) {
+				return masses;
+			}
+			masses.push_back(mass);
+			total -= mass;
+		}
+	}
+
+	void wrap(float &coordinate) const
+	{
+		auto box_size = float(params.box_size);
+		coordinate = std::fmod(coordinate, box_size);
+		if (coordinate < 0) {
+			coordinate += box_size;
+		}
+	}
+
+	std::size_t add_halo(synthetic_tree &tree, int snapshot, const float position[3], const float velocity[3])
+	{
+		synthetic_halo halo;
+		halo.snapshot = snapshot;
+		for (int i = 0; i != 3; i++) {
+			halo.position[i] = position[i];
+			halo.velocity[i] = velocity[i];
+		}
+		tree.halos.emplace_back(std::move(halo));
+		return tree.halos.size() - 1;
+	}
+
+	/// Adds a progenitor halo of @p descendant_halo at the previous snapshot,
+	/// either close to it (@p main) or falling into it
+	std::size_t add_progenitor_halo(synthetic_tree &tree, std::size_t descendant_halo, bool main)
+	{
+		const auto &descendant = tree.halos[descendant_halo];
+		auto snapshot = descendant.snapshot;
+		auto central_mass = tree.subhalos[descendant.subhalos[0]].mass;
+		auto distance = main ? 0.1 : 2 * virial_radius(central_mass, snapshot);
+		auto velocity_dispersion = main ? 20. : virial_velocity(central_mass, snapshot);
+
+		// Isotropic direction
+		auto cos_theta = 2 * uniform() - 1;
+		auto sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+		auto phi = 2 * constants::PI * uniform();
+		double direction[3] = {sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+
+		float position[3], velocity[3];
+		for (int i = 0; i != 3; i++) {
+			position[i] = float(descendant.position[i] + distance * direction[i]);
+			wrap(position[i]);
+			velocity[i] = float(descendant.velocity[i] + gaussian(velocity_dispersion));
+		}
+		return add_halo(tree, snapshot - 1, position, velocity);
+	}
+
+	void add_subhalo(synthetic_tree &tree, std::size_t host, double mass, std::int64_t descendant, bool main_progenitor)
+	{
+		const auto &halo = tree.halos[host];
+		auto snapshot = halo.snapshot;
+		auto vvir = virial_velocity(mass, snapshot);
+
+		synthetic_subhalo subhalo;
+		subhalo.host = host;
+		subhalo.descendant = descendant;
+		subhalo.main_progenitor = main_progenitor;
+		subhalo.mass = float(mass);
+		subhalo.vmax = float(1.2 * vvir);
+
+		// Centrals sit at the centre of their halo, satellites around it
+		bool central = halo.subhalos.empty();
+		double offset_sigma = 0, velocity_sigma = 0;
+		if (!central) {
+			auto central_mass = tree.subhalos[halo.subhalos[0]].mass;
+			offset_sigma = 0.5 * virial_radius(central_mass, snapshot);
+			velocity_sigma = virial_velocity(central_mass, snapshot);
+		}
+		for (int i = 0; i != 3; i++) {
+			subhalo.position[i] = float(halo.position[i] + gaussian(offset_sigma));
+			wrap(subhalo.position[i]);
+			subhalo.velocity[i] = float(halo.velocity[i] + gaussian(velocity_sigma));
+		}
+
+		// Angular momentum with a lognormal spin parameter in a random direction,
+		// following the definition of the spin used by shark
+		auto spin = SPIN_MEDIAN * std::exp(gaussian(SPIN_SCATTER));
+		auto L = spin * mass * std::pow(constants::G * mass, 0.666) / (1.5234153 * std::pow(hubble_parameter(snapshot), 0.33));
+		auto cos_theta = 2 * uniform() - 1;
+		auto sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+		auto phi = 2 * constants::PI * uniform();
+		subhalo.L[0] = float(L * sin_theta * std::cos(phi));
+		subhalo.L[1] = float(L * sin_theta * std::sin(phi));
+		subhalo.L[2] = float(L * cos_theta);
+
+		tree.subhalos.push_back(subhalo);
+		tree.halos[host].subhalos.push_back(tree.subhalos.size() - 1);
+	}
+
+	/// Adds the progenitors of all subhalos of @p halo, collecting the new halos into @p progenitors
+	void add_progenitors(synthetic_tree &tree, std::size_t halo, std::vector<std::size_t> &progenitors)
+	{
+		auto snapshot = tree.halos[halo].snapshot;
+		auto subhalos = tree.halos[halo].subhalos;
+		auto dz = redshifts[snapshot - 1] - redshifts[snapshot];
+		auto dlna = std::log((1 + redshifts[snapshot - 1]) / (1 + redshifts[snapshot]));
+
+		// The main progenitor of the central subhalo, in its own halo
+		auto central = subhalos[0];
+		double central_mass = tree.subhalos[central].mass;
+		auto main_mass = central_mass * std::exp(-GROWTH_RATE * dz * std::exp(gaussian(GROWTH_SCATTER)));
+		bool has_main_halo = main_mass >= min_mass;
+		std::size_t main_halo = 0;
+		if (has_main_halo) {
+			main_halo = add_progenitor_halo(tree, halo, true);
+			add_subhalo(tree, main_halo, main_mass, std::int64_t(central), true);
+			progenitors.push_back(main_halo);
+
+			// Resolved mergers into the central subhalo
+			for (auto mass: draw_masses(MERGER_FRACTION * (central_mass - main_mass), main_mass)) {
+				if (uniform() < SATELLITE_MERGER_PROBABILITY) {
+					add_subhalo(tree, main_halo, mass, std::int64_t(central), false);
+				}
+				else {
+					auto merging_halo = add_progenitor_halo(tree, halo, false);
+					add_subhalo(tree, merging_halo, mass, std::int64_t(central), false);
+					progenitors.push_back(merging_halo);
+				}
+			}
+		}
+
+		// Satellites were either satellites already, or just fell in
+		auto infall_probability = 1 - std::exp(-dlna / SATELLITE_LIFETIME);
+		for (auto it = subhalos.begin() + 1; it != subhalos.end(); it++) {
+			auto mass = tree.subhalos[*it].mass * std::exp(STRIPPING_RATE * dlna);
+			if (mass < min_mass) {
+				continue;
+			}
+			if (has_main_halo && uniform() >= infall_probability) {
+				add_subhalo(tree, main_halo, mass, std::int64_t(*it), true);
+			}
+			else {
+				auto infall_halo = add_progenitor_halo(tree, halo, false);
+				add_subhalo(tree, infall_halo, mass, std::int64_t(*it), true);
+				progenitors.push_back(infall_halo);
+			}
+		}
+	}
+};
+
+/// Redshifts of all snapshots, equally spaced in ln(1 + z)
+std::vector<double> snapshot_redshifts(int n_snapshots, double max_redshift)
+{
+	std::vector<double> redshifts(n_snapshots);
+	for (int snapshot = 0; snapshot != n_snapshots; snapshot++) {
+		auto fraction = n_snapshots == 1 ? 0. : 1 - double(snapshot) / (n_snapshots - 1);
+		redshifts[snapshot] = std::expm1(fraction * std::log1p(max_redshift));
+	}
+	return redshifts;
+}
+
+/// Writes the trees of a single file, assigning the IDs of their halos and
+/// subhalos from the per-snapshot counters in @p next_ids
+std::size_t write_trees(const std::string &fname, const std::vector<synthetic_tree> &trees, const synthetic_trees_params &params, std::vector<std::int64_t> &next_ids)
+{
+	auto n_snapshots = params.n_snapshots;
+	auto particle_mass = params.particle_mass;
+
+	// Rows are sorted by snapshot, then by host, centrals first
+	struct halo_ref {
+		std::size_t tree;
+		std::size_t halo;
+	};
+	std::vector<std::vector<halo_ref>> halos_by_snapshot(n_snapshots);
+	std::vector<std::vector<std::int64_t>> subhalo_ids(trees.size());
+	std::size_t n_rows = 0;
+	for (std::size_t t = 0; t != trees.size(); t++) {
+		for (std::size_t h = 0; h != trees[t].halos.size(); h++) {
+			halos_by_snapshot[trees[t].halos[h].snapshot].push_back({t, h});
+		}
+		subhalo_ids[t].resize(trees[t].subhalos.size());
+		n_rows += trees[t].subhalos.size();
+	}
+
+	// IDs first, since descendants are written before they get one otherwise
+	std::vector<std::vector<std::int64_t>> halo_ids(trees.size());
+	for (std::size_t t = 0; t != trees.size(); t++) {
+		halo_ids[t].resize(trees[t].halos.size());
+	}
+	for (int snapshot = 0; snapshot != n_snapshots; snapshot++) {
+		for (auto &ref: halos_by_snapshot[snapshot]) {
+			halo_ids[ref.tree][ref.halo] = snapshot * SNAPSHOT_ID_FACTOR + next_ids[snapshot]++;
+			for (auto subhalo: trees[ref.tree].halos[ref.halo].subhalos) {
+				subhalo_ids[ref.tree][subhalo] = snapshot * SNAPSHOT_ID_FACTOR + next_ids[snapshot]++;
+			}
+		}
+	}
+
+	std::vector<float> position, velocity, L, mass, vmax;
+	std::vector<int> npart, snapshot_number, is_main, is_centre;
+	std::vector<std::int64_t> node_index, descendant_index, host_index, descendant_host;
+	position.reserve(3 * n_rows);
+	velocity.reserve(3 * n_rows);
+	L.reserve(3 * n_rows);
+	for (int snapshot = 0; snapshot != n_snapshots; snapshot++) {
+		for (auto &ref: halos_by_snapshot[snapshot]) {
+			const auto &tree = trees[ref.tree];
+			const auto &halo = tree.halos[ref.halo];
+			for (auto s: halo.subhalos) {
+				const auto &subhalo = tree.subhalos[s];
+				position.insert(position.end(), subhalo.position, subhalo.position + 3);
+				velocity.insert(velocity.end(), subhalo.velocity, subhalo.velocity + 3);
+				L.insert(L.end(), subhalo.L, subhalo.L + 3);
+				mass.push_back(subhalo.mass);
+				vmax.push_back(subhalo.vmax);
+				npart.push_back(int(std::round(subhalo.mass / particle_mass)));
+				snapshot_number.push_back(snapshot);
+				is_main.push_back(subhalo.main_progenitor ? 1 : 0);
+				is_centre.push_back(s == halo.subhalos[0] ? 1 : 0);
+				node_index.push_back(subhalo_ids[ref.tree][s]);
+				host_index.push_back(halo_ids[ref.tree][ref.halo]);
+				if (subhalo.descendant == -1) {
+					descendant_index.push_back(-1);
+					descendant_host.push_back(-1);
+				}
+				else {
+					auto descendant = std::size_t(subhalo.descendant);
+					descendant_index.push_back(subhalo_ids[ref.tree][descendant]);
+					descendant_host.push_back(halo_ids[ref.tree][tree.subhalos[descendant].host]);
+				}
+			}
+		}
+	}
+
+	hdf5::Writer file(fname, true, naming_convention::LOWER_CAMEL_CASE, naming_convention::LOWER_CAMEL_CASE, naming_convention::LOWER_CAMEL_CASE);
+	file.write_attribute("fileInfo/numberOfFiles", params.n_files);
+	file.write_dataset_v_2("haloTrees/position", position, 3);
+	file.write_dataset_v_2("haloTrees/velocity", velocity, 3);
+	file.write_dataset_v_2("haloTrees/angularMomentum", L, 3);
+	file.write_dataset("haloTrees/nodeMass", mass);
+	file.write_dataset("haloTrees/particleNumber", npart);
+	file.write_dataset("haloTrees/maximumCircularVelocity", vmax);
+	file.write_dataset("haloTrees/snapshotNumber", snapshot_number);
+	file.write_dataset("haloTrees/nodeIndex", node_index);
+	file.write_dataset("haloTrees/descendantIndex", descendant_index);
+	file.write_dataset("haloTrees/hostIndex", host_index);
+	file.write_dataset("haloTrees/descendantHost", descendant_host);
+	file.write_dataset("haloTrees/isMainProgenitor", is_main);
+	file.write_dataset("haloTrees/isDHaloCentre", is_centre);
+	file.write_dataset("haloTrees/isInterpolated", std::vector<int>(n_rows, 0));
+	return n_rows;
+}
+
+}  // anonymous namespace
+
+void generate_synthetic_trees(const synthetic_trees_params &params)
+{
+	if (params.n_snapshots < 2) {
+		throw invalid_argument("At least two snapshots are needed");
+	}
+	if (params.n_files == 0) {
+		throw invalid_argument("At least one file is needed");
+	}
+	if (params.box_size <= 0 || params.particle_mass <= 0 || params.max_redshift <= 0) {
+		throw invalid_argument("Box size, particle mass and maximum redshift must be positive");
+	}
+	if (params.cluster_fraction < 0 || params.cluster_fraction > 1) {
+		throw invalid_argument("Cluster fraction must be between 0 and 1");
+	}
+
+	auto output_dir = boost::filesystem::path(params.prefix).parent_path();
+	if (!output_dir.empty() && !boost::filesystem::exists(output_dir)) {
+		boost::filesystem::create_directories(output_dir);
+	}
+
+	// Trees are generated until they have the requested number of nodes,
+	// and are distributed across files in turn. Cluster trees are interleaved
+	// with field trees until they have their share of nodes
+	Timer t;
+	auto redshifts = snapshot_redshifts(params.n_snapshots, params.max_redshift);
+	TreeGenerator generator(params, redshifts);
+	std::vector<std::vector<synthetic_tree>> file_trees(params.n_files);
+	std::size_t n_trees = 0;
+	std::size_t n_cluster_trees = 0;
+	double field_nodes = 0;
+	double cluster_nodes = 0;
+	auto cluster_fraction = params.cluster_fraction;
+	while (field_nodes + cluster_nodes < params.n_nodes) {
+		bool cluster = cluster_nodes < cluster_fraction * params.n_nodes &&
+		               cluster_nodes * (1 - cluster_fraction) <= field_nodes * cluster_fraction;
+		auto file = static_cast<unsigned int>(n_trees % params.n_files);
+		auto tree = generator.generate(n_trees, file, cluster);
+		if (cluster) {
+			cluster_nodes += tree.subhalos.size();
+			n_cluster_trees++;
+		}
+		else {
+			field_nodes += tree.subhalos.size();
+		}
+		file_trees[file].emplace_back(std::move(tree));
+		n_trees++;
+	}
+	LOG(info) << "Generated " << n_trees << " merger trees (" << n_cluster_trees << " clusters) with "
+	          << std::size_t(field_nodes + cluster_nodes) << " nodes (" << std::size_t(cluster_nodes) << " in clusters) in " << t;
+
+	std::vector<std::int64_t> next_ids(params.n_snapshots, 0);
+	for (unsigned int batch = 0; batch != params.n_files; batch++) {
+		Timer write_t;
+		auto fname = params.prefix + "." + std::to_string(batch) + ".hdf5";
+		auto n_rows = write_trees(fname, file_trees[batch], params, next_ids);
+		file_trees[batch].clear();
+		LOG(info) << "Wrote " << n_rows << " nodes into " << fname << " in " << write_t;
+	}
+
+	auto redshift_file = params.prefix + ".redshifts.txt";
+	std::ofstream redshifts_f(redshift_file);
+	redshifts_f << std::setprecision(std::numeric_limits<double>::digits10);
+	for (int snapshot = 0; snapshot != params.n_snapshots; snapshot++) {
+		redshifts_f << snapshot << " " << redshifts[snapshot] << std::endl;
+	}
+	if (!redshifts_f) {
+		throw exception("Error while writing " + redshift_file);
+	}
+
+	auto config_file = params.prefix + ".cfg";
+	std::ofstream config_f(config_file);
+	config_f << "# Simulation options of the synthetic merger trees generated by shark-bench-trees" << std::endl;
+	config_f << std::endl;
+	config_f << "[execution]" << std::endl;
+	config_f << "simulation_batches = 0";
+	if (params.n_files > 1) {
+		config_f << "-" << params.n_files - 1;
+	}
+	config_f << std::endl;
+	config_f << "output_snapshots = " << params.n_snapshots - 1 << std::endl;
+	config_f << std::endl;
+	config_f << "[simulation]" << std::endl;
+	config_f << "sim_name = shark-bench-trees" << std::endl;
+	config_f << "lbox = " << params.box_size << std::endl;
+	config_f << "volume = " << std::pow(params.box_size, 3) / params.n_files << std::endl;
+	config_f << "tot_n_subvolumes = " << params.n_files << std::endl;
+	config_f << "particle_mass = " << params.particle_mass << std::endl;
+	config_f << "min_snapshot = 1" << std::endl;
+	config_f << "max_snapshot = " << params.n_snapshots - 1 << std::endl;
+	config_f << "tree_files_prefix = " << params.prefix << std::endl;
+	config_f << "redshift_file = " << redshift_file << std::endl;
+	if (!config_f) {
+		throw exception("Error while writing " + config_file);
+	}
+	LOG(info) << "Wrote simulation options into " << config_file;
+}
+
+} // namespace shark
@@ -0,0 +1,227 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Tracer implementation
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "trace.h"
+
+namespace shark {
+
+namespace {
+
+struct trace_event {
+	const char *name;
+	std::int64_t id;
+	std::int64_t start;
+	std::int64_t duration;
+};
+
+/// The spans recorded by a single thread, oldest first once wrapped around
+class thread_buffer {
+
+public:
+	thread_buffer(unsigned int tid, std::size_t capacity) :
+		tid(tid), capacity(capacity)
+	{
+	}
+
+	void add(const trace_event &event)
+	{
+		if (events.size() < capacity) {
+			events.push_back(event);
+			return;
+		}
+		events[next] = event;
+		next = (next + 1) % capacity;
+		dropped++;
+	}
+
+	template <typename F>
+	void for_each(F &&f) const
+	{
+		for (std::size_t i = 0; i != events.size(); i++) {
+			f(events[(next + i) % events.size()]);
+		}
+	}
+
+	unsigned int tid;
+	std::size_t capacity;
+	std::size_t dropped = 0;
+
+private:
+	std::vector<trace_event> events;
+	std::size_t next = 0;
+};
+
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<thread_buffer>> buffers;
+std::size_t buffer_capacity = Tracer::DEFAULT_EVENTS_PER_THREAD;
+Timer::clock::time_point trace_start;
+
+// Buffers are discarded every time tracing is (re)enabled, so threads check
+// that the buffer they point to belongs to the current generation
+std::atomic<std::size_t> generation {0};
+thread_local thread_buffer *this_thread_buffer = nullptr;
+thread_local std::size_t this_thread_generation = 0;
+
+thread_buffer &get_thread_buffer()
+{
+	auto current_generation = generation.load(std::memory_order_acquire);
+	if (!this_thread_buffer || this_thread_generation != current_generation) {
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffers.emplace_back(new thread_buffer(unsigned(buffers.size()), buffer_capacity));
+		this_thread_buffer = buffers.back().get();
+		this_thread_generation = current_generation;
+	}
+	return *this_thread_buffer;
+}
+
+void write_microseconds(std::ostream &os, std::int64_t nanoseconds)
+{
+	os << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+}
+
+}  // anonymous namespace
+
+constexpr std::size_t Tracer::DEFAULT_EVENTS_PER_THREAD;
+std::atomic<bool> Tracer::is_enabled {false};
+
+void Tracer::enable(std::size_t events_per_thread)
+{
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffers.clear();
+		buffer_capacity = events_per_thread;
+		trace_start = Timer::clock::now();
+		generation++;
+	}
+	is_enabled = true;
+
+	// The enabling thread comes first
+	get_thread_buffer();
+}
+
+void Tracer::disable()
+{
+	is_enabled = false;
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	buffers.clear();
+	generation++;
+}
+
+void Tracer::record(const char *name, std::int64_t id, Timer::clock::time_point start, Timer::clock::time_point end)
+{
+	if (!enabled()) {
+		return;
+	}
+	auto since_trace_start = [](Timer::clock::time_point t) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t - trace_start).count();
+	};
+	auto event_start = since_trace_start(start);
+	get_thread_buffer().add({name, id, event_start, since_trace_start(end) - event_start});
+}
+
+void Tracer::write(const std::string &filename)
+{
+	Timer t;
+	auto trace_dir = boost::filesystem::path(filename).parent_path();
+	if (!trace_dir.empty() && !boost::filesystem::exists(trace_dir)) {
+		boost::filesystem::create_directories(trace_dir);
+	}
+	std::ofstream f(filename);
+	if (!f) {
+		throw exception("Cannot open trace file " + filename);
+	}
+
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	std::size_t n_events = 0;
+	std::size_t dropped = 0;
+	f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char *separator = "\n";
+	for (auto &buffer: buffers) {
+		f << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+		  << ",\"args\":{\"name\":\"";
+		if (buffer->tid == 0) {
+			f << "main";
+		}
+		else {
+			f << "thread " << buffer->tid;
+		}
+		f << "\"}}";
+		separator = ",\n";
+		buffer->for_each([&](const trace_event &event) {
+			f << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+			write_microseconds(f, event.start);
+			f << ",\"dur\":";
+			write_microseconds(f, event.duration);
+			if (event.id != -1) {
+				f << ",\"args\":{\"id\":" << event.id << '}';
+			}
+			f << '}';
+			n_events++;
+		});
+		dropped += buffer->dropped;
+	}
+	f << "\n]}\n";
+	if (!f) {
+		throw exception("Error while writing trace file " + filename);
+	}
+
+	LOG(info) << "Wrote " << n_events << " trace events of " << buffers.size() << " threads into " << filename << " in " << t;
+	if (dropped != 0) {
+		LOG(warning) << dropped << " older trace events were dropped because thread buffers were full";
+	}
+}
+
+TraceFile::TraceFile(const std::string &filename) :
+	filename(filename)
+{
+	if (!filename.empty()) {
+		Tracer::enable();
+	}
+}
+
+TraceFile::~TraceFile()
+{
+	if (filename.empty()) {
+		return;
+	}
+	try {
+		Tracer::write(filename);
+	} catch (const std::exception &e) {
+		LOG(error) << "Error while writing trace file: " << e.what();
+	}
+	Tracer::disable();
+}
+
+}  // namespace shark
@@ -22,8 +22,10 @@
  */
 
 #include <algorithm>
+#include <exception>
 #include <iomanip>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <vector>
@@ -40,6 +42,7 @@
 #include "subhalo.h"
 #include "timer.h"
 #include "total_baryon.h"
+#include "trace.h"
 #include "tree_builder.h"
 
 
@@ -58,10 +61,15 @@ ExecutionParameters &TreeBuilder::get_exec_params()
 	return exec_params;
 }
 
+unsigned int TreeBuilder::get_threads() const
+{
+	return threads;
+}
+
 void TreeBuilder::ensure_trees_are_self_contained(const std::vector<MergerTreePtr> &trees) const
 {
 	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, unsigned int thread_idx) {
-		for (auto &halo: tree->halos) {
+		for (auto &halo: tree->get_halos()) {
 			if (halo->merger_tree != tree) {
 				std::ostringstream os;
 				os << halo << " is not actually part of " << tree;
@@ -92,6 +100,7 @@ std::vector<MergerTreePtr> TreeBuilder::build_trees(std::vector<HaloPtr> &halos,
 		const CosmologyPtr &cosmology,
 		TotalBaryon &AllBaryons)
 {
+	TraceSpan span("build_merger_trees");
 
 	auto last_snapshot_to_consider = exec_params.last_output_snapshot();
 
@@ -163,13 +172,24 @@ std::vector<MergerTreePtr> TreeBuilder::build_trees(std::vector<HaloPtr> &halos,
 	LOG(info) << "Defining central subhalos";
 	define_central_subhalos(trees, sim_params, dark_matter_params);
 
+	// The remaining passes only walk through the trees,
+	// which is cheaper to do over their flat representation
+	std::vector<MergerTreeGraph> graphs(trees.size());
+	{
+		Timer t;
+		omp_static_for(std::size_t(0), trees.size(), threads, [&](std::size_t i, unsigned int thread_idx) {
+			graphs[i] = MergerTreeGraph(*trees[i]);
+		});
+		LOG(info) << "Took " << t << " to create the graphs of all trees";
+	}
+
 	// Define accretion rate from DM in case we want this.
 	LOG(info) << "Defining accretion rate using cosmology";
-	define_accretion_rate_from_dm(trees, sim_params, gas_cooling_params, *cosmology, AllBaryons);
+	define_accretion_rate_from_dm(graphs, sim_params, gas_cooling_params, *cosmology, AllBaryons);
 
 	// Define halo and subhalos ages and other relevant properties
 	LOG(info) << "Defining ages of halos and subhalos";
-	define_ages_halos(trees, sim_params, darkmatterhalos);
+	define_ages_halos(graphs, sim_params, darkmatterhalos);
 
 	return trees;
 }
@@ -195,7 +215,7 @@ void TreeBuilder::link(const SubhaloPtr &parent_shalo, const SubhaloPtr &desc_su
 	add_parent(desc_halo, parent_halo);
 }
 
-SubhaloPtr TreeBuilder::define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhalo)
+SubhaloPtr TreeBuilder::define_central_subhalo(const HaloPtr &halo, SubhaloPtr &subhalo)
 {
 	// point central subhalo to this subhalo.
 	halo->central_subhalo = subhalo;
@@ -222,6 +242,7 @@ SubhaloPtr TreeBuilder::define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhal
 }
 
 void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, DarkMatterHaloParameters &dark_matter_params){
+	TraceSpan span("define_central_subhalos");
 
 	//This function loops over merger trees and halos to define central galaxies in a self-consistent way. The loop starts at z=0.
 
@@ -325,6 +346,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 }
 
 void TreeBuilder::ensure_halo_mass_growth(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params){
+	TraceSpan span("ensure_halo_mass_growth");
 
 	//This function loops over merger trees and halos to make sure that descendant halos are at least as massive as their progenitors.
 	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, unsigned int thread_idx) {
@@ -381,20 +403,26 @@ void TreeBuilder::spin_interpolated_halos(const std::vector<MergerTreePtr> &tree
 }
 
 
-void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr> &trees,
+void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreeGraph> &graphs,
 		SimulationParameters &sim_params,
 		GasCoolingParameters &gas_cooling_params,
 		Cosmology &cosmology,
 		TotalBaryon &AllBaryons){
+	TraceSpan span("define_accretion_rate");
 
 
 	//Loop over trees.
 	auto universal_baryon_fraction = cosmology.universal_baryon_fraction();
-	for(auto &tree: trees) {
+	omp_static_for(graphs, threads, [&](const MergerTreeGraph &graph, unsigned int thread_idx) {
 		for(int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
-				for(auto &halo: tree->halos_at(snapshot)){
+				auto halos = graph.halos_at(snapshot);
+				for(auto h = halos.first; h != halos.second; h++){
 
-					auto Mvir_asc = halo->total_mass_ascendants();
+					auto &halo = graph.halo(h);
+					double Mvir_asc = 0;
+					for (auto progenitor: graph.progenitors(h)) {
+						Mvir_asc += graph.halo(progenitor)->Mvir;
+					}
 
 					// Define accreted baryonic mass.
 					halo->central_subhalo->accreted_mass = (halo->Mvir - Mvir_asc) * universal_baryon_fraction;
@@ -405,16 +433,19 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 					}
 				}
 		}
-	}
+	});
 
 	// Now accummulate baryons staring from the highest redshift.
+	// This is a single running sum over snapshots, trees and halos in order,
+	// so totals are the same regardless of the number of threads
 	double total_baryon_accreted = 0;
 
 	for(int snapshot=sim_params.min_snapshot; snapshot <= sim_params.max_snapshot; snapshot++) {
-		for(auto &tree: trees) {
-				for(auto &halo: tree->halos_at(snapshot)){
-					total_baryon_accreted += halo->central_subhalo->accreted_mass;
-				}
+		for(auto &graph: graphs) {
+			auto halos = graph.halos_at(snapshot);
+			for(auto h = halos.first; h != halos.second; h++){
+				total_baryon_accreted += graph.halo(h)->central_subhalo->accreted_mass;
+			}
 		}
 		// Keep track of the integral of the baryons mass accreted.
 		AllBaryons.baryon_total_created[snapshot] = total_baryon_accreted;
@@ -422,60 +453,92 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 
 }
 
-void TreeBuilder::define_ages_halos(const std::vector<MergerTreePtr> &trees,
+void TreeBuilder::define_ages_halos(const std::vector<MergerTreeGraph> &graphs,
 		SimulationParameters &sim_params,
 		const DarkMatterHalosPtr &darkmatterhalos){
+	TraceSpan span("define_ages_halos");
+
+	using handle_t = MergerTreeGraph::handle_t;
+	constexpr handle_t none = MergerTreeGraph::none;
+	constexpr handle_t unvisited = -2;
+
+	// Halos are visited from the earliest snapshot onwards, so the results of
+	// progenitors can be reused by their descendants instead of walking
+	// down the full main progenitor branch of each halo and subhalo.
+	omp_static_for(graphs, threads, [&](const MergerTreeGraph &graph, unsigned int thread_idx) {
+
+		// For each halo, its closest main progenitor with a mass that is not
+		// larger than its own. All main progenitors in between are heavier.
+		std::vector<handle_t> lighter_progenitor(graph.size(), unvisited);
+
+		// The closest main progenitor of halo h with a mass not larger than max_mass
+		auto find_progenitor = [&](handle_t h, double max_mass) {
+			auto prog = graph.main_progenitor(h);
+			while (prog != none && graph.halo(prog)->Mvir > max_mass) {
+				auto lighter = lighter_progenitor[prog];
+				prog = (lighter == unvisited ? graph.main_progenitor(prog) : lighter);
+			}
+			return prog;
+		};
 
+		for(int snapshot=sim_params.min_snapshot; snapshot <= sim_params.max_snapshot; snapshot++) {
+				auto halos = graph.halos_at(snapshot);
+				for(auto h = halos.first; h != halos.second; h++){
 
-	//Loop over trees.
-	for(auto &tree: trees) {
-		for(int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
-				for(auto &halo: tree->halos_at(snapshot)){
-
-					auto prog = halo->main_progenitor();
+					auto &halo = graph.halo(h);
 
 					/*
 					 * Define assembly ages of halos by going backwards in time and checking when the main progenitors had
 					 * 50% and 80% of the mass of the current halo.
 					 */
-					auto snap = snapshot - 1;
-					while(prog && (halo->age_50 == 0 || halo->age_80 == 0)){
-						if(prog->Mvir <= 0.8* halo->Mvir && halo->age_80 == 0){
-							halo->age_80 = sim_params.redshifts[snap];
+					if (halo->age_80 == 0) {
+						auto prog = find_progenitor(h, 0.8 * halo->Mvir);
+						if (prog != none) {
+							halo->age_80 = sim_params.redshifts[graph.halo(prog)->snapshot];
 						}
-						if(prog->Mvir <= 0.5* halo->Mvir && halo->age_50 == 0){
-							halo->age_50 = sim_params.redshifts[snap];
+					}
+					if (halo->age_50 == 0) {
+						auto prog = find_progenitor(h, 0.5 * halo->Mvir);
+						if (prog != none) {
+							halo->age_50 = sim_params.redshifts[graph.halo(prog)->snapshot];
 						}
-						snap --;
-						prog = prog->main_progenitor();
 					}
+					lighter_progenitor[h] = find_progenitor(h, halo->Mvir);
 
 					for (auto &subhalo: halo->satellite_subhalos) {
 
+						// Go back until finding a main progenitor that was a central,
+						// or a satellite whose infall was already found
 						auto main_prog = subhalo->main();
-						auto snap = snapshot - 1;
-
-						while(main_prog && subhalo->infall_t == 0){
-							if(main_prog->subhalo_type == Subhalo::CENTRAL){
-								subhalo->infall_t = sim_params.redshifts[snap];
-								subhalo->Mvir_infall = main_prog->Mvir;
-								subhalo->rvir_infall = darkmatterhalos->halo_virial_radius(main_prog->host_halo, sim_params.redshifts[snap]);
-
-								//assume the stripping radius is equal to the virial radius at infall (which the largest it can be).
-								subhalo->hot_halo_gas_r_rps = subhalo->rvir_infall;
-							}
-							snap --;
+						while (main_prog && main_prog->subhalo_type != Subhalo::CENTRAL && main_prog->infall_t == 0) {
 							main_prog = main_prog->main();
 						}
+
+						if (!main_prog || subhalo->infall_t != 0) {
+							continue;
+						}
+						if (main_prog->subhalo_type == Subhalo::CENTRAL) {
+							subhalo->infall_t = sim_params.redshifts[main_prog->snapshot];
+							subhalo->Mvir_infall = main_prog->Mvir;
+							subhalo->rvir_infall = darkmatterhalos->halo_virial_radius(main_prog->host_halo, sim_params.redshifts[main_prog->snapshot]);
+						}
+						else {
+							subhalo->infall_t = main_prog->infall_t;
+							subhalo->Mvir_infall = main_prog->Mvir_infall;
+							subhalo->rvir_infall = main_prog->rvir_infall;
+						}
+
+						//assume the stripping radius is equal to the virial radius at infall (which the largest it can be).
+						subhalo->hot_halo_gas_r_rps = subhalo->rvir_infall;
 					}
 				}
 		}
 
-	}
+	});
 
 }
 
-void TreeBuilder::remove_satellite(HaloPtr &halo, SubhaloPtr &subhalo){
+void TreeBuilder::remove_satellite(const HaloPtr &halo, SubhaloPtr &subhalo){
 
 	auto it = std::find(halo->satellite_subhalos.begin(), halo->satellite_subhalos.end(), subhalo);
 
@@ -503,15 +566,82 @@ static std::vector<SubhaloPtr>::const_iterator find_by_id(const std::vector<Subh
 	});
 }
 
+void HaloBasedTreeBuilder::build_subhalo_index(const std::vector<HaloPtr> &halos)
+{
+	TraceSpan span("build_subhalo_index");
+	Timer t;
+	subhalo_index.clear();
+	for (auto &halo: halos) {
+		if (halo->central_subhalo) {
+			subhalo_index.push_back({halo->central_subhalo->id, halo->central_subhalo, false});
+		}
+		for (auto &subhalo: halo->satellite_subhalos) {
+			subhalo_index.push_back({subhalo->id, subhalo, false});
+		}
+	}
+	std::stable_sort(subhalo_index.begin(), subhalo_index.end(), [](const indexed_subhalo &lhs, const indexed_subhalo &rhs) {
+		return lhs.id < rhs.id;
+	});
+	LOG(info) << "Indexed " << subhalo_index.size() << " subhalos by id in " << t;
+}
+
+std::pair<std::size_t, std::size_t> HaloBasedTreeBuilder::find_in_index(Subhalo::id_t id) const
+{
+	auto lo = std::lower_bound(subhalo_index.begin(), subhalo_index.end(), id, [](const indexed_subhalo &x, Subhalo::id_t id) {
+		return x.id < id;
+	});
+	auto up = std::upper_bound(lo, subhalo_index.end(), id, [](Subhalo::id_t id, const indexed_subhalo &x) {
+		return id < x.id;
+	});
+	return {std::distance(subhalo_index.begin(), lo), std::distance(subhalo_index.begin(), up)};
+}
+
+SubhaloPtr HaloBasedTreeBuilder::find_subhalo(const HaloPtr &halo, Subhalo::id_t id) const
+{
+	auto range = find_in_index(id);
+
+	// Subhalo ids are expected to be unique, but if they aren't we look
+	// for the subhalo in the halo itself
+	if (range.second - range.first > 1) {
+		auto subhalos = halo->all_subhalos();
+		auto subhalo_found = find_by_id(subhalos, id);
+		return subhalo_found == subhalos.end() ? SubhaloPtr() : *subhalo_found;
+	}
+
+	if (range.first == range.second) {
+		return SubhaloPtr();
+	}
+	auto &entry = subhalo_index[range.first];
+	if (entry.removed || entry.subhalo->host_halo != halo) {
+		return SubhaloPtr();
+	}
+	return entry.subhalo;
+}
+
+void HaloBasedTreeBuilder::remove_subhalo(const HaloPtr &halo, const SubhaloPtr &subhalo)
+{
+	halo->remove_subhalo(subhalo);
+	// Only entries of subhalos from the snapshot currently being linked are
+	// modified, while only those from later snapshots are looked up
+	auto range = find_in_index(subhalo->id);
+	for (auto i = range.first; i != range.second; i++) {
+		if (subhalo_index[i].subhalo == subhalo) {
+			subhalo_index[i].removed = true;
+		}
+	}
+}
+
 SubhaloPtr HaloBasedTreeBuilder::find_descendant_subhalo(
     const HaloPtr &halo, const SubhaloPtr &subhalo, const HaloPtr &descendant_halo)
 {
+	// Descendant halos are always from later snapshots (see loop_through_halos),
+	// which are not modified anymore while linking this halo, so their
+	// subhalos can be safely looked up in the index
+	auto descendant_subhalo = find_subhalo(descendant_halo, subhalo->descendant_id);
+
 	// if the descendant subhalo is not found in the descendant halos'
 	// subhalos then we error
-	auto descendant_subhalos = descendant_halo->all_subhalos();
-	auto descendant_subhalo_found = find_by_id(descendant_subhalos, subhalo->descendant_id);
-
-	if (descendant_subhalo_found == descendant_subhalos.end()) {
+	if (!descendant_subhalo) {
 		std::ostringstream os;
 		auto exec_params = get_exec_params();
 		if (exec_params.skip_missing_descendants || exec_params.warn_on_missing_descendants) {
@@ -533,13 +663,12 @@ SubhaloPtr HaloBasedTreeBuilder::find_descendant_subhalo(
 		if (get_exec_params().warn_on_missing_descendants) {
 			LOG(warning) << os.str();
 		}
-		halo->remove_subhalo(subhalo);
+		remove_subhalo(halo, subhalo);
 		return nullptr;
 	}
 
 	// We support only direct parentage; that is, descendants must be
 	// in the snapshot directly after ours
-	auto descendant_subhalo = *descendant_subhalo_found;
 	if (subhalo->snapshot != descendant_subhalo->snapshot - 1) {
 		std::ostringstream os;
 		os << "Subhalo " << descendant_subhalo << " (snapshot " << subhalo->snapshot << ") ";
@@ -568,7 +697,9 @@ static std::vector<HaloPtr>::iterator find_by_id(std::vector<HaloPtr> &halos, Ha
 
 void HaloBasedTreeBuilder::loop_through_halos(std::vector<HaloPtr> &halos)
 {
+	TraceSpan span("link_halos");
 	sort_by_id(halos);
+	build_subhalo_index(halos);
 
 	// To find subhalos/halos that correspond to each other, we do the following
 	//  1. Iterate over snapshots in descending order
@@ -579,79 +710,140 @@ void HaloBasedTreeBuilder::loop_through_halos(std::vector<HaloPtr> &halos)
 	//     DSH inside DH that matches SH's descendant_id
 	//  6. Now we have SH, H, DSH and DH. We link them all together,
 	//     and to their tree
+	//
+	// Steps 3-5 only read the halos of later snapshots (and modify H), so they
+	// are carried out in parallel for all halos of a snapshot. The resulting
+	// links are then established serially, in the same order as they would
+	// have been by looping over the halos one by one.
+
+	// Bucket halos by snapshot (keeping them sorted by id), and skip the last
+	// snapshot; those were already processed and MergerTrees were built for them
+	std::map<int, std::vector<HaloPtr>> halos_by_snapshot;
+	for(const auto &halo: halos) {
+		halos_by_snapshot[halo->snapshot].push_back(halo);
+	}
+	if (!halos_by_snapshot.empty()) {
+		halos_by_snapshot.erase(std::prev(halos_by_snapshot.end()));
+	}
 
-	// Get all snapshots in the Halos and sort them in decreasing order
-	// (but skip the first one, those were already processed and MergerTrees
-	// were built for them)
-	std::vector<int> sorted_halo_snapshots;
-	{
-		std::set<int> halo_snapshots;
-		for(const auto &halo: halos) {
-			halo_snapshots.insert(halo->snapshot);
+	// Linking the halos of a snapshot in parallel relies on descendants being
+	// in later snapshots, so anything else is rejected upfront
+	std::vector<std::exception_ptr> descendant_errors(halos.size());
+	omp_dynamic_for(std::size_t(0), halos.size(), get_threads(), 100, [&](std::size_t i, unsigned int thread_idx) {
+		const auto &halo = halos[i];
+		for(const auto &subhalo: halo->all_subhalos()) {
+			if (!subhalo->has_descendant) {
+				continue;
+			}
+			auto descendant_halo_position = find_by_id(halos, subhalo->descendant_halo_id);
+			if (descendant_halo_position != halos.end() && (*descendant_halo_position)->snapshot <= halo->snapshot) {
+				std::ostringstream os;
+				os << subhalo << " points to descendant halo " << *descendant_halo_position;
+				os << ", which is not in a later snapshot";
+				descendant_errors[i] = std::make_exception_ptr(invalid_data(os.str()));
+				return;
+			}
+		}
+	});
+	for(auto &error: descendant_errors) {
+		if (error) {
+			std::rethrow_exception(error);
 		}
-		sorted_halo_snapshots = std::vector<int>(++(halo_snapshots.rbegin()), halo_snapshots.rend());
 	}
 
-	// Loop as per instructions above
-	Timer t;
-	for(int snapshot: sorted_halo_snapshots) {
-
-		LOG(info) << "Linking Halos/Subhalos at snapshot " << snapshot;
-
+	// The links found for a halo, plus whether it was ignored
+	struct halo_links {
+		struct subhalo_link {
+			SubhaloPtr subhalo;
+			SubhaloPtr descendant_subhalo;
+			HaloPtr descendant_halo;
+		};
+		std::vector<subhalo_link> links;
 		int ignored = 0;
-		auto halos_in_snapshot = make_range_filter(halos, in_snapshot(snapshot));
-		for(auto &halo: halos_in_snapshot) {
-			bool halo_linked = false;
-			for(const auto &subhalo: halo->all_subhalos()) {
-
-				// this subhalo has no descendants, let's not even try
-				if (!subhalo->has_descendant) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " has no descendant, not following";
-					}
-					halo->remove_subhalo(subhalo);
-					continue;
-				}
+		std::exception_ptr error;
+	};
 
-				// if the descendant halo is not found, we don't consider this
-				// halo anymore (and all its progenitors)
-				auto descendant_halo_position = find_by_id(halos, subhalo->descendant_halo_id);
-				if (descendant_halo_position == halos.end()) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " points to descendant halo/subhalo "
-						           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
-						           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
-					}
-					ignored++;
-					break;
-				}
-				auto descendant_halo = *descendant_halo_position;
-				// hasn't been put in any merger tree, so it was ignored
-				if (!descendant_halo->merger_tree) {
-					continue;
-				}
+	auto find_links = [&](const HaloPtr &halo, halo_links &halo_links) {
+		bool halo_linked = false;
+		for(const auto &subhalo: halo->all_subhalos()) {
 
-				auto descendant_subhalo = find_descendant_subhalo(halo, subhalo, descendant_halo);
-				if (descendant_subhalo) {
-					link(subhalo, descendant_subhalo, halo, descendant_halo);
-					halo_linked = true;
+			// this subhalo has no descendants, let's not even try
+			if (!subhalo->has_descendant) {
+				if (LOG_ENABLED(debug)) {
+					LOG(debug) << subhalo << " has no descendant, not following";
 				}
+				remove_subhalo(halo, subhalo);
+				continue;
 			}
 
-			// If no subhalos were linked, this Halo will not have been linked,
-			// meaning that it also needs to be ignored
-			if (!halo_linked) {
+			// if the descendant halo is not found, we don't consider this
+			// halo anymore (and all its progenitors)
+			auto descendant_halo_position = find_by_id(halos, subhalo->descendant_halo_id);
+			if (descendant_halo_position == halos.end()) {
 				if (LOG_ENABLED(debug)) {
-					LOG(debug) << halo << " doesn't contain any Subhalo pointing to"
-					           << " descendants, ignoring it (and the rest of its progenitors)";
+					LOG(debug) << subhalo << " points to descendant halo/subhalo "
+					           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
+					           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
 				}
-				ignored++;
+				halo_links.ignored++;
+				break;
+			}
+			auto descendant_halo = *descendant_halo_position;
+			// hasn't been put in any merger tree, so it was ignored
+			if (!descendant_halo->merger_tree) {
+				continue;
+			}
+
+			auto descendant_subhalo = find_descendant_subhalo(halo, subhalo, descendant_halo);
+			if (descendant_subhalo) {
+				halo_links.links.push_back({subhalo, descendant_subhalo, descendant_halo});
+				halo_linked = true;
 			}
+		}
+
+		// If no subhalos were linked, this Halo will not have been linked,
+		// meaning that it also needs to be ignored
+		if (!halo_linked) {
+			if (LOG_ENABLED(debug)) {
+				LOG(debug) << halo << " doesn't contain any Subhalo pointing to"
+				           << " descendants, ignoring it (and the rest of its progenitors)";
+			}
+			halo_links.ignored++;
+		}
+	};
 
+	// Loop as per instructions above
+	Timer t;
+	for(auto it = halos_by_snapshot.rbegin(); it != halos_by_snapshot.rend(); it++) {
+
+		auto snapshot = it->first;
+		const auto &halos_in_snapshot = it->second;
+		LOG(info) << "Linking Halos/Subhalos at snapshot " << snapshot;
+
+		auto n_snapshot_halos = halos_in_snapshot.size();
+		std::vector<halo_links> snapshot_links(n_snapshot_halos);
+		omp_dynamic_for(std::size_t(0), n_snapshot_halos, get_threads(), 100, [&](std::size_t i, unsigned int thread_idx) {
+			try {
+				find_links(halos_in_snapshot[i], snapshot_links[i]);
+			}
+			catch (...) {
+				snapshot_links[i].error = std::current_exception();
+			}
+		});
+
+		int ignored = 0;
+		for(std::size_t i = 0; i != n_snapshot_halos; i++) {
+			auto &halo_links = snapshot_links[i];
+			if (halo_links.error) {
+				std::rethrow_exception(halo_links.error);
+			}
+			for(auto &link: halo_links.links) {
+				this->link(link.subhalo, link.descendant_subhalo, halos_in_snapshot[i], link.descendant_halo);
+			}
+			ignored += halo_links.ignored;
 		}
 
 		if (LOG_ENABLED(debug)) {
-			auto n_snapshot_halos = halos_in_snapshot.size();
 			LOG(debug) << ignored << "/" << n_snapshot_halos << " ("
 			           << std::setprecision(2) << std::setiosflags(std::ios::fixed)
 			           << ignored * 100. / n_snapshot_halos << "%)"
@@ -663,6 +855,8 @@ void HaloBasedTreeBuilder::loop_through_halos(std::vector<HaloPtr> &halos)
 	}
 
 	LOG(info) << "Linked all Halos/Subhalos in " << t;
+	subhalo_index.clear();
+	subhalo_index.shrink_to_fit();
 }
 
 
@@ -0,0 +1,1047 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * TreeCache implementation
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "halo.h"
+#include "logging.h"
+#include "mapped_file.h"
+#include "merger_tree.h"
+#include "subhalo.h"
+#include "timer.h"
+#include "total_baryon.h"
+#include "trace.h"
+#include "tree_cache.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace {
+
+//
+// On-disk layout. All records are explicitly padded to multiples of 8 bytes
+// so sections can be laid out one after the other and read in place.
+// Links between components are expressed as indices into the corresponding
+// section (-1 meaning "no link").
+//
+constexpr char MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'T', 'R', 'C'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct cache_header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order_mark;
+	std::uint64_t key;
+	std::uint64_t n_trees;
+	std::uint64_t n_halos;
+	std::uint64_t n_subhalos;
+	std::uint64_t n_halo_links;
+	std::uint64_t n_subhalo_links;
+	std::uint64_t n_baryon_entries;
+};
+
+struct cached_tree {
+	std::int64_t n_halos;
+	std::int32_t id;
+	std::int32_t last_snapshot;
+};
+
+struct cached_halo {
+	std::int64_t id;
+	std::int64_t descendant;
+	std::int64_t first_subhalo;
+	std::int64_t n_subhalos;
+	std::int64_t first_ascendant;
+	std::int64_t n_ascendants;
+	float position[3];
+	float velocity[3];
+	float mass_fraction_subhalos;
+	float Vvir;
+	float Mvir;
+	float Mgas;
+	float concentration;
+	float lambda;
+	float age_80;
+	float age_50;
+	float excess_jetfeedback;
+	std::int32_t snapshot;
+	std::uint8_t has_central;
+	std::uint8_t ignore_gal_formation;
+	std::uint8_t hydrostatic_eq;
+	std::uint8_t padding[5];
+};
+
+struct cached_subhalo {
+	std::int64_t id;
+	std::int64_t descendant_id;
+	std::int64_t descendant_halo_id;
+	std::int64_t haloID;
+	std::int64_t descendant;
+	std::int64_t first_ascendant;
+	std::int64_t n_ascendants;
+	float position[3];
+	float velocity[3];
+	float L[3];
+	float Vvir;
+	float Mvir;
+	float Mgas;
+	float Vcirc;
+	float concentration;
+	float lambda;
+	float infall_t;
+	float Mvir_infall;
+	float rvir_infall;
+	float hot_halo_gas_r_rps;
+	float accreted_mass;
+	std::int32_t Npart;
+	std::int32_t snapshot;
+	std::int32_t descendant_snapshot;
+	std::int32_t last_snapshot_identified;
+	std::int32_t subhalo_type;
+	std::uint8_t has_descendant;
+	std::uint8_t main_progenitor;
+	std::uint8_t IsInterpolated;
+	std::uint8_t padding[1];
+};
+
+struct cached_baryon_entry {
+	std::int32_t snapshot;
+	std::int32_t padding;
+	double mass;
+};
+
+template <typename T>
+struct is_cache_record {
+	static constexpr bool value = std::is_trivially_copyable<T>::value && sizeof(T) % 8 == 0;
+};
+static_assert(is_cache_record<cache_header>::value, "invalid cache_header layout");
+static_assert(is_cache_record<cached_tree>::value, "invalid cached_tree layout");
+static_assert(is_cache_record<cached_halo>::value, "invalid cached_halo layout");
+static_assert(is_cache_record<cached_subhalo>::value, "invalid cached_subhalo layout");
+static_assert(is_cache_record<cached_baryon_entry>::value, "invalid cached_baryon_entry layout");
+
+template <typename T>
+void write_records(std::ofstream &f, const std::vector<T> &records)
+{
+	f.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T));
+}
+
+template <typename T>
+const T *read_records(const MappedFile &file, std::size_t &offset, std::uint64_t n_records)
+{
+	auto size = n_records * sizeof(T);
+	if (offset + size > file.size()) {
+		return nullptr;
+	}
+	auto records = file.at<T>(offset);
+	offset += size;
+	return records;
+}
+
+/// Pointers to the different sections of a cache file
+struct cache_sections {
+	const cache_header *header;
+	const cached_tree *trees;
+	const cached_halo *halos;
+	const cached_subhalo *subhalos;
+	const std::int64_t *halo_links;
+	const std::int64_t *subhalo_links;
+	const cached_baryon_entry *baryon_entries;
+};
+
+/// The records of a set of merger trees, laid out as in cache files
+struct cache_records {
+	cache_header header;
+	std::vector<cached_tree> trees;
+	std::vector<cached_halo> halos;
+	std::vector<cached_subhalo> subhalos;
+	std::vector<std::int64_t> halo_links;
+	std::vector<std::int64_t> subhalo_links;
+	std::vector<cached_baryon_entry> baryon_entries;
+
+	cache_sections sections() const
+	{
+		return {&header, trees.data(), halos.data(), subhalos.data(), halo_links.data(), subhalo_links.data(), baryon_entries.data()};
+	}
+};
+
+/// Whether the records [first, first + n) lie within a section of @p size records
+bool in_range(std::int64_t first, std::int64_t n, std::uint64_t size)
+{
+	return first >= 0 && n >= 0 && std::uint64_t(first) <= size && std::uint64_t(n) <= size - std::uint64_t(first);
+}
+
+/// Whether @p idx is either -1 ("no link") or a valid index into a section of @p size records
+bool valid_link(std::int64_t idx, std::uint64_t size)
+{
+	return idx == -1 || (idx >= 0 && std::uint64_t(idx) < size);
+}
+
+/// Checks that all indices stored in the records of @p sections point within their sections
+bool check_indices(const cache_sections &sections)
+{
+	const auto &header = *sections.header;
+	std::uint64_t tree_halos = 0;
+	for (std::size_t i = 0; i != header.n_trees; i++) {
+		auto n_halos = sections.trees[i].n_halos;
+		if (!in_range(std::int64_t(tree_halos), n_halos, header.n_halos)) {
+			return false;
+		}
+		tree_halos += std::uint64_t(n_halos);
+	}
+	for (std::size_t i = 0; i != header.n_halos; i++) {
+		const auto &c_halo = sections.halos[i];
+		if (!valid_link(c_halo.descendant, header.n_halos) ||
+		    !in_range(c_halo.first_subhalo, c_halo.n_subhalos, header.n_subhalos) ||
+		    !in_range(c_halo.first_ascendant, c_halo.n_ascendants, header.n_halo_links)) {
+			return false;
+		}
+	}
+	for (std::size_t i = 0; i != header.n_subhalos; i++) {
+		const auto &c_subhalo = sections.subhalos[i];
+		if (!valid_link(c_subhalo.descendant, header.n_subhalos) ||
+		    !in_range(c_subhalo.first_ascendant, c_subhalo.n_ascendants, header.n_subhalo_links)) {
+			return false;
+		}
+	}
+	for (std::size_t i = 0; i != header.n_halo_links; i++) {
+		if (!valid_link(sections.halo_links[i], header.n_halos)) {
+			return false;
+		}
+	}
+	for (std::size_t i = 0; i != header.n_subhalo_links; i++) {
+		if (!valid_link(sections.subhalo_links[i], header.n_subhalos)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Checks that @p file is a valid cache file for @p key and finds its sections
+bool read_sections(const MappedFile &file, const std::string &filename, std::uint64_t key, cache_sections &sections)
+{
+	if (file.size() < sizeof(cache_header)) {
+		LOG(warning) << "Ignoring truncated tree cache " << filename;
+		return false;
+	}
+	const auto &header = *file.at<cache_header>(0);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byte_order_mark != BYTE_ORDER_MARK) {
+		LOG(warning) << "Ignoring " << filename << ", it is not a tree cache file for this platform";
+		return false;
+	}
+	if (header.version != TreeCache::VERSION) {
+		LOG(warning) << "Ignoring tree cache " << filename << " with version " << header.version
+		             << " (expected " << TreeCache::VERSION << ")";
+		return false;
+	}
+	if (header.key != key) {
+		LOG(warning) << "Ignoring tree cache " << filename << ", its key doesn't match";
+		return false;
+	}
+
+	std::size_t offset = sizeof(cache_header);
+	sections.header = &header;
+	sections.trees = read_records<cached_tree>(file, offset, header.n_trees);
+	sections.halos = read_records<cached_halo>(file, offset, header.n_halos);
+	sections.subhalos = read_records<cached_subhalo>(file, offset, header.n_subhalos);
+	sections.halo_links = read_records<std::int64_t>(file, offset, header.n_halo_links);
+	sections.subhalo_links = read_records<std::int64_t>(file, offset, header.n_subhalo_links);
+	sections.baryon_entries = read_records<cached_baryon_entry>(file, offset, header.n_baryon_entries);
+	if (!sections.trees || !sections.halos || !sections.subhalos || !sections.halo_links ||
+	    !sections.subhalo_links || !sections.baryon_entries || offset != file.size() ||
+	    !check_indices(sections)) {
+		LOG(warning) << "Ignoring corrupted tree cache " << filename;
+		return false;
+	}
+	return true;
+}
+
+/// Creates a Halo (without links) out of its cached version
+HaloPtr make_halo(const cached_halo &c_halo)
+{
+	auto halo = std::make_shared<Halo>(c_halo.id, c_halo.snapshot);
+	halo->position = {c_halo.position[0], c_halo.position[1], c_halo.position[2]};
+	halo->velocity = {c_halo.velocity[0], c_halo.velocity[1], c_halo.velocity[2]};
+	halo->mass_fraction_subhalos = c_halo.mass_fraction_subhalos;
+	halo->Vvir = c_halo.Vvir;
+	halo->Mvir = c_halo.Mvir;
+	halo->Mgas = c_halo.Mgas;
+	halo->concentration = c_halo.concentration;
+	halo->lambda = c_halo.lambda;
+	halo->age_80 = c_halo.age_80;
+	halo->age_50 = c_halo.age_50;
+	halo->excess_jetfeedback = c_halo.excess_jetfeedback;
+	halo->ignore_gal_formation = c_halo.ignore_gal_formation;
+	halo->hydrostatic_eq = c_halo.hydrostatic_eq;
+	return halo;
+}
+
+/// Creates a Subhalo (without links) out of its cached version
+SubhaloPtr make_subhalo(const cached_subhalo &c_subhalo)
+{
+	auto subhalo = std::make_shared<Subhalo>(c_subhalo.id, c_subhalo.snapshot);
+	subhalo->position = {c_subhalo.position[0], c_subhalo.position[1], c_subhalo.position[2]};
+	subhalo->velocity = {c_subhalo.velocity[0], c_subhalo.velocity[1], c_subhalo.velocity[2]};
+	subhalo->L = {c_subhalo.L[0], c_subhalo.L[1], c_subhalo.L[2]};
+	subhalo->descendant_id = c_subhalo.descendant_id;
+	subhalo->descendant_halo_id = c_subhalo.descendant_halo_id;
+	subhalo->haloID = c_subhalo.haloID;
+	subhalo->Vvir = c_subhalo.Vvir;
+	subhalo->Mvir = c_subhalo.Mvir;
+	subhalo->Mgas = c_subhalo.Mgas;
+	subhalo->Npart = c_subhalo.Npart;
+	subhalo->Vcirc = c_subhalo.Vcirc;
+	subhalo->concentration = c_subhalo.concentration;
+	subhalo->lambda = c_subhalo.lambda;
+	subhalo->infall_t = c_subhalo.infall_t;
+	subhalo->Mvir_infall = c_subhalo.Mvir_infall;
+	subhalo->rvir_infall = c_subhalo.rvir_infall;
+	subhalo->hot_halo_gas_r_rps = c_subhalo.hot_halo_gas_r_rps;
+	subhalo->accreted_mass = c_subhalo.accreted_mass;
+	subhalo->descendant_snapshot = c_subhalo.descendant_snapshot;
+	subhalo->last_snapshot_identified = c_subhalo.last_snapshot_identified;
+	subhalo->subhalo_type = Subhalo::subhalo_type_t(c_subhalo.subhalo_type);
+	subhalo->has_descendant = c_subhalo.has_descendant;
+	subhalo->main_progenitor = c_subhalo.main_progenitor;
+	subhalo->IsInterpolated = c_subhalo.IsInterpolated;
+	return subhalo;
+}
+
+/// Adds @p subhalo to @p halo, the central subhalo going first in the cache
+void add_cached_subhalo(const HaloPtr &halo, SubhaloPtr &&subhalo, bool is_central)
+{
+	subhalo->host_halo = halo;
+	if (is_central) {
+		halo->central_subhalo = std::move(subhalo);
+	}
+	else {
+		halo->satellite_subhalos.emplace_back(std::move(subhalo));
+	}
+}
+
+void load_baryons(const cache_sections &sections, TotalBaryon &all_baryons)
+{
+	for (std::size_t i = 0; i != sections.header->n_baryon_entries; i++) {
+		all_baryons.baryon_total_created[sections.baryon_entries[i].snapshot] = sections.baryon_entries[i].mass;
+	}
+}
+
+/// Creates the merger trees, with all their halos and subhalos linked together,
+/// out of their cached version
+std::vector<MergerTreePtr> make_trees(const cache_sections &sections)
+{
+	const auto &header = *sections.header;
+	auto c_trees = sections.trees;
+	auto c_halos = sections.halos;
+	auto c_subhalos = sections.subhalos;
+	auto halo_links = sections.halo_links;
+	auto subhalo_links = sections.subhalo_links;
+
+	// First create all objects, then link them together
+	std::vector<HaloPtr> halos(header.n_halos);
+	std::vector<SubhaloPtr> subhalos(header.n_subhalos);
+	for (std::size_t i = 0; i != header.n_halos; i++) {
+		halos[i] = make_halo(c_halos[i]);
+	}
+	for (std::size_t i = 0; i != header.n_subhalos; i++) {
+		subhalos[i] = make_subhalo(c_subhalos[i]);
+	}
+
+	auto halo_at = [&](std::int64_t idx) -> HaloPtr {
+		if (idx < 0) {
+			return {};
+		}
+		return halos.at(std::size_t(idx));
+	};
+	auto subhalo_at = [&](std::int64_t idx) -> SubhaloPtr {
+		if (idx < 0) {
+			return {};
+		}
+		return subhalos.at(std::size_t(idx));
+	};
+
+	for (std::size_t i = 0; i != header.n_halos; i++) {
+		const auto &c_halo = c_halos[i];
+		auto &halo = halos[i];
+		halo->descendant = halo_at(c_halo.descendant);
+		halo->ascendants.reserve(c_halo.n_ascendants);
+		for (std::int64_t j = 0; j != c_halo.n_ascendants; j++) {
+			halo->ascendants.push_back(halo_at(halo_links[c_halo.first_ascendant + j]));
+		}
+		// Central first (if any), then satellites in their original order
+		halo->satellite_subhalos.reserve(c_halo.n_subhalos);
+		for (std::int64_t j = 0; j != c_halo.n_subhalos; j++) {
+			add_cached_subhalo(halo, subhalo_at(c_halo.first_subhalo + j), j == 0 && c_halo.has_central);
+		}
+	}
+	for (std::size_t i = 0; i != header.n_subhalos; i++) {
+		const auto &c_subhalo = c_subhalos[i];
+		auto &subhalo = subhalos[i];
+		subhalo->descendant = subhalo_at(c_subhalo.descendant);
+		subhalo->ascendants.reserve(c_subhalo.n_ascendants);
+		for (std::int64_t j = 0; j != c_subhalo.n_ascendants; j++) {
+			subhalo->ascendants.push_back(subhalo_at(subhalo_links[c_subhalo.first_ascendant + j]));
+		}
+	}
+
+	std::vector<MergerTreePtr> loaded_trees;
+	loaded_trees.reserve(header.n_trees);
+	std::size_t halo_idx = 0;
+	for (std::size_t i = 0; i != header.n_trees; i++) {
+		const auto &c_tree = c_trees[i];
+		auto tree = std::make_shared<MergerTree>(c_tree.id);
+		tree->last_snapshot = c_tree.last_snapshot;
+		for (std::int64_t j = 0; j != c_tree.n_halos; j++) {
+			auto &halo = halos.at(halo_idx++);
+			halo->merger_tree = tree;
+			tree->add_halo(halo);
+		}
+		tree->index_snapshots();
+		loaded_trees.emplace_back(std::move(tree));
+	}
+	return loaded_trees;
+}
+
+/// Lays out @p trees (which must not contain galaxies yet) and the baryon
+/// bookkeeping of @p all_baryons as cache records
+cache_records make_records(const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons, std::uint64_t key)
+{
+	// Assign an index to each halo and subhalo. Halos are laid out in tree
+	// order, and subhalos in halo order, central subhalo first
+	std::unordered_map<const Halo *, std::int64_t> halo_indices;
+	std::unordered_map<const Subhalo *, std::int64_t> subhalo_indices;
+	for (auto &tree: trees) {
+		for (auto &halo: tree->get_halos()) {
+			halo_indices.emplace(halo.get(), std::int64_t(halo_indices.size()));
+			if (halo->central_subhalo) {
+				subhalo_indices.emplace(halo->central_subhalo.get(), std::int64_t(subhalo_indices.size()));
+			}
+			for (auto &subhalo: halo->satellite_subhalos) {
+				subhalo_indices.emplace(subhalo.get(), std::int64_t(subhalo_indices.size()));
+			}
+		}
+	}
+
+	auto halo_index = [&](const HaloPtr &halo) -> std::int64_t {
+		if (!halo) {
+			return -1;
+		}
+		auto it = halo_indices.find(halo.get());
+		if (it == halo_indices.end()) {
+			std::ostringstream os;
+			os << halo << " is not part of any merger tree, cannot cache trees";
+			throw invalid_data(os.str());
+		}
+		return it->second;
+	};
+	auto subhalo_index = [&](const SubhaloPtr &subhalo) -> std::int64_t {
+		if (!subhalo) {
+			return -1;
+		}
+		auto it = subhalo_indices.find(subhalo.get());
+		if (it == subhalo_indices.end()) {
+			std::ostringstream os;
+			os << subhalo << " is not part of any merger tree, cannot cache trees";
+			throw invalid_data(os.str());
+		}
+		return it->second;
+	};
+
+	std::vector<cached_tree> c_trees;
+	std::vector<cached_halo> c_halos;
+	std::vector<cached_subhalo> c_subhalos;
+	std::vector<std::int64_t> halo_links;
+	std::vector<std::int64_t> subhalo_links;
+	c_trees.reserve(trees.size());
+	c_halos.reserve(halo_indices.size());
+	c_subhalos.reserve(subhalo_indices.size());
+
+	auto add_subhalo = [&](const SubhaloPtr &subhalo) {
+		if (!subhalo->galaxies.empty()) {
+			std::ostringstream os;
+			os << subhalo << " already contains galaxies, cannot cache trees";
+			throw invalid_data(os.str());
+		}
+		cached_subhalo c_subhalo;
+		std::memset(&c_subhalo, 0, sizeof(c_subhalo));
+		c_subhalo.id = subhalo->id;
+		c_subhalo.descendant_id = subhalo->descendant_id;
+		c_subhalo.descendant_halo_id = subhalo->descendant_halo_id;
+		c_subhalo.haloID = subhalo->haloID;
+		c_subhalo.descendant = subhalo_index(subhalo->descendant);
+		c_subhalo.first_ascendant = std::int64_t(subhalo_links.size());
+		c_subhalo.n_ascendants = std::int64_t(subhalo->ascendants.size());
+		for (auto &ascendant: subhalo->ascendants) {
+			subhalo_links.push_back(subhalo_index(ascendant));
+		}
+		c_subhalo.position[0] = subhalo->position.x;
+		c_subhalo.position[1] = subhalo->position.y;
+		c_subhalo.position[2] = subhalo->position.z;
+		c_subhalo.velocity[0] = subhalo->velocity.x;
+		c_subhalo.velocity[1] = subhalo->velocity.y;
+		c_subhalo.velocity[2] = subhalo->velocity.z;
+		c_subhalo.L[0] = subhalo->L.x;
+		c_subhalo.L[1] = subhalo->L.y;
+		c_subhalo.L[2] = subhalo->L.z;
+		c_subhalo.Vvir = subhalo->Vvir;
+		c_subhalo.Mvir = subhalo->Mvir;
+		c_subhalo.Mgas = subhalo->Mgas;
+		c_subhalo.Vcirc = subhalo->Vcirc;
+		c_subhalo.concentration = subhalo->concentration;
+		c_subhalo.lambda = subhalo->lambda;
+		c_subhalo.infall_t = subhalo->infall_t;
+		c_subhalo.Mvir_infall = subhalo->Mvir_infall;
+		c_subhalo.rvir_infall = subhalo->rvir_infall;
+		c_subhalo.hot_halo_gas_r_rps = subhalo->hot_halo_gas_r_rps;
+		c_subhalo.accreted_mass = subhalo->accreted_mass;
+		c_subhalo.Npart = subhalo->Npart;
+		c_subhalo.snapshot = subhalo->snapshot;
+		c_subhalo.descendant_snapshot = subhalo->descendant_snapshot;
+		c_subhalo.last_snapshot_identified = subhalo->last_snapshot_identified;
+		c_subhalo.subhalo_type = subhalo->subhalo_type;
+		c_subhalo.has_descendant = subhalo->has_descendant;
+		c_subhalo.main_progenitor = subhalo->main_progenitor;
+		c_subhalo.IsInterpolated = subhalo->IsInterpolated;
+		c_subhalos.push_back(c_subhalo);
+	};
+
+	for (auto &tree: trees) {
+		cached_tree c_tree;
+		std::memset(&c_tree, 0, sizeof(c_tree));
+		c_tree.id = tree->id;
+		c_tree.last_snapshot = tree->last_snapshot;
+		c_tree.n_halos = std::int64_t(tree->get_halos().size());
+		c_trees.push_back(c_tree);
+
+		for (auto &halo: tree->get_halos()) {
+			cached_halo c_halo;
+			std::memset(&c_halo, 0, sizeof(c_halo));
+			c_halo.id = halo->id;
+			c_halo.descendant = halo_index(halo->descendant);
+			c_halo.first_ascendant = std::int64_t(halo_links.size());
+			c_halo.n_ascendants = std::int64_t(halo->ascendants.size());
+			for (auto &ascendant: halo->ascendants) {
+				halo_links.push_back(halo_index(ascendant));
+			}
+			c_halo.first_subhalo = std::int64_t(c_subhalos.size());
+			c_halo.n_subhalos = std::int64_t(halo->subhalo_count());
+			c_halo.has_central = bool(halo->central_subhalo);
+			c_halo.position[0] = halo->position.x;
+			c_halo.position[1] = halo->position.y;
+			c_halo.position[2] = halo->position.z;
+			c_halo.velocity[0] = halo->velocity.x;
+			c_halo.velocity[1] = halo->velocity.y;
+			c_halo.velocity[2] = halo->velocity.z;
+			c_halo.mass_fraction_subhalos = halo->mass_fraction_subhalos;
+			c_halo.Vvir = halo->Vvir;
+			c_halo.Mvir = halo->Mvir;
+			c_halo.Mgas = halo->Mgas;
+			c_halo.concentration = halo->concentration;
+			c_halo.lambda = halo->lambda;
+			c_halo.age_80 = halo->age_80;
+			c_halo.age_50 = halo->age_50;
+			c_halo.excess_jetfeedback = halo->excess_jetfeedback;
+			c_halo.snapshot = halo->snapshot;
+			c_halo.ignore_gal_formation = halo->ignore_gal_formation;
+			c_halo.hydrostatic_eq = halo->hydrostatic_eq;
+			c_halos.push_back(c_halo);
+
+			if (halo->central_subhalo) {
+				add_subhalo(halo->central_subhalo);
+			}
+			for (auto &subhalo: halo->satellite_subhalos) {
+				add_subhalo(subhalo);
+			}
+		}
+	}
+
+	std::vector<cached_baryon_entry> baryon_entries;
+	for (auto &entry: all_baryons.baryon_total_created) {
+		cached_baryon_entry c_entry;
+		std::memset(&c_entry, 0, sizeof(c_entry));
+		c_entry.snapshot = entry.first;
+		c_entry.mass = entry.second;
+		baryon_entries.push_back(c_entry);
+	}
+
+	cache_header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = TreeCache::VERSION;
+	header.byte_order_mark = BYTE_ORDER_MARK;
+	header.key = key;
+	header.n_trees = c_trees.size();
+	header.n_halos = c_halos.size();
+	header.n_subhalos = c_subhalos.size();
+	header.n_halo_links = halo_links.size();
+	header.n_subhalo_links = subhalo_links.size();
+	header.n_baryon_entries = baryon_entries.size();
+
+	return {header, std::move(c_trees), std::move(c_halos), std::move(c_subhalos), std::move(halo_links), std::move(subhalo_links), std::move(baryon_entries)};
+}
+
+}  // anonymous namespace
+
+const std::uint32_t TreeCache::VERSION;
+
+TreeCache::TreeCache(const std::string &cache_dir, const Options &options, const ExecutionParameters &exec_params, const std::vector<std::string> &input_files)
+{
+	Timer t;
+	hasher h;
+	h.update_value(VERSION);
+
+	// All the options of these groups influence how halos are read and trees are built
+	for (auto &group: {"cosmology", "dark_matter_halo", "simulation"}) {
+		for (auto &option: options.get_group(group)) {
+			h.update(option.first);
+			h.update(option.second);
+		}
+	}
+
+	// From the execution group only a handful of them do, including the seed,
+	// which might have been randomly generated
+	h.update_value(exec_params.seed);
+	for (auto batch: exec_params.simulation_batches) {
+		h.update_value(batch);
+	}
+	h.update_value(exec_params.output_snapshots.empty() ? -1 : *exec_params.output_snapshots.rbegin());
+	h.update_value(exec_params.skip_missing_descendants);
+	h.update_value(exec_params.ensure_mass_growth);
+	h.update_value(exec_params.ignore_late_massive_halos);
+	h.update_value(exec_params.ignore_npart_threshold);
+	h.update_value(exec_params.ignore_below_z);
+
+	// All input files, identified by their name, size and modification time.
+	// Reading their full contents takes about as long as importing them,
+	// so it's done only if requested
+	std::string redshift_file;
+	options.load("simulation.redshift_file", redshift_file);
+	std::vector<std::string> all_input_files(input_files);
+	if (!redshift_file.empty()) {
+		all_input_files.push_back(redshift_file);
+	}
+	h.update_value(exec_params.tree_cache_checksums);
+	for (auto &input_file: all_input_files) {
+		h.update(input_file);
+		if (exec_params.tree_cache_checksums) {
+			h.update_file(input_file);
+			continue;
+		}
+		boost::system::error_code ec;
+		auto size = boost::filesystem::file_size(input_file, ec);
+		if (ec) {
+			throw invalid_argument("Cannot access " + input_file + " to compute the tree cache key: " + ec.message());
+		}
+		h.update_value(static_cast<std::uint64_t>(size));
+		h.update_value(static_cast<std::int64_t>(boost::filesystem::last_write_time(input_file)));
+	}
+
+	key = h.digest();
+	std::ostringstream os;
+	os << std::hex << std::setw(16) << std::setfill('0') << key;
+	filename = cache_dir + "/trees-" + os.str() + ".bin";
+	LOG(info) << "Tree cache key " << os.str() << " computed in " << t;
+}
+
+bool TreeCache::load(std::vector<MergerTreePtr> &trees, TotalBaryon &all_baryons) const
+{
+	TraceSpan span("load_tree_cache");
+	if (!boost::filesystem::exists(filename)) {
+		LOG(info) << "No tree cache found at " << filename;
+		return false;
+	}
+
+	Timer t;
+	MappedFile file(filename);
+	cache_sections sections;
+	if (!read_sections(file, filename, key, sections)) {
+		return false;
+	}
+	trees = make_trees(sections);
+	load_baryons(sections, all_baryons);
+	LOG(info) << trees.size() << " Merger trees (" << sections.header->n_halos << " halos, " << sections.header->n_subhalos
+	          << " subhalos) loaded from tree cache " << filename << " in " << t;
+	return true;
+}
+
+void TreeCache::store(const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons) const
+{
+	TraceSpan span("store_tree_cache");
+	Timer t;
+	auto records = make_records(trees, all_baryons, key);
+
+	// Write into a temporary file first, then move it into place, so readers
+	// never see a half-written cache
+	boost::filesystem::path cache_path(filename);
+	auto cache_dir = cache_path.parent_path();
+	if (!cache_dir.empty() && !boost::filesystem::exists(cache_dir)) {
+		boost::filesystem::create_directories(cache_dir);
+	}
+	std::ostringstream tmp_filename;
+	tmp_filename << filename << ".tmp." << std::random_device()();
+	{
+		std::ofstream f(tmp_filename.str(), std::ios::binary | std::ios::trunc);
+		f.write(reinterpret_cast<const char *>(&records.header), sizeof(records.header));
+		write_records(f, records.trees);
+		write_records(f, records.halos);
+		write_records(f, records.subhalos);
+		write_records(f, records.halo_links);
+		write_records(f, records.subhalo_links);
+		write_records(f, records.baryon_entries);
+		if (!f) {
+			std::remove(tmp_filename.str().c_str());
+			throw exception("Error while writing tree cache " + tmp_filename.str());
+		}
+	}
+	boost::filesystem::rename(tmp_filename.str(), cache_path);
+
+	LOG(info) << "Stored " << trees.size() << " merger trees in tree cache " << filename
+	          << " (" << memory_amount(boost::filesystem::file_size(cache_path)) << ") in " << t;
+}
+
+class TreeImage::impl {
+public:
+	cache_records records;
+};
+
+TreeImage::TreeImage(const std::vector<MergerTreePtr> &trees, const TotalBaryon &all_baryons) :
+	pimpl(new impl {make_records(trees, all_baryons, 0)})
+{
+}
+
+TreeImage::~TreeImage() = default;
+
+std::vector<MergerTreePtr> TreeImage::restore(TotalBaryon &all_baryons) const
+{
+	auto sections = pimpl->records.sections();
+	load_baryons(sections, all_baryons);
+	return make_trees(sections);
+}
+
+std::size_t TreeImage::size() const
+{
+	auto &records = pimpl->records;
+	return sizeof(records.header) + records.trees.size() * sizeof(cached_tree) +
+	       records.halos.size() * sizeof(cached_halo) + records.subhalos.size() * sizeof(cached_subhalo) +
+	       (records.halo_links.size() + records.subhalo_links.size()) * sizeof(std::int64_t) +
+	       records.baryon_entries.size() * sizeof(cached_baryon_entry);
+}
+
+class TreeCacheStream::impl {
+
+public:
+	impl(const std::string &filename) :
+		filename(filename), file(filename)
+	{
+	}
+
+	bool open(std::uint64_t key)
+	{
+		if (!read_sections(file, filename, key, sections)) {
+			return false;
+		}
+		std::int64_t first_halo = 0;
+		for (std::size_t i = 0; i != sections.header->n_trees; i++) {
+			const auto &c_tree = sections.trees[i];
+			auto tree = std::make_shared<MergerTree>(c_tree.id);
+			tree->last_snapshot = c_tree.last_snapshot;
+			trees.emplace_back(std::move(tree));
+			tree_first_halos.push_back(first_halo);
+			first_halo += c_tree.n_halos;
+		}
+		for (std::size_t i = 0; i != trees.size(); i++) {
+			auto last_halos = tree_halos(i, trees[i]->last_snapshot);
+			for (auto idx = last_halos.first; idx != last_halos.second; idx++) {
+				load_halo(idx);
+			}
+			trees[i]->index_snapshots();
+		}
+		return true;
+	}
+
+	std::vector<std::size_t> count_first_halos(int first_snapshot, int last_snapshot) const
+	{
+		std::vector<std::size_t> counts;
+		counts.reserve(trees.size());
+		for (std::size_t i = 0; i != trees.size(); i++) {
+			std::size_t count = 0;
+			auto first = tree_halos(i, first_snapshot).first;
+			auto last = tree_halos(i, last_snapshot).second;
+			for (auto idx = first; idx < last; idx++) {
+				count += is_first_halo(idx);
+			}
+			counts.push_back(count);
+		}
+		return counts;
+	}
+
+	std::vector<HaloPtr> first_halos(int snapshot) const
+	{
+		std::vector<HaloPtr> first_halos;
+		for (std::size_t i = 0; i != trees.size(); i++) {
+			auto snapshot_halos = tree_halos(i, snapshot);
+			for (auto idx = snapshot_halos.first; idx != snapshot_halos.second; idx++) {
+				if (is_first_halo(idx)) {
+					first_halos.push_back(halos.at(idx));
+				}
+			}
+		}
+		return first_halos;
+	}
+
+	void load_snapshot(int snapshot)
+	{
+		std::vector<std::int64_t> linked_halos;
+		std::vector<std::int64_t> linked_subhalos;
+		for (std::size_t i = 0; i != trees.size(); i++) {
+			auto snapshot_halos = tree_halos(i, snapshot);
+			for (auto idx = snapshot_halos.first; idx != snapshot_halos.second; idx++) {
+				load_halo(idx);
+			}
+
+			// Descendants can be found more than one snapshot ahead,
+			// and need to be there before galaxies are transferred into them
+			for (auto idx = snapshot_halos.first; idx != snapshot_halos.second; idx++) {
+				const auto &c_halo = sections.halos[idx];
+				if (c_halo.descendant >= 0) {
+					halos.at(idx)->descendant = load_halo(c_halo.descendant);
+					linked_halos.push_back(c_halo.descendant);
+				}
+				for (std::int64_t j = 0; j != c_halo.n_subhalos; j++) {
+					auto subhalo_idx = c_halo.first_subhalo + j;
+					auto descendant_idx = sections.subhalos[subhalo_idx].descendant;
+					if (descendant_idx >= 0) {
+						subhalos.at(subhalo_idx)->descendant = load_subhalo(descendant_idx);
+						linked_subhalos.push_back(descendant_idx);
+					}
+				}
+			}
+		}
+
+		for (auto &tree: trees) {
+			tree->index_snapshots();
+		}
+
+		// Ascendants are given in their original order, but only include those
+		// that have been loaded already and are still around
+		sort_unique(linked_halos);
+		for (auto idx: linked_halos) {
+			const auto &c_halo = sections.halos[idx];
+			auto &ascendants = halos.at(idx)->ascendants;
+			ascendants.clear();
+			for (std::int64_t j = 0; j != c_halo.n_ascendants; j++) {
+				auto ascendant = halos.find(sections.halo_links[c_halo.first_ascendant + j]);
+				if (ascendant != halos.end() && ascendant->second->snapshot <= snapshot) {
+					ascendants.push_back(ascendant->second);
+				}
+			}
+		}
+		sort_unique(linked_subhalos);
+		for (auto idx: linked_subhalos) {
+			const auto &c_subhalo = sections.subhalos[idx];
+			auto &ascendants = subhalos.at(idx)->ascendants;
+			ascendants.clear();
+			for (std::int64_t j = 0; j != c_subhalo.n_ascendants; j++) {
+				auto ascendant = subhalos.find(sections.subhalo_links[c_subhalo.first_ascendant + j]);
+				if (ascendant != subhalos.end() && ascendant->second->snapshot <= snapshot) {
+					ascendants.push_back(ascendant->second);
+				}
+			}
+		}
+	}
+
+	void forget_snapshots(int snapshot)
+	{
+		for (auto it = halos.begin(); it != halos.end();) {
+			if (it->second->snapshot <= snapshot) {
+				halo_indices.erase(it->second.get());
+				it = halos.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+		for (auto it = subhalos.begin(); it != subhalos.end();) {
+			it = (it->second->snapshot <= snapshot ? subhalos.erase(it) : std::next(it));
+		}
+	}
+
+	std::string filename;
+	MappedFile file;
+	cache_sections sections;
+	std::vector<MergerTreePtr> trees;
+
+private:
+	std::vector<std::int64_t> tree_first_halos;
+
+	// Halos and subhalos currently loaded, indexed by their position in the cache
+	std::unordered_map<std::int64_t, HaloPtr> halos;
+	std::unordered_map<const Halo *, std::int64_t> halo_indices;
+	std::unordered_map<std::int64_t, SubhaloPtr> subhalos;
+
+	static void sort_unique(std::vector<std::int64_t> &indices)
+	{
+		std::sort(indices.begin(), indices.end());
+		indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+	}
+
+	bool is_first_halo(std::int64_t idx) const
+	{
+		const auto &c_halo = sections.halos[idx];
+		return c_halo.has_central && sections.subhalos[c_halo.first_subhalo].n_ascendants == 0;
+	}
+
+	/// The range of cache indices of the halos of tree @p tree_idx at @p snapshot
+	std::pair<std::int64_t, std::int64_t> tree_halos(std::size_t tree_idx, int snapshot) const
+	{
+		// Halos of each tree are sorted by snapshot
+		auto first = sections.halos + tree_first_halos[tree_idx];
+		auto last = first + sections.trees[tree_idx].n_halos;
+		first = std::lower_bound(first, last, snapshot, [](const cached_halo &c_halo, int s) {
+			return c_halo.snapshot < s;
+		});
+		last = std::upper_bound(first, last, snapshot, [](int s, const cached_halo &c_halo) {
+			return s < c_halo.snapshot;
+		});
+		return {first - sections.halos, last - sections.halos};
+	}
+
+	/// Returns the halo at cache index @p idx, creating it and its subhalos
+	/// and adding it to its tree if it was not loaded yet
+	HaloPtr load_halo(std::int64_t idx)
+	{
+		auto it = halos.find(idx);
+		if (it != halos.end()) {
+			return it->second;
+		}
+
+		const auto &c_halo = sections.halos[idx];
+		auto halo = make_halo(c_halo);
+		halo->satellite_subhalos.reserve(c_halo.n_subhalos);
+		for (std::int64_t j = 0; j != c_halo.n_subhalos; j++) {
+			auto subhalo_idx = c_halo.first_subhalo + j;
+			auto subhalo = make_subhalo(sections.subhalos[subhalo_idx]);
+			subhalos.emplace(subhalo_idx, subhalo);
+			add_cached_subhalo(halo, std::move(subhalo), j == 0 && c_halo.has_central);
+		}
+		halos.emplace(idx, halo);
+		halo_indices.emplace(halo.get(), idx);
+
+		// Keep the tree's halos sorted by snapshot, and in their cached order
+		// within each snapshot
+		auto tree_idx = std::distance(tree_first_halos.begin(), std::upper_bound(tree_first_halos.begin(), tree_first_halos.end(), idx)) - 1;
+		auto &tree = trees[tree_idx];
+		auto range = std::equal_range(tree->get_halos().begin(), tree->get_halos().end(), c_halo.snapshot, by_snapshot{});
+		auto position = std::upper_bound(range.first, range.second, idx, [&](std::int64_t i, const HaloPtr &other) {
+			return i < halo_indices.at(other.get());
+		});
+		halo->merger_tree = tree;
+		tree->insert_halo(position, halo);
+		return halo;
+	}
+
+	/// Returns the subhalo at cache index @p idx, loading its halo if needed
+	SubhaloPtr load_subhalo(std::int64_t idx)
+	{
+		auto it = subhalos.find(idx);
+		if (it != subhalos.end()) {
+			return it->second;
+		}
+
+		// Subhalos are stored in the order of their halos
+		auto last = sections.halos + sections.header->n_halos;
+		auto host = std::upper_bound(sections.halos, last, idx, [](std::int64_t i, const cached_halo &c_halo) {
+			return i < c_halo.first_subhalo;
+		}) - 1;
+		load_halo(host - sections.halos);
+		return subhalos.at(idx);
+	}
+};
+
+std::unique_ptr<TreeCacheStream> TreeCache::open_stream(TotalBaryon &all_baryons) const
+{
+	if (!boost::filesystem::exists(filename)) {
+		LOG(info) << "No tree cache found at " << filename;
+		return {};
+	}
+
+	Timer t;
+	std::unique_ptr<TreeCacheStream::impl> stream_impl(new TreeCacheStream::impl(filename));
+	if (!stream_impl->open(key)) {
+		return {};
+	}
+	load_baryons(stream_impl->sections, all_baryons);
+	LOG(info) << stream_impl->trees.size() << " Merger trees opened for streaming from tree cache " << filename << " in " << t;
+	return std::unique_ptr<TreeCacheStream>(new TreeCacheStream(std::move(stream_impl)));
+}
+
+TreeCacheStream::TreeCacheStream(std::unique_ptr<impl> &&pimpl) :
+	pimpl(std::move(pimpl))
+{
+}
+
+TreeCacheStream::~TreeCacheStream() = default;
+
+const std::vector<MergerTreePtr> &TreeCacheStream::get_trees() const
+{
+	return pimpl->trees;
+}
+
+std::vector<std::size_t> TreeCacheStream::count_first_halos(int first_snapshot, int last_snapshot) const
+{
+	return pimpl->count_first_halos(first_snapshot, last_snapshot);
+}
+
+std::vector<HaloPtr> TreeCacheStream::first_halos(int snapshot) const
+{
+	return pimpl->first_halos(snapshot);
+}
+
+void TreeCacheStream::load_snapshot(int snapshot)
+{
+	TraceSpan span("stream_snapshot", snapshot);
+	pimpl->load_snapshot(snapshot);
+}
+
+void TreeCacheStream::forget_snapshots(int snapshot)
+{
+	pimpl->forget_snapshots(snapshot);
+}
+
+}  // namespace shark
@@ -0,0 +1,351 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Tree cost model implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "halo.h"
+#include "tree_cost.h"
+
+namespace shark {
+
+namespace {
+
+using feature_vector = std::array<double, TreeCostModel::N_WEIGHTS>;
+
+/// @return The features of a tree as multiplied by the weights of a model
+feature_vector to_vector(const tree_features &features)
+{
+	return {1, features.subhalos, features.max_subhalos, features.mergers, features.depth, features.max_mvir};
+}
+
+std::ofstream open_for_writing(const std::string &filename, const std::string &description)
+{
+	auto dir = boost::filesystem::path(filename).parent_path();
+	if (!dir.empty() && !boost::filesystem::exists(dir)) {
+		boost::filesystem::create_directories(dir);
+	}
+	std::ofstream f(filename, std::ios::trunc);
+	if (!f) {
+		throw invalid_option("Cannot open " + description + " " + filename);
+	}
+	f << std::setprecision(std::numeric_limits<double>::max_digits10);
+	return f;
+}
+
+/**
+ * Solves the linear system @p a x = @p b by Gaussian elimination with
+ * partial pivoting, leaving x in @p b.
+ */
+void solve(std::array<feature_vector, TreeCostModel::N_WEIGHTS> &a, feature_vector &b)
+{
+	constexpr auto n = TreeCostModel::N_WEIGHTS;
+	for (std::size_t col = 0; col != n; col++) {
+		auto pivot = col;
+		for (std::size_t row = col + 1; row != n; row++) {
+			if (std::abs(a[row][col]) > std::abs(a[pivot][col])) {
+				pivot = row;
+			}
+		}
+		if (a[pivot][col] == 0) {
+			throw invalid_data("Tree timings are not enough to fit a tree cost model");
+		}
+		std::swap(a[col], a[pivot]);
+		std::swap(b[col], b[pivot]);
+		for (std::size_t row = col + 1; row != n; row++) {
+			auto factor = a[row][col] / a[col][col];
+			for (std::size_t k = col; k != n; k++) {
+				a[row][k] -= factor * a[col][k];
+			}
+			b[row] -= factor * b[col];
+		}
+	}
+	for (std::size_t col = n; col-- != 0;) {
+		for (std::size_t k = col + 1; k != n; k++) {
+			b[col] -= a[col][k] * b[k];
+		}
+		b[col] /= a[col][col];
+	}
+}
+
+}  // anonymous namespace
+
+tree_features get_tree_features(const MergerTree &tree)
+{
+	tree_features features;
+	if (tree.get_halos().empty()) {
+		return features;
+	}
+
+	// Halos are sorted by snapshot
+	int snapshot = tree.get_halos().front()->snapshot;
+	double snapshot_subhalos = 0;
+	for (auto &halo: tree.get_halos()) {
+		if (halo->snapshot != snapshot) {
+			features.max_subhalos = std::max(features.max_subhalos, snapshot_subhalos);
+			snapshot = halo->snapshot;
+			snapshot_subhalos = 0;
+		}
+		auto subhalos = double(halo->subhalo_count());
+		features.subhalos += subhalos;
+		snapshot_subhalos += subhalos;
+		if (halo->ascendants.size() > 1) {
+			features.mergers += double(halo->ascendants.size() - 1);
+		}
+		features.max_mvir = std::max(features.max_mvir, double(halo->Mvir) / 1e12);
+	}
+	features.max_subhalos = std::max(features.max_subhalos, snapshot_subhalos);
+	features.depth = tree.get_halos().back()->snapshot - tree.get_halos().front()->snapshot + 1;
+	return features;
+}
+
+void write_tree_timings(const std::string &filename, const tree_timings &timings)
+{
+	auto f = open_for_writing(filename, "tree timings file");
+	f << "# shark tree timings\n";
+	f << "# subvolumes";
+	for (auto subvolume: timings.subvolumes) {
+		f << ' ' << subvolume;
+	}
+	f << "\n# tree subhalos max_subhalos mergers depth max_mvir seconds\n";
+	for (auto &timing: timings.trees) {
+		auto &features = timing.features;
+		f << timing.tree_id << ' ' << features.subhalos << ' ' << features.max_subhalos << ' '
+		  << features.mergers << ' ' << features.depth << ' ' << features.max_mvir << ' '
+		  << timing.seconds << '\n';
+	}
+	f.close();
+	if (!f) {
+		throw exception("Error while writing tree timings file " + filename);
+	}
+}
+
+tree_timings read_tree_timings(const std::string &filename)
+{
+	std::ifstream f(filename);
+	if (!f) {
+		throw invalid_argument("Cannot open tree timings file " + filename);
+	}
+
+	tree_timings timings;
+	std::string line;
+	while (std::getline(f, line)) {
+		std::istringstream is(line);
+		if (line.compare(0, 13, "# subvolumes ") == 0) {
+			is.ignore(13);
+			unsigned int subvolume;
+			while (is >> subvolume) {
+				timings.subvolumes.push_back(subvolume);
+			}
+			continue;
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		tree_timing timing;
+		auto &features = timing.features;
+		is >> timing.tree_id >> features.subhalos >> features.max_subhalos >> features.mergers
+		   >> features.depth >> features.max_mvir >> timing.seconds;
+		if (!is) {
+			throw invalid_data("Invalid line in tree timings file " + filename + ": " + line);
+		}
+		timings.trees.push_back(timing);
+	}
+	return timings;
+}
+
+const std::array<const char *, TreeCostModel::N_WEIGHTS> TreeCostModel::WEIGHT_NAMES {
+	{"intercept", "subhalos", "max_subhalos", "mergers", "depth", "max_mvir"}
+};
+
+TreeCostModel::TreeCostModel(const std::string &filename)
+{
+	if (filename.empty()) {
+		return;
+	}
+	std::ifstream f(filename);
+	if (!f) {
+		throw invalid_option("Cannot open tree cost model " + filename);
+	}
+
+	std::array<bool, N_WEIGHTS> found {};
+	std::string line;
+	while (std::getline(f, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream is(line);
+		std::string name;
+		is >> name;
+		if (name == "subvolume") {
+			unsigned int subvolume;
+			double cost;
+			if (is >> subvolume >> cost) {
+				subvolume_costs[subvolume] = cost;
+				continue;
+			}
+		}
+		else {
+			auto it = std::find_if(WEIGHT_NAMES.begin(), WEIGHT_NAMES.end(), [&name](const char *weight_name) {
+				return name == weight_name;
+			});
+			auto i = std::size_t(std::distance(WEIGHT_NAMES.begin(), it));
+			if (it != WEIGHT_NAMES.end() && is >> weights[i]) {
+				found[i] = true;
+				continue;
+			}
+		}
+		throw invalid_data("Invalid line in tree cost model " + filename + ": " + line);
+	}
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		if (!found[i]) {
+			throw invalid_data("Tree cost model " + filename + " has no " + WEIGHT_NAMES[i] + " weight");
+		}
+	}
+	is_enabled = true;
+}
+
+TreeCostModel TreeCostModel::fit(const std::vector<tree_timings> &timings)
+{
+	// Features have very different magnitudes, so they are scaled
+	// to keep the normal equations well conditioned
+	feature_vector scales;
+	scales.fill(0);
+	std::size_t n_trees = 0;
+	for (auto &execution_timings: timings) {
+		for (auto &timing: execution_timings.trees) {
+			auto x = to_vector(timing.features);
+			for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+				scales[i] = std::max(scales[i], std::abs(x[i]));
+			}
+			n_trees++;
+		}
+	}
+	if (n_trees < N_WEIGHTS) {
+		throw invalid_data("At least " + std::to_string(N_WEIGHTS) + " tree timings are needed to fit a tree cost model");
+	}
+	for (auto &scale: scales) {
+		if (scale == 0) {
+			scale = 1;
+		}
+	}
+
+	std::array<feature_vector, N_WEIGHTS> a {};
+	feature_vector b {};
+	for (auto &execution_timings: timings) {
+		for (auto &timing: execution_timings.trees) {
+			auto x = to_vector(timing.features);
+			for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+				x[i] /= scales[i];
+			}
+			for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+				for (std::size_t j = 0; j != N_WEIGHTS; j++) {
+					a[i][j] += x[i] * x[j];
+				}
+				b[i] += x[i] * timing.seconds;
+			}
+		}
+	}
+
+	// A tiny ridge keeps features that are constant or collinear
+	// (e.g., all trees spanning all snapshots) from making the system singular
+	double trace = 0;
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		trace += a[i][i];
+	}
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		a[i][i] += 1e-9 * trace / N_WEIGHTS;
+	}
+	solve(a, b);
+
+	TreeCostModel model;
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		model.weights[i] = b[i] / scales[i];
+	}
+	model.is_enabled = true;
+
+	// Executions that evolved a single subvolume give its total cost
+	for (auto &execution_timings: timings) {
+		if (execution_timings.subvolumes.size() != 1) {
+			continue;
+		}
+		double cost = 0;
+		for (auto &timing: execution_timings.trees) {
+			cost += model.predict(timing.features);
+		}
+		auto &subvolume_cost = model.subvolume_costs[execution_timings.subvolumes.front()];
+		subvolume_cost = std::max(subvolume_cost, cost);
+	}
+	return model;
+}
+
+double TreeCostModel::predict(const tree_features &features) const
+{
+	auto x = to_vector(features);
+	double cost = 0;
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		cost += weights[i] * x[i];
+	}
+	return std::max(cost, 0.);
+}
+
+bool TreeCostModel::subvolume_cost(unsigned int subvolume, double &cost) const
+{
+	auto it = subvolume_costs.find(subvolume);
+	if (it == subvolume_costs.end()) {
+		return false;
+	}
+	cost = it->second;
+	return true;
+}
+
+void TreeCostModel::save(const std::string &filename) const
+{
+	auto f = open_for_writing(filename, "tree cost model");
+	f << "# shark tree cost model\n";
+	f << "# predicted time to evolve a tree [s] = intercept + sum of weight * feature\n";
+	for (std::size_t i = 0; i != N_WEIGHTS; i++) {
+		f << WEIGHT_NAMES[i] << ' ' << weights[i] << '\n';
+	}
+	if (!subvolume_costs.empty()) {
+		f << "# predicted time to evolve each subvolume on its own [s]\n";
+	}
+	for (auto &subvolume_and_cost: subvolume_costs) {
+		f << "subvolume " << subvolume_and_cost.first << ' ' << subvolume_and_cost.second << '\n';
+	}
+	f.close();
+	if (!f) {
+		throw exception("Error while writing tree cost model " + filename);
+	}
+}
+
+}  // namespace shark
@@ -33,12 +33,13 @@
 #include <string>
 #include <sstream>
 
-// gethostname, getrusage
+// gethostname, getrusage, task_info
 #ifdef _WIN32
 # include <windows.h> // include this first, others are not self-contained
 # include <psapi.h>
 # include <winsock.h>
 #elif defined(__MACH__)
+# include <mach/mach.h>
 # include <sys/resource.h>
 # include <unistd.h>
 #else // linux
@@ -127,16 +128,10 @@ std::string gethostname()
 }
 
 
-std::size_t peak_rss()
+#ifdef __linux__
+/// Reads a memory amount (e.g., VmHWM) from this process' status file
+static std::size_t read_proc_status_memory(const std::string &name)
 {
-#ifdef __MACH__
-	struct rusage ru;
-	int err = getrusage(RUSAGE_SELF, &ru);
-	if (err != 0) {
-		throw exception("Couldn't get resource usage");
-	}
-return ru.ru_maxrss;
-#elif defined(__linux__)
 	std::stringstream ss;
 	ss << "/proc/" << getpid() << "/status";
 	std::ifstream file(ss.str());
@@ -146,17 +141,31 @@ return ru.ru_maxrss;
 	while (file.good()) {
 		std::string token;
 		file >> token;
-		if (token == "VmHWM:") {
-			std::size_t rsspeak;
-			file >> rsspeak;
+		if (token == name) {
+			std::size_t amount;
+			file >> amount;
 			file >> token;
 			if (token != "kB") {
 				throw exception("Unexpected memory unit: " + token);
 			}
-			return rsspeak * 1024;
+			return amount * 1024;
 		}
 	}
-	throw exception("Didn't find highwater mark information in " + ss.str());
+	throw exception("Didn't find " + name + " information in " + ss.str());
+}
+#endif // __linux__
+
+std::size_t peak_rss()
+{
+#ifdef __MACH__
+	struct rusage ru;
+	int err = getrusage(RUSAGE_SELF, &ru);
+	if (err != 0) {
+		throw exception("Couldn't get resource usage");
+	}
+return ru.ru_maxrss;
+#elif defined(__linux__)
+	return read_proc_status_memory("VmHWM:");
 #else // windows
 	PROCESS_MEMORY_COUNTERS info;
 	if (!GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info))) {
@@ -166,4 +175,77 @@ return ru.ru_maxrss;
 #endif // __MACH__
 }
 
+std::size_t current_rss()
+{
+#ifdef __MACH__
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+		throw exception("Couldn't get task information");
+	}
+	return std::size_t(info.resident_size);
+#elif defined(__linux__)
+	return read_proc_status_memory("VmRSS:");
+#else // windows
+	PROCESS_MEMORY_COUNTERS info;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info))) {
+		throw exception("error when running GetProcessMemoryInfo()");
+	}
+	return std::size_t(info.WorkingSetSize);
+#endif // __MACH__
+}
+
+io_counters current_io()
+{
+	io_counters counters;
+#ifdef __linux__
+	std::stringstream ss;
+	ss << "/proc/" << getpid() << "/io";
+	std::ifstream file(ss.str());
+	std::string token;
+	while (file >> token) {
+		if (token == "rchar:") {
+			file >> counters.bytes_read;
+		}
+		else if (token == "wchar:") {
+			file >> counters.bytes_written;
+		}
+	}
+#endif // __linux__
+	return counters;
+}
+
+void hasher::update(const void *data, std::size_t size)
+{
+	auto bytes = static_cast<const unsigned char *>(data);
+	for (; size >= 8; size -= 8, bytes += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, bytes, 8);
+		mix(word);
+	}
+	for (; size > 0; size--, bytes++) {
+		mix(*bytes);
+	}
+}
+
+void hasher::update(const std::string &s)
+{
+	update(s.data(), s.size());
+	mix(0);
+}
+
+void hasher::update_file(const std::string &fname)
+{
+	std::ifstream f(fname, std::ios::binary);
+	if (!f) {
+		throw invalid_argument("Cannot open " + fname + " to compute its checksum");
+	}
+	std::vector<char> buffer(1024 * 1024);
+	while (f) {
+		f.read(buffer.data(), buffer.size());
+		update(buffer.data(), std::size_t(f.gcount()));
+	}
+	mix(0);
+}
+
 }  // namespace shark
@@ -0,0 +1,309 @@
+//
+// Checkpoint unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+
+#include "checkpoint.h"
+#include "exceptions.h"
+#include "execution.h"
+#include "galaxy.h"
+#include "halo.h"
+#include "merger_tree.h"
+#include "options.h"
+#include "shark_runner.h"
+#include "subhalo.h"
+#include "synthetic_trees.h"
+#include "total_baryon.h"
+#include "hdf5/io/reader.h"
+
+#include "test_utils.h"
+
+using namespace shark;
+
+class TestCheckpoint : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_checkpoint.bin";
+
+	Checkpoint make_checkpoint(const std::string &seed = "1", const std::string &option = "")
+	{
+		std::vector<std::string> extra_options {"execution.seed = " + seed};
+		if (!option.empty()) {
+			extra_options.push_back(option);
+		}
+		auto opts = make_test_options(extra_options);
+		return Checkpoint(filename, opts, ExecutionParameters(opts));
+	}
+
+	// A single tree with one halo per snapshot between 1 and 3, with a central
+	// subhalo each. The halo at snapshot 2 also hosts a satellite subhalo that
+	// merges into the central at snapshot 3. Galaxies live at snapshot 2
+	std::vector<MergerTreePtr> make_trees()
+	{
+		auto tree = std::make_shared<MergerTree>(7);
+		std::vector<HaloPtr> halos;
+		std::vector<SubhaloPtr> centrals;
+		for (int snapshot = 1; snapshot <= 3; snapshot++) {
+			auto halo = std::make_shared<Halo>(snapshot * 10, snapshot);
+			auto central = std::make_shared<Subhalo>(snapshot * 100, snapshot);
+			central->subhalo_type = Subhalo::CENTRAL;
+			central->main_progenitor = true;
+			central->host_halo = halo;
+			central->Mvir = float(snapshot);
+			halo->central_subhalo = central;
+			halo->Mvir = float(snapshot);
+			if (!centrals.empty()) {
+				centrals.back()->descendant = central;
+				centrals.back()->has_descendant = true;
+				central->ascendants.push_back(centrals.back());
+			}
+			halos.push_back(halo);
+			centrals.push_back(central);
+		}
+
+		auto satellite = std::make_shared<Subhalo>(201, 2);
+		satellite->subhalo_type = Subhalo::SATELLITE;
+		satellite->host_halo = halos[1];
+		satellite->infall_t = 0.5;
+		satellite->descendant = centrals[2];
+		satellite->has_descendant = true;
+		centrals[2]->ascendants.push_back(satellite);
+		halos[1]->satellite_subhalos.push_back(satellite);
+
+		centrals[1]->galaxies.emplace_back(1);
+		auto &central_galaxy = centrals[1]->galaxies.back();
+		central_galaxy.galaxy_type = Galaxy::CENTRAL;
+		central_galaxy.disk_gas.mass = 2.5;
+		central_galaxy.smbh.mass = 0.125;
+		central_galaxy.history.push_back({1, 2, 3, 4, 5, 6, 1});
+		central_galaxy.history.push_back({7, 8, 9, 10, 11, 12, 2});
+		central_galaxy.bh_history.push_back({1, 2, 3, 4, 5, 2});
+		satellite->galaxies.emplace_back(2);
+		satellite->galaxies.back().galaxy_type = Galaxy::TYPE1;
+		satellite->galaxies.back().tmerge = 3.5;
+
+		halos[2]->merger_tree = tree;
+		tree->add_halo(halos[2]);
+		add_parent(halos[2], halos[1]);
+		add_parent(halos[1], halos[0]);
+		tree->consolidate();
+		return {tree};
+	}
+
+	const std::string restart_dir = "test_checkpoint_restart";
+
+	// The options to evolve synthetic merger trees with 12 snapshots,
+	// generating them if necessary, and saving a checkpoint at snapshot 6
+	Options make_restart_options()
+	{
+		auto prefix = restart_dir + "/trees/tree";
+		if (!boost::filesystem::exists(prefix + ".cfg")) {
+			synthetic_trees_params params;
+			params.prefix = prefix;
+			params.n_nodes = 2000;
+			params.n_snapshots = 12;
+			params.max_redshift = 6;
+			params.box_size = 20;
+			params.cluster_fraction = 0;
+			params.particle_mass = 1e9;
+			params.n_files = 1;
+			params.seed = 1;
+			generate_synthetic_trees(params);
+		}
+
+		Options options(SHARK_SAMPLE_CFG);
+		options.add_file(prefix + ".cfg");
+		options.add("execution.output_directory = " + restart_dir);
+		options.add("execution.name_model = restart");
+		options.add("execution.output_sf_histories = false");
+		options.add("execution.checkpoint_snapshots = 6");
+		options.add("execution.seed = 1");
+		return options;
+	}
+
+	struct restart_outputs {
+		int first_snapshot = -1;
+		TotalBaryon all_baryons;
+		std::vector<Galaxy::id_t> id_galaxy;
+		std::vector<std::vector<float>> properties;
+	};
+
+	// Evolves the synthetic merger trees from the beginning or from their
+	// checkpoint, collecting the global quantities and final galaxies
+	restart_outputs evolve_synthetic_trees(bool restart, unsigned int threads)
+	{
+		restart_outputs outputs;
+		SharkRunner runner(make_restart_options(), threads);
+		runner.on_snapshot_evolved([&outputs](int snapshot, const TotalBaryon &all_baryons) {
+			if (outputs.first_snapshot == -1) {
+				outputs.first_snapshot = snapshot;
+			}
+			outputs.all_baryons = all_baryons;
+		});
+		if (restart) {
+			runner.restart();
+		}
+		else {
+			runner.run();
+		}
+
+		hdf5::Reader galaxies(restart_dir + "/shark-bench-trees/restart/11/0/galaxies.hdf5");
+		outputs.id_galaxy = galaxies.read_dataset_v<Galaxy::id_t>("galaxies/id_galaxy");
+		for (auto &name: {"mstars_disk", "mstars_bulge", "mgas_disk", "mgas_bulge", "mhot", "m_bh", "sfr_disk", "sfr_burst"}) {
+			outputs.properties.push_back(galaxies.read_dataset_v<float>(std::string("galaxies/") + name));
+		}
+		return outputs;
+	}
+
+	void assert_same_baryons(const TotalBaryon &expected, const TotalBaryon &actual)
+	{
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mcold), actual.get_masses(actual.mcold));
+		TS_ASSERT_EQUALS(expected.get_metals(expected.mcold), actual.get_metals(actual.mcold));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mstars), actual.get_masses(actual.mstars));
+		TS_ASSERT_EQUALS(expected.get_metals(expected.mstars), actual.get_metals(actual.mstars));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mstars_burst_galaxymergers), actual.get_masses(actual.mstars_burst_galaxymergers));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mstars_burst_diskinstabilities), actual.get_masses(actual.mstars_burst_diskinstabilities));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mhot_halo), actual.get_masses(actual.mhot_halo));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mcold_halo), actual.get_masses(actual.mcold_halo));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mejected_halo), actual.get_masses(actual.mejected_halo));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mlost_halo), actual.get_masses(actual.mlost_halo));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mBH), actual.get_masses(actual.mBH));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mHI), actual.get_masses(actual.mHI));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mH2), actual.get_masses(actual.mH2));
+		TS_ASSERT_EQUALS(expected.get_masses(expected.mDM), actual.get_masses(actual.mDM));
+		TS_ASSERT_EQUALS(expected.SFR_disk, actual.SFR_disk);
+		TS_ASSERT_EQUALS(expected.SFR_bulge, actual.SFR_bulge);
+		TS_ASSERT_EQUALS(expected.max_BH, actual.max_BH);
+		TS_ASSERT_EQUALS(expected.major_mergers, actual.major_mergers);
+		TS_ASSERT_EQUALS(expected.minor_mergers, actual.minor_mergers);
+		TS_ASSERT_EQUALS(expected.disk_instabil, actual.disk_instabil);
+		TS_ASSERT_EQUALS(expected.baryon_total_created, actual.baryon_total_created);
+		TS_ASSERT_EQUALS(expected.baryon_total_lost, actual.baryon_total_lost);
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+		boost::filesystem::remove_all(restart_dir);
+	}
+
+	void test_roundtrip()
+	{
+		auto checkpoint = make_checkpoint();
+		TotalBaryon all_baryons;
+		std::vector<MergerTreePtr> trees;
+		TS_ASSERT(!checkpoint.load(2, trees, all_baryons, 1));
+
+		BaryonBase mcold;
+		mcold.mass = 1.5;
+		all_baryons.mcold.push_back(mcold);
+		all_baryons.major_mergers.push_back(3);
+		all_baryons.baryon_total_created[2] = 2.5;
+		checkpoint.save(2, make_trees(), all_baryons, 2);
+
+		TotalBaryon loaded_baryons;
+		TS_ASSERT(checkpoint.load(2, trees, loaded_baryons, 2));
+		TS_ASSERT_EQUALS(loaded_baryons.mcold.size(), 1);
+		TS_ASSERT_EQUALS(loaded_baryons.mcold[0].mass, 1.5);
+		TS_ASSERT_EQUALS(loaded_baryons.major_mergers, all_baryons.major_mergers);
+		TS_ASSERT_EQUALS(loaded_baryons.baryon_total_created, all_baryons.baryon_total_created);
+		TS_ASSERT_EQUALS(trees.size(), 1);
+
+		// The halo at snapshot 1 is not needed anymore
+		auto &tree = trees[0];
+		TS_ASSERT_EQUALS(tree->id, 7);
+		TS_ASSERT_EQUALS(tree->get_halos().size(), 2);
+		auto h2 = tree->get_halos()[0];
+		auto h3 = tree->get_halos()[1];
+		TS_ASSERT_EQUALS(h2->id, 20);
+		TS_ASSERT_EQUALS(h2->merger_tree, tree);
+		TS_ASSERT(h2->ascendants.empty());
+		TS_ASSERT_EQUALS(h2->descendant, h3);
+		TS_ASSERT_EQUALS(h3->main_progenitor(), h2);
+		TS_ASSERT_EQUALS(*tree->halos_at(3).begin(), h3);
+
+		auto central = h2->central_subhalo;
+		TS_ASSERT_EQUALS(central->id, 200);
+		TS_ASSERT_EQUALS(central->host_halo, h2);
+		TS_ASSERT(central->ascendants.empty());
+		TS_ASSERT_EQUALS(central->descendant, h3->central_subhalo);
+		TS_ASSERT_EQUALS(h2->satellite_subhalos.size(), 1);
+		auto satellite = h2->satellite_subhalos[0];
+		TS_ASSERT_EQUALS(satellite->infall_t, 0.5);
+		TS_ASSERT_EQUALS(h3->central_subhalo->ascendants.size(), 2);
+		TS_ASSERT_EQUALS(h3->central_subhalo->ascendants[1], satellite);
+
+		TS_ASSERT_EQUALS(central->galaxies.size(), 1);
+		auto &galaxy = central->galaxies[0];
+		TS_ASSERT_EQUALS(galaxy.id, 1);
+		TS_ASSERT_EQUALS(galaxy.galaxy_type, Galaxy::CENTRAL);
+		TS_ASSERT_EQUALS(galaxy.disk_gas.mass, 2.5);
+		TS_ASSERT_EQUALS(galaxy.smbh.mass, 0.125);
+		TS_ASSERT_EQUALS(galaxy.history.size(), 2);
+		TS_ASSERT_EQUALS(galaxy.history[1].sfr_z_bulge_diskins, 12);
+		TS_ASSERT_EQUALS(galaxy.history[1].snapshot, 2);
+		TS_ASSERT_EQUALS(galaxy.bh_history.size(), 1);
+		TS_ASSERT_EQUALS(galaxy.bh_history[0].spin, 5);
+		TS_ASSERT_EQUALS(satellite->galaxies.size(), 1);
+		TS_ASSERT_EQUALS(satellite->galaxies[0].galaxy_type, Galaxy::TYPE1);
+		TS_ASSERT_EQUALS(satellite->galaxies[0].tmerge, 3.5);
+	}
+
+	void test_key()
+	{
+		TotalBaryon all_baryons;
+		std::vector<MergerTreePtr> trees;
+		make_checkpoint().save(2, make_trees(), all_baryons, 1);
+
+		// Loading requires the same snapshot, seed and options
+		TS_ASSERT_THROWS(make_checkpoint().load(3, trees, all_baryons, 1), const invalid_data &);
+		TS_ASSERT_THROWS(make_checkpoint("2").load(2, trees, all_baryons, 1), const invalid_data &);
+		TS_ASSERT_THROWS(make_checkpoint("1", "gas_cooling.pre_enrich_z = 1e-3").load(2, trees, all_baryons, 1), const invalid_data &);
+		TS_ASSERT(make_checkpoint("1", "execution.release_past_snapshots = true").load(2, trees, all_baryons, 1));
+	}
+
+	void test_restart_matches_uninterrupted_run()
+	{
+		// The restarted execution uses a different number of threads,
+		// and thus partitions merger trees differently
+		auto uninterrupted = evolve_synthetic_trees(false, 2);
+		TS_ASSERT(boost::filesystem::exists(restart_dir + "/shark-bench-trees/restart/6/0/checkpoint.bin"));
+		auto restarted = evolve_synthetic_trees(true, 3);
+
+		TS_ASSERT_EQUALS(uninterrupted.first_snapshot, 1);
+		TS_ASSERT_EQUALS(restarted.first_snapshot, 6);
+		TS_ASSERT(!uninterrupted.id_galaxy.empty());
+		assert_same_baryons(uninterrupted.all_baryons, restarted.all_baryons);
+		TS_ASSERT_EQUALS(uninterrupted.id_galaxy, restarted.id_galaxy);
+		TS_ASSERT_EQUALS(uninterrupted.properties, restarted.properties);
+	}
+
+};
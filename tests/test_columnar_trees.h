@@ -0,0 +1,105 @@
+//
+// Columnar merger tree files unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+
+#include "columnar_trees.h"
+#include "exceptions.h"
+#include "halo.h"
+#include "subhalo.h"
+#include "hdf5/io/writer.h"
+
+using namespace shark;
+
+class TestColumnarTrees : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string hdf5_file = "test_columnar_trees.hdf5";
+	const std::string columnar_file = "test_columnar_trees.bin";
+
+	// Three subhalos in snapshots 1 and 2, written in the SURFS layout
+	void write_surfs_file()
+	{
+		hdf5::Writer writer(hdf5_file, true, naming_convention::CAMEL_CASE, naming_convention::CAMEL_CASE, naming_convention::CAMEL_CASE);
+		writer.write_attribute("fileInfo/numberOfFiles", 1u);
+		std::vector<float> vectors {1, 2, 3, 4, 5, 6, 7, 8, 9};
+		writer.write_dataset_v_2("haloTrees/position", vectors, 3);
+		writer.write_dataset_v_2("haloTrees/velocity", vectors, 3);
+		writer.write_dataset_v_2("haloTrees/angularMomentum", vectors, 3);
+		writer.write_dataset("haloTrees/nodeMass", std::vector<float> {3, 2, 1});
+		writer.write_dataset("haloTrees/particleNumber", std::vector<int> {30, 20, 10});
+		writer.write_dataset("haloTrees/maximumCircularVelocity", std::vector<float> {1, 1, 1});
+		writer.write_dataset("haloTrees/snapshotNumber", std::vector<int> {2, 1, 1});
+		writer.write_dataset("haloTrees/nodeIndex", std::vector<Subhalo::id_t> {200, 100, 101});
+		writer.write_dataset("haloTrees/descendantIndex", std::vector<Subhalo::id_t> {-1, 200, 200});
+		writer.write_dataset("haloTrees/hostIndex", std::vector<Halo::id_t> {20, 10, 10});
+		writer.write_dataset("haloTrees/descendantHost", std::vector<Halo::id_t> {-1, 20, 20});
+		writer.write_dataset("haloTrees/isMainProgenitor", std::vector<int> {0, 1, 0});
+		writer.write_dataset("haloTrees/isInterpolated", std::vector<int> {0, 0, 0});
+	}
+
+public:
+
+	void setUp()
+	{
+		write_surfs_file();
+		write_columnar_trees(hdf5_file, columnar_file, false);
+	}
+
+	void tearDown()
+	{
+		std::remove(hdf5_file.c_str());
+		std::remove(columnar_file.c_str());
+	}
+
+	void test_read()
+	{
+		ColumnarTreeFile trees(columnar_file);
+		TS_ASSERT_EQUALS(trees.size(), 3);
+		TS_ASSERT_EQUALS(trees.number_of_files(), 1);
+		TS_ASSERT_EQUALS(trees.first_row_from(1), 0);
+		TS_ASSERT_EQUALS(trees.first_row_from(2), 2);
+		TS_ASSERT_EQUALS(trees.first_row_from(3), 3);
+		TS_ASSERT_EQUALS(trees.column<Subhalo::id_t>(ColumnarTreeFile::NODE_INDEX)[2], 200);
+		TS_ASSERT_EQUALS(trees.column<int>(ColumnarTreeFile::IS_INTERPOLATED)[2], 0);
+	}
+
+	void test_truncated()
+	{
+		// Cut the file in the middle of its last column (three ints plus
+		// four bytes of padding)
+		auto size = boost::filesystem::file_size(columnar_file);
+		boost::filesystem::resize_file(columnar_file, size - 2 * sizeof(int));
+		TS_ASSERT_THROWS(ColumnarTreeFile trees(columnar_file), invalid_data &);
+
+		// Cut it within its first column
+		boost::filesystem::resize_file(columnar_file, size / 2);
+		TS_ASSERT_THROWS(ColumnarTreeFile trees(columnar_file), invalid_data &);
+	}
+
+};
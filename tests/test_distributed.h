@@ -0,0 +1,153 @@
+//
+// Checkpoint unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <cxxtest/TestSuite.h>
+
+#include "distributed.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+class TestDistributed : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string directory = "test_distributed";
+
+	std::vector<work_batch> make_batches()
+	{
+		std::vector<work_batch> batches(3);
+		for (int i = 0; i != 3; i++) {
+			batches[i].id = i;
+			batches[i].cost = (i == 1) ? 10 : i;
+			batches[i].seed = 7;
+			batches[i].subvolumes = {unsigned(10 + i)};
+		}
+		return batches;
+	}
+
+	snapshot_baryons make_baryons(int batch, int snapshot)
+	{
+		snapshot_baryons baryons {};
+		baryons.batch = batch;
+		baryons.snapshot = snapshot;
+		baryons.mstars.mass = float(batch + 1);
+		baryons.max_BH = batch;
+		baryons.major_mergers = 1;
+		baryons.baryon_total_created = 2;
+		return baryons;
+	}
+
+	// Evolves snapshots 5 and 6 of three batches through @p transport,
+	// as a single worker would, checking what the coordinator assembles
+	void evolve_batches(Transport &transport)
+	{
+		Coordinator coordinator(transport, 5, 7);
+		coordinator.publish(make_batches());
+		TS_ASSERT(!coordinator.receive());
+
+		// Costliest batches are claimed first
+		std::vector<int> claimed;
+		work_batch batch;
+		while (transport.claim(batch)) {
+			TS_ASSERT_EQUALS(batch.seed, 7);
+			TS_ASSERT_EQUALS(batch.subvolumes, std::vector<unsigned int>{unsigned(10 + batch.id)});
+			claimed.push_back(batch.id);
+			transport.send(make_baryons(batch.id, 5));
+			transport.send(make_baryons(batch.id, 6));
+			transport.finish(batch.id, "");
+		}
+		TS_ASSERT_EQUALS(claimed, (std::vector<int>{1, 2, 0}));
+		TS_ASSERT(coordinator.receive());
+
+		auto all_baryons = coordinator.get_total_baryons();
+		TS_ASSERT_EQUALS(all_baryons.mstars.size(), 2);
+		TS_ASSERT_EQUALS(all_baryons.mstars[1].mass, 6.f);
+		TS_ASSERT_EQUALS(all_baryons.max_BH[0], 2.);
+		TS_ASSERT_EQUALS(all_baryons.major_mergers[1], 3);
+		TS_ASSERT_EQUALS(all_baryons.baryon_total_created[7], 6.);
+	}
+
+public:
+
+	void tearDown()
+	{
+		boost::filesystem::remove_all(directory);
+	}
+
+	void test_local_transport()
+	{
+		LocalTransport transport;
+		evolve_batches(transport);
+	}
+
+	void test_directory_transport()
+	{
+		boost::filesystem::create_directories(directory);
+		DirectoryTransport transport(directory);
+		evolve_batches(transport);
+	}
+
+	void test_failed_batch()
+	{
+		LocalTransport transport;
+		Coordinator coordinator(transport, 5, 7);
+		coordinator.publish(make_batches());
+		transport.finish(0, "out of memory");
+		TS_ASSERT_THROWS(coordinator.receive(), const shark::exception &);
+	}
+
+	void test_worker_timeout()
+	{
+		LocalTransport transport;
+		Coordinator coordinator(transport, 5, 7, std::chrono::milliseconds(50));
+		coordinator.publish(make_batches());
+		TS_ASSERT(!coordinator.receive());
+
+		// Anything received keeps the coordinator waiting
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		transport.send(make_baryons(0, 5));
+		TS_ASSERT(!coordinator.receive());
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		TS_ASSERT_THROWS(coordinator.receive(), const shark::exception &);
+	}
+
+	void test_missing_snapshot()
+	{
+		LocalTransport transport;
+		Coordinator coordinator(transport, 5, 7);
+		coordinator.publish(make_batches());
+		for (int batch = 0; batch != 3; batch++) {
+			transport.send(make_baryons(batch, 5));
+			transport.finish(batch, "");
+		}
+		TS_ASSERT(coordinator.receive());
+		TS_ASSERT_THROWS(coordinator.get_total_baryons(), const shark::exception &);
+	}
+
+};
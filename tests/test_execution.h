@@ -23,6 +23,8 @@
 
 #include "execution.h"
 
+#include "test_utils.h"
+
 using namespace shark;
 
 class TestSubhalos : public CxxTest::TestSuite
@@ -60,4 +62,26 @@ public:
 		assert_output_snapshots("199 0 199", {0, 199}, 199);
 		assert_output_snapshots("0 199", {0, 199}, 199);
 	}
+
+	void test_output_properties()
+	{
+		auto params = make_test_exec_params({"execution.output_snapshots = 199"});
+		TS_ASSERT(params.output_property("halo/mvir"));
+		TS_ASSERT(params.output_property("galaxies/mstars_disk"));
+
+		params = make_test_exec_params({"execution.output_properties = galaxies/* halo/mvir !galaxies/mstars_*"});
+		TS_ASSERT_EQUALS(params.output_properties, std::vector<std::string>({"galaxies/*", "halo/mvir", "!galaxies/mstars_*"}));
+		TS_ASSERT(params.output_property("halo/mvir"));
+		TS_ASSERT(!params.output_property("halo/vvir"));
+		TS_ASSERT(!params.output_property("subhalo/id"));
+		TS_ASSERT(params.output_property("galaxies/mgas_disk"));
+		TS_ASSERT(!params.output_property("galaxies/mstars_disk"));
+		TS_ASSERT(!params.output_property("galaxies/mstars_metals_bulge"));
+
+		params = make_test_exec_params({"execution.output_properties = !subhalo/* !galaxies/*_x"});
+		TS_ASSERT(params.output_property("halo/mvir"));
+		TS_ASSERT(!params.output_property("subhalo/id"));
+		TS_ASSERT(params.output_property("galaxies/position_y"));
+		TS_ASSERT(!params.output_property("galaxies/position_x"));
+	}
 };
\ No newline at end of file
@@ -116,6 +116,34 @@ public:
 		TS_ASSERT_EQUALS(doubles, hdf5_doubles);
 	}
 
+	void test_write_dataset_v_2() {
+		std::vector<float> floats{1, 2, 3, 4, 5, 6};
+		{
+			auto writer = get_writer();
+			writer.write_dataset_v_2("floats", floats, 3);
+		}
+
+		auto reader = get_reader();
+		TS_ASSERT_EQUALS(floats, reader.read_dataset_v_2<float>("floats"));
+	}
+
+	void test_append_dataset() {
+		// Write in blocks smaller and larger than the chunk size
+		{
+			auto writer = get_writer();
+			writer.create_extendible_dataset<int>("group/integers", 3);
+			writer.create_extendible_dataset<double>("doubles", 3);
+			writer.append_dataset("group/integers", std::vector<int>{1, 2});
+			writer.append_dataset("group/integers", std::vector<int>{});
+			writer.append_dataset("group/integers", std::vector<int>{3, 4, 5, 6, 7});
+			writer.append_dataset("doubles", std::vector<double>{1});
+		}
+
+		auto reader = get_reader();
+		TS_ASSERT_EQUALS(reader.read_dataset_v<int>("group/integers"), std::vector<int>({1, 2, 3, 4, 5, 6, 7}));
+		TS_ASSERT_EQUALS(reader.read_dataset_v<double>("doubles"), std::vector<double>({1}));
+	}
+
 	void test_wrong_attribute_writes() {
 		// Single-named attributes are not supported
 		auto writer = get_writer();
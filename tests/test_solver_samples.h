@@ -0,0 +1,83 @@
+//
+// Checkpoint unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "solver_samples.h"
+
+using namespace shark;
+
+class TestSolverSamples : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_solver_samples.bin";
+
+	// Offers the solutions of galaxies 0 to 99 at snapshot 5,
+	// spread across the recorders of @p threads threads
+	std::vector<solver_sample> sample(unsigned int threads)
+	{
+		{
+			SolverSampler sampler(filename, 10, 1, 2, threads);
+			sampler.start_snapshot(5);
+			for (Galaxy::id_t id = 0; id != 100; id++) {
+				auto &recorder = sampler.recorder(unsigned(id % threads));
+				std::uint64_t key;
+				if (recorder.should_sample(id, false, key)) {
+					solver_sample sample {};
+					sample.key = key;
+					sample.record.galaxy_id = id;
+					sample.initial_values = {double(id), 1};
+					sample.final_values = {double(id), 2};
+					recorder.add(std::move(sample));
+				}
+			}
+			sampler.write_snapshot();
+		}
+		auto samples = read_solver_samples(filename);
+		std::remove(filename.c_str());
+		return samples;
+	}
+
+public:
+
+	void test_samples_independent_of_threads()
+	{
+		auto samples = sample(1);
+		TS_ASSERT_EQUALS(samples.size(), 10);
+		for (auto &s: samples) {
+			TS_ASSERT_EQUALS(s.record.snapshot, 5);
+			TS_ASSERT_EQUALS(s.initial_values[0], double(s.record.galaxy_id));
+			TS_ASSERT_EQUALS(s.final_values[1], 2.);
+		}
+
+		auto samples_4_threads = sample(4);
+		TS_ASSERT_EQUALS(samples_4_threads.size(), 10);
+		for (std::size_t i = 0; i != samples.size(); i++) {
+			TS_ASSERT_EQUALS(samples[i].record.galaxy_id, samples_4_threads[i].record.galaxy_id);
+		}
+	}
+
+};
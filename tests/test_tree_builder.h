@@ -0,0 +1,274 @@
+//
+// Tree builder unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "execution.h"
+#include "halo.h"
+#include "merger_tree.h"
+#include "merger_tree_graph.h"
+#include "subhalo.h"
+#include "timer.h"
+#include "tree_builder.h"
+
+#include "test_utils.h"
+
+using namespace shark;
+
+class LinkingTreeBuilder : public HaloBasedTreeBuilder {
+public:
+	using HaloBasedTreeBuilder::HaloBasedTreeBuilder;
+	using HaloBasedTreeBuilder::loop_through_halos;
+};
+
+class TestTreeBuilder : public CxxTest::TestSuite
+{
+
+private:
+
+	// A cluster-dominated batch: at each snapshot a single halo hosts
+	// a central and n_satellites satellite subhalos, each of them
+	// descending into the same subhalo of the next snapshot's halo
+	std::vector<HaloPtr> make_cluster(int n_snapshots, int n_satellites)
+	{
+		std::vector<HaloPtr> halos;
+		for (int snapshot = 1; snapshot <= n_snapshots; snapshot++) {
+			auto halo = std::make_shared<Halo>(snapshot, snapshot);
+			for (int i = 0; i <= n_satellites; i++) {
+				auto subhalo = std::make_shared<Subhalo>(snapshot * 1000000 + i, snapshot);
+				subhalo->subhalo_type = (i == 0 ? Subhalo::CENTRAL : Subhalo::SATELLITE);
+				subhalo->Mvir = float(n_satellites + 1 - i);
+				subhalo->host_halo = halo;
+				subhalo->haloID = halo->id;
+				if (snapshot < n_snapshots) {
+					subhalo->has_descendant = true;
+					subhalo->descendant_id = (snapshot + 1) * 1000000 + i;
+					subhalo->descendant_halo_id = snapshot + 1;
+				}
+				halo->add_subhalo(std::move(subhalo));
+			}
+			halos.push_back(halo);
+		}
+
+		auto tree = std::make_shared<MergerTree>(0);
+		halos.back()->merger_tree = tree;
+		tree->add_halo(halos.back());
+		return halos;
+	}
+
+	// A batch with n_halos halos per snapshot, each hosting n_subhalos
+	// subhalos. Subhalo i of halo h descends into subhalo i of halo h / 2,
+	// so pairs of halos merge at every snapshot. Each halo of the last
+	// snapshot roots its own tree
+	std::vector<HaloPtr> make_forest(int n_snapshots, int n_halos, int n_subhalos)
+	{
+		std::vector<HaloPtr> halos;
+		for (int snapshot = 1; snapshot <= n_snapshots; snapshot++) {
+			for (int h = 0; h != n_halos; h++) {
+				auto halo = std::make_shared<Halo>(snapshot * 1000 + h, snapshot);
+				for (int i = 0; i != n_subhalos; i++) {
+					auto subhalo = std::make_shared<Subhalo>(snapshot * 1000000 + h * 100 + i, snapshot);
+					subhalo->subhalo_type = (i == 0 ? Subhalo::CENTRAL : Subhalo::SATELLITE);
+					subhalo->Mvir = float(n_subhalos - i);
+					subhalo->host_halo = halo;
+					subhalo->haloID = halo->id;
+					if (snapshot < n_snapshots) {
+						subhalo->has_descendant = true;
+						subhalo->descendant_id = (snapshot + 1) * 1000000 + (h / 2) * 100 + i;
+						subhalo->descendant_halo_id = (snapshot + 1) * 1000 + h / 2;
+					}
+					halo->add_subhalo(std::move(subhalo));
+				}
+				if (snapshot == n_snapshots) {
+					auto tree = std::make_shared<MergerTree>(h);
+					halo->merger_tree = tree;
+					tree->add_halo(halo);
+				}
+				halos.push_back(halo);
+			}
+		}
+		return halos;
+	}
+
+	template <typename T>
+	std::vector<typename T::element_type::id_t> ids(const std::vector<T> &objects)
+	{
+		std::vector<typename T::element_type::id_t> object_ids;
+		for (auto &object: objects) {
+			object_ids.push_back(object->id);
+		}
+		return object_ids;
+	}
+
+	void assert_linked(const std::vector<HaloPtr> &halos)
+	{
+		for (std::size_t h = 0; h != halos.size() - 1; h++) {
+			auto &halo = halos[h];
+			TS_ASSERT_EQUALS(halo->descendant, halos[h + 1]);
+			TS_ASSERT_EQUALS(halo->merger_tree, halos.back()->merger_tree);
+			for (auto &subhalo: halo->all_subhalos()) {
+				TS_ASSERT(subhalo->descendant);
+				TS_ASSERT_EQUALS(subhalo->descendant->id, subhalo->descendant_id);
+				TS_ASSERT_EQUALS(subhalo->descendant->host_halo, halos[h + 1]);
+			}
+		}
+	}
+
+public:
+
+	void test_link_cluster()
+	{
+		const int n_satellites = 5000;
+		auto halos = make_cluster(3, n_satellites);
+		LinkingTreeBuilder builder(make_test_exec_params(), 1);
+
+		Timer t;
+		builder.loop_through_halos(halos);
+		std::ostringstream os;
+		os << "Linked 3 snapshots of a halo with " << n_satellites << " satellites in " << t;
+		TS_TRACE(os.str());
+
+		assert_linked(halos);
+	}
+
+	void test_link_threads()
+	{
+		// Links, and the order in which they are established, must not
+		// depend on the number of threads
+		auto serial_halos = make_forest(4, 500, 3);
+		auto parallel_halos = make_forest(4, 500, 3);
+		LinkingTreeBuilder(make_test_exec_params(), 1).loop_through_halos(serial_halos);
+		LinkingTreeBuilder(make_test_exec_params(), 4).loop_through_halos(parallel_halos);
+
+		TS_ASSERT_EQUALS(serial_halos.size(), parallel_halos.size());
+		for (std::size_t h = 0; h != serial_halos.size(); h++) {
+			auto &serial = serial_halos[h];
+			auto &parallel = parallel_halos[h];
+			TS_ASSERT_EQUALS(serial->id, parallel->id);
+			TS_ASSERT_EQUALS(bool(serial->descendant), bool(parallel->descendant));
+			if (serial->descendant && parallel->descendant) {
+				TS_ASSERT_EQUALS(serial->descendant->id, parallel->descendant->id);
+			}
+			TS_ASSERT_EQUALS(ids(serial->ascendants), ids(parallel->ascendants));
+			TS_ASSERT(serial->merger_tree);
+			TS_ASSERT(parallel->merger_tree);
+			if (serial->merger_tree && parallel->merger_tree) {
+				TS_ASSERT_EQUALS(serial->merger_tree->id, parallel->merger_tree->id);
+				TS_ASSERT_EQUALS(ids(serial->merger_tree->get_halos()), ids(parallel->merger_tree->get_halos()));
+			}
+
+			auto serial_subhalos = serial->all_subhalos();
+			auto parallel_subhalos = parallel->all_subhalos();
+			TS_ASSERT_EQUALS(ids(serial_subhalos), ids(parallel_subhalos));
+			for (std::size_t i = 0; i != std::min(serial_subhalos.size(), parallel_subhalos.size()); i++) {
+				auto &serial_subhalo = serial_subhalos[i];
+				auto &parallel_subhalo = parallel_subhalos[i];
+				TS_ASSERT_EQUALS(bool(serial_subhalo->descendant), bool(parallel_subhalo->descendant));
+				if (serial_subhalo->descendant && parallel_subhalo->descendant) {
+					TS_ASSERT_EQUALS(serial_subhalo->descendant->id, parallel_subhalo->descendant->id);
+				}
+				TS_ASSERT_EQUALS(ids(serial_subhalo->ascendants), ids(parallel_subhalo->ascendants));
+			}
+		}
+	}
+
+	void test_graph()
+	{
+		auto halos = make_cluster(3, 2);
+		for (auto &halo: halos) {
+			halo->central_subhalo->main_progenitor = true;
+		}
+		LinkingTreeBuilder builder(make_test_exec_params(), 1);
+		builder.loop_through_halos(halos);
+		auto tree = halos.back()->merger_tree;
+		tree->consolidate();
+
+		MergerTreeGraph graph(*tree);
+		TS_ASSERT_EQUALS(graph.size(), 3);
+		TS_ASSERT_EQUALS(graph.halos_at(0), std::make_pair(0, 0));
+		TS_ASSERT_EQUALS(graph.halos_at(2), std::make_pair(1, 2));
+		TS_ASSERT_EQUALS(graph.halos_at(4), std::make_pair(3, 3));
+		TS_ASSERT_EQUALS(graph.halo(1), halos[1]);
+		TS_ASSERT_EQUALS(graph.descendant(1), 2);
+		TS_ASSERT_EQUALS(graph.descendant(2), MergerTreeGraph::none);
+		TS_ASSERT_EQUALS(graph.main_progenitor(2), 1);
+		TS_ASSERT_EQUALS(graph.main_progenitor(0), MergerTreeGraph::none);
+		auto progenitors = graph.progenitors(1);
+		TS_ASSERT_EQUALS(std::vector<MergerTreeGraph::handle_t>(progenitors.begin(), progenitors.end()), std::vector<MergerTreeGraph::handle_t>{0});
+		TS_ASSERT_EQUALS(graph.progenitors(0).begin(), graph.progenitors(0).end());
+	}
+
+	void test_halos_at()
+	{
+		auto halos = make_cluster(3, 2);
+		LinkingTreeBuilder builder(make_test_exec_params(), 1);
+		builder.loop_through_halos(halos);
+		auto tree = halos.back()->merger_tree;
+		tree->consolidate();
+
+		TS_ASSERT_EQUALS(tree->halos_at(0).begin(), tree->halos_at(0).end());
+		TS_ASSERT_EQUALS(*tree->halos_at(2).begin(), halos[1]);
+		TS_ASSERT_EQUALS(tree->halos_at(3).end(), tree->get_halos().end());
+		TS_ASSERT_EQUALS(tree->halos_at(4).begin(), tree->halos_at(4).end());
+
+		// Adding a halo drops the index, but halos are still found
+		auto late_halo = std::make_shared<Halo>(100, 4);
+		tree->add_halo(late_halo);
+		TS_ASSERT_EQUALS(*tree->halos_at(4).begin(), late_halo);
+		TS_ASSERT_EQUALS(*tree->halos_at(2).begin(), halos[1]);
+		tree->index_snapshots();
+		TS_ASSERT_EQUALS(*tree->halos_at(4).begin(), late_halo);
+		TS_ASSERT_EQUALS(*tree->halos_at(2).begin(), halos[1]);
+		TS_ASSERT_EQUALS(std::distance(tree->halos_at(2).begin(), tree->halos_at(2).end()), 1);
+	}
+
+	void test_missing_descendant_subhalo()
+	{
+		auto halos = make_cluster(2, 10);
+		auto lost = halos[0]->satellite_subhalos[3];
+		lost->descendant_id = 12345;
+		auto exec_params = make_test_exec_params();
+		exec_params.skip_missing_descendants = true;
+		exec_params.warn_on_missing_descendants = false;
+		LinkingTreeBuilder builder(exec_params, 1);
+
+		builder.loop_through_halos(halos);
+		TS_ASSERT_EQUALS(halos[0]->subhalo_count(), 10);
+		TS_ASSERT(!lost->descendant);
+		assert_linked(halos);
+	}
+
+	void test_descendant_not_in_later_snapshot()
+	{
+		auto halos = make_cluster(3, 2);
+		halos[1]->satellite_subhalos[0]->descendant_halo_id = halos[0]->id;
+		LinkingTreeBuilder builder(make_test_exec_params(), 1);
+		TS_ASSERT_THROWS(builder.loop_through_halos(halos), const invalid_data &);
+	}
+
+};
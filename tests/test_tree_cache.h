@@ -0,0 +1,274 @@
+//
+// Tree cache unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+
+#include "execution.h"
+#include "halo.h"
+#include "merger_tree.h"
+#include "subhalo.h"
+#include "total_baryon.h"
+#include "tree_cache.h"
+
+#include "test_utils.h"
+
+using namespace shark;
+
+class TestTreeCache : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string input_file = "test_tree_cache_input.txt";
+
+	TreeCache make_cache(const std::string &seed = "1", bool checksums = false)
+	{
+		auto opts = make_test_options({"execution.output_snapshots = 2", "execution.seed = " + seed,
+		                               std::string("execution.tree_cache_checksums = ") + (checksums ? "true" : "false")});
+		return TreeCache(".", opts, ExecutionParameters(opts), {input_file});
+	}
+
+	// A single tree with one halo at snapshot 1 with two subhalos,
+	// which merge into a single subhalo in a halo at snapshot 2
+	std::vector<MergerTreePtr> make_trees()
+	{
+		auto tree = std::make_shared<MergerTree>(7);
+		auto h1 = std::make_shared<Halo>(10, 1);
+		auto h2 = std::make_shared<Halo>(20, 2);
+		auto s1 = std::make_shared<Subhalo>(100, 1);
+		auto s2 = std::make_shared<Subhalo>(101, 1);
+		auto s3 = std::make_shared<Subhalo>(200, 2);
+		s1->subhalo_type = Subhalo::CENTRAL;
+		s1->Mvir = 3;
+		s1->main_progenitor = true;
+		s2->subhalo_type = Subhalo::SATELLITE;
+		s2->Mvir = 1;
+		s2->infall_t = 0.5;
+		s3->subhalo_type = Subhalo::CENTRAL;
+		s3->Mvir = 5;
+		s3->accreted_mass = 0.25;
+		for (auto &s: {s1, s2}) {
+			s->host_halo = h1;
+			s->descendant = s3;
+			s->has_descendant = true;
+			s3->ascendants.push_back(s);
+		}
+		s3->host_halo = h2;
+		h1->central_subhalo = s1;
+		h1->satellite_subhalos.push_back(s2);
+		h2->central_subhalo = s3;
+		h1->Mvir = 4;
+		h2->Mvir = 5;
+		h2->age_50 = 1.5;
+		h2->merger_tree = tree;
+		tree->add_halo(h2);
+		add_parent(h2, h1);
+		tree->consolidate();
+		return {tree};
+	}
+
+public:
+
+	void setUp()
+	{
+		std::ofstream f(input_file);
+		f << "some input data";
+	}
+
+	void tearDown()
+	{
+		std::remove(make_cache().get_filename().c_str());
+		std::remove(input_file.c_str());
+	}
+
+	void test_roundtrip()
+	{
+		auto cache = make_cache();
+		TotalBaryon all_baryons;
+		std::vector<MergerTreePtr> trees;
+		TS_ASSERT(!cache.load(trees, all_baryons));
+
+		all_baryons.baryon_total_created[1] = 1.5;
+		all_baryons.baryon_total_created[2] = 2.5;
+		cache.store(make_trees(), all_baryons);
+
+		TotalBaryon loaded_baryons;
+		TS_ASSERT(cache.load(trees, loaded_baryons));
+		TS_ASSERT_EQUALS(loaded_baryons.baryon_total_created, all_baryons.baryon_total_created);
+		TS_ASSERT_EQUALS(trees.size(), 1);
+
+		auto &tree = trees[0];
+		TS_ASSERT_EQUALS(tree->id, 7);
+		TS_ASSERT_EQUALS(tree->last_snapshot, 2);
+		TS_ASSERT_EQUALS(tree->get_halos().size(), 2);
+
+		auto h1 = tree->get_halos()[0];
+		auto h2 = tree->get_halos()[1];
+		TS_ASSERT_EQUALS(h1->id, 10);
+		TS_ASSERT_EQUALS(h2->id, 20);
+		TS_ASSERT_EQUALS(h1->merger_tree, tree);
+		TS_ASSERT_EQUALS(h1->descendant, h2);
+		TS_ASSERT_EQUALS(h2->ascendants.size(), 1);
+		TS_ASSERT_EQUALS(h2->ascendants[0], h1);
+		TS_ASSERT_EQUALS(h2->age_50, 1.5);
+		TS_ASSERT_EQUALS(h1->subhalo_count(), 2);
+		TS_ASSERT_EQUALS(h1->central_subhalo->id, 100);
+		TS_ASSERT_EQUALS(h1->satellite_subhalos[0]->id, 101);
+		TS_ASSERT_EQUALS(h1->satellite_subhalos[0]->host_halo, h1);
+		TS_ASSERT_EQUALS(h1->satellite_subhalos[0]->infall_t, 0.5);
+
+		auto s3 = h2->central_subhalo;
+		TS_ASSERT_EQUALS(s3->id, 200);
+		TS_ASSERT_EQUALS(s3->accreted_mass, 0.25);
+		TS_ASSERT_EQUALS(s3->ascendants.size(), 2);
+		TS_ASSERT_EQUALS(s3->ascendants[0], h1->central_subhalo);
+		TS_ASSERT_EQUALS(s3->main(), h1->central_subhalo);
+		TS_ASSERT_EQUALS(h1->central_subhalo->descendant, s3);
+		TS_ASSERT_EQUALS(h1->main_progenitor(), HaloPtr());
+		TS_ASSERT_EQUALS(h2->main_progenitor(), h1);
+	}
+
+	void test_corrupted_links()
+	{
+		auto cache = make_cache();
+		TotalBaryon all_baryons;
+		all_baryons.baryon_total_created[2] = 2.5;
+		cache.store(make_trees(), all_baryons);
+
+		// The file ends with the two subhalo links followed by the single
+		// baryon entry; point the last subhalo link outside the subhalos
+		std::int64_t bad_link = 1000;
+		{
+			std::fstream f(cache.get_filename(), std::ios::in | std::ios::out | std::ios::binary);
+			f.seekp(-std::streamoff(16 + sizeof(bad_link)), std::ios::end);
+			f.write(reinterpret_cast<const char *>(&bad_link), sizeof(bad_link));
+		}
+
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon loaded_baryons;
+		TS_ASSERT(!cache.load(trees, loaded_baryons));
+		TS_ASSERT(trees.empty());
+	}
+
+	void test_image()
+	{
+		TotalBaryon all_baryons;
+		all_baryons.baryon_total_created[1] = 1.5;
+		auto original = make_trees();
+		TreeImage image(original, all_baryons);
+
+		TotalBaryon restored_baryons;
+		auto trees = image.restore(restored_baryons);
+		auto copies = image.restore(restored_baryons);
+		TS_ASSERT_EQUALS(restored_baryons.baryon_total_created, all_baryons.baryon_total_created);
+		TS_ASSERT_EQUALS(trees.size(), 1);
+		TS_ASSERT_EQUALS(copies.size(), 1);
+		TS_ASSERT_DIFFERS(trees[0], copies[0]);
+		TS_ASSERT_DIFFERS(trees[0]->get_halos()[0], original[0]->get_halos()[0]);
+		TS_ASSERT_DIFFERS(trees[0]->get_halos()[0], copies[0]->get_halos()[0]);
+
+		auto h1 = trees[0]->get_halos()[0];
+		auto h2 = trees[0]->get_halos()[1];
+		TS_ASSERT_EQUALS(h1->id, 10);
+		TS_ASSERT_EQUALS(h1->merger_tree, trees[0]);
+		TS_ASSERT_EQUALS(h1->descendant, h2);
+		TS_ASSERT_EQUALS(h2->main_progenitor(), h1);
+		TS_ASSERT_EQUALS(h2->central_subhalo->ascendants[0], h1->central_subhalo);
+		TS_ASSERT_EQUALS(*trees[0]->halos_at(2).begin(), h2);
+	}
+
+	void test_stream()
+	{
+		auto cache = make_cache();
+		TotalBaryon all_baryons;
+		TS_ASSERT(!cache.open_stream(all_baryons));
+
+		all_baryons.baryon_total_created[2] = 2.5;
+		cache.store(make_trees(), all_baryons);
+
+		TotalBaryon loaded_baryons;
+		auto stream = cache.open_stream(loaded_baryons);
+		TS_ASSERT(stream);
+		TS_ASSERT_EQUALS(loaded_baryons.baryon_total_created, all_baryons.baryon_total_created);
+		TS_ASSERT_EQUALS(stream->count_first_halos(1, 2), std::vector<std::size_t>{1});
+
+		// Only the halo at the last snapshot is loaded initially
+		auto &tree = stream->get_trees()[0];
+		TS_ASSERT_EQUALS(tree->get_halos().size(), 1);
+		auto h2 = tree->get_halos()[0];
+		TS_ASSERT_EQUALS(h2->id, 20);
+		TS_ASSERT(h2->ascendants.empty());
+		TS_ASSERT(stream->first_halos(2).empty());
+
+		stream->load_snapshot(1);
+		TS_ASSERT_EQUALS(tree->get_halos().size(), 2);
+		auto h1 = tree->get_halos()[0];
+		TS_ASSERT_EQUALS(h1->id, 10);
+		TS_ASSERT_EQUALS(h1->merger_tree, tree);
+		TS_ASSERT_EQUALS(h1->descendant, h2);
+		TS_ASSERT_EQUALS(h2->ascendants.size(), 1);
+		TS_ASSERT_EQUALS(h2->ascendants[0], h1);
+		TS_ASSERT_EQUALS(h2->main_progenitor(), h1);
+		TS_ASSERT_EQUALS(h1->central_subhalo->descendant, h2->central_subhalo);
+		TS_ASSERT_EQUALS(h1->satellite_subhalos[0]->descendant, h2->central_subhalo);
+		TS_ASSERT_EQUALS(h2->central_subhalo->ascendants.size(), 2);
+		TS_ASSERT_EQUALS(stream->first_halos(1), std::vector<HaloPtr>{h1});
+	}
+
+	void test_key_changes_with_inputs()
+	{
+		auto cache = make_cache();
+		TS_ASSERT_DIFFERS(cache.get_filename(), make_cache("2").get_filename());
+
+		std::ofstream f(input_file, std::ios::app);
+		f << "more input data";
+		f.close();
+		TS_ASSERT_DIFFERS(cache.get_filename(), make_cache().get_filename());
+	}
+
+	void test_key_checksums()
+	{
+		auto cache = make_cache();
+		auto checksum_cache = make_cache("1", true);
+		TS_ASSERT_DIFFERS(cache.get_filename(), checksum_cache.get_filename());
+
+		// Overwrite the input file keeping its size and modification time,
+		// which only checksums notice
+		auto mtime = boost::filesystem::last_write_time(input_file);
+		auto size = boost::filesystem::file_size(input_file);
+		{
+			std::ofstream f(input_file, std::ios::trunc);
+			f << std::string(size, 'x');
+		}
+		boost::filesystem::last_write_time(input_file, mtime);
+		TS_ASSERT_EQUALS(cache.get_filename(), make_cache().get_filename());
+		TS_ASSERT_DIFFERS(checksum_cache.get_filename(), make_cache("1", true).get_filename());
+	}
+
+};
@@ -0,0 +1,139 @@
+//
+// Tree cost model unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2019
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "halo.h"
+#include "merger_tree.h"
+#include "subhalo.h"
+#include "tree_cost.h"
+
+using namespace shark;
+
+class TestTreeCost : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_tree_cost.txt";
+
+	// Times are an exact linear function of the features of each tree
+	tree_timings make_timings(unsigned int subvolume, int n_trees)
+	{
+		tree_timings timings;
+		timings.subvolumes = {subvolume};
+		for (int i = 0; i != n_trees; i++) {
+			tree_timing timing;
+			timing.tree_id = i;
+			auto &features = timing.features;
+			features.subhalos = 10 + (i * 7) % 13;
+			features.max_subhalos = 1 + (i * 5) % 3;
+			features.mergers = (i * 3) % 4;
+			features.depth = 1 + i % 6;
+			features.max_mvir = 0.1 * (i % 5);
+			timing.seconds = 0.5 + 2 * features.subhalos + 0.25 * features.mergers + 3 * features.max_mvir;
+			timings.trees.push_back(timing);
+		}
+		return timings;
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_features()
+	{
+		// Two halos at snapshot 2 merge into a single one at snapshot 3
+		auto tree = std::make_shared<MergerTree>(1);
+		auto h1 = std::make_shared<Halo>(1, 2);
+		auto h2 = std::make_shared<Halo>(2, 2);
+		auto h3 = std::make_shared<Halo>(3, 3);
+		h1->central_subhalo = std::make_shared<Subhalo>(1, 2);
+		h1->satellite_subhalos.push_back(std::make_shared<Subhalo>(2, 2));
+		h2->central_subhalo = std::make_shared<Subhalo>(3, 2);
+		h3->central_subhalo = std::make_shared<Subhalo>(4, 3);
+		h3->ascendants = {h1, h2};
+		h3->Mvir = 2e12;
+		for (auto &halo: {h3, h2, h1}) {
+			tree->add_halo(halo);
+		}
+		tree->consolidate();
+
+		auto features = get_tree_features(*tree);
+		TS_ASSERT_EQUALS(features.subhalos, 4.);
+		TS_ASSERT_EQUALS(features.max_subhalos, 3.);
+		TS_ASSERT_EQUALS(features.mergers, 1.);
+		TS_ASSERT_EQUALS(features.depth, 2.);
+		TS_ASSERT_DELTA(features.max_mvir, 2., 1e-6);
+	}
+
+	void test_timings_roundtrip()
+	{
+		auto timings = make_timings(3, 10);
+		write_tree_timings(filename, timings);
+		auto read = read_tree_timings(filename);
+		TS_ASSERT_EQUALS(read.subvolumes, timings.subvolumes);
+		TS_ASSERT_EQUALS(read.trees.size(), timings.trees.size());
+		TS_ASSERT_EQUALS(read.trees[4].tree_id, 4);
+		TS_ASSERT_EQUALS(read.trees[4].features.max_mvir, timings.trees[4].features.max_mvir);
+		TS_ASSERT_EQUALS(read.trees[4].seconds, timings.trees[4].seconds);
+	}
+
+	void test_fit()
+	{
+		auto model = TreeCostModel::fit({make_timings(3, 50), make_timings(5, 20)});
+		TS_ASSERT(model.enabled());
+		tree_features features;
+		features.subhalos = 100;
+		features.mergers = 4;
+		features.max_mvir = 10;
+		TS_ASSERT_DELTA(model.predict(features), 0.5 + 200 + 1 + 30, 1e-3);
+
+		// Costs of subvolumes evolved on their own are kept, and saved
+		double cost3, cost5, cost;
+		TS_ASSERT(model.subvolume_cost(3, cost3));
+		TS_ASSERT(model.subvolume_cost(5, cost5));
+		TS_ASSERT(!model.subvolume_cost(4, cost));
+		TS_ASSERT_LESS_THAN(cost5, cost3);
+
+		model.save(filename);
+		TreeCostModel loaded(filename);
+		TS_ASSERT(loaded.enabled());
+		TS_ASSERT_EQUALS(loaded.get_weights(), model.get_weights());
+		TS_ASSERT(loaded.subvolume_cost(3, cost));
+		TS_ASSERT_EQUALS(cost, cost3);
+	}
+
+	void test_not_enough_timings()
+	{
+		TS_ASSERT(!TreeCostModel().enabled());
+		TS_ASSERT(!TreeCostModel("").enabled());
+		TS_ASSERT_THROWS(TreeCostModel::fit({make_timings(0, 3)}), const invalid_data &);
+	}
+
+};
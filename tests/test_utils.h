@@ -0,0 +1,64 @@
+//
+// Utilities shared by the unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef SHARK_TEST_UTILS_H_
+#define SHARK_TEST_UTILS_H_
+
+#include <string>
+#include <vector>
+
+#include "execution.h"
+#include "options.h"
+
+namespace shark {
+
+/**
+ * Returns the minimal set of execution options needed to build an
+ * ExecutionParameters object, followed by @p extra_options, which can
+ * also override them.
+ *
+ * @param extra_options Additional options, each of them as "group.name = value"
+ * @return The options
+ */
+inline Options make_test_options(const std::vector<std::string> &extra_options = {})
+{
+	Options opts {};
+	opts.add("execution.output_format = hdf5");
+	opts.add("execution.output_directory = .");
+	opts.add("execution.simulation_batches = 0");
+	opts.add("execution.ode_solver_precision = 0.5");
+	opts.add("execution.name_model = test");
+	opts.add("execution.output_snapshots = 3");
+	for (auto &option: extra_options) {
+		opts.add(option);
+	}
+	return opts;
+}
+
+/// The execution parameters corresponding to make_test_options(@p extra_options)
+inline ExecutionParameters make_test_exec_params(const std::vector<std::string> &extra_options = {})
+{
+	return ExecutionParameters(make_test_options(extra_options));
+}
+
+}  // namespace shark
+
+#endif // SHARK_TEST_UTILS_H_